@@ -0,0 +1,595 @@
+/*! \file    Benchmark.cpp
+ *  \brief   Benchmarks for Pixie's hot paths.
+ *  \author  Peter C. Chapin <pchapin@vtc.edu>
+ *
+ * This program is built and run by "make bench". Each benchmark runs against synthetic task
+ * files of increasing size and the results are written to the standard output as JSON so that
+ * they can be compared between releases. Allocations are counted by replacing the global
+ * operator new, so memory obtained in other ways (by stdio, for example) is not included.
+ *
+ * Usage: pixie-bench [--max-tasks N] [--hot-ratio R] [--description-length L] [--min-time S]
+ *                    [--only name]
+ */
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <fstream>
+#include <iostream>
+#include <new>
+#include <random>
+#include <sstream>
+#include <streambuf>
+#include <string>
+#include <vector>
+
+#if defined(_WIN32)
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "Commands.hpp"
+#include "Calendar.hpp"
+#include "Date.hpp"
+#include "EventIndex.hpp"
+#include "Events.hpp"
+#include "PixieTask.hpp"
+#include "TaskParser.hpp"
+#include "Tasks.hpp"
+
+using namespace std;
+
+namespace {
+
+    std::atomic< unsigned long long > allocation_count( 0 );
+    std::atomic< unsigned long long > allocation_bytes( 0 );
+
+}
+
+
+void *operator new( std::size_t size )
+{
+    allocation_count.fetch_add( 1, memory_order_relaxed );
+    allocation_bytes.fetch_add( size, memory_order_relaxed );
+    void *result = malloc( size == 0 ? 1 : size );
+    if( result == nullptr ) throw bad_alloc( );
+    return result;
+}
+
+
+void operator delete( void *memory ) noexcept
+{
+    free( memory );
+}
+
+
+namespace {
+
+    //! Parameters that apply to every benchmark.
+    struct Settings {
+        std::size_t max_tasks          = 100000;
+        double      hot_ratio          = 0.25;  //!< Fraction of tasks with unmet daily allocations.
+        std::size_t description_length = 40;
+        double      min_time           = 0.2;   //!< Seconds to spend measuring each benchmark.
+        const char *only               = nullptr;
+    };
+
+    Settings settings;
+
+    const char *const bench_folder = "pixie-bench.tmp";
+
+    //! Accumulates the time and allocations spent in the measured parts of a benchmark.
+    class Probe {
+    public:
+        void start( )
+        {
+            allocations = allocation_count.load( memory_order_relaxed );
+            bytes       = allocation_bytes.load( memory_order_relaxed );
+            started     = chrono::steady_clock::now( );
+        }
+
+        void stop( unsigned long long operations_done )
+        {
+            const chrono::steady_clock::time_point finished = chrono::steady_clock::now( );
+            nanoseconds       += chrono::duration< double, nano >( finished - started ).count( );
+            total_allocations += allocation_count.load( memory_order_relaxed ) - allocations;
+            total_bytes       += allocation_bytes.load( memory_order_relaxed ) - bytes;
+            operations        += operations_done;
+        }
+
+        //! True if enough time has been measured (or too many operations done) to stop.
+        bool done( unsigned long long max_operations = 0 ) const
+        {
+            if( max_operations != 0 && operations >= max_operations ) return true;
+            return nanoseconds >= settings.min_time * 1.0E9;
+        }
+
+        double             nanoseconds       = 0.0;
+        unsigned long long operations        = 0;
+        unsigned long long total_allocations = 0;
+        unsigned long long total_bytes       = 0;
+
+    private:
+        chrono::steady_clock::time_point started;
+        unsigned long long allocations = 0;
+        unsigned long long bytes       = 0;
+    };
+
+
+    //! A stream buffer that discards everything written to it.
+    class NullBuffer : public streambuf {
+    protected:
+        int_type overflow( int_type c ) override { return traits_type::not_eof( c ); }
+        streamsize xsputn( const char *, streamsize count ) override { return count; }
+    };
+
+
+    //! Writes one benchmark result as a JSON object.
+    void report( const char *name, std::size_t task_count, const Probe &probe )
+    {
+        static bool first_result = true;
+        const double operations = static_cast< double >( probe.operations == 0 ? 1 : probe.operations );
+
+        cout << ( first_result ? "\n" : ",\n" );
+        first_result = false;
+        cout << "    { \"name\": \"" << name << "\""
+             << ", \"tasks\": " << task_count
+             << ", \"hot_ratio\": " << settings.hot_ratio
+             << ", \"description_length\": " << settings.description_length
+             << ", \"operations\": " << probe.operations
+             << ", \"ns_per_op\": " << probe.nanoseconds / operations
+             << ", \"allocations_per_op\": " << probe.total_allocations / operations
+             << ", \"bytes_per_op\": " << probe.total_bytes / operations
+             << " }" << flush;
+    }
+
+
+    //! True if the named benchmark should run.
+    bool selected( const char *name )
+    {
+        return settings.only == nullptr || strcmp( settings.only, name ) == 0;
+    }
+
+
+    //! Returns today's date the way the task file records it.
+    spica::Date current_date( )
+    {
+        const time_t now = time( NULL );
+        const struct tm * const cooked_time = localtime( &now );
+        spica::Date today;
+        today.set( cooked_time->tm_year + 1900, cooked_time->tm_mon + 1, cooked_time->tm_mday );
+        return today;
+    }
+
+
+    //! Returns the text of a task file holding the given number of synthetic tasks.
+    string make_task_file( std::size_t task_count )
+    {
+        minstd_rand generator( 12345 );
+        uniform_real_distribution< double > fraction( 0.0, 1.0 );
+        ostringstream file;
+
+        file << current_date( ) << " 0\n";
+        for( std::size_t i = 0; i < task_count; ++i ) {
+            int daily = 0;
+            int debt  = 0;
+            if( fraction( generator ) < settings.hot_ratio ) {
+                daily = 30;
+                debt  = 1 + static_cast< int >( generator( ) % 120 );
+            }
+            else if( generator( ) % 2 == 0 ) {
+                daily = 30;
+                debt  = -static_cast< int >( generator( ) % 60 );
+            }
+            file << 0 << ' '
+                 << generator( ) % 1000 << ' '
+                 << generator( ) % 60 << ' '
+                 << daily << ' '
+                 << 1 + generator( ) % 99 << ' '
+                 << debt << ' ';
+
+            string description = "Task " + to_string( i ) + " ";
+            while( description.size( ) < settings.description_length ) {
+                description += static_cast< char >( 'a' + generator( ) % 26 );
+            }
+            file << description << '\n';
+        }
+        return file.str( );
+    }
+
+
+    string task_file_name( )
+    {
+        return string( bench_folder ) + "/.pixie-tasks";
+    }
+
+
+    //! Replaces the task file (and removes any journal) so that initialize_tasks( ) loads it.
+    void install_task_file( const string &contents )
+    {
+        ofstream file( task_file_name( ).c_str( ), ios::binary );
+        file.write( contents.data( ), static_cast< streamsize >( contents.size( ) ) );
+        file.close( );
+        std::remove( ( task_file_name( ) + ".journal" ).c_str( ) );
+        std::remove( ( task_file_name( ) + ".journal.old" ).c_str( ) );
+        std::remove( ( task_file_name( ) + ".lock" ).c_str( ) );
+    }
+
+
+    void bench_parse_line( const string &contents, std::size_t task_count )
+    {
+        const char *const last = contents.data( ) + contents.size( );
+        const char *const first_task = end_of_line( contents.data( ), last ) + 1;
+        Probe probe;
+        PixieTask task;
+
+        do {
+            probe.start( );
+            std::size_t lines = 0;
+            const char *line_start = first_task;
+            while( line_start < last ) {
+                const char *line_end = end_of_line( line_start, last );
+                if( !parse_line( line_start, line_end, task ) ) {
+                    cerr << "pixie-bench: synthetic task file didn't parse\n";
+                    exit( EXIT_FAILURE );
+                }
+                line_start = line_end + 1;
+                ++lines;
+            }
+            probe.stop( lines );
+        } while( !probe.done( ) );
+        report( "parse_line", task_count, probe );
+    }
+
+
+    //! Replaces the task file with the given contents converted to another format.
+    void install_task_file( const string &contents, TaskFileFormat format )
+    {
+        install_task_file( contents );
+        if( format == TaskFileFormat::text ) return;
+        initialize_tasks( );
+        convert_tasks( format );
+        cleanup_tasks( );
+    }
+
+
+    // The task file is loaded by initialize_tasks( ), which also opens the journal.
+    void bench_read_tasks( const string &contents, std::size_t task_count, TaskFileFormat format, const char *name )
+    {
+        Probe probe;
+
+        install_task_file( contents, format );
+        do {
+            probe.start( );
+            initialize_tasks( );
+            probe.stop( 1 );
+            cleanup_tasks( );
+        } while( !probe.done( ) );
+        report( name, task_count, probe );
+    }
+
+
+    // The task file is written by convert_tasks( ), which also empties the journal.
+    void bench_write_tasks( const string &contents, std::size_t task_count, TaskFileFormat format, const char *name )
+    {
+        Probe probe;
+
+        install_task_file( contents );
+        initialize_tasks( );
+        do {
+            probe.start( );
+            convert_tasks( format );
+            probe.stop( 1 );
+        } while( !probe.done( ) );
+        cleanup_tasks( );
+        report( name, task_count, probe );
+    }
+
+
+    // Each sort starts from the unsorted order in the synthetic file.
+    void bench_sort( const string &contents, std::size_t task_count )
+    {
+        Probe probe;
+
+        do {
+            install_task_file( contents );
+            initialize_tasks( );
+            probe.start( );
+            sort_tasks( true );
+            probe.stop( 1 );
+            cleanup_tasks( );
+        } while( !probe.done( ) );
+        report( "compare_tasks/stable_sort", task_count, probe );
+    }
+
+
+    void bench_display_tasks( const string &contents, std::size_t task_count )
+    {
+        Probe probe;
+        NullBuffer null_buffer;
+
+        install_task_file( contents );
+        initialize_tasks( );
+        sort_tasks( );
+        streambuf *const standard_output = cout.rdbuf( &null_buffer );
+        do {
+            probe.start( );
+            display_tasks( );
+            probe.stop( 1 );
+        } while( !probe.done( ) );
+        cout.rdbuf( standard_output );
+        cleanup_tasks( );
+        report( "display_tasks", task_count, probe );
+    }
+
+
+    // A mix of commands that leaves the number of tasks unchanged.
+    void bench_process_command( const string &contents, std::size_t task_count )
+    {
+        const vector< string > commands = {
+            "add 1 5", "priority 2 40", "daily 3 30", "start 4", "stop",
+            "rename 5 A new description for the task", "create Another task", "delete 1",
+            "help", "not_a_command"
+        };
+        const unsigned long long max_commands = 200000; // Limits the size of the journal.
+        Probe probe;
+        NullBuffer null_buffer;
+
+        install_task_file( contents );
+        initialize_tasks( );
+        streambuf *const standard_output = cout.rdbuf( &null_buffer );
+        do {
+            probe.start( );
+            for( const string &command : commands ) {
+                const char *error_message = "";
+                process_command( command, error_message );
+            }
+            probe.stop( commands.size( ) );
+        } while( !probe.done( max_commands ) );
+        cout.rdbuf( standard_output );
+        cleanup_tasks( );
+        report( "process_command", task_count, probe );
+    }
+
+
+    // The search index is built before measuring; each query is a substring, a near match, or neither.
+    void bench_find( const string &contents, std::size_t task_count )
+    {
+        const vector< string > queries = { "task 4242", "tsak 4242", "qzqzq" };
+        Probe probe;
+        NullBuffer null_buffer;
+
+        install_task_file( contents );
+        initialize_tasks( );
+        streambuf *const standard_output = cout.rdbuf( &null_buffer );
+        display_matches( queries[0].data( ), queries[0].data( ) + queries[0].size( ) );
+        do {
+            probe.start( );
+            for( const string &query : queries ) {
+                display_matches( query.data( ), query.data( ) + query.size( ) );
+            }
+            probe.stop( queries.size( ) );
+        } while( !probe.done( ) );
+        cout.rdbuf( standard_output );
+        cleanup_tasks( );
+        report( "find", task_count, probe );
+    }
+
+
+    // Each operation changes one task and then asks the named policy for the next task.
+    void bench_next( const string &contents, std::size_t task_count, const char *policy, const char *name )
+    {
+        Probe probe;
+        NullBuffer null_buffer;
+        std::size_t operation = 0;
+
+        install_task_file( contents );
+        initialize_tasks( );
+        set_policy( policy, policy + strlen( policy ) );
+        streambuf *const standard_output = cout.rdbuf( &null_buffer );
+        display_next( );
+        do {
+            probe.start( );
+            for( int i = 0; i < 10; ++i ) {
+                add_minutes( static_cast< int >( operation++ % task_count ) + 1, 5 );
+                display_next( );
+            }
+            probe.stop( 10 );
+        } while( !probe.done( ) );
+        cout.rdbuf( standard_output );
+        cleanup_tasks( );
+        report( name, task_count, probe );
+    }
+
+
+    // Each operation is another process renaming one task: a record is appended to the journal
+    // and then applied by sync_tasks( ). Compare with read_tasks, which loading the list costs.
+    void bench_sync_tasks( const string &contents, std::size_t task_count )
+    {
+        const unsigned long long max_operations = 100000; // Limits the size of the journal.
+        const string journal_name = task_file_name( ) + ".journal";
+        unsigned long long sequence = 1000000000ULL;
+        Probe probe;
+
+        install_task_file( contents );
+        initialize_tasks( );
+        const unsigned long long task_id = static_cast< unsigned long long >( ::task_id( 1 ) );
+        do {
+            probe.start( );
+            for( int i = 0; i < 10; ++i ) {
+                ofstream journal( journal_name.c_str( ), ios::binary | ios::app );
+                ++sequence;
+                journal << sequence << " E " << task_id << " 0 0 0 0 50 0 Renamed by another process " << sequence << "\n";
+                journal.close( );
+                sync_tasks( );
+            }
+            probe.stop( 10 );
+        } while( !probe.done( max_operations ) );
+        cleanup_tasks( );
+        report( "sync_tasks", task_count, probe );
+    }
+
+
+    // Each operation exports the whole task list as CSV. The output is discarded, so this measures
+    // the formatting; compare the time per task with the write bandwidth of the disk.
+    void bench_export( const string &contents, std::size_t task_count )
+    {
+        const string request = "tasks csv -";
+        Probe probe;
+        NullBuffer null_buffer;
+        const char *error_message;
+
+        install_task_file( contents );
+        initialize_tasks( );
+        streambuf *const standard_output = cout.rdbuf( &null_buffer );
+        do {
+            probe.start( );
+            export_records( request.data( ), request.data( ) + request.size( ), error_message );
+            probe.stop( task_count );
+        } while( !probe.done( ) );
+        cout.rdbuf( standard_output );
+        cleanup_tasks( );
+        report( "export/csv", task_count, probe );
+    }
+
+
+    // Events are built directly in an index holding ten times as many events as there are tasks: a
+    // third recur daily or weekly and the rest occur once over the surrounding two years. Each
+    // operation asks for the events in progress now or for the next ten occurrences.
+    void bench_events( std::size_t task_count, bool upcoming, const char *name )
+    {
+        const std::size_t event_count = 10 * task_count;
+        const std::int64_t now = current_event_minute( );
+        const string description = "Event";
+        minstd_rand generator( 12345 );
+        EventIndex events;
+        vector< EventIndex::Occurrence > occurrences;
+        Probe probe;
+
+        for( std::size_t i = 0; i < event_count; ++i ) {
+            const std::int32_t duration = static_cast< std::int32_t >( 15 + generator( ) % 120 );
+            std::int32_t period = 0;
+            if( i % 3 == 0 ) period = ( generator( ) % 2 == 0 ) ? 1440 : 7 * 1440;
+            const std::int64_t start = now - 365 * 1440 + static_cast< std::int64_t >( generator( ) % ( 2 * 365 * 1440 ) );
+            events.insert( i + 1, start, duration, period, description.data( ), description.data( ) + description.size( ) );
+        }
+        events.compact( );
+        do {
+            probe.start( );
+            for( int i = 0; i < 10; ++i ) {
+                if( upcoming ) events.upcoming( now + i, 10, occurrences );
+                else events.overlapping( now + i, now + i + 1, occurrences );
+            }
+            probe.stop( 10 );
+        } while( !probe.done( ) );
+        report( name, task_count, probe );
+    }
+
+
+    void print_usage( )
+    {
+        cerr << "Usage: pixie-bench [--max-tasks N] [--hot-ratio R] [--description-length L]"
+                " [--min-time S] [--only name]\n"
+                "Benchmarks: parse_line, read_tasks, read_tasks/xml, write_tasks, write_tasks/xml,"
+                " compare_tasks/stable_sort, display_tasks, process_command, find, next/pixie, next/stride,"
+                " next/deadline, next/fair_share, sync_tasks, events/now,"
+                " events/upcoming, export/csv\n";
+    }
+
+
+    bool parse_arguments( int argc, char **argv )
+    {
+        for( int i = 1; i < argc; ++i ) {
+            if( i + 1 == argc ) return false;
+            const char *value = argv[++i];
+            char *end;
+            if( strcmp( argv[i - 1], "--max-tasks" ) == 0 ) {
+                settings.max_tasks = strtoul( value, &end, 10 );
+            }
+            else if( strcmp( argv[i - 1], "--hot-ratio" ) == 0 ) {
+                settings.hot_ratio = strtod( value, &end );
+                if( settings.hot_ratio < 0.0 || settings.hot_ratio > 1.0 ) return false;
+            }
+            else if( strcmp( argv[i - 1], "--description-length" ) == 0 ) {
+                settings.description_length = strtoul( value, &end, 10 );
+            }
+            else if( strcmp( argv[i - 1], "--min-time" ) == 0 ) {
+                settings.min_time = strtod( value, &end );
+            }
+            else if( strcmp( argv[i - 1], "--only" ) == 0 ) {
+                settings.only = value;
+                end = const_cast< char * >( value + strlen( value ) );
+            }
+            else {
+                return false;
+            }
+            if( *end != '\0' ) return false;
+        }
+        return settings.max_tasks >= 10;
+    }
+
+}
+
+
+//! Benchmark entry point.
+int main( int argc, char **argv )
+{
+    if( !parse_arguments( argc, argv ) ) {
+        print_usage( );
+        return EXIT_FAILURE;
+    }
+
+    // The benchmarks use their own task folder.
+#if defined(_WIN32)
+    _mkdir( bench_folder );
+    _putenv_s( "PIXIE_HOME", bench_folder );
+#else
+    mkdir( bench_folder, 0777 );
+    setenv( "PIXIE_HOME", bench_folder, 1 );
+#endif
+
+    cout << "{\n  \"benchmarks\": [";
+    try {
+        for( std::size_t task_count = 10; task_count <= settings.max_tasks; task_count *= 10 ) {
+            const string contents = make_task_file( task_count );
+
+            if( selected( "parse_line"                ) ) bench_parse_line( contents, task_count );
+            if( selected( "read_tasks"                ) ) bench_read_tasks( contents, task_count, TaskFileFormat::text, "read_tasks" );
+            if( selected( "read_tasks/xml"            ) ) bench_read_tasks( contents, task_count, TaskFileFormat::xml, "read_tasks/xml" );
+            if( selected( "write_tasks"               ) ) bench_write_tasks( contents, task_count, TaskFileFormat::text, "write_tasks" );
+            if( selected( "write_tasks/xml"           ) ) bench_write_tasks( contents, task_count, TaskFileFormat::xml, "write_tasks/xml" );
+            if( selected( "compare_tasks/stable_sort" ) ) bench_sort( contents, task_count );
+            if( selected( "display_tasks"             ) ) bench_display_tasks( contents, task_count );
+            if( selected( "process_command"           ) ) bench_process_command( contents, task_count );
+            if( selected( "find"                      ) ) bench_find( contents, task_count );
+            for( const char *policy : { "pixie", "stride", "deadline", "fair_share" } ) {
+                const string name = string( "next/" ) + policy;
+                if( selected( name.c_str( ) ) ) bench_next( contents, task_count, policy, name.c_str( ) );
+            }
+            if( selected( "sync_tasks"                ) ) bench_sync_tasks( contents, task_count );
+            if( selected( "events/now"                ) ) bench_events( task_count, false, "events/now" );
+            if( selected( "events/upcoming"           ) ) bench_events( task_count, true, "events/upcoming" );
+            if( selected( "export/csv"                ) ) bench_export( contents, task_count );
+        }
+    }
+    catch( exception &e ) {
+        cerr << "pixie-bench: " << e.what( ) << "\n";
+        return EXIT_FAILURE;
+    }
+    cout << "\n  ]\n}\n";
+
+    std::remove( task_file_name( ).c_str( ) );
+    std::remove( ( task_file_name( ) + ".journal" ).c_str( ) );
+    std::remove( ( task_file_name( ) + ".lock" ).c_str( ) );
+#if defined(_WIN32)
+    _rmdir( bench_folder );
+#else
+    rmdir( bench_folder );
+#endif
+    return EXIT_SUCCESS;
+}
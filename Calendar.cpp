@@ -0,0 +1,53 @@
+/*! \file    Calendar.cpp
+ *  \brief   Day numbers.
+ *  \author  Peter C. Chapin <pchapin@vtc.edu>
+ */
+
+#include <cstring>
+
+#include "Calendar.hpp"
+
+using namespace std;
+
+long days_from_civil( long year, int month, int day ) noexcept
+{
+    year -= ( month <= 2 );
+    const long era = ( year >= 0 ? year : year - 399 ) / 400;
+    const long year_of_era = year - era * 400;
+    const long day_of_year = ( 153 * ( month > 2 ? month - 3 : month + 9 ) + 2 ) / 5 + day - 1;
+    const long day_of_era = year_of_era * 365 + year_of_era / 4 - year_of_era / 100 + day_of_year;
+    return era * 146097 + day_of_era - 719468;
+}
+
+
+void civil_from_days( long days, long &year, int &month, int &day ) noexcept
+{
+    days += 719468;
+    const long era = ( days >= 0 ? days : days - 146096 ) / 146097;
+    const long day_of_era = days - era * 146097;
+    const long year_of_era = ( day_of_era - day_of_era / 1460 + day_of_era / 36524 - day_of_era / 146096 ) / 365;
+    const long day_of_year = day_of_era - ( 365 * year_of_era + year_of_era / 4 - year_of_era / 100 );
+    const long month_index = ( 5 * day_of_year + 2 ) / 153;
+    day   = static_cast< int >( day_of_year - ( 153 * month_index + 2 ) / 5 + 1 );
+    month = static_cast< int >( month_index < 10 ? month_index + 3 : month_index - 9 );
+    year  = year_of_era + era * 400 + ( month <= 2 );
+}
+
+
+long day_number( time_t time )
+{
+    const struct tm * const cooked_time = localtime( &time );
+    return days_from_civil( cooked_time->tm_year + 1900L, cooked_time->tm_mon + 1, cooked_time->tm_mday );
+}
+
+
+time_t day_start( long day )
+{
+    // mktime( ) normalizes the day of the month.
+    struct tm cooked_time;
+    memset( &cooked_time, 0, sizeof( cooked_time ) );
+    cooked_time.tm_year  = 70;
+    cooked_time.tm_mday  = static_cast< int >( 1 + day );
+    cooked_time.tm_isdst = -1;
+    return mktime( &cooked_time );
+}
@@ -0,0 +1,26 @@
+/*! \file    Calendar.hpp
+ *  \brief   Day numbers.
+ *  \author  Peter C. Chapin <pchapin@vtc.edu>
+ */
+
+#ifndef CALENDAR_HPP
+#define CALENDAR_HPP
+
+#include <ctime>
+
+//! Returns the number of days from 1970-01-01 to the given date in the Gregorian calendar.
+/*!
+ * Days are numbered consecutively with day zero being 1970-01-01. Months range from 1 to 12.
+ */
+long days_from_civil( long year, int month, int day ) noexcept;
+
+//! Returns the date in the Gregorian calendar of a day numbered as by days_from_civil( ).
+void civil_from_days( long days, long &year, int &month, int &day ) noexcept;
+
+//! Returns the number of the local calendar day that contains the given time.
+long day_number( std::time_t time );
+
+//! Returns the time at which the given local calendar day starts.
+std::time_t day_start( long day );
+
+#endif
@@ -0,0 +1,158 @@
+/*! \file    CommandTrace.cpp
+ *  \brief   Recording of the commands given to Pixie.
+ *  \author  Peter C. Chapin <pchapin@vtc.edu>
+ *
+ * A trace file starts with the magic string "PIXIETRC" followed by the format version and the
+ * time at which the trace was started (in microseconds since the epoch). Each record then holds
+ * the microseconds since the previous record, the length of the command line, and the command
+ * line itself. Numbers are stored in seven bit groups, least significant first, with the high bit
+ * of each byte set if another byte follows. This keeps a typical record to a few bytes more than
+ * its command and makes the file independent of the byte order of the machine.
+ *
+ * Commands are only executed by the main thread (the daemon is single threaded too), so the
+ * recorder needs no locking.
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+
+#include "CommandTrace.hpp"
+
+using namespace std;
+
+std::atomic< bool > trace_on( false );
+
+namespace {
+
+    const char          trace_magic[8]     = { 'P', 'I', 'X', 'I', 'E', 'T', 'R', 'C' };
+    const std::uint64_t trace_version      = 1;
+    const std::uint64_t max_command_length = 1024 * 1024;  //!< Longer records mean a damaged trace.
+
+    FILE *trace_file = nullptr;
+    chrono::steady_clock::time_point last_record;  //!< Time of the previous record.
+
+    //! Stores value at buffer and returns the end of the encoding (at most ten bytes).
+    char *encode_number( std::uint64_t value, char *buffer ) noexcept
+    {
+        while( value >= 0x80 ) {
+            *buffer++ = static_cast< char >( ( value & 0x7F ) | 0x80 );
+            value >>= 7;
+        }
+        *buffer++ = static_cast< char >( value );
+        return buffer;
+    }
+
+}
+
+
+bool start_trace( const string &file_name )
+{
+    stop_trace( );
+    trace_file = fopen( file_name.c_str( ), "wb" );
+    if( trace_file == nullptr ) return false;
+
+    const std::int64_t now = chrono::duration_cast< chrono::microseconds >(
+        chrono::system_clock::now( ).time_since_epoch( ) ).count( );
+    char header[sizeof( trace_magic ) + 20];
+    memcpy( header, trace_magic, sizeof( trace_magic ) );
+    char *end = encode_number( trace_version, header + sizeof( trace_magic ) );
+    end = encode_number( static_cast< std::uint64_t >( now ), end );
+    if( fwrite( header, 1, static_cast< size_t >( end - header ), trace_file ) != static_cast< size_t >( end - header ) ||
+        fflush( trace_file ) != 0 ) {
+        fclose( trace_file );
+        trace_file = nullptr;
+        return false;
+    }
+    last_record = chrono::steady_clock::now( );
+    trace_on.store( true, memory_order_relaxed );
+    return true;
+}
+
+
+void stop_trace( ) noexcept
+{
+    trace_on.store( false, memory_order_relaxed );
+    if( trace_file != nullptr ) {
+        fclose( trace_file );
+        trace_file = nullptr;
+    }
+}
+
+
+void record_command( const char *first, const char *last ) noexcept
+{
+    if( !tracing_enabled( ) ) return;
+
+    const chrono::steady_clock::time_point now = chrono::steady_clock::now( );
+    const std::int64_t delay = chrono::duration_cast< chrono::microseconds >( now - last_record ).count( );
+    last_record = now;
+
+    const size_t length = static_cast< size_t >( last - first );
+    char prefix[20];
+    char *end = encode_number( static_cast< std::uint64_t >( delay ), prefix );
+    end = encode_number( length, end );
+    const size_t prefix_size = static_cast< size_t >( end - prefix );
+    if( fwrite( prefix, 1, prefix_size, trace_file ) != prefix_size ||
+        fwrite( first, 1, length, trace_file ) != length ||
+        fflush( trace_file ) != 0 ) {
+        stop_trace( );
+    }
+}
+
+
+TraceReader::TraceReader( istream &input ) : input( input )
+{
+    char magic[sizeof( trace_magic )];
+    std::uint64_t version;
+    std::uint64_t start;
+
+    if( !input.read( magic, sizeof( magic ) ) || memcmp( magic, trace_magic, sizeof( magic ) ) != 0 ) {
+        problem = "not a trace file";
+        return;
+    }
+    if( !read_number( version ) || !read_number( start ) ) {
+        problem = "truncated trace header";
+        return;
+    }
+    if( version != trace_version ) {
+        problem = "unsupported trace version";
+        return;
+    }
+    started = static_cast< std::int64_t >( start );
+}
+
+
+bool TraceReader::next( std::int64_t &offset, string &command )
+{
+    std::uint64_t delay;
+    std::uint64_t length;
+
+    if( problem != nullptr ) return false;
+    if( input.peek( ) == istream::traits_type::eof( ) ) return false;
+    if( !read_number( delay ) || !read_number( length ) || length > max_command_length ) {
+        problem = "damaged trace record";
+        return false;
+    }
+    command.resize( static_cast< size_t >( length ) );
+    if( length != 0 && !input.read( &command[0], static_cast< streamsize >( length ) ) ) {
+        problem = "truncated trace record";
+        return false;
+    }
+    elapsed += static_cast< std::int64_t >( delay );
+    offset = elapsed;
+    return true;
+}
+
+
+bool TraceReader::read_number( std::uint64_t &value )
+{
+    value = 0;
+    for( int shift = 0; shift < 64; shift += 7 ) {
+        const int byte = input.get( );
+        if( byte == istream::traits_type::eof( ) ) return false;
+        value |= static_cast< std::uint64_t >( byte & 0x7F ) << shift;
+        if( ( byte & 0x80 ) == 0 ) return true;
+    }
+    return false;
+}
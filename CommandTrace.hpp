@@ -0,0 +1,69 @@
+/*! \file    CommandTrace.hpp
+ *  \brief   Recording of the commands given to Pixie.
+ *  \author  Peter C. Chapin <pchapin@vtc.edu>
+ *
+ * A trace holds every command line passed to process_command( ) along with the time at which it
+ * arrived, so that a workload can be replayed later (see Replay.cpp). Recording is off by default;
+ * while it is off process_command( ) only tests a flag.
+ */
+
+#ifndef COMMANDTRACE_HPP
+#define COMMANDTRACE_HPP
+
+#include <atomic>
+#include <cstdint>
+#include <istream>
+#include <string>
+
+extern std::atomic< bool > trace_on;  //!< Use tracing_enabled( ) instead.
+
+//! Returns true if commands are being recorded.
+inline bool tracing_enabled( ) noexcept
+{
+    return trace_on.load( std::memory_order_relaxed );
+}
+
+//! Starts recording commands in a new trace file, replacing any existing file of that name.
+/*!
+ * Returns false if the file can't be created.
+ */
+bool start_trace( const std::string &file_name );
+
+//! Stops recording and closes the trace file.
+void stop_trace( ) noexcept;
+
+//! Appends the command line [first, last) to the trace. Does nothing unless tracing is enabled.
+/*!
+ * Each record is written to the file immediately, so a trace is complete up to the last command
+ * even if Pixie doesn't exit normally. Recording stops if the file can't be written.
+ */
+void record_command( const char *first, const char *last ) noexcept;
+
+//! Reads the records of a trace file in order.
+class TraceReader {
+public:
+    //! Reads the header of the trace. Check error( ) before reading any records.
+    explicit TraceReader( std::istream &input );
+
+    //! Returns a description of the problem if the trace is damaged, otherwise nullptr.
+    const char *error( ) const noexcept { return problem; }
+
+    //! Returns the time at which the trace was started, in microseconds since the epoch.
+    std::int64_t start_time( ) const noexcept { return started; }
+
+    //! Reads the next record. Returns false at the end of the trace or if it is damaged.
+    /*!
+     * The offset of a record is the number of microseconds from the start of the trace.
+     */
+    bool next( std::int64_t &offset, std::string &command );
+
+private:
+    std::istream &input;
+    const char   *problem = nullptr;
+    std::int64_t  started = 0;
+    std::int64_t  elapsed = 0;
+
+    bool read_number( std::uint64_t &value );
+};
+
+#endif
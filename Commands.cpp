@@ -0,0 +1,622 @@
+/*! \file    Commands.cpp
+ *  \brief   Interpretation of Pixie commands.
+ *  \author  Peter C. Chapin <pchapin@vtc.edu>
+ *
+ * Each command is described by an entry in a static table that gives its name, the arguments it
+ * takes, and the function that carries it out. Commands are located with a small hash table
+ * built from the command table when the first command is processed.
+ */
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <string>
+
+#include "CommandTrace.hpp"
+#include "Commands.hpp"
+#include "Events.hpp"
+#include "Export.hpp"
+#include "Statistics.hpp"
+#include "Tasks.hpp"
+
+using namespace std;
+
+namespace {
+
+    //! Kinds of arguments that appear on a command line.
+    enum class Argument {
+        none,      //!< Marks the end of an argument list.
+        task,      //!< A task number or #ID; must refer to an existing task.
+        integer,   //!< Any integer.
+        daily,     //!< A daily allocation in minutes (0 or more).
+        priority,  //!< A priority level (1 .. 99).
+        weeks,     //!< A number of weeks (1 .. 520).
+        count,     //!< A number of tasks (0 or more).
+        page,      //!< A page number (1 or more).
+        shard,     //!< The name of a shard (see move_task( )).
+        policy,    //!< The name of a scheduling policy (see set_policy( )).
+        event,     //!< An event ID, with or without #; must refer to an existing event.
+        time,      //!< A date, optionally with a time of day (see parse_event_time( )).
+        duration,  //!< A number of minutes (0 or more).
+        days,      //!< A number of days (0 .. 3660).
+        listed,    //!< A number of items to list (1 or more).
+        exported,  //!< The rest of the command line, checked by parse_export( ). Must be the last argument.
+        text       //!< The rest of the command line. Must be the last argument.
+    };
+
+    const int max_arguments = 3;
+
+    //! The arguments of a command after they have been checked.
+    struct Arguments {
+        TaskRef       task{ 0 };             //!< The task argument (if any).
+        std::uint64_t event;                 //!< The event argument (if any).
+        std::int64_t  time;                  //!< The time argument (if any) as a minute number.
+        int           number[max_arguments]; //!< Value of each numeric argument, in order. Zero for a task, event, or time.
+        const char   *text;                  //!< The text or shard argument (if any). Not null terminated.
+        std::size_t   text_size;
+    };
+
+    //! Description of a single command.
+    struct Command {
+        const char *name;
+        Argument    arguments[max_arguments];
+        CommandStatus ( *handler )( const Arguments & );
+        const char *usage;
+        const char *description;
+    };
+
+    CommandStatus do_help( const Arguments & );
+
+    CommandStatus do_add( const Arguments &a )
+    {
+        add_minutes( a.task, a.number[1] );
+        return CommandStatus::ok;
+    }
+
+    CommandStatus do_agenda( const Arguments &a )
+    {
+        display_agenda( a.number[0] );
+        return CommandStatus::ok;
+    }
+
+    CommandStatus do_cancel( const Arguments &a )
+    {
+        cancel_event( a.event );
+        return CommandStatus::ok;
+    }
+
+    CommandStatus do_create( const Arguments &a )
+    {
+        create_task( a.text, a.text + a.text_size, 50 );
+        return CommandStatus::ok;
+    }
+
+    CommandStatus do_daily( const Arguments &a )
+    {
+        change_daily( a.task, a.number[1] );
+        return CommandStatus::ok;
+    }
+
+    CommandStatus do_delete( const Arguments &a )
+    {
+        delete_task( a.task );
+        return CommandStatus::ok;
+    }
+
+    CommandStatus do_event( const Arguments &a )
+    {
+        const std::uint64_t event_id = create_event( a.time, a.number[1], a.text, a.text + a.text_size );
+        if( event_id != 0 ) cout << "Created event #" << event_id << "\n";
+        return CommandStatus::ok;
+    }
+
+    CommandStatus do_events( const Arguments &a )
+    {
+        display_upcoming( a.number[0] );
+        return CommandStatus::ok;
+    }
+
+    CommandStatus do_export( const Arguments &a )
+    {
+        const char *error_message = "";
+        if( !export_records( a.text, a.text + a.text_size, error_message ) ) {
+            cout << "The export failed: " << error_message << "\n";
+        }
+        return CommandStatus::ok;
+    }
+
+    CommandStatus do_find( const Arguments &a )
+    {
+        display_matches( a.text, a.text + a.text_size );
+        return CommandStatus::ok;
+    }
+
+    CommandStatus do_id( const Arguments &a )
+    {
+        cout << task_id( a.task ) << "\n";
+        return CommandStatus::ok;
+    }
+
+    CommandStatus do_mem( const Arguments & )
+    {
+        display_memory( );
+        return CommandStatus::ok;
+    }
+
+    CommandStatus do_policy( const Arguments &a )
+    {
+        set_policy( a.text, a.text + a.text_size );
+        return CommandStatus::ok;
+    }
+
+    CommandStatus do_priority( const Arguments &a )
+    {
+        change_priority( a.task, a.number[1] );
+        return CommandStatus::ok;
+    }
+
+    CommandStatus do_quit( const Arguments & )
+    {
+        return CommandStatus::quit;
+    }
+
+    CommandStatus do_repeat( const Arguments &a )
+    {
+        if( !repeat_event( a.event, a.number[1] ) ) {
+            cout << "An event must be shorter than the time between its occurrences\n";
+        }
+        return CommandStatus::ok;
+    }
+
+    CommandStatus do_report( const Arguments &a )
+    {
+        display_report( a.number[0] );
+        return CommandStatus::ok;
+    }
+
+    CommandStatus do_rename( const Arguments &a )
+    {
+        rename( a.task, a.text, a.text + a.text_size );
+        return CommandStatus::ok;
+    }
+
+    CommandStatus do_save( const Arguments & )
+    {
+        save_tasks( );
+        return CommandStatus::ok;
+    }
+
+    CommandStatus do_now( const Arguments & )
+    {
+        display_current_events( );
+        return CommandStatus::ok;
+    }
+
+    CommandStatus do_next( const Arguments & )
+    {
+        display_next( );
+        return CommandStatus::ok;
+    }
+
+    CommandStatus do_page( const Arguments &a )
+    {
+        show_page( a.number[0] );
+        return CommandStatus::ok;
+    }
+
+    CommandStatus do_shard( const Arguments &a )
+    {
+        if( !move_task( a.task, a.text, a.text + a.text_size ) ) {
+            cout << "That shard can't be used\n";
+        }
+        return CommandStatus::ok;
+    }
+
+    CommandStatus do_shards( const Arguments & )
+    {
+        display_shards( );
+        return CommandStatus::ok;
+    }
+
+    CommandStatus do_shutdown( const Arguments & )
+    {
+        return CommandStatus::shutdown;
+    }
+
+    CommandStatus do_show( const Arguments &a )
+    {
+        show_tasks( a.number[0] );
+        return CommandStatus::ok;
+    }
+
+    CommandStatus do_start( const Arguments &a )
+    {
+        start_task( a.task );
+        return CommandStatus::ok;
+    }
+
+    CommandStatus do_stats( const Arguments & )
+    {
+        display_statistics( cout );
+        return CommandStatus::ok;
+    }
+
+    CommandStatus do_stop( const Arguments & )
+    {
+        stop_tasks( );
+        return CommandStatus::ok;
+    }
+
+    CommandStatus do_undo_daily( const Arguments & )
+    {
+        undo_daily( );
+        return CommandStatus::ok;
+    }
+
+    CommandStatus do_zero( const Arguments & )
+    {
+        zero_tasks( );
+        return CommandStatus::ok;
+    }
+
+    //! All of Pixie's commands. The help command lists them in this order.
+    const Command commands[] = {
+        { "quit",       { Argument::none },
+          do_quit,       "quit",                    "Terminate Pixie, saving automatically" },
+        { "add",        { Argument::task, Argument::integer },
+          do_add,        "add task_no minutes",     "Adds 'minutes' to task 'task_no'" },
+        { "agenda",     { Argument::days },
+          do_agenda,     "agenda days",             "Lists the events from now to the end of the day 'days' days from today" },
+        { "cancel",     { Argument::event },
+          do_cancel,     "cancel event_id",         "Deletes event 'event_id'" },
+        { "create",     { Argument::text },
+          do_create,     "create task_name",        "Creates a task 'task_name'. The name can contain spaces" },
+        { "daily",      { Argument::task, Argument::daily },
+          do_daily,      "daily task_no minutes",   "Sets task 'task_no' to have 'minutes' daily minutes" },
+        { "delete",     { Argument::task },
+          do_delete,     "delete task_no",          "Deletes task 'task_no'" },
+        { "event",      { Argument::time, Argument::duration, Argument::text },
+          do_event,      "event when minutes name", "Creates an event at 'when' (2026-10-18 or 2026-10-18T14:30) lasting 'minutes'" },
+        { "events",     { Argument::listed },
+          do_events,     "events count",            "Lists the next 'count' events" },
+        { "export",     { Argument::exported },
+          do_export,     "export what format file", "Writes 'tasks' or 'sessions' to 'file' (- for the screen) as 'csv' or 'jsonl'" },
+        { "find",       { Argument::text },
+          do_find,       "find text",               "Lists the tasks whose names contain 'text' (~ marks near matches)" },
+        { "help",       { Argument::none },
+          do_help,       "help",                    "Displays this list of commands" },
+        { "id",         { Argument::task },
+          do_id,         "id task_no",              "Displays the ID of task 'task_no'. Commands accept #ID for task_no" },
+        { "mem",        { Argument::none },
+          do_mem,        "mem",                     "Displays the memory used by the task list" },
+        { "next",       { Argument::none },
+          do_next,       "next",                    "Displays the task that the scheduling policy suggests working on next" },
+        { "now",        { Argument::none },
+          do_now,        "now",                     "Lists the events in progress now" },
+        { "page",       { Argument::page },
+          do_page,       "page number",             "Displays page 'number' of the tasks, in pages of the size set by show" },
+        { "policy",     { Argument::policy },
+          do_policy,     "policy name",             "Uses policy 'name' for next: pixie, stride, deadline, or fair_share" },
+        { "priority",   { Argument::task, Argument::priority },
+          do_priority,   "priority task_no pri",    "Sets task 'task_no' to priority 'pri'" },
+        { "rename",     { Argument::task, Argument::text },
+          do_rename,     "rename task_no new_name", "Changes task 'task_no' to the name 'new_name'" },
+        { "repeat",     { Argument::event, Argument::days },
+          do_repeat,     "repeat event_id days",    "Makes event 'event_id' recur every 'days' days (0 for once)" },
+        { "report",     { Argument::weeks },
+          do_report,     "report weeks",            "Displays the minutes spent on each task in each of the last 'weeks' weeks" },
+        { "save",       { Argument::none },
+          do_save,       "save",                    "Saves current state now" },
+        { "shard",      { Argument::task, Argument::shard },
+          do_shard,      "shard task_no name",      "Moves task 'task_no' to shard 'name' (- for the main task file)" },
+        { "shards",     { Argument::none },
+          do_shards,     "shards",                  "Lists the shards and the number of tasks in each" },
+        { "show",       { Argument::count },
+          do_show,       "show count",              "Displays only the first 'count' tasks (0 displays all)" },
+        { "shutdown",   { Argument::none },
+          do_shutdown,   "shutdown",                "Stops the daemon, saving automatically (like quit elsewhere)" },
+        { "start",      { Argument::task },
+          do_start,      "start task_no",           "Starts task 'task_no'" },
+        { "stats",      { Argument::none },
+          do_stats,      "stats",                   "Displays command latencies and I/O statistics" },
+        { "stop",       { Argument::none },
+          do_stop,       "stop",                    "Stops the currently running task" },
+        { "undo_daily", { Argument::none },
+          do_undo_daily, "undo_daily",              "Removes one day's worth of daily accumulation from all tasks" },
+        { "zero",       { Argument::none },
+          do_zero,       "zero",                    "Sets all times to zero" },
+    };
+
+    const std::size_t command_count = sizeof( commands ) / sizeof( commands[0] );
+
+    CommandStatus do_help( const Arguments & )
+    {
+        for( std::size_t i = 0; i < command_count; ++i ) {
+            cout << left << setw( 24 ) << commands[i].usage << right << ": " << commands[i].description << "\n";
+        }
+        return CommandStatus::ok;
+    }
+
+
+    // Open addressing hash table mapping command names to entries in the command table. Each
+    // slot holds an index into the command table plus one; zero marks an empty slot.
+    //
+    const std::size_t command_slots = 128;  //!< Must be a power of two larger than command_count.
+    unsigned char     command_index[command_slots];
+    bool              command_index_ready = false;
+    LatencyProbe     *command_probes[command_count];  //!< Statistics for each command.
+
+    static_assert( command_slots > 2 * command_count,
+                   "The command hash table is too small" );
+    static_assert( command_count + fixed_probes <= max_probes,
+                   "The statistics can't have a probe for every command" );
+
+    //! FNV-1a hash of the text in [first, last).
+    std::size_t hash_name( const char *first, const char *last ) noexcept
+    {
+        std::size_t hash = 2166136261U;
+        while( first != last ) {
+            hash ^= static_cast< unsigned char >( *first++ );
+            hash *= 16777619U;
+        }
+        return hash;
+    }
+
+
+    void index_commands( ) noexcept
+    {
+        for( std::size_t i = 0; i < command_count; ++i ) {
+            const char *name = commands[i].name;
+            std::size_t slot = hash_name( name, name + strlen( name ) ) & ( command_slots - 1 );
+            while( command_index[slot] != 0 ) slot = ( slot + 1 ) & ( command_slots - 1 );
+            command_index[slot] = static_cast< unsigned char >( i + 1 );
+            command_probes[i] = &find_probe( name );
+        }
+        command_index_ready = true;
+    }
+
+
+    //! Returns the command named by [first, last) or nullptr if there is no such command.
+    const Command *find_command( const char *first, const char *last ) noexcept
+    {
+        if( !command_index_ready ) index_commands( );
+
+        const std::size_t length = static_cast< std::size_t >( last - first );
+        std::size_t slot = hash_name( first, last ) & ( command_slots - 1 );
+        while( command_index[slot] != 0 ) {
+            const Command &candidate = commands[command_index[slot] - 1];
+            if( length == strlen( candidate.name ) && memcmp( candidate.name, first, length ) == 0 )
+                return &candidate;
+            slot = ( slot + 1 ) & ( command_slots - 1 );
+        }
+        return nullptr;
+    }
+
+
+    bool is_blank( char ch ) noexcept
+    {
+        return ch == ' ' || ch == '\t' || ch == '\r';
+    }
+
+
+    //! Parses [first, last) as a task ID (a positive decimal number). Returns false if it isn't one.
+    bool parse_id( const char *first, const char *last, std::uint64_t &value ) noexcept
+    {
+        std::uint64_t result = 0;
+        if( first == last ) return false;
+        while( first != last ) {
+            if( *first < '0' || *first > '9' ) return false;
+            const unsigned digit = static_cast< unsigned >( *first - '0' );
+            if( result > ( numeric_limits< std::uint64_t >::max( ) - digit ) / 10 ) return false;
+            result = 10 * result + digit;
+            ++first;
+        }
+        value = result;
+        return result != 0;
+    }
+
+
+    //! Parses [first, last) as a decimal int. Returns false if it isn't one.
+    bool parse_int( const char *first, const char *last, int &value ) noexcept
+    {
+        const long long limit = numeric_limits< int >::max( );
+        long long result   = 0;
+        bool      negative = false;
+
+        if( first != last && ( *first == '-' || *first == '+' ) ) {
+            negative = ( *first == '-' );
+            ++first;
+        }
+        if( first == last ) return false;
+        while( first != last ) {
+            if( *first < '0' || *first > '9' ) return false;
+            result = 10 * result + ( *first - '0' );
+            if( result > limit ) return false;
+            ++first;
+        }
+        value = static_cast< int >( negative ? -result : result );
+        return true;
+    }
+
+}
+
+
+CommandStatus process_command( const char *first, const char *last, const char *&error_message )
+{
+    static LatencyProbe &probe = find_probe( "process_command( )" );
+    LatencyTimer timer( probe );
+    Arguments arguments;
+
+    record_command( first, last );
+
+    // Locate the command name.
+    while( first != last && is_blank( *first ) ) ++first;
+    if( first == last ) return CommandStatus::ok;
+    const char *name_end = first;
+    while( name_end != last && !is_blank( *name_end ) ) ++name_end;
+
+    const Command *command = find_command( first, name_end );
+    if( command == nullptr ) {
+        error_message = "unknown command";
+        return CommandStatus::error;
+    }
+
+    // Check the arguments against what the command expects.
+    const char *cursor = name_end;
+    int number_count = 0;
+    arguments.text = nullptr;
+    arguments.text_size = 0;
+    for( int i = 0; i < max_arguments && command->arguments[i] != Argument::none; ++i ) {
+        while( cursor != last && is_blank( *cursor ) ) ++cursor;
+        if( cursor == last ) {
+            error_message = "missing argument";
+            return CommandStatus::error;
+        }
+
+        const Argument kind = command->arguments[i];
+        if( kind == Argument::text || kind == Argument::exported ) {
+            const char *text_end = last;
+            while( text_end != cursor && is_blank( text_end[-1] ) ) --text_end;
+            ExportRequest request;
+            if( kind == Argument::exported && !parse_export( cursor, text_end, request, error_message ) ) {
+                return CommandStatus::error;
+            }
+            arguments.text = cursor;
+            arguments.text_size = static_cast< std::size_t >( text_end - cursor );
+            cursor = last;
+            break;
+        }
+
+        const char *word_end = cursor;
+        while( word_end != last && !is_blank( *word_end ) ) ++word_end;
+        if( kind == Argument::shard ) {
+            if( !is_shard_name( cursor, word_end ) ) {
+                error_message = "shard names start with a letter or digit and contain only letters, digits, and . - _";
+                return CommandStatus::error;
+            }
+            arguments.text = cursor;
+            arguments.text_size = static_cast< std::size_t >( word_end - cursor );
+            cursor = word_end;
+            continue;
+        }
+        if( kind == Argument::policy ) {
+            if( !is_policy_name( cursor, word_end ) ) {
+                error_message = "the scheduling policies are pixie, stride, deadline, and fair_share";
+                return CommandStatus::error;
+            }
+            arguments.text = cursor;
+            arguments.text_size = static_cast< std::size_t >( word_end - cursor );
+            cursor = word_end;
+            continue;
+        }
+        int &value = arguments.number[number_count++];
+        if( kind == Argument::event ) {
+            std::uint64_t event_id;
+            if( !parse_id( cursor + ( *cursor == '#' ), word_end, event_id ) || !event_exists( event_id ) ) {
+                error_message = "no such event";
+                return CommandStatus::error;
+            }
+            arguments.event = event_id;
+            value  = 0;
+            cursor = word_end;
+            continue;
+        }
+        if( kind == Argument::time ) {
+            if( !parse_event_time( cursor, word_end, arguments.time ) ) {
+                error_message = "times look like 2026-10-18 or 2026-10-18T14:30";
+                return CommandStatus::error;
+            }
+            value  = 0;
+            cursor = word_end;
+            continue;
+        }
+        if( kind == Argument::task && *cursor == '#' ) {
+            std::uint64_t task_id;
+            if( !parse_id( cursor + 1, word_end, task_id ) || !task_exists( TaskRef::from_id( task_id ) ) ) {
+                error_message = "no such task";
+                return CommandStatus::error;
+            }
+            arguments.task = TaskRef::from_id( task_id );
+            value  = 0;
+            cursor = word_end;
+            continue;
+        }
+        if( !parse_int( cursor, word_end, value ) ) {
+            error_message = "argument must be an integer";
+            return CommandStatus::error;
+        }
+        cursor = word_end;
+
+        switch( kind ) {
+        case Argument::task:
+            if( !task_exists( value ) ) {
+                error_message = "no such task";
+                return CommandStatus::error;
+            }
+            arguments.task = value;
+            value = 0;
+            break;
+        case Argument::daily:
+            if( value < 0 ) {
+                error_message = "daily minutes must not be negative";
+                return CommandStatus::error;
+            }
+            break;
+        case Argument::priority:
+            if( value < 1 || value > 99 ) {
+                error_message = "priority must be between 1 and 99";
+                return CommandStatus::error;
+            }
+            break;
+        case Argument::weeks:
+            if( value < 1 || value > 520 ) {
+                error_message = "weeks must be between 1 and 520";
+                return CommandStatus::error;
+            }
+            break;
+        case Argument::count:
+            if( value < 0 ) {
+                error_message = "count must not be negative";
+                return CommandStatus::error;
+            }
+            break;
+        case Argument::page:
+            if( value < 1 ) {
+                error_message = "page must be at least 1";
+                return CommandStatus::error;
+            }
+            break;
+        case Argument::duration:
+            if( value < 0 ) {
+                error_message = "minutes must not be negative";
+                return CommandStatus::error;
+            }
+            break;
+        case Argument::days:
+            if( value < 0 || value > 3660 ) {
+                error_message = "days must be between 0 and 3660";
+                return CommandStatus::error;
+            }
+            break;
+        case Argument::listed:
+            if( value < 1 ) {
+                error_message = "count must be at least 1";
+                return CommandStatus::error;
+            }
+            break;
+        default:
+            break;
+        }
+    }
+
+    while( cursor != last && is_blank( *cursor ) ) ++cursor;
+    if( cursor != last ) {
+        error_message = "too many arguments";
+        return CommandStatus::error;
+    }
+    LatencyTimer command_timer( *command_probes[command - commands] );
+    return command->handler( arguments );
+}
@@ -0,0 +1,33 @@
+/*! \file    Commands.hpp
+ *  \brief   Interpretation of Pixie commands.
+ *  \author  Peter C. Chapin <pchapin@vtc.edu>
+ */
+
+#ifndef COMMANDS_HPP
+#define COMMANDS_HPP
+
+#include <string>
+
+//! Outcome of a single command.
+enum class CommandStatus {
+    ok,     //!< The command was executed.
+    error,    //!< The command was not understood and nothing was done.
+    quit,     //!< The command asks Pixie (or a daemon's client) to terminate.
+    shutdown  //!< The command asks a daemon to stop; elsewhere it is the same as quit.
+};
+
+//! Executes the command in [first, last).
+/*!
+ * The command line is examined in place; no memory is allocated except as needed by the
+ * command itself. If the command can't be executed, error_message is set to a description of
+ * the problem.
+ */
+CommandStatus process_command( const char *first, const char *last, const char *&error_message );
+
+//! Executes the command in the given string.
+inline CommandStatus process_command( const std::string &command_line, const char *&error_message )
+{
+    return process_command( command_line.data( ), command_line.data( ) + command_line.size( ), error_message );
+}
+
+#endif
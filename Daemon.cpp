@@ -0,0 +1,517 @@
+/*! \file    Daemon.cpp
+ *  \brief   Resident daemon serving Pixie commands over a Unix domain socket.
+ *  \author  Peter C. Chapin <pchapin@vtc.edu>
+ *
+ * The daemon is a single threaded epoll loop, so commands from different clients never run
+ * concurrently. Sockets are edge triggered; each event drains the socket, executes every
+ * complete command line received, and sends as much of the reply as the socket accepts. Output
+ * written to cout by the commands themselves (help, mem, stats) is captured into the reply. Each
+ * command's changes are committed as soon as it completes. The loop also wakes at midnight to
+ * roll the task list over to the new day.
+ */
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#define PIXIE_HAVE_UNIX_SOCKETS
+#endif
+
+#if defined(__linux__)
+#include <sys/epoll.h>
+#include <sys/signalfd.h>
+#define PIXIE_HAVE_EPOLL
+#endif
+
+#include "Calendar.hpp"
+#include "Commands.hpp"
+#include "Daemon.hpp"
+#include "Events.hpp"
+#include "Tasks.hpp"
+
+using namespace std;
+
+namespace {
+
+#if defined(PIXIE_HAVE_UNIX_SOCKETS)
+
+    //! Fills in the address of the named socket. Returns false if the name is too long.
+    bool make_address( const string &name, sockaddr_un &address )
+    {
+        memset( &address, 0, sizeof( address ) );
+        address.sun_family = AF_UNIX;
+        if( name.size( ) >= sizeof( address.sun_path ) ) return false;
+        memcpy( address.sun_path, name.c_str( ), name.size( ) + 1 );
+        return true;
+    }
+
+#endif
+
+#if defined(PIXIE_HAVE_EPOLL)
+
+    const std::size_t max_line_length = 64 * 1024;  //!< Longer command lines close the connection.
+    const int         max_events      = 64;         //!< Events handled per call to epoll_wait( ).
+
+    //! Redirects cout into a string for as long as the object exists.
+    class OutputCapture {
+    public:
+        explicit OutputCapture( string &destination )
+            : destination( destination ), saved( cout.rdbuf( buffer.rdbuf( ) ) )
+            { }
+
+       ~OutputCapture( )
+        {
+            cout.rdbuf( saved );
+            destination += buffer.str( );
+        }
+
+        OutputCapture( const OutputCapture & ) = delete;
+        OutputCapture &operator=( const OutputCapture & ) = delete;
+
+    private:
+        string       &destination;
+        ostringstream buffer;
+        streambuf    *saved;
+    };
+
+    //! The state of one client.
+    struct Connection {
+        string        input;                 //!< Received text not yet executed.
+        string        output;                //!< Reply text not yet sent.
+        std::size_t   sent          = 0;     //!< Bytes at the front of output already sent.
+        bool          input_closed  = false; //!< True when the client has sent everything.
+        bool          finished      = false; //!< True when the reply is complete.
+        bool          quit          = false; //!< True if the client sent quit (or shutdown).
+        bool          shutdown      = false; //!< True if the client sent the shutdown command.
+        unsigned long command_count = 0;
+        unsigned long error_count   = 0;
+        chrono::steady_clock::time_point start;
+    };
+
+    int  listener   = -1;
+    int  signal_fd  = -1;
+    int  epoll_fd   = -1;
+    bool running    = true;
+    unordered_map< int, Connection > connections;
+
+    //! Executes one command line on behalf of a client and appends its status to the reply.
+    void execute_line( Connection &client, const char *first, const char *last )
+    {
+        if( client.command_count == 0 ) client.start = chrono::steady_clock::now( );
+
+        // Task numbers refer to the order in which the task list would be displayed now. Other
+        // clients' commands might come between this client's commands, so this is done for each.
+        sync_tasks( );
+        refresh_date( );
+        sort_tasks( );
+        if( first != last && last[-1] == '\r' ) --last;
+
+        const char *error_message = "";
+        CommandStatus status;
+        {
+            OutputCapture capture( client.output );
+            status = process_command( first, last, error_message );
+            commit_tasks( );
+        }
+
+        ostringstream formatter;
+        ++client.command_count;
+        if( status == CommandStatus::error ) {
+            ++client.error_count;
+            formatter << client.command_count << ": error: " << error_message << ": ";
+            formatter.write( first, last - first );
+            formatter << "\n";
+        }
+        else {
+            formatter << client.command_count << ": ok\n";
+        }
+        client.output += formatter.str( );
+        if( status == CommandStatus::quit || status == CommandStatus::shutdown ) client.quit = true;
+        if( status == CommandStatus::shutdown ) client.shutdown = true;
+    }
+
+    //! Completes the reply to a client that has sent all of its commands.
+    void finish( Connection &client )
+    {
+        client.finished = true;
+        if( client.command_count == 0 ) {
+            sync_tasks( );
+            refresh_date( );
+            OutputCapture capture( client.output );
+            display_tasks( );
+            return;
+        }
+
+        using namespace std::chrono;
+        const long long elapsed =
+            duration_cast< microseconds >( steady_clock::now( ) - client.start ).count( );
+        ostringstream formatter;
+        formatter << client.command_count << " commands, " << client.error_count << " errors, "
+                  << elapsed / 1000 << "." << setfill( '0' ) << setw( 3 ) << elapsed % 1000 << " ms\n";
+        client.output += formatter.str( );
+    }
+
+    //! Executes every complete command line received from a client. Returns false on a protocol error.
+    bool execute_input( Connection &client )
+    {
+        // Wakeups after the reply is complete (to send more of it) have nothing to execute.
+        if( client.finished ) return true;
+
+        std::size_t line_start = 0;
+        std::size_t line_end;
+        while( !client.quit && ( line_end = client.input.find( '\n', line_start ) ) != string::npos ) {
+            const char *const line = client.input.data( );
+            execute_line( client, line + line_start, line + line_end );
+            line_start = line_end + 1;
+        }
+        client.input.erase( 0, line_start );
+
+        if( client.quit ) {
+            client.input.clear( );
+            client.input_closed = true;
+        }
+        if( client.input.size( ) > max_line_length ) return false;
+        if( client.input_closed ) {
+            if( !client.input.empty( ) ) {
+                const char *const line = client.input.data( );
+                execute_line( client, line, line + client.input.size( ) );
+                client.input.clear( );
+            }
+            finish( client );
+        }
+        return true;
+    }
+
+    //! Reads everything available from a client. Returns false if the connection failed.
+    bool receive_input( int fd, Connection &client )
+    {
+        char buffer[4096];
+        while( !client.input_closed ) {
+            const ssize_t count = read( fd, buffer, sizeof( buffer ) );
+            if( count > 0 ) {
+                client.input.append( buffer, static_cast< std::size_t >( count ) );
+            }
+            else if( count == 0 ) {
+                client.input_closed = true;
+            }
+            else if( errno == EAGAIN || errno == EWOULDBLOCK ) {
+                break;
+            }
+            else if( errno != EINTR ) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    //! Sends as much of the reply as the client's socket accepts. Returns false if the connection failed.
+    bool send_output( int fd, Connection &client )
+    {
+        while( client.sent < client.output.size( ) ) {
+            const ssize_t count = send( fd,
+                                        client.output.data( ) + client.sent,
+                                        client.output.size( ) - client.sent,
+                                        MSG_NOSIGNAL );
+            if( count >= 0 ) {
+                client.sent += static_cast< std::size_t >( count );
+            }
+            else if( errno == EAGAIN || errno == EWOULDBLOCK ) {
+                return true;
+            }
+            else if( errno != EINTR ) {
+                return false;
+            }
+        }
+        client.output.clear( );
+        client.sent = 0;
+        return true;
+    }
+
+    void close_connection( int fd )
+    {
+        epoll_ctl( epoll_fd, EPOLL_CTL_DEL, fd, nullptr );
+        close( fd );
+        connections.erase( fd );
+    }
+
+    //! Handles activity on a client's socket.
+    void serve( int fd, Connection &client )
+    {
+        const bool healthy =
+            receive_input( fd, client ) && execute_input( client ) && send_output( fd, client );
+
+        if( !healthy || ( client.finished && client.output.empty( ) ) ) {
+            // Quit only ends this client's commands; shutdown stops the daemon for everyone.
+            if( client.shutdown ) running = false;
+            close_connection( fd );
+        }
+    }
+
+    //! Accepts every pending connection.
+    void accept_clients( )
+    {
+        while( true ) {
+            const int fd = accept4( listener, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC );
+            if( fd == -1 ) {
+                if( errno == EINTR ) continue;
+                if( errno != EAGAIN && errno != EWOULDBLOCK ) {
+                    cerr << "Pixie: Can't accept a client (" << strerror( errno ) << ")" << endl;
+                }
+                return;
+            }
+
+            epoll_event event;
+            event.events  = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+            event.data.fd = fd;
+            if( epoll_ctl( epoll_fd, EPOLL_CTL_ADD, fd, &event ) == -1 ) {
+                close( fd );
+                continue;
+            }
+            connections[fd] = Connection( );
+        }
+    }
+
+    //! Creates the listening socket. Returns false (after explaining why) if that fails.
+    bool open_listener( const string &name )
+    {
+        sockaddr_un address;
+        if( !make_address( name, address ) ) {
+            cerr << "Pixie: Socket name is too long: " << name << endl;
+            return false;
+        }
+
+        // Refuse to start if another daemon answers. Otherwise the socket is left from a daemon
+        // that didn't exit cleanly and it can be replaced.
+        const int probe = socket( AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0 );
+        if( probe != -1 ) {
+            const bool answered =
+                connect( probe, reinterpret_cast< sockaddr * >( &address ), sizeof( address ) ) == 0;
+            close( probe );
+            if( answered ) {
+                cerr << "Pixie: A daemon is already using " << name << endl;
+                return false;
+            }
+        }
+        unlink( name.c_str( ) );
+
+        listener = socket( AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0 );
+        if( listener == -1 ) {
+            cerr << "Pixie: Can't create socket (" << strerror( errno ) << ")" << endl;
+            return false;
+        }
+
+        // Only the owner of the task list may connect.
+        const mode_t old_mask = umask( 077 );
+        const bool bound =
+            bind( listener, reinterpret_cast< sockaddr * >( &address ), sizeof( address ) ) == 0;
+        umask( old_mask );
+        if( !bound || listen( listener, SOMAXCONN ) == -1 ) {
+            cerr << "Pixie: Can't listen on " << name << " (" << strerror( errno ) << ")" << endl;
+            close( listener );
+            listener = -1;
+            return false;
+        }
+        return true;
+    }
+
+    //! Returns the milliseconds until the next local midnight.
+    int until_midnight( )
+    {
+        const time_t now      = time( nullptr );
+        const time_t midnight = day_start( day_number( now ) + 1 );
+
+        // Wake at least hourly in case the clock or the time zone changes.
+        const long long seconds = min< long long >( max< long long >( midnight - now, 1 ), 3600 );
+        return static_cast< int >( seconds * 1000 );
+    }
+
+    //! Adds a descriptor to the epoll set. Returns false if that fails.
+    bool watch( int fd )
+    {
+        epoll_event event;
+        event.events  = EPOLLIN;
+        event.data.fd = fd;
+        return epoll_ctl( epoll_fd, EPOLL_CTL_ADD, fd, &event ) == 0;
+    }
+
+#endif
+
+}
+
+
+string daemon_socket_name( )
+{
+    const char *pixie_folder = getenv( "PIXIE_HOME" );
+    if( pixie_folder == nullptr ) {
+        pixie_folder = getenv( "HOME" );
+    }
+    string name = ( pixie_folder == nullptr ) ? "." : pixie_folder;
+    name += "/.pixie-socket";
+    return name;
+}
+
+
+int run_daemon( )
+{
+#if defined(PIXIE_HAVE_EPOLL)
+    const string name = daemon_socket_name( );
+    if( !open_listener( name ) ) return EXIT_FAILURE;
+    initialize_tasks( );
+
+    // SIGINT and SIGTERM are delivered through the event loop so that the task list is saved.
+    sigset_t signals;
+    sigemptyset( &signals );
+    sigaddset( &signals, SIGINT );
+    sigaddset( &signals, SIGTERM );
+    sigprocmask( SIG_BLOCK, &signals, nullptr );
+    signal_fd = signalfd( -1, &signals, SFD_NONBLOCK | SFD_CLOEXEC );
+
+    epoll_fd = epoll_create1( EPOLL_CLOEXEC );
+    int rc = EXIT_SUCCESS;
+    // Changes that other processes make to the task list are applied as soon as they are noticed.
+    const int task_watch_fd = task_watch_descriptor( );
+    if( signal_fd == -1 || epoll_fd == -1 || !watch( listener ) || !watch( signal_fd ) ||
+        ( task_watch_fd != -1 && !watch( task_watch_fd ) ) ) {
+        cerr << "Pixie: Can't start the event loop (" << strerror( errno ) << ")" << endl;
+        rc = EXIT_FAILURE;
+        running = false;
+    }
+    else {
+        cout << "Pixie: Serving " << name << endl;
+    }
+
+    epoll_event events[max_events];
+    while( running ) {
+        const int count = epoll_wait( epoll_fd, events, max_events, until_midnight( ) );
+        if( count == -1 ) {
+            if( errno == EINTR ) continue;
+            cerr << "Pixie: Event loop failed (" << strerror( errno ) << ")" << endl;
+            rc = EXIT_FAILURE;
+            break;
+        }
+        if( count == 0 ) {
+            // The day changes without touching every task (see refresh_date( )).
+            refresh_date( );
+            commit_tasks( );
+            continue;
+        }
+        for( int i = 0; i < count && running; ++i ) {
+            const int fd = events[i].data.fd;
+            if( fd == listener ) {
+                accept_clients( );
+            }
+            else if( fd == signal_fd ) {
+                running = false;
+            }
+            else if( fd == task_watch_fd ) {
+                sync_tasks( );
+                commit_tasks( );
+            }
+            else {
+                // The connection might have been closed by an earlier event in this batch.
+                const auto client = connections.find( fd );
+                if( client != connections.end( ) ) serve( fd, client->second );
+            }
+        }
+    }
+
+    for( const auto &client : connections ) {
+        close( client.first );
+    }
+    connections.clear( );
+    if( epoll_fd  != -1 ) close( epoll_fd );
+    if( signal_fd != -1 ) close( signal_fd );
+    close( listener );
+    unlink( name.c_str( ) );
+    sigprocmask( SIG_UNBLOCK, &signals, nullptr );
+    cleanup_events( );
+    cleanup_tasks( );
+    return rc;
+#else
+    cerr << "Pixie: The daemon isn't supported on this platform" << endl;
+    return EXIT_FAILURE;
+#endif
+}
+
+
+int run_client( int command_count, char **commands )
+{
+#if defined(PIXIE_HAVE_UNIX_SOCKETS)
+    const string name = daemon_socket_name( );
+    sockaddr_un address;
+    if( !make_address( name, address ) ) {
+        cerr << "Pixie: Socket name is too long: " << name << endl;
+        return EXIT_FAILURE;
+    }
+
+    const int fd = socket( AF_UNIX, SOCK_STREAM, 0 );
+    if( fd == -1 ||
+        connect( fd, reinterpret_cast< sockaddr * >( &address ), sizeof( address ) ) == -1 ) {
+        cerr << "Pixie: Can't reach the daemon at " << name << " (" << strerror( errno ) << ")" << endl;
+        if( fd != -1 ) close( fd );
+        return EXIT_FAILURE;
+    }
+    signal( SIGPIPE, SIG_IGN );
+
+    string request;
+    for( int i = 0; i < command_count; ++i ) {
+        request += commands[i];
+        request += '\n';
+    }
+    std::size_t sent = 0;
+    while( sent < request.size( ) ) {
+        const ssize_t count = write( fd, request.data( ) + sent, request.size( ) - sent );
+        if( count == -1 && errno == EINTR ) continue;
+        if( count == -1 ) break;
+        sent += static_cast< std::size_t >( count );
+    }
+    shutdown( fd, SHUT_WR );
+
+    // The reply is short. The last line is the summary, from which the exit code is taken.
+    string reply;
+    char buffer[4096];
+    while( true ) {
+        const ssize_t count = read( fd, buffer, sizeof( buffer ) );
+        if( count == -1 && errno == EINTR ) continue;
+        if( count <= 0 ) break;
+        reply.append( buffer, static_cast< std::size_t >( count ) );
+    }
+    close( fd );
+    cout << reply << flush;
+
+    if( sent != request.size( ) || reply.empty( ) ) {
+        cerr << "Pixie: The daemon closed the connection" << endl;
+        return EXIT_FAILURE;
+    }
+    if( command_count == 0 ) return EXIT_SUCCESS;
+
+    const std::size_t last_line = reply.rfind( '\n', reply.size( ) - 2 );
+    unsigned long executed = 0;
+    unsigned long errors   = 0;
+    if( sscanf( reply.c_str( ) + ( last_line == string::npos ? 0 : last_line + 1 ),
+                "%lu commands, %lu errors", &executed, &errors ) != 2 ) {
+        return EXIT_FAILURE;
+    }
+    return ( errors == 0 ) ? EXIT_SUCCESS : EXIT_FAILURE;
+#else
+    (void)command_count;
+    (void)commands;
+    cerr << "Pixie: The daemon isn't supported on this platform" << endl;
+    return EXIT_FAILURE;
+#endif
+}
@@ -0,0 +1,37 @@
+/*! \file    Daemon.hpp
+ *  \brief   Resident daemon serving Pixie commands over a Unix domain socket.
+ *  \author  Peter C. Chapin <pchapin@vtc.edu>
+ *
+ * A client connects to the socket, writes one command per line, and then shuts down its side of
+ * the connection. The daemon executes the commands in the same way as batch mode, replying with
+ * a status line for each command and a summary. Unlike batch mode, the list is put in order
+ * before every command, since other clients' commands might come in between; task numbers
+ * always refer to the order in which the list would be displayed at that moment. A client that
+ * sends no commands receives the task list instead. The quit command ends a client's commands
+ * (the rest are ignored) without stopping the daemon.
+ */
+
+#ifndef DAEMON_HPP
+#define DAEMON_HPP
+
+#include <string>
+
+//! Returns the name of the socket used by the daemon.
+std::string daemon_socket_name( );
+
+//! Serves clients until a client sends the shutdown command or the daemon receives SIGINT or SIGTERM.
+/*!
+ * The task list is loaded once the socket is ready and saved when the
+ * daemon stops. Nothing is loaded if another daemon is already serving the same task list.
+ * Returns the program's exit code.
+ */
+int run_daemon( );
+
+//! Sends the given commands to the daemon and writes its reply to the standard output.
+/*!
+ * The task list is not touched. Returns the program's exit code: failure if the daemon can't be
+ * reached or if any command failed.
+ */
+int run_client( int command_count, char **commands );
+
+#endif
@@ -0,0 +1,138 @@
+/*! \file    EventFile.cpp
+ *  \brief   Binary event file format.
+ *  \author  Peter C. Chapin <pchapin@vtc.edu>
+ *
+ * An event file has the same layout as a binary task snapshot: a header, an array of fixed size
+ * records holding the numeric fields of each event, and a string table holding the descriptions.
+ * Values are stored in the byte order of the machine that wrote the file, which is marked in the
+ * header. The records are in order of ID so that loading them doesn't need to sort them.
+ */
+
+#include <cstdint>
+#include <cstring>
+#include <limits>
+
+#include "EventFile.hpp"
+
+using namespace std;
+
+namespace {
+
+    const char          event_magic[8]    = { 'P', 'I', 'X', 'I', 'E', 'E', 'V', 'T' };
+    const std::uint32_t event_version     = 1;
+    const std::uint32_t byte_order_marker = 0x01020304;
+
+    struct EventHeader {
+        char          magic[8];
+        std::uint32_t version;
+        std::uint32_t byte_order;
+        std::uint64_t event_count;
+        std::uint64_t strings_size;  //!< Size of the string table in bytes.
+    };
+
+    struct EventRecord {
+        std::uint64_t id;
+        std::int64_t  start;
+        std::int32_t  duration;
+        std::int32_t  period;
+        std::uint32_t description_offset;  //!< Offset of the description in the string table.
+        std::uint32_t description_size;
+    };
+
+    static_assert( sizeof( EventHeader ) == 32, "Unexpected padding in EventHeader" );
+    static_assert( sizeof( EventRecord ) == 32, "Unexpected padding in EventRecord" );
+
+}
+
+
+bool read_event_file( const MappedFile &file, EventIndex &events, const char *&error )
+{
+    EventHeader header;
+
+    if( file.size( ) == 0 ) return true;
+    if( file.size( ) < sizeof( header ) || memcmp( file.begin( ), event_magic, sizeof( event_magic ) ) != 0 ) {
+        error = "not an event file";
+        return false;
+    }
+    memcpy( &header, file.begin( ), sizeof( header ) );
+    if( header.byte_order != byte_order_marker ) {
+        error = "written on a machine with a different byte order";
+        return false;
+    }
+    if( header.version != event_version ) {
+        error = "unsupported event file version";
+        return false;
+    }
+
+    // Check the sizes before touching any records. The counts come from the file and can't be trusted.
+    const std::uint64_t available = file.size( ) - sizeof( header );
+    if( header.event_count > available / sizeof( EventRecord ) ||
+        header.strings_size != available - header.event_count * sizeof( EventRecord ) ) {
+        error = "truncated or damaged event file";
+        return false;
+    }
+
+    const char *records = file.begin( ) + sizeof( header );
+    const char *strings = records + header.event_count * sizeof( EventRecord );
+
+    events.reserve( static_cast< size_t >( header.event_count ), static_cast< size_t >( header.strings_size ) );
+    for( std::uint64_t i = 0; i < header.event_count; ++i ) {
+        EventRecord record;
+        memcpy( &record, records + i * sizeof( EventRecord ), sizeof( record ) );
+        if( static_cast< std::uint64_t >( record.description_offset ) + record.description_size > header.strings_size ) {
+            error = "description outside of the string table";
+            return false;
+        }
+        if( record.id == 0 || record.duration < 0 || record.period < 0 ||
+            ( record.period != 0 && record.duration >= record.period ) ) {
+            error = "event ID, duration, or period out of range";
+            return false;
+        }
+        const char *description = strings + record.description_offset;
+        events.insert( record.id, record.start, record.duration, record.period,
+                       description, description + record.description_size );
+    }
+    return true;
+}
+
+
+bool write_event_file( ostream &output, const EventIndex &events )
+{
+    EventHeader header;
+    memset( &header, 0, sizeof( header ) );
+    memcpy( header.magic, event_magic, sizeof( event_magic ) );
+    header.version     = event_version;
+    header.byte_order  = byte_order_marker;
+    header.event_count = events.size( );
+
+    std::uint64_t strings_size = 0;
+    for( size_t slot = 0; slot < events.slot_count( ); ++slot ) {
+        const EventIndex::Event event = events.event( static_cast< std::uint32_t >( slot ) );
+        if( event.id != 0 ) strings_size += event.text_size;
+    }
+    if( strings_size > numeric_limits< std::uint32_t >::max( ) ) return false;
+    header.strings_size = strings_size;
+
+    output.write( reinterpret_cast< const char * >( &header ), sizeof( header ) );
+
+    std::uint32_t offset = 0;
+    for( size_t slot = 0; slot < events.slot_count( ); ++slot ) {
+        const EventIndex::Event event = events.event( static_cast< std::uint32_t >( slot ) );
+        if( event.id == 0 ) continue;
+        EventRecord record;
+        record.id                 = event.id;
+        record.start              = event.start;
+        record.duration           = event.duration;
+        record.period             = event.period;
+        record.description_offset = offset;
+        record.description_size   = static_cast< std::uint32_t >( event.text_size );
+        output.write( reinterpret_cast< const char * >( &record ), sizeof( record ) );
+        offset += record.description_size;
+    }
+
+    for( size_t slot = 0; slot < events.slot_count( ); ++slot ) {
+        const EventIndex::Event event = events.event( static_cast< std::uint32_t >( slot ) );
+        if( event.id != 0 ) output.write( event.text, static_cast< streamsize >( event.text_size ) );
+    }
+    return static_cast< bool >( output );
+}
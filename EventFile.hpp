@@ -0,0 +1,24 @@
+/*! \file    EventFile.hpp
+ *  \brief   Binary event file format.
+ *  \author  Peter C. Chapin <pchapin@vtc.edu>
+ */
+
+#ifndef EVENTFILE_HPP
+#define EVENTFILE_HPP
+
+#include <ostream>
+
+#include "EventIndex.hpp"
+#include "MappedFile.hpp"
+
+//! Adds the events in a mapped event file to an empty index.
+/*!
+ * An empty file holds no events. Returns false (and explains in error) if the file is damaged or
+ * was written by an incompatible version of Pixie.
+ */
+bool read_event_file( const MappedFile &file, EventIndex &events, const char *&error );
+
+//! Writes every event in an index. The index should be compacted first (see EventIndex::compact( )).
+bool write_event_file( std::ostream &output, const EventIndex &events );
+
+#endif
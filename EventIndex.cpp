@@ -0,0 +1,474 @@
+/*! \file    EventIndex.cpp
+ *  \brief   Calendar of events indexed by the times at which they occur.
+ *  \author  Peter C. Chapin <pchapin@vtc.edu>
+ */
+
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+
+#include "EventIndex.hpp"
+
+using namespace std;
+
+namespace {
+
+    //! Fewest changes that make a query rebuild the trees; see needs_rebuild( ).
+    const std::size_t rebuild_minimum = 1024;
+
+    //! Division that rounds toward negative infinity. The divisor must be positive.
+    std::int64_t floor_div( std::int64_t dividend, std::int64_t divisor ) noexcept
+    {
+        const std::int64_t quotient = dividend / divisor;
+        return ( dividend % divisor < 0 ) ? quotient - 1 : quotient;
+    }
+
+
+    //! Division that rounds toward positive infinity. The divisor must be positive.
+    std::int64_t ceil_div( std::int64_t dividend, std::int64_t divisor ) noexcept
+    {
+        return -floor_div( -dividend, divisor );
+    }
+
+
+    //! Returns the number of minutes that an event with the given duration occupies.
+    std::int64_t length_of( std::int32_t duration ) noexcept
+    {
+        return max< std::int64_t >( duration, 1 );
+    }
+
+
+    //! Sets max_high in the nodes [first, last) and returns the largest high among them.
+    /*!
+     * The root of the subtree [first, last) is the node in the middle. The nodes must be sorted
+     * by low.
+     */
+    template< typename Node >
+    std::int64_t augment( vector< Node > &nodes, std::size_t first, std::size_t last ) noexcept
+    {
+        if( first >= last ) return numeric_limits< std::int64_t >::min( );
+        const std::size_t middle = first + ( last - first ) / 2;
+        Node &node = nodes[middle];
+        node.max_high = max( node.high, max( augment( nodes, first, middle ), augment( nodes, middle + 1, last ) ) );
+        return node.max_high;
+    }
+
+
+    //! Calls report( node ) for each node in the subtree [first, last) that overlaps [low, high).
+    template< typename Node, typename Report >
+    void search( const vector< Node > &nodes,
+                 std::size_t first,
+                 std::size_t last,
+                 std::int64_t low,
+                 std::int64_t high,
+                 Report &report )
+    {
+        while( first < last ) {
+            const std::size_t middle = first + ( last - first ) / 2;
+            const Node &node = nodes[middle];
+            if( node.max_high <= low ) return;
+            search( nodes, first, middle, low, high, report );
+            // Everything to the right starts no earlier than this node.
+            if( node.low >= high ) return;
+            if( node.high > low ) report( node );
+            first = middle + 1;
+        }
+    }
+
+}
+
+
+void EventIndex::clear( ) noexcept
+{
+    entries.clear( );
+    text.clear( );
+    indexed_count = 0;
+    removed       = 0;
+    removed_text  = 0;
+    biggest_id    = 0;
+    once.clear( );
+    groups.clear( );
+}
+
+
+void EventIndex::reserve( std::size_t count, std::size_t text_size )
+{
+    entries.reserve( count );
+    text.reserve( text_size );
+}
+
+
+bool EventIndex::insert( TaskId id,
+                         std::int64_t start,
+                         std::int32_t duration,
+                         std::int32_t period,
+                         const char *first,
+                         const char *last )
+{
+    const std::size_t text_size = static_cast< std::size_t >( last - first );
+
+    // New events have the largest IDs, so usually there is nothing to replace.
+    if( id <= biggest_id ) {
+        const std::size_t slot = locate( id );
+        if( slot != entries.size( ) ) {
+            const Entry &existing = entries[slot];
+            if( existing.start == start && existing.duration == duration && existing.period == period &&
+                existing.text_size == text_size && equal( first, last, text.data( ) + existing.text_offset ) ) {
+                return false;
+            }
+            remove_slot( slot );
+        }
+    }
+
+    if( text.size( ) + text_size > numeric_limits< std::uint32_t >::max( ) ) {
+        throw length_error( "The event descriptions are too long" );
+    }
+    Entry entry;
+    entry.id          = id;
+    entry.start       = start;
+    entry.duration    = duration;
+    entry.period      = period;
+    entry.text_offset = static_cast< std::uint32_t >( text.size( ) );
+    entry.text_size   = static_cast< std::uint32_t >( text_size );
+    text.append( first, last );
+    entries.push_back( entry );
+    biggest_id = max( biggest_id, id );
+    return true;
+}
+
+
+bool EventIndex::erase( TaskId id ) noexcept
+{
+    const std::size_t slot = locate( id );
+    if( slot == entries.size( ) ) return false;
+    remove_slot( slot );
+    return true;
+}
+
+
+bool EventIndex::find( TaskId id, Event &result ) const noexcept
+{
+    const std::size_t slot = locate( id );
+    if( slot == entries.size( ) ) return false;
+    result = event( static_cast< std::uint32_t >( slot ) );
+    return true;
+}
+
+
+EventIndex::Event EventIndex::event( std::uint32_t slot ) const noexcept
+{
+    const Entry &entry = entries[slot];
+    Event result;
+    result.id        = is_removed( entry ) ? 0 : entry.id;
+    result.start     = entry.start;
+    result.duration  = entry.duration;
+    result.period    = max( entry.period, 0 );
+    result.text      = text.data( ) + entry.text_offset;
+    result.text_size = entry.text_size;
+    return result;
+}
+
+
+void EventIndex::compact( )
+{
+    if( indexed_count != entries.size( ) || removed != 0 ) rebuild( );
+}
+
+
+void EventIndex::overlapping( std::int64_t first, std::int64_t last, vector< Occurrence > &result )
+{
+    result.clear( );
+    if( first >= last ) return;
+    if( needs_rebuild( ) ) rebuild( );
+
+    auto report_once = [this, &result]( const Node &node ) {
+        if( !is_removed( entries[node.slot] ) ) result.push_back( Occurrence{ node.low, node.slot } );
+    };
+    search( once, 0, once.size( ), first, last, report_once );
+
+    for( const Group &group : groups ) {
+        if( group.live == 0 ) continue;
+        const std::int64_t period = group.period;
+
+        // An occurrence is shorter than the period, so the first one that can overlap starts
+        // less than a period before first. No event in the group occurs before its earliest start.
+        std::int64_t       cycle      = max( floor_div( first, period ) - 1, floor_div( group.earliest, period ) );
+        const std::int64_t last_cycle = floor_div( last - 1, period );
+        for( ; cycle <= last_cycle; ++cycle ) {
+            const std::int64_t base = cycle * period;
+            auto report_periodic = [this, &result, base]( const Node &node ) {
+                const Entry &entry = entries[node.slot];
+                const std::int64_t start = base + node.low;
+                if( !is_removed( entry ) && start >= entry.start ) result.push_back( Occurrence{ start, node.slot } );
+            };
+            search( group.nodes, 0, group.nodes.size( ), first - base, last - base, report_periodic );
+        }
+    }
+
+    for( std::size_t slot = indexed_count; slot < entries.size( ); ++slot ) {
+        const Entry &entry = entries[slot];
+        if( is_removed( entry ) ) continue;
+        const std::int64_t length = length_of( entry.duration );
+        if( entry.period == 0 ) {
+            if( entry.start < last && entry.start + length > first ) {
+                result.push_back( Occurrence{ entry.start, static_cast< std::uint32_t >( slot ) } );
+            }
+            continue;
+        }
+        const std::int64_t cycle = max< std::int64_t >( 0, floor_div( first - length - entry.start, entry.period ) + 1 );
+        for( std::int64_t start = entry.start + cycle * entry.period; start < last; start += entry.period ) {
+            result.push_back( Occurrence{ start, static_cast< std::uint32_t >( slot ) } );
+        }
+    }
+    sort_occurrences( result );
+}
+
+
+void EventIndex::upcoming( std::int64_t from, std::size_t count, vector< Occurrence > &result )
+{
+    result.clear( );
+    if( count == 0 ) return;
+    if( needs_rebuild( ) ) rebuild( );
+
+    // The occurrences from each source come in order, so they are merged with a heap of cursors.
+    const auto later = []( const Cursor &left, const Cursor &right ) {
+        return left.time != right.time ? left.time > right.time : left.id > right.id;
+    };
+    const auto by_low = []( const Node &node, std::int64_t time ) { return node.low < time; };
+    cursors.clear( );
+    Cursor cursor = Cursor( );
+
+    cursor.position = static_cast< std::size_t >( lower_bound( once.begin( ), once.end( ), from, by_low ) - once.begin( ) );
+    if( settle( cursor ) ) cursors.push_back( cursor );
+
+    for( std::size_t i = 0; i < groups.size( ); ++i ) {
+        const Group &group = groups[i];
+        if( group.live == 0 ) continue;
+        cursor.source   = i + 1;
+        cursor.cycle    = floor_div( from, group.period );
+        cursor.position = static_cast< std::size_t >(
+            lower_bound( group.nodes.begin( ), group.nodes.end( ), from - cursor.cycle * group.period, by_low ) -
+            group.nodes.begin( ) );
+        if( settle( cursor ) ) cursors.push_back( cursor );
+    }
+
+    cursor.source = groups.size( ) + 1;
+    for( std::size_t slot = indexed_count; slot < entries.size( ); ++slot ) {
+        const Entry &entry = entries[slot];
+        if( is_removed( entry ) ) continue;
+        if( entry.period == 0 ) {
+            if( entry.start < from ) continue;
+            cursor.cycle = 0;
+        }
+        else {
+            cursor.cycle = max< std::int64_t >( 0, ceil_div( from - entry.start, entry.period ) );
+        }
+        cursor.position = slot;
+        if( settle( cursor ) ) cursors.push_back( cursor );
+    }
+
+    make_heap( cursors.begin( ), cursors.end( ), later );
+    while( result.size( ) < count && !cursors.empty( ) ) {
+        pop_heap( cursors.begin( ), cursors.end( ), later );
+        Cursor &next = cursors.back( );
+        result.push_back( Occurrence{ next.time, next.slot } );
+        if( next.source <= groups.size( ) ) ++next.position; else ++next.cycle;
+        if( settle( next ) ) {
+            push_heap( cursors.begin( ), cursors.end( ), later );
+        }
+        else {
+            cursors.pop_back( );
+        }
+    }
+}
+
+
+std::size_t EventIndex::memory_used( ) const noexcept
+{
+    std::size_t used = entries.capacity( ) * sizeof( Entry ) + text.capacity( ) +
+                       once.capacity( ) * sizeof( Node ) + groups.capacity( ) * sizeof( Group ) +
+                       cursors.capacity( ) * sizeof( Cursor );
+    for( const Group &group : groups ) used += group.nodes.capacity( ) * sizeof( Node );
+    return used;
+}
+
+
+//! Returns the slot of the event with the given ID, or the number of slots if there is no such event.
+std::size_t EventIndex::locate( TaskId id ) const noexcept
+{
+    const auto indexed_end = entries.begin( ) + static_cast< std::ptrdiff_t >( indexed_count );
+    const auto found = lower_bound( entries.begin( ), indexed_end, id,
+        []( const Entry &entry, TaskId wanted ) { return entry.id < wanted; } );
+    if( found != indexed_end && found->id == id && !is_removed( *found ) ) {
+        return static_cast< std::size_t >( found - entries.begin( ) );
+    }
+
+    // Only the last copy of a replaced event can still be there.
+    for( std::size_t slot = entries.size( ); slot > indexed_count; --slot ) {
+        const Entry &entry = entries[slot - 1];
+        if( entry.id == id ) return is_removed( entry ) ? entries.size( ) : slot - 1;
+    }
+    return entries.size( );
+}
+
+
+//! Marks the event in a slot as removed.
+void EventIndex::remove_slot( std::size_t slot ) noexcept
+{
+    Entry &entry = entries[slot];
+    if( slot < indexed_count && entry.period != 0 ) {
+        const auto group = lower_bound( groups.begin( ), groups.end( ), entry.period,
+            []( const Group &candidate, std::int32_t period ) { return candidate.period < period; } );
+        --group->live;
+    }
+    entry.period = -1;
+    ++removed;
+    removed_text += entry.text_size;
+}
+
+
+//! Returns true if so many events were added or removed that the trees should be rebuilt.
+bool EventIndex::needs_rebuild( ) const noexcept
+{
+    // Queries examine the added events one at a time, so the number allowed grows slowly.
+    const std::size_t limit = max( rebuild_minimum, entries.size( ) / 128 );
+    return entries.size( ) - indexed_count > limit || removed > limit;
+}
+
+
+void EventIndex::rebuild( )
+{
+    // Drop the removed entries. The entries that were in the trees stay in order of ID.
+    if( removed != 0 ) {
+        const auto indexed_end = entries.begin( ) + static_cast< std::ptrdiff_t >( indexed_count );
+        indexed_count -= static_cast< std::size_t >( count_if( entries.begin( ), indexed_end, is_removed ) );
+        entries.erase( remove_if( entries.begin( ), entries.end( ), is_removed ), entries.end( ) );
+        removed = 0;
+
+        if( removed_text > text.size( ) / 2 ) {
+            string packed;
+            packed.reserve( text.size( ) - removed_text );
+            for( Entry &entry : entries ) {
+                const std::uint32_t offset = static_cast< std::uint32_t >( packed.size( ) );
+                packed.append( text, entry.text_offset, entry.text_size );
+                entry.text_offset = offset;
+            }
+            text.swap( packed );
+            removed_text = 0;
+        }
+    }
+
+    const auto by_id = []( const Entry &left, const Entry &right ) { return left.id < right.id; };
+    const auto indexed_end = entries.begin( ) + static_cast< std::ptrdiff_t >( indexed_count );
+    sort( indexed_end, entries.end( ), by_id );
+    inplace_merge( entries.begin( ), indexed_end, entries.end( ), by_id );
+    indexed_count = entries.size( );
+
+    // Slots are now in order of ID, so sorting by slot breaks ties in the same way as sorting by ID.
+    vector< Node > periodic;
+    once.clear( );
+    groups.clear( );
+    for( std::size_t slot = 0; slot < entries.size( ); ++slot ) {
+        const Entry &entry = entries[slot];
+        const std::int64_t length = length_of( entry.duration );
+        if( entry.period == 0 ) {
+            once.push_back( Node{ entry.start, entry.start + length, 0, static_cast< std::uint32_t >( slot ) } );
+        }
+        else {
+            const std::int64_t phase = entry.start - floor_div( entry.start, entry.period ) * entry.period;
+            periodic.push_back( Node{ phase, phase + length, 0, static_cast< std::uint32_t >( slot ) } );
+        }
+    }
+
+    const auto by_low = []( const Node &left, const Node &right ) {
+        return left.low != right.low ? left.low < right.low : left.slot < right.slot;
+    };
+    sort( once.begin( ), once.end( ), by_low );
+    augment( once, 0, once.size( ) );
+
+    const auto by_period = [this, &by_low]( const Node &left, const Node &right ) {
+        const std::int32_t left_period  = entries[left.slot].period;
+        const std::int32_t right_period = entries[right.slot].period;
+        return left_period != right_period ? left_period < right_period : by_low( left, right );
+    };
+    sort( periodic.begin( ), periodic.end( ), by_period );
+    for( std::size_t first = 0; first < periodic.size( ); ) {
+        const std::int32_t period = entries[periodic[first].slot].period;
+        std::size_t last = first;
+        Group group;
+        group.period   = period;
+        group.earliest = numeric_limits< std::int64_t >::max( );
+        while( last < periodic.size( ) && entries[periodic[last].slot].period == period ) {
+            group.earliest = min( group.earliest, entries[periodic[last].slot].start );
+            ++last;
+        }
+        group.nodes.assign( periodic.begin( ) + static_cast< std::ptrdiff_t >( first ),
+                            periodic.begin( ) + static_cast< std::ptrdiff_t >( last ) );
+        group.live = group.nodes.size( );
+        augment( group.nodes, 0, group.nodes.size( ) );
+        groups.push_back( std::move( group ) );
+        first = last;
+    }
+}
+
+
+//! Puts the occurrences in order of start time and then of ID.
+void EventIndex::sort_occurrences( vector< Occurrence > &result ) const
+{
+    sort( result.begin( ), result.end( ), [this]( const Occurrence &left, const Occurrence &right ) {
+        return left.start != right.start ? left.start < right.start : entries[left.slot].id < entries[right.slot].id;
+    } );
+}
+
+
+//! Moves a cursor forward, if necessary, to the next occurrence of an event that hasn't been removed.
+/*!
+ * Fills in the cursor's time, ID, and slot. Returns false if its source has no more occurrences.
+ */
+bool EventIndex::settle( Cursor &cursor ) const noexcept
+{
+    if( cursor.source == 0 ) {
+        for( ; cursor.position < once.size( ); ++cursor.position ) {
+            const Node &node = once[cursor.position];
+            const Entry &entry = entries[node.slot];
+            if( is_removed( entry ) ) continue;
+            cursor.time = node.low;
+            cursor.id   = entry.id;
+            cursor.slot = node.slot;
+            return true;
+        }
+        return false;
+    }
+
+    if( cursor.source <= groups.size( ) ) {
+        // The group has a live event, and that event occurs eventually, so this ends.
+        const Group &group = groups[cursor.source - 1];
+        while( true ) {
+            if( cursor.position == group.nodes.size( ) ) {
+                cursor.position = 0;
+                ++cursor.cycle;
+            }
+            if( ( cursor.cycle + 1 ) * group.period <= group.earliest ) {
+                cursor.cycle    = floor_div( group.earliest, group.period );
+                cursor.position = 0;
+            }
+            const Node &node = group.nodes[cursor.position];
+            const Entry &entry = entries[node.slot];
+            const std::int64_t time = cursor.cycle * group.period + node.low;
+            if( !is_removed( entry ) && time >= entry.start ) {
+                cursor.time = time;
+                cursor.id   = entry.id;
+                cursor.slot = node.slot;
+                return true;
+            }
+            ++cursor.position;
+        }
+    }
+
+    const Entry &entry = entries[cursor.position];
+    if( entry.period == 0 && cursor.cycle != 0 ) return false;
+    cursor.time = entry.start + cursor.cycle * entry.period;
+    cursor.id   = entry.id;
+    cursor.slot = static_cast< std::uint32_t >( cursor.position );
+    return true;
+}
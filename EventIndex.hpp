@@ -0,0 +1,152 @@
+/*! \file    EventIndex.hpp
+ *  \brief   Calendar of events indexed by the times at which they occur.
+ *  \author  Peter C. Chapin <pchapin@vtc.edu>
+ */
+
+#ifndef EVENTINDEX_HPP
+#define EVENTINDEX_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "PixieTask.hpp"
+
+//! Holds the events in the calendar and finds the ones that occur at a given time.
+/*!
+ * Times are minute numbers (see event_minute( ) in Events.hpp). An event occurs at its start time and, if it
+ * is periodic, every period minutes after that without end. An event lasts for its duration; an
+ * event with no duration marks a moment, and occurs during the minute that it starts. A periodic
+ * event must be shorter than its period.
+ *
+ * One-off events are kept in an interval tree: an array sorted by start time, viewed as a
+ * balanced binary tree with each node holding the latest end time in its subtree. Periodic
+ * events are grouped by period, and the events of a group are kept in a similar tree keyed by
+ * their phase (the start time modulo the period), so that the recurrences of an event are never
+ * materialized. A query visits O( log n ) nodes for each occurrence it finds; looking for the
+ * occurrences in a window visits each group once for each period the window spans.
+ *
+ * Events added since the trees were built are kept aside and examined one by one, and removed
+ * events are only marked; both are folded into the trees by the next query after enough of them
+ * accumulate. Events are stored in the order of their IDs so that they can be found by ID
+ * without a separate table.
+ */
+class EventIndex {
+public:
+    //! The fields of an event. The description is only valid until the index is changed.
+    struct Event {
+        TaskId       id;
+        std::int64_t start;       //!< Minute at which the event (first) occurs.
+        std::int32_t duration;    //!< In minutes. Zero marks a moment.
+        std::int32_t period;      //!< Minutes between occurrences. Zero for a one-off event.
+        const char  *text;        //!< The description. Not null terminated.
+        std::size_t  text_size;
+    };
+
+    //! One occurrence of an event found by a query.
+    struct Occurrence {
+        std::int64_t  start;  //!< Minute at which this occurrence starts.
+        std::uint32_t slot;   //!< Refers to the event; see event( ).
+    };
+
+    //! Removes every event.
+    void clear( ) noexcept;
+
+    //! Makes room for the given number of events with descriptions of the given total size.
+    void reserve( std::size_t count, std::size_t text_size );
+
+    //! Adds an event, replacing any event with the same ID. Returns false if the event was there already.
+    bool insert( TaskId id, std::int64_t start, std::int32_t duration, std::int32_t period,
+                 const char *first, const char *last );
+
+    //! Removes the event with the given ID. Returns false if there is no such event.
+    bool erase( TaskId id ) noexcept;
+
+    //! Looks up the event with the given ID. Returns false if there is no such event.
+    bool find( TaskId id, Event &result ) const noexcept;
+
+    //! Returns the number of events.
+    std::size_t size( ) const noexcept { return entries.size( ) - removed; }
+
+    //! Returns the largest ID of any event, or zero if there are none.
+    TaskId largest_id( ) const noexcept { return biggest_id; }
+
+    //! Returns the number of slots, some of which might not hold an event (see event( )).
+    std::size_t slot_count( ) const noexcept { return entries.size( ); }
+
+    //! Returns the event in a slot. Its ID is zero if the slot doesn't hold an event.
+    Event event( std::uint32_t slot ) const noexcept;
+
+    //! Folds every change into the trees, leaving a slot for each event in order of ID.
+    void compact( );
+
+    //! Finds the occurrences of events that overlap the minutes [first, last), in order of start time.
+    /*!
+     * Occurrences that start at the same time are in order of the events' IDs. An occurrence
+     * that began before first and is still in progress is included.
+     */
+    void overlapping( std::int64_t first, std::int64_t last, std::vector< Occurrence > &result );
+
+    //! Finds the first count occurrences of events that start at or after from, in order of start time.
+    void upcoming( std::int64_t from, std::size_t count, std::vector< Occurrence > &result );
+
+    //! Returns the number of bytes allocated by the index.
+    std::size_t memory_used( ) const noexcept;
+
+private:
+    struct Entry {
+        TaskId        id;
+        std::int64_t  start;
+        std::int32_t  duration;
+        std::int32_t  period;       //!< Negative if the event was removed.
+        std::uint32_t text_offset;  //!< Offset of the description in text.
+        std::uint32_t text_size;
+    };
+
+    //! A node of an interval tree; it covers the minutes [low, high).
+    struct Node {
+        std::int64_t  low;
+        std::int64_t  high;
+        std::int64_t  max_high;     //!< Largest high in the node's subtree.
+        std::uint32_t slot;
+    };
+
+    //! The periodic events with one period.
+    struct Group {
+        std::int32_t        period;
+        std::int64_t        earliest;  //!< Earliest start time of the events in the group.
+        std::size_t         live;      //!< Number of nodes whose events haven't been removed.
+        std::vector< Node > nodes;     //!< Keyed by phase.
+    };
+
+    //! Position of a query in the occurrences of one source of events (see upcoming( )).
+    struct Cursor {
+        std::int64_t  time;
+        TaskId        id;
+        std::uint32_t slot;
+        std::size_t   source;    //!< 0 for one-off events, then each group, then an added event.
+        std::int64_t  cycle;     //!< Number of periods since minute zero, or since the event's start.
+        std::size_t   position;  //!< Node in the source's tree, or slot of an added event.
+    };
+
+    std::vector< Entry >  entries;            //!< Entries before indexed_count are in order of ID.
+    std::string           text;               //!< Descriptions of the events.
+    std::size_t           indexed_count = 0;  //!< Number of entries in the trees.
+    std::size_t           removed       = 0;  //!< Number of entries that were removed.
+    std::size_t           removed_text  = 0;  //!< Bytes of text that belong to removed entries.
+    TaskId                biggest_id    = 0;
+    std::vector< Node >   once;               //!< One-off events, keyed by start time.
+    std::vector< Group >  groups;             //!< In order of period.
+    std::vector< Cursor > cursors;            //!< Scratch space used by upcoming( ).
+
+    static bool is_removed( const Entry &entry ) noexcept { return entry.period < 0; }
+    std::size_t locate( TaskId id ) const noexcept;
+    bool needs_rebuild( ) const noexcept;
+    void remove_slot( std::size_t slot ) noexcept;
+    void rebuild( );
+    void sort_occurrences( std::vector< Occurrence > &result ) const;
+    bool settle( Cursor &cursor ) const noexcept;
+};
+
+#endif
@@ -0,0 +1,439 @@
+/*! \file    Events.cpp
+ *  \brief   The calendar of events.
+ *  \author  Peter C. Chapin <pchapin@vtc.edu>
+ *
+ * The events are stored in a binary event file (see EventFile.hpp) and a journal of the
+ * changes made since that file was written. The journal is a text file with one record per
+ * line: "V id start duration period description" gives all of an event's fields (whether the
+ * event is new or not) and "X id" deletes an event. Applying a record twice has the same effect
+ * as applying it once, so every process simply applies the journal from where it last stopped,
+ * its own records included. When the journal grows long it is folded into a new event file.
+ *
+ * Processes share the lock file of the task list (see LockFile.hpp): writers of either file hold
+ * it exclusively and readers hold it shared. Event IDs come from the same source as task IDs,
+ * so no event has the ID of a task.
+ */
+
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#if !defined(_WIN32)
+#include <unistd.h>
+#endif
+
+#include "Calendar.hpp"
+#include "Date.hpp"
+#include "EventFile.hpp"
+#include "EventIndex.hpp"
+#include "Events.hpp"
+#include "FileWatch.hpp"
+#include "LockFile.hpp"
+#include "MappedFile.hpp"
+#include "Statistics.hpp"
+#include "Tasks.hpp"
+
+using namespace std;
+
+namespace {
+
+    const int         minutes_per_day    = 1440;
+    const std::size_t min_journal_length = 1000;  //!< Fewest records that make the journal long.
+
+    bool        events_loaded  = false;
+    bool        events_damaged = false;      //!< True if the event file couldn't be read. It is then never rewritten.
+    std::string event_file_name;
+    std::string event_journal_name;
+    LockFile    event_lock;
+    EventIndex  events;
+    FileStamp   event_file_stamp;            //!< The event file as this process last read or wrote it.
+    long        journal_read    = 0;         //!< Bytes at the start of the journal already applied.
+    std::size_t journal_records = 0;         //!< Number of records in the journal.
+    std::string journal_tail;                //!< Scratch space used by read_journal( ).
+    vector< EventIndex::Occurrence > occurrences;  //!< Scratch space used by the display functions.
+
+
+    //! Parses a space and then a decimal number at cursor, moving cursor past them. Returns false if they aren't there.
+    bool parse_field( const char *&cursor, const char *last, long long &value ) noexcept
+    {
+        if( cursor == last || *cursor != ' ' ) return false;
+        ++cursor;
+        char *number_end;
+        value = strtoll( cursor, &number_end, 10 );
+        if( number_end == cursor || number_end > last ) return false;
+        cursor = number_end;
+        return true;
+    }
+
+
+    //! Applies one journal record in [first, last), which doesn't include the end of the line.
+    bool apply_record( const char *first, const char *last )
+    {
+        // The numbers are converted in place. Every line ends before the end of journal_tail, so
+        // a conversion that runs past the end of its line stops there at the latest.
+        if( first == last ) return false;
+        const char *cursor = first + 1;
+        long long id;
+        if( !parse_field( cursor, last, id ) || id <= 0 ) return false;
+        if( *first == 'X' ) {
+            if( cursor != last ) return false;
+            events.erase( static_cast< TaskId >( id ) );
+            return true;
+        }
+        if( *first != 'V' ) return false;
+
+        long long start;
+        long long duration;
+        long long period;
+        if( !parse_field( cursor, last, start ) || !parse_field( cursor, last, duration ) ||
+            !parse_field( cursor, last, period ) || cursor == last || *cursor != ' ' ) {
+            return false;
+        }
+        const long long limit = numeric_limits< std::int32_t >::max( );
+        if( duration < 0 || duration > limit || period < 0 || period > limit || ( period != 0 && duration >= period ) ) {
+            return false;
+        }
+        events.insert( static_cast< TaskId >( id ), start, static_cast< std::int32_t >( duration ),
+                       static_cast< std::int32_t >( period ), cursor + 1, last );
+        return true;
+    }
+
+
+    //! Applies the journal records added since the journal was last read. The caller holds event_lock.
+    /*!
+     * A record that is still being written (without the end of its line) is left for next time.
+     */
+    void read_journal( )
+    {
+        FILE *journal_file = fopen( event_journal_name.c_str( ), "rb" );
+        if( journal_file == nullptr ) return;
+        journal_tail.clear( );
+        if( fseek( journal_file, journal_read, SEEK_SET ) == 0 ) {
+            char buffer[4096];
+            std::size_t count;
+            while( ( count = fread( buffer, 1, sizeof( buffer ), journal_file ) ) != 0 ) {
+                journal_tail.append( buffer, count );
+            }
+        }
+        fclose( journal_file );
+
+        const char *const tail_end = journal_tail.data( ) + journal_tail.size( );
+        const char *line_start = journal_tail.data( );
+        while( true ) {
+            const char *line_end = static_cast< const char * >( memchr( line_start, '\n', static_cast< std::size_t >( tail_end - line_start ) ) );
+            if( line_end == nullptr ) break;
+            if( !apply_record( line_start, line_end ) ) {
+                cerr << "Error in event journal! Bad record at offset " << journal_read << " ignored" << endl;
+            }
+            ++journal_records;
+            journal_read += static_cast< long >( line_end + 1 - line_start );
+            line_start = line_end + 1;
+        }
+    }
+
+
+    //! Loads the event file and applies the journal. The caller holds event_lock.
+    void load_events( )
+    {
+        static LatencyProbe &probe = find_probe( "load_events( )" );
+        LatencyTimer timer( probe );
+
+        events.clear( );
+        events_damaged   = false;
+        event_file_stamp = stamp_file( event_file_name );
+        MappedFile event_file;
+        if( event_file.open( event_file_name ) ) {
+            record_bytes( probe, event_file.size( ) );
+            const char *error = nullptr;
+            if( !read_event_file( event_file, events, error ) ) {
+                cerr << "Error in event file! File: " << event_file_name << " (" << error
+                     << ") (the event file won't be saved)" << endl;
+                events_damaged = true;
+            }
+        }
+        journal_read    = 0;
+        journal_records = 0;
+        read_journal( );
+        events_loaded = true;
+    }
+
+
+    //! Brings the events up to date with the files. The caller holds event_lock.
+    void refresh_events( )
+    {
+        // Another process replaced the event file, and emptied the journal, if the stamp changed.
+        if( !events_loaded || !( stamp_file( event_file_name ) == event_file_stamp ) ) {
+            load_events( );
+            return;
+        }
+        const long long journal_size = stamp_file( event_journal_name ).size;
+        if( journal_size < journal_read ) {
+            load_events( );
+        }
+        else if( journal_size > journal_read ) {
+            read_journal( );
+        }
+    }
+
+
+    //! Opens the lock file (the first time) and brings the events up to date.
+    void sync_events( )
+    {
+        if( !events_loaded ) {
+            const char *pixie_folder = getenv( "PIXIE_HOME" );
+            if( pixie_folder == nullptr ) {
+                pixie_folder = getenv( "HOME" );
+            }
+            event_file_name    = string( pixie_folder ) + "/.pixie-events";
+            event_journal_name = event_file_name + ".journal";
+            event_lock.open( string( pixie_folder ) + "/.pixie-tasks.lock" );
+        }
+        LockHolder holder( event_lock, false );
+        refresh_events( );
+    }
+
+
+    //! Writes every event to a new event file and empties the journal. The caller holds event_lock exclusively.
+    void compact_events( )
+    {
+        static LatencyProbe &probe = find_probe( "compact_events( )" );
+        LatencyTimer timer( probe );
+
+        if( events_damaged ) return;
+        events.compact( );
+        const string temporary_name = event_file_name + ".new";
+        {
+            ofstream event_file( temporary_name.c_str( ), ios::binary );
+            if( !event_file || !write_event_file( event_file, events ) || !event_file.flush( ) ) {
+                cerr << "Can't write the event file; the event journal keeps growing" << endl;
+                return;
+            }
+        }
+#if defined(_WIN32)
+        remove( event_file_name.c_str( ) );
+#endif
+        if( rename( temporary_name.c_str( ), event_file_name.c_str( ) ) != 0 ) return;
+
+        // The journal keeps its identity so that a process reading it sees that it got shorter.
+        FILE *journal_file = fopen( event_journal_name.c_str( ), "wb" );
+        if( journal_file != nullptr ) fclose( journal_file );
+        event_file_stamp = stamp_file( event_file_name );
+        journal_read     = 0;
+        journal_records  = 0;
+    }
+
+
+    //! Adds a record to the journal and applies it, compacting the journal if it is long.
+    /*!
+     * Returns false, applying nothing, if the record couldn't be written.
+     */
+    bool write_record( const string &record )
+    {
+        LockHolder holder( event_lock, true );
+        refresh_events( );
+
+        FILE *journal_file = fopen( event_journal_name.c_str( ), "ab" );
+        bool written = journal_file != nullptr &&
+                       fwrite( record.data( ), 1, record.size( ), journal_file ) == record.size( ) &&
+                       fflush( journal_file ) == 0;
+#if !defined(_WIN32)
+        written = written && fsync( fileno( journal_file ) ) == 0;
+#endif
+        if( journal_file != nullptr ) fclose( journal_file );
+        if( !written ) {
+            cerr << "Can't write the event journal; the change is lost" << endl;
+            return false;
+        }
+
+        read_journal( );
+        if( journal_records >= max( min_journal_length, events.size( ) / 16 ) ) compact_events( );
+        return true;
+    }
+
+
+    //! Returns the record that gives every field of an event.
+    string event_record( TaskId id, std::int64_t start, std::int32_t duration, std::int32_t period,
+                         const char *first, const char *last )
+    {
+        ostringstream record;
+        record << "V " << id << " " << start << " " << duration << " " << period << " ";
+        record.write( first, last - first );
+        record << "\n";
+        return record.str( );
+    }
+
+
+    //! Displays one occurrence of an event.
+    void display_occurrence( const EventIndex::Occurrence &occurrence )
+    {
+        const EventIndex::Event event = events.event( occurrence.slot );
+        int minute;
+        const spica::Date date = event_date( occurrence.start, minute );
+
+        cout << date << " "
+             << setfill( '0' ) << setw( 2 ) << minute / 60 << ":" << setw( 2 ) << minute % 60 << setfill( ' ' )
+             << setw( 6 ) << event.duration << " min  #" << event.id << "  ";
+        cout.write( event.text, static_cast< streamsize >( event.text_size ) );
+        if( event.period != 0 ) cout << "  (every " << event.period / minutes_per_day << " days)";
+        cout << "\n";
+    }
+
+
+    //! Displays the occurrences found by a query, or message if there are none.
+    void display_occurrences( const char *message )
+    {
+        for( const EventIndex::Occurrence &occurrence : occurrences ) display_occurrence( occurrence );
+        if( occurrences.empty( ) ) cout << message << "\n";
+        cout << flush;
+    }
+
+}
+
+
+bool parse_event_time( const char *first, const char *last, std::int64_t &minute )
+{
+    const char *date_end = find( first, last, 'T' );
+
+    // The date is read the same way as the date in the task file.
+    istringstream date_text( string( first, date_end ) );
+    spica::Date date;
+    if( !( date_text >> date ) || date_text.get( ) != char_traits< char >::eof( ) ) return false;
+
+    // Dates that don't exist, such as February 30, are rejected.
+    int minute_of_day;
+    if( event_date( event_minute( date, 0 ), minute_of_day ) != date ) return false;
+
+    int hour           = 0;
+    int minute_of_hour = 0;
+    if( date_end != last ) {
+        const string time_text( date_end + 1, last );
+        if( time_text.size( ) != 5 || time_text[2] != ':' ||
+            !isdigit( static_cast< unsigned char >( time_text[0] ) ) || !isdigit( static_cast< unsigned char >( time_text[1] ) ) ||
+            !isdigit( static_cast< unsigned char >( time_text[3] ) ) || !isdigit( static_cast< unsigned char >( time_text[4] ) ) ) {
+            return false;
+        }
+        hour           = 10 * ( time_text[0] - '0' ) + ( time_text[1] - '0' );
+        minute_of_hour = 10 * ( time_text[3] - '0' ) + ( time_text[4] - '0' );
+        if( hour > 23 || minute_of_hour > 59 ) return false;
+    }
+    minute = event_minute( date, 60 * hour + minute_of_hour );
+    return true;
+}
+
+
+std::int64_t event_minute( const spica::Date &date, int minute_of_day ) noexcept
+{
+    // The day is numbered as in the task list, where date_number( ) gives the days since 1970-01-01.
+    return static_cast< std::int64_t >( days_from_civil( date.year( ), date.month( ), date.day( ) ) ) * minutes_per_day +
+           minute_of_day;
+}
+
+
+spica::Date event_date( std::int64_t minute, int &minute_of_day )
+{
+    const std::int64_t day_index = minute / minutes_per_day - ( minute % minutes_per_day < 0 ? 1 : 0 );
+    minute_of_day = static_cast< int >( minute - day_index * minutes_per_day );
+    long year;
+    int  month;
+    int  day;
+    civil_from_days( static_cast< long >( day_index ), year, month, day );
+    return spica::Date( static_cast< int >( year ), month, day );
+}
+
+
+std::int64_t current_event_minute( )
+{
+    // Today's date is found the same way the task list finds it.
+    const time_t now = time( nullptr );
+    const struct tm * const cooked_time = localtime( &now );
+    const spica::Date today( cooked_time->tm_year + 1900, cooked_time->tm_mon + 1, cooked_time->tm_mday );
+    return event_minute( today, 60 * cooked_time->tm_hour + cooked_time->tm_min );
+}
+
+
+bool event_exists( std::uint64_t event_id )
+{
+    sync_events( );
+    EventIndex::Event event;
+    return events.find( event_id, event );
+}
+
+
+std::uint64_t create_event( std::int64_t start, int duration, const char *first, const char *last )
+{
+    sync_events( );
+    const TaskId id = claim_entity_id( events.largest_id( ) + 1 );
+    return write_record( event_record( id, start, duration, 0, first, last ) ) ? id : 0;
+}
+
+
+bool repeat_event( std::uint64_t event_id, int days )
+{
+    sync_events( );
+    EventIndex::Event event;
+    if( !events.find( event_id, event ) ) return true;
+    const std::int32_t period = days * minutes_per_day;
+    if( period != 0 && event.duration >= period ) return false;
+    write_record( event_record( event.id, event.start, event.duration, period, event.text, event.text + event.text_size ) );
+    return true;
+}
+
+
+void cancel_event( std::uint64_t event_id )
+{
+    if( event_exists( event_id ) ) write_record( "X " + to_string( event_id ) + "\n" );
+}
+
+
+void display_upcoming( int count )
+{
+    static LatencyProbe &probe = find_probe( "display_upcoming( )" );
+    LatencyTimer timer( probe );
+
+    sync_events( );
+    events.upcoming( current_event_minute( ), static_cast< std::size_t >( count ), occurrences );
+    display_occurrences( "No upcoming events" );
+}
+
+
+void display_agenda( int days )
+{
+    static LatencyProbe &probe = find_probe( "display_agenda( )" );
+    LatencyTimer timer( probe );
+
+    sync_events( );
+    const std::int64_t now = current_event_minute( );
+    const std::int64_t end = ( now / minutes_per_day + days + 1 ) * minutes_per_day;
+    events.overlapping( now, end, occurrences );
+    display_occurrences( "No events" );
+}
+
+
+void display_current_events( )
+{
+    static LatencyProbe &probe = find_probe( "display_current_events( )" );
+    LatencyTimer timer( probe );
+
+    sync_events( );
+    const std::int64_t now = current_event_minute( );
+    events.overlapping( now, now + 1, occurrences );
+    display_occurrences( "No events in progress" );
+}
+
+
+void cleanup_events( )
+{
+    events.clear( );
+    events_loaded = false;
+    event_lock.close( );
+}
@@ -0,0 +1,69 @@
+/*! \file    Events.hpp
+ *  \brief   The calendar of events.
+ *  \author  Peter C. Chapin <pchapin@vtc.edu>
+ */
+
+#ifndef EVENTS_HPP
+#define EVENTS_HPP
+
+#include <cstdint>
+
+#include "Date.hpp"
+
+//! Returns the minute number of the given minute (counted from midnight) of a date.
+/*!
+ * Events are timed to the minute, which spica::Date doesn't represent, so a time is kept as one
+ * integer: the number of its date, counted as the task list counts days, times 1440 plus the
+ * minute of the day. These integers can be compared and added to directly, which the interval
+ * tree of events needs, and they convert back to a spica::Date with event_date( ). Changes to
+ * and from daylight saving time are ignored, so an event at 14:30 stays at 14:30 local time.
+ */
+std::int64_t event_minute( const spica::Date &date, int minute_of_day ) noexcept;
+
+//! Returns the date of a minute number and sets minute_of_day to the minute within that date.
+spica::Date event_date( std::int64_t minute, int &minute_of_day );
+
+//! Returns the minute number of the current local time.
+std::int64_t current_event_minute( );
+
+//! Parses [first, last) as a time: a date written as in the task file, optionally followed by T and hh:mm.
+/*!
+ * On success minute is set to the minute number (see event_minute( )) of the time; a date
+ * without a time means the start of the day. Returns false if [first, last) isn't a valid time.
+ */
+bool parse_event_time( const char *first, const char *last, std::int64_t &minute );
+
+//! Returns true if the event with the given ID exists.
+bool event_exists( std::uint64_t event_id );
+
+//! Creates a one-off event with the description [first, last) and returns its ID.
+/*!
+ * The event starts at the given minute and lasts for duration minutes; an event with no duration
+ * marks a moment. Events are stored in .pixie-events next to the task file, and are loaded when
+ * one of the functions declared here is first called. Changes made by other Pixie processes are
+ * applied by each of these functions before it does anything else.
+ */
+std::uint64_t create_event( std::int64_t start, int duration, const char *first, const char *last );
+
+//! Makes an event recur every given number of days, or occur once if days is zero.
+/*!
+ * Returns false, changing nothing, if the event lasts at least as long as the period.
+ */
+bool repeat_event( std::uint64_t event_id, int days );
+
+//! Deletes an event.
+void cancel_event( std::uint64_t event_id );
+
+//! Displays the next count occurrences of events that start from now on.
+void display_upcoming( int count );
+
+//! Displays the occurrences of events in progress from now to the end of the day the given number of days from today.
+void display_agenda( int days );
+
+//! Displays the events that are in progress now.
+void display_current_events( );
+
+//! Releases the memory used by the events.
+void cleanup_events( );
+
+#endif
@@ -0,0 +1,510 @@
+/*! \file    Export.cpp
+ *  \brief   Export of tasks and sessions as CSV or JSON Lines.
+ *  \author  Peter C. Chapin <pchapin@vtc.edu>
+ *
+ * Records are formatted by write_in_parallel( ), so the functions that read a record must only
+ * read the task list or history. The task list doesn't change during an export, so it is
+ * formatted in place. The sessions are read from the history file one chunk at a time by the
+ * thread formatting the chunk, so they are never all in memory at once.
+ */
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+
+#include "Calendar.hpp"
+#include "Export.hpp"
+#include "ParallelWriter.hpp"
+#include "SessionHistory.hpp"
+#include "TaskList.hpp"
+
+using namespace std;
+
+namespace {
+
+    struct FieldInfo {
+        const char *name;
+        bool        numeric;
+    };
+
+    const FieldInfo task_fields[] = {
+        { "id",          true  },
+        { "number",      true  },
+        { "description", false },
+        { "priority",    true  },
+        { "daily",       true  },
+        { "today",       true  },
+        { "total",       true  },
+        { "debt",        true  },
+        { "running",     true  },
+        { "shard",       false }
+    };
+    const int task_field_count = sizeof( task_fields ) / sizeof( task_fields[0] );
+
+    const FieldInfo session_fields[] = {
+        { "id",          true  },
+        { "description", false },
+        { "start",       false },
+        { "end",         false },
+        { "seconds",     true  }
+    };
+    const int session_field_count = sizeof( session_fields ) / sizeof( session_fields[0] );
+
+    //! The value of one field of one record.
+    struct Value {
+        long long   number;
+        const char *text;          //!< Not null terminated. Might point into storage.
+        std::size_t size;
+        char        storage[24];
+    };
+
+    bool is_blank( char ch ) noexcept
+    {
+        return ch == ' ' || ch == '\t' || ch == '\r' || ch == '\n';
+    }
+
+    //! Returns the index of the field named [first, last), or -1 if there is no such field.
+    int find_field( const FieldInfo *fields, int field_count, const char *first, const char *last ) noexcept
+    {
+        const std::size_t size = static_cast< std::size_t >( last - first );
+        for( int i = 0; i < field_count; ++i ) {
+            if( strlen( fields[i].name ) == size && memcmp( fields[i].name, first, size ) == 0 ) return i;
+        }
+        return -1;
+    }
+
+    //! Appends a number in decimal.
+    void append_number( string &output, long long number )
+    {
+        char digits[24];
+        char *end = digits + sizeof( digits );
+        char *start = end;
+        unsigned long long magnitude = ( number < 0 ) ? 0ULL - static_cast< unsigned long long >( number )
+                                                      : static_cast< unsigned long long >( number );
+        do {
+            *--start = static_cast< char >( '0' + magnitude % 10 );
+            magnitude /= 10;
+        } while( magnitude != 0 );
+        if( number < 0 ) *--start = '-';
+        output.append( start, end );
+    }
+
+    //! Appends text as a CSV field, quoted only if it needs to be.
+    void append_csv_text( string &output, const char *text, std::size_t size )
+    {
+        bool quote = false;
+        for( std::size_t i = 0; i < size && !quote; ++i ) {
+            quote = text[i] == ',' || text[i] == '"' || text[i] == '\n' || text[i] == '\r';
+        }
+        if( !quote ) {
+            output.append( text, size );
+            return;
+        }
+        output += '"';
+        for( std::size_t i = 0; i < size; ++i ) {
+            if( text[i] == '"' ) output += '"';
+            output += text[i];
+        }
+        output += '"';
+    }
+
+    //! Appends text as a JSON string.
+    void append_json_text( string &output, const char *text, std::size_t size )
+    {
+        static const char hex_digits[] = "0123456789abcdef";
+
+        output += '"';
+        std::size_t plain = 0;
+        for( std::size_t i = 0; i < size; ++i ) {
+            const unsigned char ch = static_cast< unsigned char >( text[i] );
+            if( ch >= 0x20 && ch != '"' && ch != '\\' ) continue;
+            output.append( text + plain, i - plain );
+            plain = i + 1;
+            switch( ch ) {
+            case '"':  output += "\\\""; break;
+            case '\\': output += "\\\\"; break;
+            case '\n': output += "\\n";  break;
+            case '\r': output += "\\r";  break;
+            case '\t': output += "\\t";  break;
+            default:
+                output += "\\u00";
+                output += hex_digits[ch >> 4];
+                output += hex_digits[ch & 0xF];
+                break;
+            }
+        }
+        output.append( text + plain, size - plain );
+        output += '"';
+    }
+
+    //! Stores a time as UTC in the form 2026-10-18T14:30:00Z.
+    void set_time( Value &value, std::int64_t time ) noexcept
+    {
+        std::int64_t days = time / 86400;
+        std::int64_t seconds = time % 86400;
+        if( seconds < 0 ) {
+            seconds += 86400;
+            --days;
+        }
+        long year;
+        int  month;
+        int  day;
+        civil_from_days( static_cast< long >( days ), year, month, day );
+        const int hour   = static_cast< int >( seconds / 3600 );
+        const int minute = static_cast< int >( seconds / 60 % 60 );
+        const int second = static_cast< int >( seconds % 60 );
+
+        char *p = value.storage;
+        // Years outside 0 .. 9999 only come from damaged histories; they are clamped.
+        const long shown_year = ( year < 0 ) ? 0 : ( year > 9999 ) ? 9999 : year;
+        for( long divisor = 1000; divisor != 0; divisor /= 10 ) *p++ = static_cast< char >( '0' + shown_year / divisor % 10 );
+        const int parts[] = { month, day, hour, minute, second };
+        const char separators[] = { '-', '-', 'T', ':', ':' };
+        for( int i = 0; i < 5; ++i ) {
+            *p++ = separators[i];
+            *p++ = static_cast< char >( '0' + parts[i] / 10 );
+            *p++ = static_cast< char >( '0' + parts[i] % 10 );
+        }
+        *p++ = 'Z';
+        value.text = value.storage;
+        value.size = static_cast< std::size_t >( p - value.storage );
+    }
+
+    //! Returns true if a field's value passes the request's filter.
+    bool passes( const ExportRequest &request, bool numeric, const Value &value ) noexcept
+    {
+        typedef ExportRequest::Test Test;
+
+        if( request.filter_test == Test::contains ) {
+            const string &wanted = request.filter_text;
+            if( numeric ) return false;
+            if( wanted.empty( ) ) return true;
+            if( wanted.size( ) > value.size ) return false;
+            for( std::size_t i = 0; i + wanted.size( ) <= value.size; ++i ) {
+                if( memcmp( value.text + i, wanted.data( ), wanted.size( ) ) == 0 ) return true;
+            }
+            return false;
+        }
+
+        int order;
+        if( numeric ) {
+            order = ( value.number < request.filter_number ) ? -1 : ( value.number > request.filter_number ) ? 1 : 0;
+        }
+        else {
+            const std::size_t common = min( value.size, request.filter_text.size( ) );
+            order = memcmp( value.text, request.filter_text.data( ), common );
+            if( order == 0 ) order = ( value.size < request.filter_text.size( ) ) ? -1 : ( value.size > request.filter_text.size( ) ) ? 1 : 0;
+        }
+        switch( request.filter_test ) {
+        case Test::equal:         return order == 0;
+        case Test::not_equal:     return order != 0;
+        case Test::less:          return order <  0;
+        case Test::less_equal:    return order <= 0;
+        case Test::greater:       return order >  0;
+        case Test::greater_equal: return order >= 0;
+        default:                  return false;
+        }
+    }
+
+    //! Reads the fields of the tasks in a list.
+    class TaskRecords {
+    public:
+        TaskRecords( const TaskList &tasks, const vector< string > &shard_names )
+            : tasks( tasks ), shard_names( shard_names ) { }
+
+        bool include( std::size_t ) const noexcept { return true; }
+
+        void get( std::size_t position, int field, Value &value ) const noexcept
+        {
+            value.number = 0;
+            switch( field ) {
+            case 0: value.number = static_cast< long long >( tasks.id( position ) ); break;
+            case 1: value.number = static_cast< long long >( position + 1 ); break;
+            case 2:
+                value.text = tasks.description( position ).data( );
+                value.size = tasks.description( position ).size( );
+                break;
+            case 3: value.number = tasks.priority[position]; break;
+            case 4: value.number = tasks.daily[position]; break;
+            case 5: value.number = tasks.today( position ); break;
+            case 6: value.number = tasks.accumulated[position]; break;
+            case 7: value.number = tasks.debt( position ); break;
+            case 8: value.number = ( tasks.start_time[position] != 0 ) ? 1 : 0; break;
+            case 9: {
+                const std::size_t shard = tasks.shard[position];
+                if( shard < shard_names.size( ) ) {
+                    value.text = shard_names[shard].data( );
+                    value.size = shard_names[shard].size( );
+                }
+                else {
+                    value.text = "";
+                    value.size = 0;
+                }
+                break;
+            }
+            }
+        }
+
+    private:
+        const TaskList &tasks;
+        const vector< string > &shard_names;
+    };
+
+    //! Reads the fields of the sessions [first, first + sessions.size( )) of a history.
+    /*!
+     * A session's description is the current description of its task, or the one recorded when
+     * the task was deleted.
+     */
+    class SessionRecords {
+    public:
+        SessionRecords( const SessionHistory &history, const TaskList &tasks,
+                        const vector< SessionHistory::Session > &sessions, std::size_t first )
+            : history( history ), tasks( tasks ), sessions( sessions ), first( first ) { }
+
+        bool include( std::size_t ) const noexcept { return true; }
+
+        void get( std::size_t index, int field, Value &value ) const noexcept
+        {
+            const SessionHistory::Session &session = sessions[index - first];
+            value.number = 0;
+            switch( field ) {
+            case 0: value.number = static_cast< long long >( session.task ); break;
+            case 1: {
+                const std::size_t position = tasks.find( session.task );
+                const string *name = history.deleted_name( session.task );
+                if( position != TaskList::npos ) {
+                    value.text = tasks.description( position ).data( );
+                    value.size = tasks.description( position ).size( );
+                }
+                else if( name != nullptr ) {
+                    value.text = name->data( );
+                    value.size = name->size( );
+                }
+                else {
+                    value.text = "";
+                    value.size = 0;
+                }
+                break;
+            }
+            case 2: set_time( value, session.start ); break;
+            case 3: set_time( value, session.end ); break;
+            case 4: value.number = session.end - session.start; break;
+            }
+        }
+
+    private:
+        const SessionHistory &history;
+        const TaskList &tasks;
+        const vector< SessionHistory::Session > &sessions;
+        std::size_t first;
+    };
+
+    //! Appends the records [first, last) that pass the filter, with the requested fields.
+    template< typename Records >
+    void format_records( const ExportRequest &request, const FieldInfo *fields, const Records &records,
+                         std::size_t first, std::size_t last, string &output )
+    {
+        const bool json = request.format == ExportRequest::Format::json_lines;
+        Value value;
+
+        for( std::size_t record = first; record < last; ++record ) {
+            if( !records.include( record ) ) continue;
+            if( request.filter_field >= 0 ) {
+                records.get( record, request.filter_field, value );
+                if( !passes( request, fields[request.filter_field].numeric, value ) ) continue;
+            }
+            if( json ) output += '{';
+            for( std::size_t i = 0; i < request.fields.size( ); ++i ) {
+                const FieldInfo &field = fields[request.fields[i]];
+                if( i != 0 ) output += ',';
+                if( json ) {
+                    output += '"';
+                    output += field.name;
+                    output += "\":";
+                }
+                records.get( record, request.fields[i], value );
+                if( field.numeric ) append_number( output, value.number );
+                else if( json ) append_json_text( output, value.text, value.size );
+                else append_csv_text( output, value.text, value.size );
+            }
+            output += json ? "}\n" : "\n";
+        }
+    }
+
+    //! Writes the CSV header line, if the format has one.
+    void write_header( const ExportRequest &request, const FieldInfo *fields, ostream &output )
+    {
+        if( request.format != ExportRequest::Format::csv ) return;
+        for( std::size_t i = 0; i < request.fields.size( ); ++i ) {
+            if( i != 0 ) output << ',';
+            output << fields[request.fields[i]].name;
+        }
+        output << '\n';
+    }
+
+}
+
+
+bool parse_export( const char *first, const char *last, ExportRequest &request, const char *&error )
+{
+    request = ExportRequest( );
+
+    // Split the request into words.
+    vector< pair< const char *, const char * > > words;
+    while( true ) {
+        while( first != last && is_blank( *first ) ) ++first;
+        if( first == last ) break;
+        const char *word_end = first;
+        while( word_end != last && !is_blank( *word_end ) ) ++word_end;
+        words.push_back( make_pair( first, word_end ) );
+        first = word_end;
+    }
+    if( words.size( ) < 3 ) {
+        error = "export needs a source (tasks or sessions), a format (csv or jsonl), and a file (- for the screen)";
+        return false;
+    }
+
+    const string source( words[0].first, words[0].second );
+    const string format( words[1].first, words[1].second );
+    if( source == "tasks" ) request.source = ExportRequest::Source::tasks;
+    else if( source == "sessions" ) request.source = ExportRequest::Source::sessions;
+    else {
+        error = "the export sources are tasks and sessions";
+        return false;
+    }
+    if( format == "csv" ) request.format = ExportRequest::Format::csv;
+    else if( format == "jsonl" ) request.format = ExportRequest::Format::json_lines;
+    else {
+        error = "the export formats are csv and jsonl";
+        return false;
+    }
+    request.file_name.assign( words[2].first, words[2].second );
+
+    const bool tasks = request.source == ExportRequest::Source::tasks;
+    const FieldInfo *fields = tasks ? task_fields : session_fields;
+    const int field_count = tasks ? task_field_count : session_field_count;
+
+    for( std::size_t i = 3; i < words.size( ); ++i ) {
+        const char *option = words[i].first;
+        const char *option_end = words[i].second;
+        if( option_end - option > 7 && memcmp( option, "fields=", 7 ) == 0 ) {
+            const char *name = option + 7;
+            while( name <= option_end ) {
+                const char *name_end = name;
+                while( name_end != option_end && *name_end != ',' ) ++name_end;
+                const int field = find_field( fields, field_count, name, name_end );
+                if( field < 0 ) {
+                    error = "no such field to export";
+                    return false;
+                }
+                request.fields.push_back( field );
+                name = name_end + 1;
+            }
+        }
+        else if( option_end - option > 6 && memcmp( option, "where=", 6 ) == 0 ) {
+            const char *name = option + 6;
+            const char *test = name;
+            while( test != option_end && strchr( "=!<>~", *test ) == nullptr ) ++test;
+            request.filter_field = find_field( fields, field_count, name, test );
+            if( request.filter_field < 0 ) {
+                error = "no such field to filter on";
+                return false;
+            }
+
+            typedef ExportRequest::Test Test;
+            const char *value = test + 1;
+            if( test == option_end ) {
+                error = "a filter looks like where=field<value; the tests are = != < <= > >= and ~";
+                return false;
+            }
+            switch( *test ) {
+            case '=': request.filter_test = Test::equal; break;
+            case '~': request.filter_test = Test::contains; break;
+            case '!':
+                if( value == option_end || *value != '=' ) {
+                    error = "a filter looks like where=field<value; the tests are = != < <= > >= and ~";
+                    return false;
+                }
+                request.filter_test = Test::not_equal;
+                ++value;
+                break;
+            case '<':
+            case '>':
+                if( value != option_end && *value == '=' ) {
+                    request.filter_test = ( *test == '<' ) ? Test::less_equal : Test::greater_equal;
+                    ++value;
+                }
+                else {
+                    request.filter_test = ( *test == '<' ) ? Test::less : Test::greater;
+                }
+                break;
+            }
+            request.filter_text.assign( value, option_end );
+
+            if( fields[request.filter_field].numeric ) {
+                if( request.filter_test == Test::contains ) {
+                    error = "only text fields can be tested with ~";
+                    return false;
+                }
+                char *end;
+                request.filter_number = strtoll( request.filter_text.c_str( ), &end, 10 );
+                if( request.filter_text.empty( ) || *end != '\0' ) {
+                    error = "that field must be compared with an integer";
+                    return false;
+                }
+            }
+        }
+        else {
+            error = "export options are fields=field,... and where=field<value";
+            return false;
+        }
+    }
+
+    if( request.fields.empty( ) ) {
+        for( int i = 0; i < field_count; ++i ) request.fields.push_back( i );
+    }
+    return true;
+}
+
+
+bool export_tasks( const TaskList &tasks, const vector< string > &shard_names,
+                   const ExportRequest &request, ostream &output )
+{
+    const TaskRecords records( tasks, shard_names );
+
+    write_header( request, task_fields, output );
+    return write_in_parallel( output, tasks.size( ), [&]( std::size_t first, std::size_t last, string &text ) {
+        format_records( request, task_fields, records, first, last, text );
+    } ) && output.flush( );
+}
+
+
+bool export_sessions( SessionHistory &history, const TaskList &tasks, const ExportRequest &request,
+                      ostream &output, const char *&error )
+{
+    std::size_t count;
+    if( !history.recorded_sessions( count ) ) {
+        error = "the session history isn't available";
+        return false;
+    }
+
+    write_header( request, session_fields, output );
+    try {
+        const SessionHistory &readable = history;
+        const bool written = write_in_parallel( output, count, [&]( std::size_t first, std::size_t last, string &text ) {
+            vector< SessionHistory::Session > sessions;
+            if( !readable.read_sessions( first, last - first, sessions ) ) {
+                throw runtime_error( "the session history couldn't be read" );
+            }
+            format_records( request, session_fields, SessionRecords( readable, tasks, sessions, first ), first, last, text );
+        } ) && output.flush( );
+        if( !written ) error = "the export couldn't be written";
+        return written;
+    }
+    catch( runtime_error & ) {
+        error = "the session history couldn't be read";
+        return false;
+    }
+}
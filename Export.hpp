@@ -0,0 +1,57 @@
+/*! \file    Export.hpp
+ *  \brief   Export of tasks and sessions as CSV or JSON Lines.
+ *  \author  Peter C. Chapin <pchapin@vtc.edu>
+ */
+
+#ifndef EXPORT_HPP
+#define EXPORT_HPP
+
+#include <ostream>
+#include <string>
+#include <vector>
+
+class SessionHistory;
+class TaskList;
+
+//! What to export, where, and how. See parse_export( ).
+struct ExportRequest {
+    enum class Source { tasks, sessions };
+    enum class Format { csv, json_lines };
+    enum class Test { equal, not_equal, less, less_equal, greater, greater_equal, contains };
+
+    Source            source = Source::tasks;
+    Format            format = Format::csv;
+    std::string       file_name;             //!< "-" means the standard output.
+    std::vector< int > fields;               //!< Fields to write, in order; indexes into the source's fields.
+    int               filter_field = -1;     //!< Field tested by the filter, or -1 to export every record.
+    Test              filter_test  = Test::equal;
+    std::string       filter_text;           //!< Value the field is compared with.
+    long long         filter_number = 0;     //!< The same value, for numeric fields.
+};
+
+//! Parses an export request of the form "source format file [fields=f,...] [where=f<op>value]".
+/*!
+ * The source is tasks or sessions and the format is csv or jsonl. Tasks have the fields id,
+ * number, description, priority, daily, today, total, debt, running, and shard; sessions have
+ * id, description, start, end, and seconds (times are written as UTC in ISO 8601 form). Every field
+ * is written unless fields= selects some. The filter operators are = != < <= > >= and ~ (the
+ * field's text contains the value). Returns false, explaining in error, if the request is bad.
+ */
+bool parse_export( const char *first, const char *last, ExportRequest &request, const char *&error );
+
+//! Writes the tasks in a list, in the list's order, as requested. Returns false if the output fails.
+/*!
+ * Tasks are numbered from 1 in the order of the list; shard_names gives the name of each shard.
+ */
+bool export_tasks( const TaskList &tasks, const std::vector< std::string > &shard_names,
+                   const ExportRequest &request, std::ostream &output );
+
+//! Writes the sessions in a history, in the order they ended, as requested.
+/*!
+ * The descriptions of the tasks still in the list are taken from tasks. Returns false (and
+ * explains in error) if the history can't be read or the output fails.
+ */
+bool export_sessions( SessionHistory &history, const TaskList &tasks, const ExportRequest &request,
+                      std::ostream &output, const char *&error );
+
+#endif
@@ -0,0 +1,110 @@
+/*! \file    FileWatch.cpp
+ *  \brief   Notices changes that other processes make to files.
+ *  \author  Peter C. Chapin <pchapin@vtc.edu>
+ */
+
+#include <algorithm>
+#include <cerrno>
+
+#if !defined(_WIN32)
+#include <sys/stat.h>
+#include <sys/types.h>
+#endif
+
+#if defined(__linux__)
+#include <sys/inotify.h>
+#include <unistd.h>
+#define PIXIE_HAVE_INOTIFY
+#endif
+
+#include "FileWatch.hpp"
+
+using namespace std;
+
+FileStamp stamp_file( const string &file_name ) noexcept
+{
+    FileStamp stamp;
+#if !defined(_WIN32)
+    struct stat status;
+    if( stat( file_name.c_str( ), &status ) != 0 ) return stamp;
+    stamp.exists   = true;
+    stamp.device   = static_cast< std::uint64_t >( status.st_dev );
+    stamp.inode    = static_cast< std::uint64_t >( status.st_ino );
+#if defined(__linux__)
+    stamp.modified = static_cast< long long >( status.st_mtim.tv_sec ) * 1000000000LL + status.st_mtim.tv_nsec;
+#else
+    stamp.modified = static_cast< long long >( status.st_mtime );
+#endif
+    stamp.size     = static_cast< long long >( status.st_size );
+#else
+    (void)file_name;
+#endif
+    return stamp;
+}
+
+
+FileWatch::~FileWatch( )
+{
+    close( );
+}
+
+
+bool FileWatch::open( const string &folder, const vector< string > &file_names )
+{
+    close( );
+    names = file_names;
+#if defined(PIXIE_HAVE_INOTIFY)
+    watch_fd = inotify_init1( IN_NONBLOCK | IN_CLOEXEC );
+    if( watch_fd == -1 ) return false;
+
+    // Files are replaced by renaming, so the folder is watched rather than the files themselves.
+    const uint32_t events = IN_MODIFY | IN_CLOSE_WRITE | IN_CREATE | IN_MOVED_TO | IN_DELETE;
+    if( inotify_add_watch( watch_fd, folder.c_str( ), events ) == -1 ) {
+        close( );
+        return false;
+    }
+    return true;
+#else
+    (void)folder;
+    return false;
+#endif
+}
+
+
+void FileWatch::close( ) noexcept
+{
+#if defined(PIXIE_HAVE_INOTIFY)
+    if( watch_fd != -1 ) ::close( watch_fd );
+#endif
+    watch_fd = -1;
+}
+
+
+bool FileWatch::changed( ) noexcept
+{
+#if defined(PIXIE_HAVE_INOTIFY)
+    if( watch_fd == -1 ) return true;
+
+    // Every pending event is read so that the next call only sees new ones.
+    alignas( inotify_event ) char buffer[4096];
+    bool found = false;
+    while( true ) {
+        const ssize_t count = read( watch_fd, buffer, sizeof( buffer ) );
+        if( count == -1 && errno == EINTR ) continue;
+        if( count <= 0 ) break;
+        for( ssize_t offset = 0; offset < count; ) {
+            const inotify_event *event = reinterpret_cast< const inotify_event * >( buffer + offset );
+            if( ( event->mask & IN_Q_OVERFLOW ) != 0 ) {
+                found = true;
+            }
+            else if( event->len != 0 && find( names.begin( ), names.end( ), event->name ) != names.end( ) ) {
+                found = true;
+            }
+            offset += static_cast< ssize_t >( sizeof( inotify_event ) + event->len );
+        }
+    }
+    return found;
+#else
+    return true;
+#endif
+}
@@ -0,0 +1,62 @@
+/*! \file    FileWatch.hpp
+ *  \brief   Notices changes that other processes make to files.
+ *  \author  Peter C. Chapin <pchapin@vtc.edu>
+ */
+
+#ifndef FILEWATCH_HPP
+#define FILEWATCH_HPP
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+//! Identifies one version of a file. Since files are replaced by renaming, a new version has a new stamp.
+struct FileStamp {
+    bool          exists   = false;
+    std::uint64_t device   = 0;
+    std::uint64_t inode    = 0;
+    long long     modified = 0;  //!< In nanoseconds where that is available.
+    long long     size     = 0;
+
+    bool operator==( const FileStamp &other ) const noexcept
+    {
+        return exists == other.exists && device == other.device && inode == other.inode &&
+               modified == other.modified && size == other.size;
+    }
+};
+
+//! Returns the stamp of the named file. The stamp of a file that doesn't exist is all zeros.
+FileStamp stamp_file( const std::string &file_name ) noexcept;
+
+//! Watches some of the files in one folder for changes.
+/*!
+ * On Linux this uses inotify, so checking for changes costs one system call that never waits.
+ * Elsewhere every check reports a possible change and the caller must look for itself. Changes
+ * made by this process are reported too.
+ */
+class FileWatch {
+public:
+    FileWatch( ) = default;
+   ~FileWatch( );
+
+    FileWatch( const FileWatch & ) = delete;
+    FileWatch &operator=( const FileWatch & ) = delete;
+
+    //! Starts watching the named files in the given folder. They need not exist yet.
+    bool open( const std::string &folder, const std::vector< std::string > &file_names );
+
+    //! Stops watching.
+    void close( ) noexcept;
+
+    //! Returns a descriptor that becomes readable when a watched file changes, or -1 if there is none.
+    int descriptor( ) const noexcept { return watch_fd; }
+
+    //! Returns true if a watched file might have changed since the last call. Never waits.
+    bool changed( ) noexcept;
+
+private:
+    int                        watch_fd = -1;
+    std::vector< std::string > names;
+};
+
+#endif
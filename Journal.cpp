@@ -0,0 +1,215 @@
+/*! \file    Journal.cpp
+ *  \brief   Append-only log of changes to the task list.
+ *  \author  Peter C. Chapin <pchapin@vtc.edu>
+ */
+
+#include <cstdio>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <unistd.h>
+#endif
+
+#include "Journal.hpp"
+#include "Statistics.hpp"
+
+using namespace std;
+
+namespace {
+
+    //! Records the time spent writing the journal and the bytes written to it.
+    LatencyProbe &journal_probe( ) noexcept
+    {
+        static LatencyProbe &probe = find_probe( "Journal::write( )" );
+        return probe;
+    }
+
+}
+
+Journal::~Journal( )
+{
+    close( );
+}
+
+
+bool Journal::open( const string &file_name )
+{
+    close( );
+    file = fopen( file_name.c_str( ), "a" );
+    if( file == nullptr ) return false;
+
+    name   = file_name;
+    opened = true;
+    buffer.clear( );
+    fseek( file, 0, SEEK_END );
+    written = ftell( file );
+    bytes   = written;
+    return true;
+}
+
+
+void Journal::close( ) noexcept
+{
+    opened = false;
+    if( file != nullptr ) {
+        fclose( file );
+        file = nullptr;
+    }
+}
+
+
+// Descriptions can be long, so they are appended separately from the rest of the record.
+void Journal::append( int length, const char *description, size_t description_size ) noexcept
+{
+    if( length < 0 || static_cast< size_t >( length ) >= sizeof( line ) ) return;
+    try {
+        const size_t old_size = buffer.size( );
+        buffer.append( line, static_cast< size_t >( length ) );
+        if( description != nullptr ) {
+            buffer.append( description, description_size );
+            buffer += '\n';
+        }
+        bytes += static_cast< long >( buffer.size( ) - old_size );
+        ++records_made;
+    }
+    catch( ... ) {
+        // The change only exists in memory.
+    }
+}
+
+
+void Journal::task_record( char operation, size_t position, const TaskList &task_list ) noexcept
+{
+    if( !recording ) return;
+    append( snprintf( line, sizeof( line ), "%c %llu %lld %d %d %d %d %d ",
+        operation,
+        static_cast< unsigned long long >( task_list.id( position ) ),
+        static_cast< long long >( task_list.start_time[position] ),
+        task_list.accumulated[position],
+        task_list.today( position ),
+        task_list.daily[position],
+        task_list.priority[position],
+        task_list.debt( position ) ),
+        task_list.description( position ).data( ),
+        task_list.description( position ).size( ) );
+}
+
+
+void Journal::put( size_t position, const TaskList &task_list ) noexcept
+{
+    task_record( 'T', position, task_list );
+}
+
+
+void Journal::edit( size_t position, const TaskList &task_list ) noexcept
+{
+    task_record( 'E', position, task_list );
+}
+
+
+void Journal::add_work( TaskId task_id, int minutes ) noexcept
+{
+    if( !recording ) return;
+    append( snprintf( line, sizeof( line ), "A %llu %d\n", static_cast< unsigned long long >( task_id ), minutes ) );
+}
+
+
+void Journal::erase( TaskId task_id ) noexcept
+{
+    if( !recording ) return;
+    append( snprintf( line, sizeof( line ), "X %llu\n", static_cast< unsigned long long >( task_id ) ) );
+}
+
+
+void Journal::move( TaskId task_id, const string &shard_name ) noexcept
+{
+    if( !recording ) return;
+    append( snprintf( line, sizeof( line ), "S %llu ", static_cast< unsigned long long >( task_id ) ),
+            shard_name.data( ), shard_name.size( ) );
+}
+
+
+void Journal::record( char operation ) noexcept
+{
+    if( !recording ) return;
+    append( snprintf( line, sizeof( line ), "%c\n", operation ) );
+}
+
+
+void Journal::record( char operation, long long argument ) noexcept
+{
+    if( !recording ) return;
+    append( snprintf( line, sizeof( line ), "%c %lld\n", operation, argument ) );
+}
+
+
+void Journal::take( string &records ) noexcept
+{
+    if( records.empty( ) ) {
+        records.swap( buffer );
+        return;
+    }
+    try {
+        records += buffer;
+    }
+    catch( ... ) {
+        // The records only exist in memory.
+    }
+    buffer.clear( );
+}
+
+
+bool Journal::write( const string &records, unsigned long long &sequence, long &offset ) noexcept
+{
+    LatencyTimer timer( journal_probe( ) );
+
+    if( file == nullptr ) return false;
+    // Other processes might have written records (or emptied the journal) since the last write.
+    if( fflush( file ) != 0 || fseek( file, 0, SEEK_END ) != 0 ) return false;
+    offset = ftell( file );
+    bytes += offset - written;
+    written = offset;
+    if( records.empty( ) ) return true;
+
+    try {
+        numbered.clear( );
+        char number[24];
+        std::size_t line_start = 0;
+        while( line_start < records.size( ) ) {
+            std::size_t line_end = records.find( '\n', line_start );
+            line_end = ( line_end == string::npos ) ? records.size( ) : line_end + 1;
+            numbered.append( number, static_cast< size_t >( snprintf( number, sizeof( number ), "%llu ", ++sequence ) ) );
+            numbered.append( records, line_start, line_end - line_start );
+            line_start = line_end;
+        }
+    }
+    catch( ... ) {
+        return false;
+    }
+
+    // The records were counted in bytes without their sequence numbers.
+    const size_t count = fwrite( numbered.data( ), 1, numbered.size( ), file );
+    written += static_cast< long >( count );
+    bytes   += static_cast< long >( count ) - static_cast< long >( records.size( ) );
+    record_bytes( journal_probe( ), static_cast< unsigned long long >( count ) );
+    if( count != numbered.size( ) || fflush( file ) != 0 ) return false;
+#if defined(__unix__) || defined(__APPLE__)
+    if( fsync( fileno( file ) ) != 0 ) return false;
+#endif
+    return true;
+}
+
+
+bool Journal::truncate( )
+{
+    if( file == nullptr ) return false;
+    bytes -= written;
+    written = 0;
+#if defined(__unix__) || defined(__APPLE__)
+    // The file stays open (in append mode) so that it keeps its identity for other processes.
+    return fflush( file ) == 0 && ftruncate( fileno( file ), 0 ) == 0;
+#else
+    fclose( file );
+    file = fopen( name.c_str( ), "w" );
+    return file != nullptr;
+#endif
+}
@@ -0,0 +1,145 @@
+/*! \file    Journal.hpp
+ *  \brief   Append-only log of changes to the task list.
+ *  \author  Peter C. Chapin <pchapin@vtc.edu>
+ */
+
+#ifndef JOURNAL_HPP
+#define JOURNAL_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <cstdio>
+#include <string>
+
+#include "TaskList.hpp"
+
+//! Writes the task journal.
+/*!
+ * Every change to the task list appends one line of text to the journal so that saving costs
+ * the same no matter how many tasks there are. Each record starts with a sequence number; the
+ * task file notes the last record it already contains so that records are never applied twice.
+ * The records are:
+ *
+ *     sequence T task-line            The task with the ID in task-line is replaced (or appended).
+ *     sequence E task-line            The task with the ID in task-line takes the start time,
+ *                                     daily allocation, priority, and description in task-line.
+ *                                     Its times are left alone.
+ *     sequence A id minutes           The given minutes of work are added to the task with the
+ *                                     given ID.
+ *     sequence X id                   The task with the given ID is deleted.
+ *     sequence S id shard             The task with the given ID moves to the named shard file
+ *                                     ("-" for the main task file).
+ *     sequence O                      The task list was put into priority order. Only found
+ *                                     in older journals; the order isn't journaled now.
+ *     sequence U                      One day's worth of daily allocations was removed.
+ *     sequence Z                      All accumulated times were zeroed.
+ *     sequence R day                  A new day began (numbered as by day_number( )). The
+ *                                     workdays since the previous day were charged.
+ *
+ * A task-line has the same layout as a line in the task file, starting with the task's ID.
+ * Journals written before tasks had IDs use P (position task-line) and D (position) records
+ * instead, which refer to tasks by position and have no ID in the task-line.
+ *
+ * Several processes can append to one journal. Time is therefore only recorded as A records,
+ * which add up no matter what order they arrive in; T records only create tasks (or come from
+ * older journals) and E records change everything else. Records referring to a task that
+ * another process deleted are ignored.
+ *
+ * Records are made in memory. Another thread can then write them with write( ) so that the
+ * thread making changes never waits for the disk: the recording functions and take( ) belong to
+ * one thread and write( ) and truncate( ) to the other. Records get their sequence numbers when
+ * they are written, since only then is it known what other processes wrote before them. None of
+ * the recording functions throw; if a record can't be made or written the change only exists in
+ * memory.
+ */
+class Journal {
+public:
+    Journal( ) : bytes( 0 ) { }
+    ~Journal( );
+
+    Journal( const Journal & ) = delete;
+    Journal &operator=( const Journal & ) = delete;
+
+    //! Opens the named journal for appending.
+    bool open( const std::string &file_name );
+
+    //! Closes the journal. Records that were not written are discarded.
+    void close( ) noexcept;
+
+    //! Returns true if the journal was opened. This doesn't change while records are written.
+    bool is_open( ) const noexcept { return opened; }
+
+    //! Turns recording on or off. While it is off the recording functions do nothing.
+    /*!
+     * Recording is turned off while records that are already in a journal are applied.
+     */
+    void set_recording( bool enabled ) noexcept { recording = enabled; }
+
+    //! Records the current value of the task at the given position (a T record).
+    void put( std::size_t position, const TaskList &task_list ) noexcept;
+
+    //! Records everything but the times of the task at the given position (an E record).
+    void edit( std::size_t position, const TaskList &task_list ) noexcept;
+
+    //! Records that minutes of work were added to the task with the given ID.
+    void add_work( TaskId task_id, int minutes ) noexcept;
+
+    //! Records that the task with the given ID was deleted.
+    void erase( TaskId task_id ) noexcept;
+
+    //! Records that the task with the given ID moved to the named shard.
+    void move( TaskId task_id, const std::string &shard_name ) noexcept;
+
+    //! Records an operation that applies to the entire list ('U' or 'Z').
+    void record( char operation ) noexcept;
+
+    //! Records an operation that applies to the entire list and takes an argument ('R').
+    void record( char operation, long long argument ) noexcept;
+
+    //! Returns true if records were made since the last call to take( ).
+    bool has_records( ) const noexcept { return !buffer.empty( ); }
+
+    //! Appends the records made since the last call to records.
+    void take( std::string &records ) noexcept;
+
+    //! Appends records (from take( )) to the journal and waits for them to reach disk.
+    /*!
+     * The records are numbered after sequence, which is updated to the number of the last one.
+     * The position in the file where they start is stored in offset. Other processes must not
+     * write the journal at the same time.
+     */
+    bool write( const std::string &records, unsigned long long &sequence, long &offset ) noexcept;
+
+    //! Discards every record in the journal.
+    bool truncate( );
+
+    //! Returns the size of the file as of the last call to write( ) or truncate( ).
+    long end( ) const noexcept { return written; }
+
+    //! Returns the number of records made since the journal was created.
+    unsigned long long record_count( ) const noexcept { return records_made; }
+
+    //! Returns the size of the journal in bytes, including records that were not yet written.
+    long size( ) const noexcept { return bytes; }
+
+private:
+    // Used by the recording thread.
+    std::string        buffer;                //!< Records that were not yet taken, without sequence numbers.
+    unsigned long long records_made = 0;
+    bool               recording    = true;
+    char               line[128];             //!< Space to format a record (without its description).
+
+    // Used by the writing thread.
+    std::string        name;
+    std::FILE         *file          = nullptr;
+    long               written       = 0;     //!< Bytes in the file.
+    std::string        numbered;              //!< Space to number records.
+
+    std::atomic< long > bytes;                //!< Bytes in the file and in records not yet written.
+    bool                opened = false;       //!< Only changed by open( ) and close( ).
+
+    void append( int length, const char *description = nullptr, std::size_t description_size = 0 ) noexcept;
+    void task_record( char operation, std::size_t position, const TaskList &task_list ) noexcept;
+};
+
+#endif
@@ -0,0 +1,113 @@
+/*! \file    LockFile.cpp
+ *  \brief   Advisory lock shared by the Pixie processes that use one task list.
+ *  \author  Peter C. Chapin <pchapin@vtc.edu>
+ */
+
+#include <cerrno>
+#include <cstdio>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/file.h>
+#include <unistd.h>
+#define PIXIE_HAVE_FLOCK
+#endif
+
+#include "LockFile.hpp"
+
+using namespace std;
+
+LockFile::~LockFile( )
+{
+    close( );
+}
+
+
+bool LockFile::open( const string &file_name )
+{
+    close( );
+#if defined(PIXIE_HAVE_FLOCK)
+    descriptor = ::open( file_name.c_str( ), O_RDWR | O_CREAT | O_CLOEXEC, 0666 );
+#else
+    (void)file_name;
+#endif
+    return is_open( );
+}
+
+
+void LockFile::close( ) noexcept
+{
+#if defined(PIXIE_HAVE_FLOCK)
+    if( descriptor != -1 ) ::close( descriptor );
+#endif
+    descriptor = -1;
+}
+
+
+void LockFile::lock( bool exclusive ) noexcept
+{
+#if defined(PIXIE_HAVE_FLOCK)
+    if( descriptor == -1 ) return;
+    while( flock( descriptor, exclusive ? LOCK_EX : LOCK_SH ) == -1 && errno == EINTR ) { }
+#else
+    (void)exclusive;
+#endif
+}
+
+
+bool LockFile::try_lock( bool exclusive ) noexcept
+{
+#if defined(PIXIE_HAVE_FLOCK)
+    if( descriptor == -1 ) return true;
+    int result;
+    while( ( result = flock( descriptor, ( exclusive ? LOCK_EX : LOCK_SH ) | LOCK_NB ) ) == -1 && errno == EINTR ) { }
+    return result == 0;
+#else
+    (void)exclusive;
+    return true;
+#endif
+}
+
+
+void LockFile::unlock( ) noexcept
+{
+#if defined(PIXIE_HAVE_FLOCK)
+    if( descriptor != -1 ) flock( descriptor, LOCK_UN );
+#endif
+}
+
+
+SharedCounters LockFile::read( ) const noexcept
+{
+    SharedCounters counters;
+#if defined(PIXIE_HAVE_FLOCK)
+    char text[64];
+    const ssize_t count = ( descriptor == -1 ) ? -1 : pread( descriptor, text, sizeof( text ) - 1, 0 );
+    if( count <= 0 ) return counters;
+    text[count] = '\0';
+
+    unsigned long long sequence;
+    unsigned long long next_id;
+    if( sscanf( text, "%llu %llu", &sequence, &next_id ) == 2 ) {
+        counters.sequence = sequence;
+        counters.next_id  = static_cast< TaskId >( next_id );
+    }
+#endif
+    return counters;
+}
+
+
+void LockFile::write( const SharedCounters &counters ) noexcept
+{
+#if defined(PIXIE_HAVE_FLOCK)
+    if( descriptor == -1 ) return;
+    char text[64];
+    const int length = snprintf( text, sizeof( text ), "%llu %llu\n",
+        counters.sequence, static_cast< unsigned long long >( counters.next_id ) );
+    if( length <= 0 || static_cast< size_t >( length ) >= sizeof( text ) ) return;
+    // The counters never decrease, so the old text is never longer than the new text.
+    if( pwrite( descriptor, text, static_cast< size_t >( length ), 0 ) != length ) return;
+#else
+    (void)counters;
+#endif
+}
@@ -0,0 +1,77 @@
+/*! \file    LockFile.hpp
+ *  \brief   Advisory lock shared by the Pixie processes that use one task list.
+ *  \author  Peter C. Chapin <pchapin@vtc.edu>
+ */
+
+#ifndef LOCKFILE_HPP
+#define LOCKFILE_HPP
+
+#include <string>
+
+#include "PixieTask.hpp"
+
+//! Counters that every process using a task list must agree on. They are kept in the lock file.
+struct SharedCounters {
+    unsigned long long sequence = 0;  //!< Sequence number of the last journal record written.
+    TaskId             next_id  = 0;  //!< First task ID that no process has claimed.
+};
+
+//! An advisory lock on a file next to the task file.
+/*!
+ * Writers of the task files and the journal hold the lock exclusively; readers hold it shared.
+ * The lock belongs to the open file, so threads of one process that must exclude each other
+ * each open the file separately. The file also holds the SharedCounters, which must only be
+ * used while the lock is held exclusively. Where advisory locks aren't available open( ) fails
+ * and the task list can't be shared safely.
+ */
+class LockFile {
+public:
+    LockFile( ) = default;
+   ~LockFile( );
+
+    LockFile( const LockFile & ) = delete;
+    LockFile &operator=( const LockFile & ) = delete;
+
+    //! Opens (creating if necessary) the named lock file. Returns false on failure.
+    bool open( const std::string &file_name );
+
+    //! Closes the file, releasing the lock.
+    void close( ) noexcept;
+
+    bool is_open( ) const noexcept { return descriptor != -1; }
+
+    //! Waits for the lock to be available and takes it.
+    void lock( bool exclusive ) noexcept;
+
+    //! Takes the lock if that is possible without waiting. Returns false if it isn't.
+    bool try_lock( bool exclusive ) noexcept;
+
+    //! Releases the lock.
+    void unlock( ) noexcept;
+
+    //! Returns the counters in the file. They are zero if the file is new.
+    SharedCounters read( ) const noexcept;
+
+    //! Replaces the counters in the file.
+    void write( const SharedCounters &counters ) noexcept;
+
+private:
+    int descriptor = -1;
+};
+
+//! Holds a LockFile (if it is open) for the lifetime of the object.
+class LockHolder {
+public:
+    LockHolder( LockFile &file, bool exclusive ) noexcept : held( file )
+        { held.lock( exclusive ); }
+   ~LockHolder( )
+        { held.unlock( ); }
+
+    LockHolder( const LockHolder & ) = delete;
+    LockHolder &operator=( const LockHolder & ) = delete;
+
+private:
+    LockFile &held;
+};
+
+#endif
@@ -0,0 +1,98 @@
+/*! \file    MappedFile.cpp
+ *  \brief   Read-only view of an entire file.
+ *  \author  Peter C. Chapin <pchapin@vtc.edu>
+ */
+
+#include <fstream>
+#include <utility>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define PIXIE_HAVE_MMAP
+#endif
+
+#include "MappedFile.hpp"
+
+using namespace std;
+
+MappedFile::~MappedFile( )
+{
+    close( );
+}
+
+
+bool MappedFile::open( const string &file_name )
+{
+    close( );
+
+#if defined(PIXIE_HAVE_MMAP)
+    const int fd = ::open( file_name.c_str( ), O_RDONLY );
+    if( fd == -1 ) return false;
+
+    struct stat file_status;
+    if( fstat( fd, &file_status ) == -1 ) {
+        ::close( fd );
+        return false;
+    }
+
+    // Mapping an empty file fails, but an empty file is perfectly good.
+    if( file_status.st_size > 0 ) {
+        void *address =
+            mmap( nullptr, static_cast< size_t >( file_status.st_size ), PROT_READ, MAP_PRIVATE, fd, 0 );
+        if( address == MAP_FAILED ) {
+            ::close( fd );
+            return false;
+        }
+        // The file is read from front to back.
+        madvise( address, static_cast< size_t >( file_status.st_size ), MADV_SEQUENTIAL );
+        data   = static_cast< const char * >( address );
+        length = static_cast< size_t >( file_status.st_size );
+        mapped = true;
+    }
+    ::close( fd );
+    return true;
+#else
+    ifstream input( file_name.c_str( ), ios::binary );
+    if( !input ) return false;
+
+    input.seekg( 0, ios::end );
+    const streamoff file_size = input.tellg( );
+    input.seekg( 0, ios::beg );
+    if( file_size < 0 ) return false;
+
+    buffer.resize( static_cast< size_t >( file_size ) );
+    if( file_size > 0 && !input.read( &buffer[0], file_size ) ) {
+        buffer.clear( );
+        return false;
+    }
+    data   = buffer.data( );
+    length = buffer.size( );
+    return true;
+#endif
+}
+
+
+void MappedFile::close( ) noexcept
+{
+#if defined(PIXIE_HAVE_MMAP)
+    if( mapped ) {
+        munmap( const_cast< char * >( data ), length );
+    }
+#endif
+    buffer.clear( );
+    data   = nullptr;
+    length = 0;
+    mapped = false;
+}
+
+
+void MappedFile::swap( MappedFile &other ) noexcept
+{
+    std::swap( data, other.data );
+    std::swap( length, other.length );
+    std::swap( mapped, other.mapped );
+    buffer.swap( other.buffer );
+}
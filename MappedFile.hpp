@@ -0,0 +1,47 @@
+/*! \file    MappedFile.hpp
+ *  \brief   Read-only view of an entire file.
+ *  \author  Peter C. Chapin <pchapin@vtc.edu>
+ */
+
+#ifndef MAPPEDFILE_HPP
+#define MAPPEDFILE_HPP
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+//! Presents the contents of a file as a single contiguous block of memory.
+/*!
+ * On POSIX systems the file is memory mapped so no copy of its contents is made. Elsewhere the
+ * file is read into one buffer with a single large read. Either way the contents are only valid
+ * while the MappedFile object exists.
+ */
+class MappedFile {
+public:
+    MappedFile( ) = default;
+    ~MappedFile( );
+
+    MappedFile( const MappedFile & ) = delete;
+    MappedFile &operator=( const MappedFile & ) = delete;
+
+    //! Maps the named file, releasing any file previously mapped. Returns false on failure.
+    bool open( const std::string &file_name );
+
+    //! Releases the mapping (if any).
+    void close( ) noexcept;
+
+    //! Exchanges mappings with another object. Pointers into either mapping remain valid.
+    void swap( MappedFile &other ) noexcept;
+
+    const char *begin( ) const noexcept { return data; }
+    const char *end( ) const noexcept { return data + length; }
+    std::size_t size( ) const noexcept { return length; }
+
+private:
+    const char *data   = nullptr;
+    std::size_t length = 0;
+    bool        mapped = false;    //!< True if data must be released with munmap.
+    std::vector< char > buffer;    //!< Holds the file contents when mapping isn't available.
+};
+
+#endif
@@ -0,0 +1,110 @@
+/*! \file    ParallelWriter.cpp
+ *  \brief   Formatting records in parallel while writing them in order.
+ *  \author  Peter C. Chapin <pchapin@vtc.edu>
+ *
+ * There are two sets of buffers, each with one buffer per thread in the pool. The pool fills a
+ * set (each buffer holding one chunk) and hands it to the writer thread, then fills the other
+ * set while the first is written. A set is only refilled once the writer is done with it, so a
+ * slow disk holds back the formatting instead of letting formatted text pile up in memory.
+ */
+
+#include <algorithm>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "ParallelWriter.hpp"
+#include "ThreadPool.hpp"
+
+using namespace std;
+
+namespace {
+
+    const std::size_t chunk_records = 4096;  //!< Records formatted by one job.
+
+}
+
+
+bool write_in_parallel( ostream &output, std::size_t record_count, const RecordFormatter &format )
+{
+    // Short lists aren't worth starting any threads.
+    if( record_count <= chunk_records ) {
+        string text;
+        format( 0, record_count, text );
+        output.write( text.data( ), static_cast< streamsize >( text.size( ) ) );
+        return static_cast< bool >( output );
+    }
+
+    const std::size_t chunk_count = ( record_count + chunk_records - 1 ) / chunk_records;
+    ThreadPool pool;
+    const std::size_t set_size = pool.size( );
+    vector< string > buffers( 2 * set_size );
+
+    mutex              lock;          // Protects the counters and flags below.
+    condition_variable changed;
+    std::size_t        formatted = 0; // Number of sets handed to the writer.
+    std::size_t        written   = 0; // Number of sets the writer has finished with.
+    bool               finished  = false;
+    bool               failed    = false;
+
+    thread writer( [&]( ) {
+        unique_lock< mutex > guard( lock );
+        while( true ) {
+            changed.wait( guard, [&]( ) { return written < formatted || finished; } );
+            if( written == formatted ) return;
+
+            const std::size_t first_chunk = written * set_size;
+            const std::size_t count = min( set_size, chunk_count - first_chunk );
+            const string *set = &buffers[( written % 2 ) * set_size];
+            const bool skip = failed;
+            guard.unlock( );
+            bool ok = true;
+            for( std::size_t i = 0; i < count && ok && !skip; ++i ) {
+                output.write( set[i].data( ), static_cast< streamsize >( set[i].size( ) ) );
+                ok = static_cast< bool >( output );
+            }
+            guard.lock( );
+            if( !ok ) failed = true;
+            ++written;
+            changed.notify_all( );
+        }
+    } );
+
+    try {
+        for( std::size_t set_number = 0; set_number * set_size < chunk_count; ++set_number ) {
+            {
+                unique_lock< mutex > guard( lock );
+                changed.wait( guard, [&]( ) { return formatted - written < 2; } );
+                if( failed ) break;
+            }
+            const std::size_t first_chunk = set_number * set_size;
+            string *set = &buffers[( set_number % 2 ) * set_size];
+            pool.run( min( set_size, chunk_count - first_chunk ), [&]( std::size_t i ) {
+                const std::size_t chunk = first_chunk + i;
+                set[i].clear( );
+                format( chunk * chunk_records, min( record_count, ( chunk + 1 ) * chunk_records ), set[i] );
+            } );
+            lock_guard< mutex > guard( lock );
+            ++formatted;
+            changed.notify_all( );
+        }
+    }
+    catch( ... ) {
+        {
+            lock_guard< mutex > guard( lock );
+            finished = true;
+            changed.notify_all( );
+        }
+        writer.join( );
+        throw;
+    }
+
+    {
+        lock_guard< mutex > guard( lock );
+        finished = true;
+        changed.notify_all( );
+    }
+    writer.join( );
+    return !failed;
+}
@@ -0,0 +1,28 @@
+/*! \file    ParallelWriter.hpp
+ *  \brief   Formatting records in parallel while writing them in order.
+ *  \author  Peter C. Chapin <pchapin@vtc.edu>
+ */
+
+#ifndef PARALLELWRITER_HPP
+#define PARALLELWRITER_HPP
+
+#include <cstddef>
+#include <functional>
+#include <ostream>
+#include <string>
+
+//! Appends the text of the records [first, last) to output.
+typedef std::function< void ( std::size_t first, std::size_t last, std::string &output ) > RecordFormatter;
+
+//! Writes the text of the records [0, record_count) to output, in order.
+/*!
+ * The records are formatted in chunks of a fixed number of records, in parallel, into a fixed
+ * set of buffers. While one set of chunks is being formatted the set formatted before it is
+ * written by another thread, one large write per chunk, so the memory used doesn't depend on
+ * the number of records. The formatter is called from several threads at once and must only
+ * read shared data. Returns false if the output fails; if the formatter throws, the exception is
+ * passed on once the writing has stopped.
+ */
+bool write_in_parallel( std::ostream &output, std::size_t record_count, const RecordFormatter &format );
+
+#endif
@@ -0,0 +1,104 @@
+/*! \file    PixieTask.hpp
+ *  \brief   Representation of a single task.
+ *  \author  Peter C. Chapin <pchapin@vtc.edu>
+ */
+
+#ifndef PIXIETASK_HPP
+#define PIXIETASK_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <ctime>
+#include <utility>
+
+//! Description of a task.
+/*!
+ * A description either owns a copy of its text or refers to text that is kept elsewhere (in a
+ * mapped binary snapshot or in the task list) for as long as the description is used. In both
+ * cases the text is only available through data( ) and size( ).
+ */
+class TaskDescription {
+public:
+    TaskDescription( ) noexcept = default;
+    TaskDescription( const TaskDescription &other )
+        { if( other.owned ) assign( other.text, other.text + other.length ); else borrow( other ); }
+    TaskDescription( TaskDescription &&other ) noexcept
+        { borrow( other ); owned = other.owned; other.owned = false; other.text = ""; other.length = 0; }
+    TaskDescription &operator=( TaskDescription other ) noexcept
+        { swap( other ); return *this; }
+   ~TaskDescription( )
+        { if( owned ) delete [] text; }
+
+    void swap( TaskDescription &other ) noexcept
+        { std::swap( text, other.text ); std::swap( length, other.length ); std::swap( owned, other.owned ); }
+
+    const char *data( ) const noexcept { return text; }
+    std::size_t size( ) const noexcept { return length; }
+
+    //! True if this object owns a copy of its text.
+    bool is_owned( ) const noexcept { return owned; }
+
+    //! Replaces the description with a copy of [first, last).
+    void assign( const char *first, const char *last )
+    {
+        const std::size_t new_length = static_cast< std::size_t >( last - first );
+        char *copy = new char[new_length];
+        std::memcpy( copy, first, new_length );
+        if( owned ) delete [] text;
+        text   = copy;
+        length = static_cast< std::uint32_t >( new_length );
+        owned  = true;
+    }
+
+    //! Gives up ownership of the text, which the caller must release with delete [].
+    /*!
+     * The description keeps referring to the text. Returns null if the text wasn't owned.
+     */
+    const char *release( ) noexcept
+    {
+        if( !owned ) return nullptr;
+        owned = false;
+        return text;
+    }
+
+    //! Replaces the description with text that stays valid for as long as this object is used.
+    void assign_mapped( const char *first, std::size_t size ) noexcept
+    {
+        if( owned ) delete [] text;
+        text   = first;
+        length = static_cast< std::uint32_t >( size );
+        owned  = false;
+    }
+
+private:
+    const char   *text   = "";
+    std::uint32_t length = 0;
+    bool          owned  = false;
+
+    void borrow( const TaskDescription &other ) noexcept
+        { text = other.text; length = other.length; }
+};
+
+
+//! Identifies a task for as long as it exists. IDs are never reused; zero is not a valid ID.
+typedef std::uint64_t TaskId;
+
+
+//! Structure that holds information about a single task.
+/*!
+ * The task list itself is stored by columns (see TaskList.hpp); this structure is used to move
+ * individual tasks into and out of it.
+ */
+struct PixieTask {
+    TaskDescription description;   //!< Description of the task as presented to the user.
+    TaskId      id;                //!< Zero if the task hasn't been given an ID yet.
+    int         priority;          //!< Range 1 .. 99
+    std::time_t start_time;        //!< Zero implies that the task is not active.
+    int         accumulated;       //!< Total number of minutes applied to this task.
+    int         accumulated_today; //!< Total number of minutes applied to this task today.
+    int         daily;             //!< Number of minutes of attention this task requires each day.
+    int         accumulated_debt;  //!< Total number of minutes of attention this task requires. A credit is negative.
+};
+
+#endif
@@ -0,0 +1,421 @@
+/*! \file    Replay.cpp
+ *  \brief   Replays recorded or synthetic workloads through Pixie's command path.
+ *  \author  Peter C. Chapin <pchapin@vtc.edu>
+ *
+ * This program is built and run by "make replay". It feeds commands into process_command( ) as
+ * fast as possible, the way the interactive loop does (without displaying the task list), and
+ * writes the throughput, the latency distribution, and checksums of the final task list to the
+ * standard output as JSON. Runs of different builds on the same workload can then be compared;
+ * identical checksums show that the builds left the task list in the same state.
+ *
+ * The commands come either from a trace recorded with "pixie --trace file" or from a synthetic
+ * mix of start, stop, add, create, delete, and rename commands generated from a fixed seed. The
+ * run starts from a copy of the given task file or from a synthetic task list, in a folder of
+ * its own. Commands that depend on the clock (start and stop) record no time at full speed, so
+ * the checksums only depend on the workload and the build.
+ *
+ * Usage: pixie-replay [--trace file] [--task-file file] [--tasks N] [--commands N] [--seed S]
+ *                     [--mix start=W,stop=W,add=W,create=W,delete=W,rename=W]
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <streambuf>
+#include <string>
+#include <vector>
+
+#if defined(_WIN32)
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "CommandTrace.hpp"
+#include "Commands.hpp"
+#include "Date.hpp"
+#include "Events.hpp"
+#include "TaskList.hpp"
+#include "Tasks.hpp"
+
+using namespace std;
+
+namespace {
+
+    //! The kinds of commands in a synthetic mix, in the order of Settings::weights.
+    const char *const mix_commands[] = { "start", "stop", "add", "create", "delete", "rename" };
+    const int mix_size = sizeof( mix_commands ) / sizeof( mix_commands[0] );
+
+    //! Parameters of the run.
+    struct Settings {
+        const char   *trace         = nullptr;  //!< Trace to replay, or nullptr for a synthetic mix.
+        const char   *task_file     = nullptr;  //!< Task file to start from, or nullptr for a synthetic list.
+        std::size_t   task_count    = 1000;     //!< Size of the synthetic task list.
+        std::size_t   command_count = 100000;   //!< Length of the synthetic mix.
+        unsigned long seed          = 12345;
+        double        weights[mix_size] = { 30.0, 30.0, 20.0, 8.0, 4.0, 8.0 };
+    };
+
+    Settings settings;
+
+    const char *const replay_folder = "pixie-replay.tmp";
+
+    //! Files that Pixie might create in the replay folder.
+    const char *const pixie_files[] = {
+        ".pixie-tasks", ".pixie-tasks.journal", ".pixie-tasks.journal.old", ".pixie-tasks.lock",
+        ".pixie-tasks.new", ".pixie-history", ".pixie-history.names", ".pixie-events", ".pixie-events.journal",
+        ".pixie-events.new"
+    };
+
+
+    //! A stream buffer that discards everything written to it.
+    class NullBuffer : public streambuf {
+    protected:
+        int_type overflow( int_type c ) override { return traits_type::not_eof( c ); }
+        streamsize xsputn( const char *, streamsize count ) override { return count; }
+    };
+
+
+    //! Accumulates a 64 bit FNV-1a hash.
+    class Checksum {
+    public:
+        void add( const void *data, std::size_t size ) noexcept
+        {
+            const unsigned char *bytes = static_cast< const unsigned char * >( data );
+            for( std::size_t i = 0; i < size; ++i ) {
+                value ^= bytes[i];
+                value *= 0x100000001B3ULL;
+            }
+        }
+
+        template< typename T >
+        void add( T number ) noexcept { add( &number, sizeof( number ) ); }
+
+        unsigned long long result( ) const noexcept { return value; }
+
+    private:
+        unsigned long long value = 0xCBF29CE484222325ULL;
+    };
+
+
+    string file_name( const char *name )
+    {
+        return string( replay_folder ) + "/" + name;
+    }
+
+
+    void remove_pixie_files( )
+    {
+        for( const char *name : pixie_files ) std::remove( file_name( name ).c_str( ) );
+    }
+
+
+    //! Returns the text of a task file holding the given number of synthetic tasks.
+    string make_task_file( std::size_t task_count )
+    {
+        const time_t now = time( NULL );
+        const struct tm * const cooked_time = localtime( &now );
+        spica::Date today;
+        today.set( cooked_time->tm_year + 1900, cooked_time->tm_mon + 1, cooked_time->tm_mday );
+
+        minstd_rand generator( static_cast< minstd_rand::result_type >( settings.seed ) );
+        ostringstream file;
+        file << today << " 0\n";
+        for( std::size_t i = 0; i < task_count; ++i ) {
+            const int daily = ( generator( ) % 2 == 0 ) ? 30 : 0;
+            file << 0 << ' ' << generator( ) % 1000 << ' ' << 0 << ' ' << daily << ' '
+                 << 1 + generator( ) % 99 << ' ' << 0 << " Task " << i << '\n';
+        }
+        return file.str( );
+    }
+
+
+    //! Puts the starting task list in the replay folder. Returns false if the task file can't be read.
+    bool install_task_file( )
+    {
+        string contents;
+        if( settings.task_file != nullptr ) {
+            ifstream input( settings.task_file, ios::binary );
+            if( !input ) return false;
+            ostringstream buffer;
+            buffer << input.rdbuf( );
+            contents = buffer.str( );
+        }
+        else {
+            contents = make_task_file( settings.task_count );
+        }
+        remove_pixie_files( );
+        ofstream output( file_name( ".pixie-tasks" ).c_str( ), ios::binary );
+        output.write( contents.data( ), static_cast< streamsize >( contents.size( ) ) );
+        return static_cast< bool >( output );
+    }
+
+
+    //! Reads every command in the trace. Returns false (and explains on cerr) if it can't be read.
+    bool read_trace( vector< string > &commands )
+    {
+        ifstream input( settings.trace, ios::binary );
+        if( !input ) {
+            cerr << "pixie-replay: Can't open trace file: " << settings.trace << "\n";
+            return false;
+        }
+        TraceReader reader( input );
+        std::int64_t offset;
+        string command;
+        while( reader.next( offset, command ) ) commands.push_back( command );
+        if( reader.error( ) != nullptr ) {
+            cerr << "pixie-replay: " << settings.trace << ": " << reader.error( ) << "\n";
+            return false;
+        }
+        return true;
+    }
+
+
+    //! Generates the synthetic mix. Task numbers always refer to tasks that exist.
+    void make_mix( vector< string > &commands, std::size_t task_count )
+    {
+        minstd_rand generator( static_cast< minstd_rand::result_type >( settings.seed ) );
+        discrete_distribution< int > kind( settings.weights, settings.weights + mix_size );
+
+        commands.reserve( settings.command_count );
+        for( std::size_t i = 0; i < settings.command_count; ++i ) {
+            int choice = kind( generator );
+            // Keep at least one task so that every command has something to work on.
+            if( task_count == 0 || ( task_count == 1 && choice == 4 ) ) {
+                choice = 3;
+            }
+            const std::size_t task_number = ( task_count == 0 ) ? 0 : 1 + generator( ) % task_count;
+
+            ostringstream command;
+            command << mix_commands[choice];
+            switch( choice ) {
+            case 0: command << ' ' << task_number; break;
+            case 1: break;
+            case 2: command << ' ' << task_number << ' ' << 1 + generator( ) % 60; break;
+            case 3: command << " Replayed task " << i; ++task_count; break;
+            case 4: command << ' ' << task_number; --task_count; break;
+            case 5: command << ' ' << task_number << " Renamed task " << i; break;
+            }
+            commands.push_back( command.str( ) );
+        }
+    }
+
+
+    //! Returns a checksum of the tasks that doesn't depend on their order.
+    unsigned long long task_checksum( const TaskList &list )
+    {
+        unsigned long long total = 0;
+        for( std::size_t i = 0; i < list.size( ); ++i ) {
+            Checksum task;
+            task.add( list.id( i ) );
+            task.add( static_cast< int >( list.priority[i] ) );
+            task.add( list.accumulated[i] );
+            task.add( list.today( i ) );
+            task.add( static_cast< int >( list.daily[i] ) );
+            task.add( list.debt( i ) );
+            task.add( list.description( i ).data( ), list.description( i ).size( ) );
+            total += task.result( );
+        }
+        return total;
+    }
+
+
+    //! Returns a checksum of the named file, or zero if it can't be read.
+    unsigned long long file_checksum( const string &name )
+    {
+        ifstream input( name.c_str( ), ios::binary );
+        if( !input ) return 0;
+        Checksum file;
+        char buffer[4096];
+        while( input.read( buffer, sizeof( buffer ) ) || input.gcount( ) > 0 ) {
+            file.add( buffer, static_cast< std::size_t >( input.gcount( ) ) );
+        }
+        return file.result( );
+    }
+
+
+    //! Returns the latency (in microseconds) below which the given fraction of the sorted latencies fall.
+    double percentile( const vector< long long > &sorted, double fraction )
+    {
+        if( sorted.empty( ) ) return 0.0;
+        std::size_t index = static_cast< std::size_t >( fraction * sorted.size( ) );
+        if( index >= sorted.size( ) ) index = sorted.size( ) - 1;
+        return sorted[index] / 1000.0;
+    }
+
+
+    //! Executes the commands (or a synthetic mix if there is no trace) and writes the report.
+    int replay( vector< string > &commands )
+    {
+        vector< long long > latencies;
+        unsigned long errors = 0;
+        NullBuffer null_buffer;
+
+        latencies.reserve( commands.size( ) );
+        initialize_tasks( );
+        const std::size_t initial_tasks = static_cast< std::size_t >( task_count( ) );
+        if( settings.trace == nullptr ) make_mix( commands, initial_tasks );
+
+        streambuf *const standard_output = cout.rdbuf( &null_buffer );
+        const chrono::steady_clock::time_point start = chrono::steady_clock::now( );
+        for( const string &command : commands ) {
+            const chrono::steady_clock::time_point command_start = chrono::steady_clock::now( );
+            const char *error_message = "";
+            sync_tasks( );
+            sort_tasks( );
+            const CommandStatus status = process_command( command, error_message );
+            commit_tasks( );
+            latencies.push_back( chrono::duration_cast< chrono::nanoseconds >(
+                chrono::steady_clock::now( ) - command_start ).count( ) );
+            if( status == CommandStatus::error ) ++errors;
+            if( status == CommandStatus::quit || status == CommandStatus::shutdown ) break;
+        }
+        const double seconds = chrono::duration< double >( chrono::steady_clock::now( ) - start ).count( );
+        cout.rdbuf( standard_output );
+
+        // The text format is written so that the file checksum doesn't depend on when the task
+        // file was last compacted.
+        const unsigned long long tasks_checksum = task_checksum( *task_snapshot( ) );
+        const int final_tasks = task_count( );
+        convert_tasks( TaskFileFormat::text );
+        cleanup_events( );
+        cleanup_tasks( );
+        const unsigned long long tasks_file_checksum = file_checksum( file_name( ".pixie-tasks" ) );
+
+        sort( latencies.begin( ), latencies.end( ) );
+        cout << fixed << setprecision( 3 )
+             << "{\n"
+             << "  \"workload\": \"" << ( settings.trace != nullptr ? settings.trace : "mix" ) << "\",\n"
+             << "  \"initial_tasks\": " << initial_tasks << ",\n"
+             << "  \"commands\": " << latencies.size( ) << ",\n"
+             << "  \"errors\": " << errors << ",\n"
+             << "  \"seconds\": " << seconds << ",\n"
+             << "  \"commands_per_second\": " << ( seconds > 0.0 ? latencies.size( ) / seconds : 0.0 ) << ",\n"
+             << "  \"p50_us\": " << percentile( latencies, 0.50 ) << ",\n"
+             << "  \"p90_us\": " << percentile( latencies, 0.90 ) << ",\n"
+             << "  \"p99_us\": " << percentile( latencies, 0.99 ) << ",\n"
+             << "  \"p999_us\": " << percentile( latencies, 0.999 ) << ",\n"
+             << "  \"max_us\": " << ( latencies.empty( ) ? 0.0 : latencies.back( ) / 1000.0 ) << ",\n"
+             << "  \"final_tasks\": " << final_tasks << ",\n"
+             << hex << setfill( '0' )
+             << "  \"tasks_checksum\": \"" << setw( 16 ) << tasks_checksum << "\",\n"
+             << "  \"task_file_checksum\": \"" << setw( 16 ) << tasks_file_checksum << "\"\n"
+             << dec << "}\n";
+        return EXIT_SUCCESS;
+    }
+
+
+    void print_usage( )
+    {
+        cerr << "Usage: pixie-replay [--trace file] [--task-file file] [--tasks N] [--commands N]"
+                " [--seed S]\n"
+                "                    [--mix start=W,stop=W,add=W,create=W,delete=W,rename=W]\n";
+    }
+
+
+    //! Sets the weights named in a mix such as "start=30,stop=30". Unnamed commands keep their weights.
+    bool parse_mix( const char *mix )
+    {
+        while( *mix != '\0' ) {
+            const char *name_end = strchr( mix, '=' );
+            if( name_end == nullptr ) return false;
+            int kind = 0;
+            while( kind < mix_size && ( strlen( mix_commands[kind] ) != static_cast< std::size_t >( name_end - mix ) ||
+                                        strncmp( mix_commands[kind], mix, name_end - mix ) != 0 ) ) ++kind;
+            if( kind == mix_size ) return false;
+            char *end;
+            settings.weights[kind] = strtod( name_end + 1, &end );
+            if( end == name_end + 1 || settings.weights[kind] < 0.0 ) return false;
+            if( *end == ',' ) ++end;
+            else if( *end != '\0' ) return false;
+            mix = end;
+        }
+        double total = 0.0;
+        for( double weight : settings.weights ) total += weight;
+        return total > 0.0;
+    }
+
+
+    bool parse_arguments( int argc, char **argv )
+    {
+        for( int i = 1; i < argc; ++i ) {
+            if( i + 1 == argc ) return false;
+            const char *value = argv[++i];
+            char *end = const_cast< char * >( value + strlen( value ) );
+            if( strcmp( argv[i - 1], "--trace" ) == 0 ) {
+                settings.trace = value;
+            }
+            else if( strcmp( argv[i - 1], "--task-file" ) == 0 ) {
+                settings.task_file = value;
+            }
+            else if( strcmp( argv[i - 1], "--tasks" ) == 0 ) {
+                settings.task_count = strtoul( value, &end, 10 );
+            }
+            else if( strcmp( argv[i - 1], "--commands" ) == 0 ) {
+                settings.command_count = strtoul( value, &end, 10 );
+            }
+            else if( strcmp( argv[i - 1], "--seed" ) == 0 ) {
+                settings.seed = strtoul( value, &end, 10 );
+            }
+            else if( strcmp( argv[i - 1], "--mix" ) == 0 ) {
+                if( !parse_mix( value ) ) return false;
+            }
+            else {
+                return false;
+            }
+            if( *end != '\0' ) return false;
+        }
+        return true;
+    }
+
+}
+
+
+//! Replay entry point.
+int main( int argc, char **argv )
+{
+    if( !parse_arguments( argc, argv ) ) {
+        print_usage( );
+        return EXIT_FAILURE;
+    }
+
+    // The replay uses its own task folder.
+#if defined(_WIN32)
+    _mkdir( replay_folder );
+    _putenv_s( "PIXIE_HOME", replay_folder );
+#else
+    mkdir( replay_folder, 0777 );
+    setenv( "PIXIE_HOME", replay_folder, 1 );
+#endif
+
+    int rc = EXIT_FAILURE;
+    try {
+        vector< string > commands;
+        if( !install_task_file( ) ) {
+            cerr << "pixie-replay: Can't read task file: " << settings.task_file << "\n";
+        }
+        else if( settings.trace == nullptr || read_trace( commands ) ) {
+            rc = replay( commands );
+        }
+    }
+    catch( exception &e ) {
+        cerr << "pixie-replay: " << e.what( ) << "\n";
+    }
+
+    remove_pixie_files( );
+#if defined(_WIN32)
+    _rmdir( replay_folder );
+#else
+    rmdir( replay_folder );
+#endif
+    return rc;
+}
@@ -0,0 +1,175 @@
+/*! \file    RunQueue.hpp
+ *  \brief   Priority queue of tasks ordered by a scheduling policy.
+ *  \author  Peter C. Chapin <pchapin@vtc.edu>
+ */
+
+#ifndef RUNQUEUE_HPP
+#define RUNQUEUE_HPP
+
+#include <algorithm>
+#include <cstddef>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "PixieTask.hpp"
+#include "TaskList.hpp"
+
+//! Values that depend on the entire task list, for policies whose keys need them.
+struct ListTotals {
+    long long priority    = 0;  //!< Sum of the priorities of every task.
+    long long accumulated = 0;  //!< Sum of the accumulated times of every task.
+};
+
+//! Binary heap of tasks with the task that should run first at the top.
+/*!
+ * The Policy class decides the order. It provides a Key type; a static function key( list,
+ * position, totals ) that returns the key of the task at a position in the list; a static
+ * function before( left, right ) that returns true if the task with the left key should run
+ * before the task with the right key; and a constant uses_totals that is true if the keys depend
+ * on the ListTotals (and thus all change whenever any task changes). The key of each task is
+ * computed once, when it is added or updated, and the policy's functions are inlined into the
+ * heap operations. Tasks with equivalent keys run in order of their IDs.
+ *
+ * The queue is keyed by ID so that reordering the task list doesn't affect it. The index from
+ * IDs to entries is only built when a task is first updated or erased; a queue that is always
+ * rebuilt never needs it.
+ */
+template< typename Policy >
+class RunQueue {
+public:
+    bool empty( ) const noexcept { return heap.empty( ); }
+    std::size_t size( ) const noexcept { return heap.size( ); }
+
+    //! Removes every task.
+    void clear( ) noexcept
+    {
+        heap.clear( );
+        index.clear( );
+        indexed = true;
+    }
+
+    //! Replaces the contents of the queue with every task in the list. Takes linear time.
+    void build( const TaskList &list, const ListTotals &totals )
+    {
+        clear( );
+        heap.reserve( list.size( ) );
+        for( std::size_t i = 0; i < list.size( ); ++i ) {
+            heap.push_back( Entry{ Policy::key( list, i, totals ), list.id( i ) } );
+        }
+        std::make_heap( heap.begin( ), heap.end( ), []( const Entry &left, const Entry &right ) {
+            return before( right, left );
+        } );
+        indexed = false;
+    }
+
+    //! Adds the task at the given position, or repositions it if its key changed.
+    void update( const TaskList &list, std::size_t position, const ListTotals &totals )
+    {
+        const Entry entry{ Policy::key( list, position, totals ), list.id( position ) };
+        make_index( );
+        const auto existing = index.find( entry.id );
+        if( existing == index.end( ) ) {
+            heap.push_back( entry );
+            index[entry.id] = heap.size( ) - 1;
+            sift_up( heap.size( ) - 1 );
+            return;
+        }
+        const std::size_t slot = existing->second;
+        heap[slot] = entry;
+        sift_up( slot );
+        sift_down( index[entry.id] );
+    }
+
+    //! Removes the task with the given ID, if it is in the queue.
+    void erase( TaskId task_id )
+    {
+        make_index( );
+        const auto existing = index.find( task_id );
+        if( existing == index.end( ) ) return;
+        const std::size_t slot = existing->second;
+        index.erase( existing );
+        if( slot != heap.size( ) - 1 ) {
+            const TaskId moved = heap.back( ).id;
+            place( slot, heap.back( ) );
+            heap.pop_back( );
+            sift_up( slot );
+            sift_down( index[moved] );
+        }
+        else {
+            heap.pop_back( );
+        }
+    }
+
+    //! Returns the ID of the task that should run first, or zero if the queue is empty.
+    TaskId top( ) const noexcept { return heap.empty( ) ? 0 : heap.front( ).id; }
+
+    //! Returns the number of bytes allocated by the queue.
+    std::size_t memory_used( ) const noexcept
+    {
+        // Each entry of the hash table is assumed to cost a node plus a bucket pointer.
+        return heap.capacity( ) * sizeof( Entry ) + index.bucket_count( ) * sizeof( void * ) +
+               index.size( ) * ( sizeof( std::pair< const TaskId, std::size_t > ) + 2 * sizeof( void * ) );
+    }
+
+private:
+    struct Entry {
+        typename Policy::Key key;
+        TaskId id;
+    };
+
+    std::vector< Entry > heap;
+    std::unordered_map< TaskId, std::size_t > index;  //!< Position in heap of each task's entry.
+    bool indexed = true;                                //!< True if index is up to date.
+
+    static bool before( const Entry &left, const Entry &right ) noexcept
+    {
+        if( Policy::before( left.key, right.key ) ) return true;
+        if( Policy::before( right.key, left.key ) ) return false;
+        return left.id < right.id;
+    }
+
+    void make_index( )
+    {
+        if( indexed ) return;
+        index.reserve( heap.size( ) );
+        for( std::size_t slot = 0; slot < heap.size( ); ++slot ) index[heap[slot].id] = slot;
+        indexed = true;
+    }
+
+    void place( std::size_t slot, const Entry &entry )
+    {
+        heap[slot] = entry;
+        index[entry.id] = slot;
+    }
+
+    // Both sift functions keep index up to date.
+    void sift_up( std::size_t slot )
+    {
+        const Entry entry = heap[slot];
+        while( slot > 0 ) {
+            const std::size_t parent = ( slot - 1 ) / 2;
+            if( !before( entry, heap[parent] ) ) break;
+            place( slot, heap[parent] );
+            slot = parent;
+        }
+        place( slot, entry );
+    }
+
+    void sift_down( std::size_t slot )
+    {
+        const Entry entry = heap[slot];
+        const std::size_t count = heap.size( );
+        while( true ) {
+            std::size_t child = 2 * slot + 1;
+            if( child >= count ) break;
+            if( child + 1 < count && before( heap[child + 1], heap[child] ) ) ++child;
+            if( !before( heap[child], entry ) ) break;
+            place( slot, heap[child] );
+            slot = child;
+        }
+        place( slot, entry );
+    }
+};
+
+#endif
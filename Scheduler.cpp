@@ -0,0 +1,138 @@
+/*! \file    Scheduler.cpp
+ *  \brief   Policies that suggest which task to work on next.
+ *  \author  Peter C. Chapin <pchapin@vtc.edu>
+ */
+
+#include <cstring>
+
+#include "Scheduler.hpp"
+#include "TaskKernels.hpp"
+
+using namespace std;
+
+namespace {
+
+    struct PolicyName {
+        SchedulingPolicy policy;
+        const char      *name;
+    };
+
+    const PolicyName policy_names[] = {
+        { SchedulingPolicy::pixie,      "pixie"      },
+        { SchedulingPolicy::stride,     "stride"     },
+        { SchedulingPolicy::deadline,   "deadline"   },
+        { SchedulingPolicy::fair_share, "fair_share" }
+    };
+
+}
+
+
+const char *policy_name( SchedulingPolicy policy ) noexcept
+{
+    for( const PolicyName &entry : policy_names ) {
+        if( entry.policy == policy ) return entry.name;
+    }
+    return "";
+}
+
+
+bool find_policy( const char *first, const char *last, SchedulingPolicy &policy ) noexcept
+{
+    const std::size_t length = static_cast< std::size_t >( last - first );
+    for( const PolicyName &entry : policy_names ) {
+        if( length == strlen( entry.name ) && memcmp( entry.name, first, length ) == 0 ) {
+            policy = entry.policy;
+            return true;
+        }
+    }
+    return false;
+}
+
+
+Scheduler::Scheduler( )
+{
+    changes.reserve( max_changes );
+}
+
+
+void Scheduler::select( SchedulingPolicy policy ) noexcept
+{
+    if( policy == current ) return;
+    current = policy;
+    invalidate( );
+}
+
+
+void Scheduler::invalidate( ) noexcept
+{
+    valid = false;
+    changes.clear( );
+}
+
+
+void Scheduler::note_change( TaskId task_id ) noexcept
+{
+    if( !valid ) return;
+    if( changes.size( ) == changes.capacity( ) ) {
+        invalidate( );
+        return;
+    }
+    changes.push_back( task_id );
+}
+
+
+template< typename Policy >
+TaskId Scheduler::next_in( RunQueue< Policy > &queue, const TaskList &list )
+{
+    // When the keys depend on the totals of the list any change affects every task.
+    if( !valid || ( Policy::uses_totals && !changes.empty( ) ) ) {
+        ListTotals totals;
+        if( Policy::uses_totals ) {
+            totals.priority    = total_priority( list );
+            totals.accumulated = total_accumulated( list );
+        }
+        queue.build( list, totals );
+        valid = true;
+    }
+    else {
+        ListTotals totals;  // Not used by these policies.
+        for( TaskId task_id : changes ) {
+            const std::size_t position = list.find( task_id );
+            if( position == TaskList::npos )
+                queue.erase( task_id );
+            else
+                queue.update( list, position, totals );
+        }
+    }
+    changes.clear( );
+
+    while( !queue.empty( ) && list.find( queue.top( ) ) == TaskList::npos ) queue.erase( queue.top( ) );
+    return queue.top( );
+}
+
+
+TaskId Scheduler::next( const TaskList &list )
+{
+    // Only the current policy's queue is kept.
+    if( !valid ) {
+        pixie_queue      = RunQueue< PixiePolicy >( );
+        stride_queue     = RunQueue< StridePolicy >( );
+        deadline_queue   = RunQueue< DeadlinePolicy >( );
+        fair_share_queue = RunQueue< FairSharePolicy >( );
+    }
+
+    switch( current ) {
+    case SchedulingPolicy::pixie:      return next_in( pixie_queue, list );
+    case SchedulingPolicy::stride:     return next_in( stride_queue, list );
+    case SchedulingPolicy::deadline:   return next_in( deadline_queue, list );
+    case SchedulingPolicy::fair_share: return next_in( fair_share_queue, list );
+    }
+    return 0;
+}
+
+
+std::size_t Scheduler::memory_used( ) const noexcept
+{
+    return pixie_queue.memory_used( ) + stride_queue.memory_used( ) +
+           deadline_queue.memory_used( ) + fair_share_queue.memory_used( );
+}
@@ -0,0 +1,215 @@
+/*! \file    Scheduler.hpp
+ *  \brief   Policies that suggest which task to work on next.
+ *  \author  Peter C. Chapin <pchapin@vtc.edu>
+ */
+
+#ifndef SCHEDULER_HPP
+#define SCHEDULER_HPP
+
+#include <cstddef>
+#include <vector>
+
+#include "PixieTask.hpp"
+#include "RunQueue.hpp"
+#include "TaskList.hpp"
+
+//! Ways of choosing the task to work on next.
+enum class SchedulingPolicy {
+    pixie,      //!< The order of the displayed list (see PixiePolicy).
+    stride,     //!< Stride scheduling (see StridePolicy).
+    deadline,   //!< Earliest deadline first (see DeadlinePolicy).
+    fair_share  //!< Weighted fair share (see FairSharePolicy).
+};
+
+//! Returns the name of the given policy, as used by find_policy( ).
+const char *policy_name( SchedulingPolicy policy ) noexcept;
+
+//! Sets policy to the policy named by [first, last). Returns false if there is no such policy.
+bool find_policy( const char *first, const char *last, SchedulingPolicy &policy ) noexcept;
+
+
+//! Pixie's own order: tasks with unmet daily allocations first, by priority and then by debt.
+/*!
+ * The other tasks follow, those with the least time for their priority first.
+ */
+struct PixiePolicy {
+    struct Key {
+        bool hot;         //!< True if the task has a daily allocation that isn't met yet.
+        int  priority;
+        int  debt;
+        int  accumulated;
+    };
+
+    static const bool uses_totals = false;
+
+    //! Returns the key of a task whose "hot" status is already known.
+    static Key key( const TaskList &list, std::size_t position, bool hot ) noexcept
+    {
+        return Key{ hot, list.priority[position], list.debt( position ), list.accumulated[position] };
+    }
+
+    static Key key( const TaskList &list, std::size_t position, const ListTotals & ) noexcept
+    {
+        return key( list, position, list.daily[position] != 0 && list.debt( position ) > 0 );
+    }
+
+    static bool before( const Key &left, const Key &right ) noexcept
+    {
+        if( left.hot && right.hot ) {
+            if( left.priority == right.priority )
+                return left.debt > right.debt;
+            else
+                return left.priority > right.priority;
+        }
+
+        if( left.hot && !right.hot ) return true;
+        if( right.hot && !left.hot ) return false;
+
+        return ( right.priority * left.accumulated ) < ( left.priority * right.accumulated );
+    }
+};
+
+
+//! Stride scheduling: each task's priority is its number of tickets.
+/*!
+ * A task's pass is the time spent on it divided by its tickets, and the task with the lowest
+ * pass runs next. Over time each task gets time in proportion to its priority. Daily allocations
+ * are ignored. Ties go to the higher priority.
+ */
+struct StridePolicy {
+    struct Key {
+        int priority;
+        int accumulated;
+    };
+
+    static const bool uses_totals = false;
+
+    static Key key( const TaskList &list, std::size_t position, const ListTotals & ) noexcept
+    {
+        return Key{ list.priority[position], list.accumulated[position] };
+    }
+
+    static bool before( const Key &left, const Key &right ) noexcept
+    {
+        const long long left_pass  = static_cast< long long >( left.accumulated )  * right.priority;
+        const long long right_pass = static_cast< long long >( right.accumulated ) * left.priority;
+        if( left_pass != right_pass ) return left_pass < right_pass;
+        return left.priority > right.priority;
+    }
+};
+
+
+//! Earliest deadline first, where a daily allocation falls due at the end of each workday.
+/*!
+ * A task that owes time is as many days past its deadline as its debt is multiples of its daily
+ * allocation; the task that fell due longest ago runs next. Tasks that owe nothing have no
+ * deadline and follow, by priority.
+ */
+struct DeadlinePolicy {
+    struct Key {
+        bool due;       //!< True if the task owes time.
+        int  debt;
+        int  daily;
+        int  priority;
+    };
+
+    static const bool uses_totals = false;
+
+    static Key key( const TaskList &list, std::size_t position, const ListTotals & ) noexcept
+    {
+        const int debt = list.debt( position );
+        return Key{ list.daily[position] != 0 && debt > 0, debt, list.daily[position], list.priority[position] };
+    }
+
+    static bool before( const Key &left, const Key &right ) noexcept
+    {
+        if( left.due != right.due ) return left.due;
+        if( left.due ) {
+            const long long left_days  = static_cast< long long >( left.debt )  * right.daily;
+            const long long right_days = static_cast< long long >( right.debt ) * left.daily;
+            if( left_days != right_days ) return left_days > right_days;
+        }
+        return left.priority > right.priority;
+    }
+};
+
+
+//! Weighted fair share: each task is entitled to the fraction of all time spent given by its priority.
+/*!
+ * A task's lag is the time it is entitled to less the time spent on it; the task with the
+ * largest lag runs next. The lag depends on the totals of the entire list, so every key changes
+ * whenever any task does. Ties go to the higher priority.
+ */
+struct FairSharePolicy {
+    struct Key {
+        long long lag;  //!< Scaled by the total priority of the list.
+        int       priority;
+    };
+
+    static const bool uses_totals = true;
+
+    static Key key( const TaskList &list, std::size_t position, const ListTotals &totals ) noexcept
+    {
+        const long long lag = list.priority[position] * totals.accumulated -
+                              static_cast< long long >( list.accumulated[position] ) * totals.priority;
+        return Key{ lag, list.priority[position] };
+    }
+
+    static bool before( const Key &left, const Key &right ) noexcept
+    {
+        if( left.lag != right.lag ) return left.lag > right.lag;
+        return left.priority > right.priority;
+    }
+};
+
+
+//! Suggests the task to work on next, using a policy that can be changed at run time.
+/*!
+ * Each policy has its own RunQueue type, so choosing a policy costs one switch per query and
+ * the comparisons themselves are not indirect. Only the queue of the current policy is kept.
+ * Changes to the list are noted as they are made and applied to the queue by the next query,
+ * each in logarithmic time. The queue is rebuilt when too many tasks changed, when something
+ * changed every task (such as a new day), or (for policies that use the totals of the list)
+ * whenever anything changed. Deleted tasks are dropped when they reach the top of the queue.
+ */
+class Scheduler {
+public:
+    Scheduler( );
+
+    SchedulingPolicy policy( ) const noexcept { return current; }
+
+    //! Makes the given policy the current one.
+    void select( SchedulingPolicy policy ) noexcept;
+
+    //! Notes that any number of tasks might have changed.
+    void invalidate( ) noexcept;
+
+    //! Notes that the task with the given ID changed, was added, or was removed. Never allocates.
+    void note_change( TaskId task_id ) noexcept;
+
+    //! Returns the ID of the task in the list that should run next, or zero if the list is empty.
+    /*!
+     * Every change to the list since the last call must have been noted.
+     */
+    TaskId next( const TaskList &list );
+
+    //! Returns the number of bytes allocated by the run queue.
+    std::size_t memory_used( ) const noexcept;
+
+private:
+    static const std::size_t max_changes = 256;  //!< Beyond this many changes the queue is rebuilt.
+
+    SchedulingPolicy      current = SchedulingPolicy::pixie;
+    bool                  valid   = false;  //!< True if the queue of the current policy is usable.
+    std::vector< TaskId > changes;          //!< Tasks that changed since the queue was brought up to date.
+
+    RunQueue< PixiePolicy >     pixie_queue;
+    RunQueue< StridePolicy >    stride_queue;
+    RunQueue< DeadlinePolicy >  deadline_queue;
+    RunQueue< FairSharePolicy > fair_share_queue;
+
+    template< typename Policy >
+    TaskId next_in( RunQueue< Policy > &queue, const TaskList &list );
+};
+
+#endif
@@ -0,0 +1,324 @@
+/*! \file    SessionHistory.cpp
+ *  \brief   Append-only record of work sessions.
+ *  \author  Peter C. Chapin <pchapin@vtc.edu>
+ *
+ * The session file consists of a header followed by fixed size records, one per session, in the
+ * byte order of the machine that wrote it (as with binary task snapshots). Each record refers to
+ * its task by ID. The names file has a line for each deleted task: its ID, a space, and its
+ * description.
+ *
+ * The records are rows rather than one file per field. Sessions are appended one at a time, and
+ * every reader (load( ) and read_sessions( )) uses all of the fields of each record it reads, so
+ * separate columns would only add a write per field to each session and the chance of a crash
+ * leaving the columns with different lengths. The index built by load( ) is kept in columns.
+ */
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <unistd.h>
+#define PIXIE_HAVE_TRUNCATE
+#endif
+
+#include "Calendar.hpp"
+#include "MappedFile.hpp"
+#include "SessionHistory.hpp"
+
+using namespace std;
+
+namespace {
+
+    const char          history_magic[8]  = { 'P', 'I', 'X', 'I', 'E', 'H', 'S', 'T' };
+    const std::uint32_t history_version   = 2;
+    const std::uint32_t byte_order_marker = 0x01020304;
+
+    struct HistoryHeader {
+        char          magic[8];
+        std::uint32_t version;
+        std::uint32_t byte_order;
+    };
+
+    typedef SessionHistory::Session SessionRecord;
+
+    static_assert( sizeof( HistoryHeader ) == 16, "Unexpected padding in HistoryHeader" );
+    static_assert( sizeof( SessionRecord ) == 24, "Unexpected padding in SessionRecord" );
+
+    //! Shortens an open file. Returns false if that isn't possible.
+    bool truncate_file( std::FILE *file, long size ) noexcept
+    {
+#if defined(PIXIE_HAVE_TRUNCATE)
+        return fflush( file ) == 0 && ftruncate( fileno( file ), size ) == 0;
+#else
+        (void)file;
+        (void)size;
+        return false;
+#endif
+    }
+
+}
+
+
+void SessionHistory::DayIndex::add( long session_day, long long session_seconds )
+{
+    if( day.empty( ) || session_day > day.back( ) ) {
+        day.push_back( static_cast< int32_t >( session_day ) );
+        total.push_back( ( total.empty( ) ? 0 : total.back( ) ) + session_seconds );
+        return;
+    }
+
+    // A session earlier than the last one recorded (the clock was changed). Rare.
+    const size_t position = lower_bound( day.begin( ), day.end( ), session_day ) - day.begin( );
+    if( day[position] != session_day ) {
+        day.insert( day.begin( ) + position, static_cast< int32_t >( session_day ) );
+        total.insert( total.begin( ) + position, ( position == 0 ) ? 0 : total[position - 1] );
+    }
+    for( size_t i = position; i < total.size( ); ++i ) {
+        total[i] += session_seconds;
+    }
+}
+
+
+long long SessionHistory::DayIndex::before( long first_day ) const noexcept
+{
+    const size_t position = lower_bound( day.begin( ), day.end( ), first_day ) - day.begin( );
+    return ( position == 0 ) ? 0 : total[position - 1];
+}
+
+
+SessionHistory::~SessionHistory( )
+{
+    close( );
+}
+
+
+bool SessionHistory::read_names( const string &names_name )
+{
+    deleted_names.clear( );
+
+    ifstream input( names_name.c_str( ), ios::binary );
+    if( !input ) return true;
+    const string contents( ( istreambuf_iterator< char >( input ) ), istreambuf_iterator< char >( ) );
+    input.close( );
+
+    // A description without its newline was being written during a crash. Discard it.
+    const size_t complete = contents.rfind( '\n' ) + 1;
+    if( complete != contents.size( ) ) {
+#if defined(PIXIE_HAVE_TRUNCATE)
+        if( truncate( names_name.c_str( ), static_cast< off_t >( complete ) ) != 0 ) return false;
+#else
+        return false;
+#endif
+    }
+
+    size_t line_start = 0;
+    while( line_start < complete ) {
+        const size_t line_end = contents.find( '\n', line_start );
+        const size_t space = contents.find( ' ', line_start );
+        if( space < line_end ) {
+            const TaskId task = strtoull( contents.c_str( ) + line_start, nullptr, 10 );
+            deleted_names[task].assign( contents, space + 1, line_end - space - 1 );
+        }
+        line_start = line_end + 1;
+    }
+    return true;
+}
+
+
+bool SessionHistory::open( const string &name )
+{
+    close( );
+    const string names_name = name + ".names";
+    if( !read_names( names_name ) ) return false;
+
+    name_file = fopen( names_name.c_str( ), "ab" );
+    sessions  = fopen( name.c_str( ), "a+b" );
+    if( name_file == nullptr || sessions == nullptr ) {
+        close( );
+        return false;
+    }
+    file_name = name;
+
+    HistoryHeader header;
+    fseek( sessions, 0, SEEK_END );
+    const long size = ftell( sessions );
+    if( size < static_cast< long >( sizeof( header ) ) ) {
+        // A new history (or one whose header was never completely written).
+        memcpy( header.magic, history_magic, sizeof( header.magic ) );
+        header.version    = history_version;
+        header.byte_order = byte_order_marker;
+        if( ( size != 0 && !truncate_file( sessions, 0 ) ) ||
+            fwrite( &header, sizeof( header ), 1, sessions ) != 1 || fflush( sessions ) != 0 ) {
+            close( );
+            return false;
+        }
+        return true;
+    }
+
+    fseek( sessions, 0, SEEK_SET );
+    if( fread( &header, sizeof( header ), 1, sessions ) != 1 ||
+        memcmp( header.magic, history_magic, sizeof( header.magic ) ) != 0 ||
+        header.version != history_version ||
+        header.byte_order != byte_order_marker ) {
+        close( );
+        return false;
+    }
+    fseek( sessions, 0, SEEK_END );
+
+    // Discard a partially written session.
+    const long extra = ( size - static_cast< long >( sizeof( header ) ) ) % static_cast< long >( sizeof( SessionRecord ) );
+    if( extra != 0 && !truncate_file( sessions, size - extra ) ) {
+        close( );
+        return false;
+    }
+    return true;
+}
+
+
+void SessionHistory::close( ) noexcept
+{
+    if( sessions != nullptr ) {
+        fclose( sessions );
+        sessions = nullptr;
+    }
+    if( name_file != nullptr ) {
+        fclose( name_file );
+        name_file = nullptr;
+    }
+    deleted_names.clear( );
+    task_ids.clear( );
+    days.clear( );
+    task_index.clear( );
+    loaded = false;
+    loaded_sessions = 0;
+}
+
+
+void SessionHistory::add( TaskId task, time_t start, time_t end ) noexcept
+{
+    if( sessions == nullptr || end <= start ) return;
+
+    SessionRecord record;
+    record.start = static_cast< int64_t >( start );
+    record.end   = static_cast< int64_t >( end );
+    record.task  = task;
+    if( fwrite( &record, sizeof( record ), 1, sessions ) != 1 || fflush( sessions ) != 0 ) return;
+
+    if( loaded ) {
+        try {
+            index_session( task, start, end );
+            ++loaded_sessions;
+        }
+        catch( ... ) {
+            // Out of memory. The index no longer matches the file; it is rebuilt when next needed.
+            loaded = false;
+        }
+    }
+}
+
+
+void SessionHistory::name_deleted( TaskId task, const char *first, const char *last ) noexcept
+{
+    if( name_file == nullptr ) return;
+
+    try {
+        string line = to_string( task );
+        line += ' ';
+        line.append( first, last );
+        line += '\n';
+        if( fwrite( line.data( ), 1, line.size( ), name_file ) != line.size( ) || fflush( name_file ) != 0 ) return;
+        deleted_names[task].assign( first, last );
+    }
+    catch( ... ) {
+        // Out of memory. The name is reported once the history is opened again.
+    }
+}
+
+
+const string *SessionHistory::deleted_name( TaskId task ) const noexcept
+{
+    const auto name = deleted_names.find( task );
+    return ( name == deleted_names.end( ) ) ? nullptr : &name->second;
+}
+
+
+void SessionHistory::index_session( TaskId task_id, time_t start, time_t end )
+{
+    const auto entry = task_index.emplace( task_id, static_cast< uint32_t >( task_ids.size( ) ) );
+    if( entry.second ) {
+        task_ids.push_back( task_id );
+        days.emplace_back( );
+    }
+    DayIndex &task_days = days[entry.first->second];
+
+    // Split the session at midnight.
+    while( start < end ) {
+        if( start < cached_begin || start >= cached_end ) {
+            cached_day   = day_number( start );
+            cached_begin = day_start( cached_day );
+            cached_end   = day_start( cached_day + 1 );
+            if( cached_end <= start ) break;  // Only with damaged time zone information.
+        }
+        const time_t piece_end = min( end, cached_end );
+        task_days.add( cached_day, piece_end - start );
+        start = piece_end;
+    }
+}
+
+
+bool SessionHistory::load( )
+{
+    if( loaded ) return true;
+    if( sessions == nullptr || fflush( sessions ) != 0 ) return false;
+
+    MappedFile file;
+    if( !file.open( file_name ) || file.size( ) < sizeof( HistoryHeader ) ) return false;
+
+    task_ids.clear( );
+    days.clear( );
+    task_index.clear( );
+    loaded_sessions = 0;
+    cached_begin = cached_end = 0;
+
+    SessionRecord record;
+    for( const char *next = file.begin( ) + sizeof( HistoryHeader );
+         file.end( ) - next >= static_cast< ptrdiff_t >( sizeof( record ) );
+         next += sizeof( record ) ) {
+        memcpy( &record, next, sizeof( record ) );
+        index_session( record.task, static_cast< time_t >( record.start ), static_cast< time_t >( record.end ) );
+        ++loaded_sessions;
+    }
+    loaded = true;
+    return true;
+}
+
+
+long long SessionHistory::seconds( size_t task, long first_day, long last_day ) const noexcept
+{
+    if( task >= days.size( ) || first_day >= last_day ) return 0;
+    return days[task].before( last_day ) - days[task].before( first_day );
+}
+
+
+bool SessionHistory::recorded_sessions( size_t &count )
+{
+    if( sessions == nullptr || fflush( sessions ) != 0 || fseek( sessions, 0, SEEK_END ) != 0 ) return false;
+    const long size = ftell( sessions );
+    if( size < static_cast< long >( sizeof( HistoryHeader ) ) ) return false;
+    count = static_cast< size_t >( size - static_cast< long >( sizeof( HistoryHeader ) ) ) / sizeof( SessionRecord );
+    return true;
+}
+
+
+bool SessionHistory::read_sessions( size_t first, size_t count, vector< Session > &result ) const
+{
+    result.resize( count );
+    if( count == 0 ) return true;
+    ifstream input( file_name.c_str( ), ios::binary );
+    input.seekg( static_cast< streamoff >( sizeof( HistoryHeader ) + first * sizeof( SessionRecord ) ) );
+    return static_cast< bool >( input.read( reinterpret_cast< char * >( &result[0] ),
+                                            static_cast< streamsize >( count * sizeof( SessionRecord ) ) ) );
+}
@@ -0,0 +1,126 @@
+/*! \file    SessionHistory.hpp
+ *  \brief   Append-only record of work sessions.
+ *  \author  Peter C. Chapin <pchapin@vtc.edu>
+ */
+
+#ifndef SESSIONHISTORY_HPP
+#define SESSIONHISTORY_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <ctime>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "PixieTask.hpp"
+
+//! Every interval during which a task was being worked on, kept in files that only grow.
+/*!
+ * Sessions refer to their task by its ID, so renaming a task doesn't split its history and tasks
+ * with the same description are kept apart. The description of a task is recorded when the task
+ * is deleted (see name_deleted( )) so that its sessions can still be reported. Sessions are
+ * appended to the history as they end; the sessions recorded earlier are only read when a query
+ * needs them (see load( )). Queries use a per-task index of cumulative time by day, so the time
+ * spent on a task during any range of days is found with two binary searches.
+ */
+class SessionHistory {
+public:
+    //! A session as it is recorded.
+    struct Session {
+        std::int64_t start;  //!< When the session started.
+        std::int64_t end;    //!< When the session ended.
+        TaskId       task;
+    };
+
+    SessionHistory( ) = default;
+    ~SessionHistory( );
+
+    SessionHistory( const SessionHistory & ) = delete;
+    SessionHistory &operator=( const SessionHistory & ) = delete;
+
+    //! Opens the named history for appending, creating it if necessary.
+    /*!
+     * The descriptions of deleted tasks are kept in a second file with ".names" appended to the
+     * name. A record left incomplete by a crash is discarded.
+     */
+    bool open( const std::string &file_name );
+
+    //! Closes the history and forgets everything loaded from it.
+    void close( ) noexcept;
+
+    bool is_open( ) const noexcept { return sessions != nullptr; }
+
+    //! Records a session of the given task from start until end.
+    /*!
+     * Failures are ignored; a session that can't be recorded is lost.
+     */
+    void add( TaskId task, std::time_t start, std::time_t end ) noexcept;
+
+    //! Records the description [first, last) of a task that is being deleted.
+    /*!
+     * Failures are ignored; the task's sessions are then reported without a description.
+     */
+    void name_deleted( TaskId task, const char *first, const char *last ) noexcept;
+
+    //! Returns the description recorded for a deleted task, or nullptr if there is none.
+    const std::string *deleted_name( TaskId task ) const noexcept;
+
+    //! Reads the sessions recorded earlier if that hasn't been done already. Returns false on failure.
+    bool load( );
+
+    //! Returns the number of distinct tasks in the history. Requires load( ).
+    std::size_t task_count( ) const noexcept { return task_ids.size( ); }
+
+    //! Returns the ID of a task in the history, where task is less than task_count( ).
+    TaskId task_id( std::size_t task ) const noexcept { return task_ids[task]; }
+
+    //! Returns the number of sessions in the history. Requires load( ).
+    unsigned long long session_count( ) const noexcept { return loaded_sessions; }
+
+    //! Returns the seconds spent on a task during the days [first_day, last_day). Requires load( ).
+    long long seconds( std::size_t task, long first_day, long last_day ) const noexcept;
+
+    //! Sets count to the number of sessions recorded so far. Returns false on failure.
+    bool recorded_sessions( std::size_t &count );
+
+    //! Reads the recorded sessions [first, first + count), in the order they ended, without loading them.
+    /*!
+     * Each call reads from the file independently, so several threads may call this at once.
+     * Returns false on failure.
+     */
+    bool read_sessions( std::size_t first, std::size_t count, std::vector< Session > &result ) const;
+
+private:
+    //! Cumulative time spent on one task, for each day on which it was worked on.
+    struct DayIndex {
+        std::vector< std::int32_t > day;    //!< Increasing day numbers.
+        std::vector< long long >    total;  //!< Seconds spent on all days up to and including day[i].
+
+        void add( long session_day, long long session_seconds );
+        long long before( long first_day ) const noexcept;
+    };
+
+    std::string   file_name;
+    std::FILE    *sessions   = nullptr;   //!< Fixed size session records.
+    std::FILE    *name_file  = nullptr;   //!< The ID and description of a deleted task on each line.
+    std::unordered_map< TaskId, std::string > deleted_names;
+
+    bool               loaded          = false;
+    unsigned long long loaded_sessions = 0;
+    std::vector< TaskId >   task_ids;     //!< The tasks in the history, by task index.
+    std::vector< DayIndex > days;         //!< Index of each task's time, by task index.
+    std::unordered_map< TaskId, std::uint32_t > task_index;
+
+    // The day most recently looked up by index_session( ). Sessions mostly arrive in time
+    // order, so this avoids most conversions to local time.
+    long        cached_day   = 0;
+    std::time_t cached_begin = 0;
+    std::time_t cached_end   = 0;
+
+    bool read_names( const std::string &names_name );
+    void index_session( TaskId task_id, std::time_t start, std::time_t end );
+};
+
+#endif
@@ -0,0 +1,178 @@
+/*! \file    Statistics.cpp
+ *  \brief   Latency and I/O instrumentation.
+ *  \author  Peter C. Chapin <pchapin@vtc.edu>
+ *
+ * Latencies are kept in a histogram with four buckets for each power of two nanoseconds, so a
+ * reported percentile is within 25% of the true value. Probes are kept in a fixed table so that
+ * finding a probe never allocates memory; it is used from noexcept functions.
+ */
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+
+#include "Statistics.hpp"
+
+using namespace std;
+
+std::atomic< bool > statistics_on( false );
+
+namespace {
+
+    // Static storage, so every counter starts at zero.
+    LatencyProbe probes[max_probes];
+    std::atomic< int > probe_count( 0 );
+    std::atomic_flag   probe_lock = ATOMIC_FLAG_INIT;  //!< Serializes the creation of probes.
+
+    // Used once the table is full. It is never displayed.
+    LatencyProbe overflow_probe;
+    std::atomic< int > overflow_count( 0 );  //!< Number of probes that didn't fit in the table.
+
+    //! Returns the histogram bucket for the given latency.
+    int bucket_of( unsigned long long nanoseconds ) noexcept
+    {
+        if( nanoseconds < 4 ) return static_cast< int >( nanoseconds );
+        int exponent = 63;
+        while( ( nanoseconds >> exponent ) == 0 ) --exponent;
+        const int fraction = static_cast< int >( ( nanoseconds >> ( exponent - 2 ) ) & 3 );
+        return 4 * ( exponent - 1 ) + fraction;
+    }
+
+    //! Returns the largest latency that falls in the given bucket.
+    unsigned long long bucket_limit( int bucket ) noexcept
+    {
+        if( bucket < 4 ) return static_cast< unsigned long long >( bucket );
+        const int exponent = bucket / 4 + 1;
+        const unsigned long long lowest = static_cast< unsigned long long >( 4 + bucket % 4 ) << ( exponent - 2 );
+        return lowest + ( 1ULL << ( exponent - 2 ) ) - 1;
+    }
+
+    //! Returns the latency below which the given fraction of the operations fall.
+    unsigned long long percentile( const LatencyProbe &probe, unsigned long long count, double fraction ) noexcept
+    {
+        const unsigned long long maximum = probe.max_nanoseconds.load( memory_order_relaxed );
+        unsigned long long wanted = static_cast< unsigned long long >( fraction * count + 0.5 );
+        if( wanted == 0 ) wanted = 1;
+
+        unsigned long long seen = 0;
+        for( int i = 0; i < LatencyProbe::bucket_count; ++i ) {
+            seen += probe.buckets[i].load( memory_order_relaxed );
+            if( seen >= wanted ) return min( bucket_limit( i ), maximum );
+        }
+        return maximum;
+    }
+
+    //! Formats a latency with a convenient unit.
+    string format_time( unsigned long long nanoseconds )
+    {
+        ostringstream formatter;
+        formatter << fixed << setprecision( 1 );
+        if( nanoseconds < 10000ULL )
+            formatter << nanoseconds << "ns";
+        else if( nanoseconds < 10000000ULL )
+            formatter << nanoseconds / 1.0E3 << "us";
+        else if( nanoseconds < 10000000000ULL )
+            formatter << nanoseconds / 1.0E6 << "ms";
+        else
+            formatter << nanoseconds / 1.0E9 << "s";
+        return formatter.str( );
+    }
+
+}
+
+
+void enable_statistics( bool enabled ) noexcept
+{
+    statistics_on.store( enabled, memory_order_relaxed );
+}
+
+
+LatencyProbe &find_probe( const char *name ) noexcept
+{
+    while( probe_lock.test_and_set( memory_order_acquire ) ) { }
+
+    LatencyProbe *result = &overflow_probe;
+    const int count = probe_count.load( memory_order_relaxed );
+    int i;
+    for( i = 0; i < count; ++i ) {
+        if( strcmp( probes[i].name, name ) == 0 ) break;
+    }
+    if( i < count ) {
+        result = &probes[i];
+    }
+    else if( count < max_probes ) {
+        probes[count].name = name;
+        probe_count.store( count + 1, memory_order_release );
+        result = &probes[count];
+    }
+    else {
+        overflow_count.fetch_add( 1, memory_order_relaxed );
+    }
+    probe_lock.clear( memory_order_release );
+    return *result;
+}
+
+
+void record_latency( LatencyProbe &probe, unsigned long long nanoseconds ) noexcept
+{
+    probe.count.fetch_add( 1, memory_order_relaxed );
+    probe.total_nanoseconds.fetch_add( nanoseconds, memory_order_relaxed );
+    probe.buckets[bucket_of( nanoseconds )].fetch_add( 1, memory_order_relaxed );
+
+    unsigned long long maximum = probe.max_nanoseconds.load( memory_order_relaxed );
+    while( nanoseconds > maximum &&
+           !probe.max_nanoseconds.compare_exchange_weak( maximum, nanoseconds, memory_order_relaxed ) ) { }
+}
+
+
+void display_statistics( ostream &output )
+{
+    if( !statistics_enabled( ) ) {
+        output << "Statistics are not being collected (start Pixie with --stats)\n";
+    }
+
+    output << left << setw( 20 ) << "operation" << right
+           << setw( 10 ) << "count"
+           << setw( 10 ) << "mean"
+           << setw( 10 ) << "p50"
+           << setw( 10 ) << "p99"
+           << setw( 10 ) << "max"
+           << setw( 12 ) << "bytes" << "\n";
+
+    const int count = probe_count.load( memory_order_acquire );
+    for( int i = 0; i < count; ++i ) {
+        const LatencyProbe &probe = probes[i];
+        const unsigned long long operations = probe.count.load( memory_order_relaxed );
+        const unsigned long long bytes = probe.bytes.load( memory_order_relaxed );
+        if( operations == 0 && bytes == 0 ) continue;
+
+        output << left << setw( 20 ) << probe.name << right << setw( 10 ) << operations;
+        if( operations != 0 ) {
+            output << setw( 10 ) << format_time( probe.total_nanoseconds.load( memory_order_relaxed ) / operations )
+                   << setw( 10 ) << format_time( percentile( probe, operations, 0.50 ) )
+                   << setw( 10 ) << format_time( percentile( probe, operations, 0.99 ) )
+                   << setw( 10 ) << format_time( probe.max_nanoseconds.load( memory_order_relaxed ) );
+        }
+        else {
+            output << setw( 40 ) << "";
+        }
+        output << setw( 12 ) << bytes << "\n";
+    }
+    const int lost = overflow_count.load( memory_order_relaxed );
+    if( lost != 0 ) {
+        output << lost << " more operations were not measured (increase max_probes)\n";
+    }
+}
+
+
+bool write_statistics( const string &file_name )
+{
+    ofstream output( file_name.c_str( ) );
+    if( !output ) return false;
+    display_statistics( output );
+    output.close( );
+    return static_cast< bool >( output );
+}
@@ -0,0 +1,107 @@
+/*! \file    Statistics.hpp
+ *  \brief   Latency and I/O instrumentation.
+ *  \author  Peter C. Chapin <pchapin@vtc.edu>
+ *
+ * Interesting operations are wrapped in a LatencyTimer attached to a named LatencyProbe. Each
+ * probe counts the operations, keeps a histogram of their latencies, and counts any I/O bytes
+ * reported for it. Collection is off by default; while it is off a LatencyTimer only tests a
+ * flag, so the instrumentation can stay in production builds.
+ */
+
+#ifndef STATISTICS_HPP
+#define STATISTICS_HPP
+
+#include <atomic>
+#include <chrono>
+#include <iosfwd>
+#include <string>
+
+//! Statistics about one kind of operation. Probes live for the entire program.
+/*!
+ * The fields are updated with relaxed atomic operations since the task file can be written by
+ * a background thread.
+ */
+struct LatencyProbe {
+    static const int bucket_count = 252;  //!< Four buckets for each power of two nanoseconds.
+
+    const char *name;
+    std::atomic< unsigned long long > count;
+    std::atomic< unsigned long long > total_nanoseconds;
+    std::atomic< unsigned long long > max_nanoseconds;
+    std::atomic< unsigned long long > bytes;
+    std::atomic< unsigned long long > buckets[bucket_count];
+};
+
+extern std::atomic< bool > statistics_on;  //!< Use statistics_enabled( ) instead.
+
+//! Returns true if statistics are being collected.
+inline bool statistics_enabled( ) noexcept
+{
+    return statistics_on.load( std::memory_order_relaxed );
+}
+
+//! Turns the collection of statistics on or off.
+void enable_statistics( bool enabled ) noexcept;
+
+//! Number of probes that can be created.
+const int max_probes = 128;
+
+//! Number of probes created with a literal name, apart from the one for each command.
+/*!
+ * An upper bound, kept a little above the actual number. Commands.cpp checks that these and the
+ * command probes fit in the table.
+ */
+const int fixed_probes = 40;
+
+//! Returns the probe with the given name, creating it if necessary.
+/*!
+ * The name must be a string that lives for the entire program (normally a literal). Callers
+ * should look up a probe once and keep the reference, for example in a function static. Once
+ * max_probes exist, new probes share one probe that isn't displayed and the lost names are
+ * counted in the statistics.
+ */
+LatencyProbe &find_probe( const char *name ) noexcept;
+
+//! Records one operation that took the given time.
+void record_latency( LatencyProbe &probe, unsigned long long nanoseconds ) noexcept;
+
+//! Records I/O done by an operation.
+inline void record_bytes( LatencyProbe &probe, unsigned long long byte_count ) noexcept
+{
+    if( statistics_enabled( ) ) probe.bytes.fetch_add( byte_count, std::memory_order_relaxed );
+}
+
+//! Times the enclosing scope and records the result in a probe.
+class LatencyTimer {
+public:
+    explicit LatencyTimer( LatencyProbe &probe ) noexcept
+        : probe( probe ), active( statistics_enabled( ) )
+    {
+        if( active ) start = std::chrono::steady_clock::now( );
+    }
+
+   ~LatencyTimer( )
+    {
+        if( active ) {
+            const std::chrono::steady_clock::duration elapsed = std::chrono::steady_clock::now( ) - start;
+            record_latency( probe, static_cast< unsigned long long >(
+                std::chrono::duration_cast< std::chrono::nanoseconds >( elapsed ).count( ) ) );
+        }
+    }
+
+    LatencyTimer( const LatencyTimer & ) = delete;
+    LatencyTimer &operator=( const LatencyTimer & ) = delete;
+
+private:
+    LatencyProbe &probe;
+    bool          active;
+    std::chrono::steady_clock::time_point start;
+};
+
+//! Writes a table of every probe that has recorded something.
+void display_statistics( std::ostream &output );
+
+//! Writes the statistics table to the named file. Returns false if the file can't be written.
+bool write_statistics( const std::string &file_name );
+
+#endif
@@ -0,0 +1,235 @@
+/*! \file    Stress.cpp
+ *  \brief   Runs readers of task snapshots against a stream of commands.
+ *  \author  Peter C. Chapin <pchapin@vtc.edu>
+ *
+ * This program is built with ThreadSanitizer and run by "make stress". The main thread executes
+ * a random mix of commands that create, rename, delete, and reprioritize tasks and add time to
+ * them, committing after each command like the interactive loop. Meanwhile reader threads take
+ * snapshots with task_snapshot( ) and check every task in them: each description must still be
+ * readable and intact, and each task must be found by its ID at its own position. A data race,
+ * a freed description, or a damaged snapshot is reported by ThreadSanitizer or by the checks.
+ *
+ * Usage: pixie-stress [--readers N] [--commands N] [--seed S]
+ */
+
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <streambuf>
+#include <string>
+#include <thread>
+#include <vector>
+
+#if defined(_WIN32)
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "Commands.hpp"
+#include "TaskList.hpp"
+#include "Tasks.hpp"
+
+using namespace std;
+
+namespace {
+
+    //! Parameters of the run.
+    struct Settings {
+        unsigned      reader_count  = 4;
+        std::size_t   command_count = 5000;
+        unsigned long seed          = 12345;
+    };
+
+    Settings settings;
+
+    const char *const stress_folder = "pixie-stress.tmp";
+
+    //! Files that Pixie might create in the stress folder.
+    const char *const pixie_files[] = {
+        ".pixie-tasks", ".pixie-tasks.journal", ".pixie-tasks.journal.old", ".pixie-tasks.lock",
+        ".pixie-tasks.new", ".pixie-history", ".pixie-history.names", ".pixie-events", ".pixie-events.journal",
+        ".pixie-events.new"
+    };
+
+    //! Every description starts with this text, so that a damaged one can be recognized.
+    const char description_prefix[] = "Stress task ";
+    const std::size_t prefix_length = sizeof( description_prefix ) - 1;
+
+    std::atomic< bool >               stopping( false );
+    std::atomic< unsigned long long > snapshots_read( 0 );
+    std::atomic< unsigned long long > errors_found( 0 );
+
+
+    //! A stream buffer that discards everything written to it.
+    class NullBuffer : public streambuf {
+    protected:
+        int_type overflow( int_type c ) override { return traits_type::not_eof( c ); }
+        streamsize xsputn( const char *, streamsize count ) override { return count; }
+    };
+
+
+    void remove_pixie_files( )
+    {
+        for( const char *name : pixie_files ) {
+            std::remove( ( string( stress_folder ) + "/" + name ).c_str( ) );
+        }
+    }
+
+
+    //! Checks one snapshot. Returns a description of the first problem found, or nullptr.
+    const char *check_snapshot( const TaskList &snapshot )
+    {
+        unsigned long long sum = 0;
+        for( std::size_t i = 0; i < snapshot.size( ); ++i ) {
+            const TaskDescription text = snapshot.description( i );
+            if( text.size( ) < prefix_length || memcmp( text.data( ), description_prefix, prefix_length ) != 0 ) {
+                return "damaged description";
+            }
+            for( std::size_t j = 0; j < text.size( ); ++j ) sum += static_cast< unsigned char >( text.data( )[j] );
+            if( snapshot.find( snapshot.id( i ) ) != i ) return "task not found by its ID";
+            if( snapshot.priority[i] < 1 || snapshot.priority[i] > 99 ) return "bad priority";
+            sum += static_cast< unsigned long long >( snapshot.accumulated[i] );
+        }
+        // Keeps the reads of the text from being optimized away.
+        return ( sum == 1 ) ? "impossible checksum" : nullptr;
+    }
+
+
+    //! Reads snapshots until the commands are done.
+    void read_snapshots( )
+    {
+        while( !stopping.load( ) ) {
+            const shared_ptr< const TaskList > snapshot = task_snapshot( );
+            if( !snapshot ) continue;
+            const char *problem = check_snapshot( *snapshot );
+            if( problem != nullptr ) {
+                if( errors_found.fetch_add( 1 ) == 0 ) cerr << "pixie-stress: " << problem << "\n";
+            }
+            snapshots_read.fetch_add( 1 );
+        }
+    }
+
+
+    //! Returns a random command that keeps the list between a few and a few hundred tasks.
+    string make_command( minstd_rand &generator, unsigned long serial )
+    {
+        const int count = task_count( );
+        ostringstream command;
+        const unsigned choice = generator( ) % 100;
+        const int task = ( count == 0 ) ? 1 : 1 + static_cast< int >( generator( ) % count );
+        if( count < 10 || ( choice < 15 && count < 400 ) ) {
+            command << "create " << description_prefix << serial;
+        }
+        else if( choice < 25 ) {
+            command << "delete " << task;
+        }
+        else if( choice < 45 ) {
+            // Long names are never stored inline, so renaming retires text that snapshots might use.
+            command << "rename " << task << ' ' << description_prefix << serial << ' '
+                    << string( generator( ) % 200, 'x' );
+        }
+        else if( choice < 65 ) {
+            command << "priority " << task << ' ' << 1 + generator( ) % 99;
+        }
+        else {
+            command << "add " << task << ' ' << generator( ) % 60;
+        }
+        return command.str( );
+    }
+
+
+    //! Runs the commands against the readers. Returns the program's exit code.
+    int run_stress( )
+    {
+        NullBuffer discard;
+        streambuf *const standard_output = cout.rdbuf( &discard );
+
+        initialize_tasks( );
+        vector< thread > readers;
+        for( unsigned i = 0; i < settings.reader_count; ++i ) readers.emplace_back( read_snapshots );
+
+        minstd_rand generator( static_cast< minstd_rand::result_type >( settings.seed ) );
+        unsigned long command_errors = 0;
+        for( std::size_t i = 0; i < settings.command_count; ++i ) {
+            const char *error_message = "";
+            sort_tasks( );
+            if( process_command( make_command( generator, static_cast< unsigned long >( i ) ), error_message ) ==
+                CommandStatus::error ) ++command_errors;
+            commit_tasks( );
+        }
+
+        stopping.store( true );
+        for( thread &reader : readers ) reader.join( );
+        cleanup_tasks( );
+        cout.rdbuf( standard_output );
+
+        cout << settings.command_count << " commands (" << command_errors << " rejected), "
+             << snapshots_read.load( ) << " snapshots read, "
+             << errors_found.load( ) << " damaged" << endl;
+        return ( errors_found.load( ) == 0 ) ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+
+    //! Reads the command line into settings. Returns false if it is malformed.
+    bool parse_arguments( int argc, char **argv )
+    {
+        for( int i = 1; i < argc; ++i ) {
+            const bool has_value = i + 1 < argc;
+            if( strcmp( argv[i], "--readers" ) == 0 && has_value ) {
+                settings.reader_count = static_cast< unsigned >( strtoul( argv[++i], nullptr, 10 ) );
+            }
+            else if( strcmp( argv[i], "--commands" ) == 0 && has_value ) {
+                settings.command_count = strtoul( argv[++i], nullptr, 10 );
+            }
+            else if( strcmp( argv[i], "--seed" ) == 0 && has_value ) {
+                settings.seed = strtoul( argv[++i], nullptr, 10 );
+            }
+            else {
+                return false;
+            }
+        }
+        return true;
+    }
+
+}
+
+
+int main( int argc, char **argv )
+{
+    if( !parse_arguments( argc, argv ) ) {
+        cerr << "Usage: pixie-stress [--readers N] [--commands N] [--seed S]\n";
+        return EXIT_FAILURE;
+    }
+
+    // The run uses its own task folder.
+#if defined(_WIN32)
+    _mkdir( stress_folder );
+    _putenv_s( "PIXIE_HOME", stress_folder );
+#else
+    mkdir( stress_folder, 0777 );
+    setenv( "PIXIE_HOME", stress_folder, 1 );
+#endif
+
+    int rc = EXIT_FAILURE;
+    remove_pixie_files( );
+    try {
+        rc = run_stress( );
+    }
+    catch( exception &e ) {
+        cerr << "pixie-stress: " << e.what( ) << "\n";
+    }
+
+    remove_pixie_files( );
+#if defined(_WIN32)
+    _rmdir( stress_folder );
+#else
+    rmdir( stress_folder );
+#endif
+    return rc;
+}
@@ -0,0 +1,207 @@
+/*! \file    TaskKernels.cpp
+ *  \brief   Operations that apply to every task in a task list.
+ *  \author  Peter C. Chapin <pchapin@vtc.edu>
+ *
+ * Each operation has a portable scalar version. When compiled with gcc or clang for x86 there is
+ * also an AVX2 version that processes eight tasks at a time; it is selected at run time if the
+ * processor supports it.
+ */
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+
+#if defined(__GNUC__) && ( defined(__x86_64__) || defined(__i386__) )
+#include <immintrin.h>
+#define PIXIE_HAVE_AVX2
+#endif
+
+#include "TaskKernels.hpp"
+
+using namespace std;
+
+namespace {
+
+    // Stored debts are relative to the workday epoch (see TaskList), so a debt of one day is
+    // stored as daily * (1 - epoch).
+    void reset_debt_scalar( int *debt, const int *daily, int epoch, size_t count ) noexcept
+    {
+        for( size_t i = 0; i < count; ++i ) {
+            if( daily[i] != 0 ) debt[i] = daily[i] * ( 1 - epoch );
+        }
+    }
+
+
+    long long total_priority_scalar( const uint8_t *priority, size_t count ) noexcept
+    {
+        long long total = 0;
+        for( size_t i = 0; i < count; ++i ) {
+            total += priority[i];
+        }
+        return total;
+    }
+
+
+    long long total_accumulated_scalar( const int *accumulated, size_t count ) noexcept
+    {
+        long long total = 0;
+        for( size_t i = 0; i < count; ++i ) {
+            total += accumulated[i];
+        }
+        return total;
+    }
+
+
+    void find_hot_scalar( const int *daily, const int *debt, int epoch, unsigned char *hot, size_t count ) noexcept
+    {
+        for( size_t i = 0; i < count; ++i ) {
+            hot[i] = ( daily[i] != 0 && debt[i] + daily[i] * epoch > 0 );
+        }
+    }
+
+#if defined(PIXIE_HAVE_AVX2)
+
+    bool have_avx2( ) noexcept
+    {
+        static const bool result = ( __builtin_cpu_init( ), __builtin_cpu_supports( "avx2" ) != 0 );
+        return result;
+    }
+
+
+    inline __attribute__(( target( "avx2" ) )) __m256i load8( const int *p ) noexcept
+    {
+        return _mm256_loadu_si256( reinterpret_cast< const __m256i * >( p ) );
+    }
+
+
+    inline __attribute__(( target( "avx2" ) )) void store8( int *p, __m256i value ) noexcept
+    {
+        _mm256_storeu_si256( reinterpret_cast< __m256i * >( p ), value );
+    }
+
+
+    __attribute__(( target( "avx2" ) ))
+    void reset_debt_avx2( int *debt, const int *daily, int epoch, size_t count ) noexcept
+    {
+        const __m256i zero = _mm256_setzero_si256( );
+        const __m256i days = _mm256_set1_epi32( 1 - epoch );
+        size_t i = 0;
+        for( ; i + 8 <= count; i += 8 ) {
+            const __m256i daily_minutes = load8( daily + i );
+            const __m256i no_daily      = _mm256_cmpeq_epi32( daily_minutes, zero );
+            const __m256i one_day       = _mm256_mullo_epi32( daily_minutes, days );
+            store8( debt + i, _mm256_blendv_epi8( one_day, load8( debt + i ), no_daily ) );
+        }
+        reset_debt_scalar( debt + i, daily + i, epoch, count - i );
+    }
+
+
+    __attribute__(( target( "avx2" ) ))
+    long long total_priority_avx2( const uint8_t *priority, size_t count ) noexcept
+    {
+        // Summing absolute differences from zero adds up each group of eight bytes.
+        const __m256i zero = _mm256_setzero_si256( );
+        __m256i sums = zero;
+        size_t i = 0;
+        for( ; i + 32 <= count; i += 32 ) {
+            const __m256i values = _mm256_loadu_si256( reinterpret_cast< const __m256i * >( priority + i ) );
+            sums = _mm256_add_epi64( sums, _mm256_sad_epu8( values, zero ) );
+        }
+        alignas( 32 ) long long lanes[4];
+        _mm256_store_si256( reinterpret_cast< __m256i * >( lanes ), sums );
+        return lanes[0] + lanes[1] + lanes[2] + lanes[3] + total_priority_scalar( priority + i, count - i );
+    }
+
+
+    __attribute__(( target( "avx2" ) ))
+    long long total_accumulated_avx2( const int *accumulated, size_t count ) noexcept
+    {
+        // Each half of eight values is widened to 64 bits so that the sums can't overflow.
+        __m256i sums = _mm256_setzero_si256( );
+        size_t i = 0;
+        for( ; i + 8 <= count; i += 8 ) {
+            const __m256i values = load8( accumulated + i );
+            sums = _mm256_add_epi64( sums, _mm256_cvtepi32_epi64( _mm256_castsi256_si128( values ) ) );
+            sums = _mm256_add_epi64( sums, _mm256_cvtepi32_epi64( _mm256_extracti128_si256( values, 1 ) ) );
+        }
+        alignas( 32 ) long long lanes[4];
+        _mm256_store_si256( reinterpret_cast< __m256i * >( lanes ), sums );
+        return lanes[0] + lanes[1] + lanes[2] + lanes[3] + total_accumulated_scalar( accumulated + i, count - i );
+    }
+
+
+    __attribute__(( target( "avx2" ) ))
+    void find_hot_avx2( const int *daily, const int *debt, int epoch, unsigned char *hot, size_t count ) noexcept
+    {
+        const __m256i zero   = _mm256_setzero_si256( );
+        const __m256i charge = _mm256_set1_epi32( epoch );
+        const __m128i one    = _mm_set1_epi8( 1 );
+        size_t i = 0;
+        for( ; i + 8 <= count; i += 8 ) {
+            const __m256i daily_minutes = load8( daily + i );
+            const __m256i no_daily = _mm256_cmpeq_epi32( daily_minutes, zero );
+            const __m256i owed     = _mm256_add_epi32( load8( debt + i ), _mm256_mullo_epi32( daily_minutes, charge ) );
+            const __m256i in_debt  = _mm256_cmpgt_epi32( owed, zero );
+            const __m256i is_hot   = _mm256_andnot_si256( no_daily, in_debt );
+
+            // Narrow the eight 32 bit masks to eight bytes.
+            const __m128i words = _mm_packs_epi32( _mm256_castsi256_si128( is_hot ), _mm256_extracti128_si256( is_hot, 1 ) );
+            const __m128i bytes = _mm_packs_epi16( words, words );
+            _mm_storel_epi64( reinterpret_cast< __m128i * >( hot + i ), _mm_and_si128( bytes, one ) );
+        }
+        find_hot_scalar( daily + i, debt + i, epoch, hot + i, count - i );
+    }
+
+#endif
+
+}
+
+
+void zero_times( TaskList &task_list ) noexcept
+{
+    fill( task_list.start_time.begin( ), task_list.start_time.end( ), 0 );
+    fill( task_list.accumulated.begin( ), task_list.accumulated.end( ), 0 );
+    task_list.clear_today( );
+#if defined(PIXIE_HAVE_AVX2)
+    if( have_avx2( ) ) {
+        reset_debt_avx2( task_list.accumulated_debt.data( ), task_list.daily.data( ), task_list.epoch( ), task_list.size( ) );
+        return;
+    }
+#endif
+    reset_debt_scalar( task_list.accumulated_debt.data( ), task_list.daily.data( ), task_list.epoch( ), task_list.size( ) );
+}
+
+
+long long total_priority( const TaskList &task_list ) noexcept
+{
+#if defined(PIXIE_HAVE_AVX2)
+    if( have_avx2( ) ) {
+        return total_priority_avx2( task_list.priority.data( ), task_list.size( ) );
+    }
+#endif
+    return total_priority_scalar( task_list.priority.data( ), task_list.size( ) );
+}
+
+
+long long total_accumulated( const TaskList &task_list ) noexcept
+{
+#if defined(PIXIE_HAVE_AVX2)
+    if( have_avx2( ) ) {
+        return total_accumulated_avx2( task_list.accumulated.data( ), task_list.size( ) );
+    }
+#endif
+    return total_accumulated_scalar( task_list.accumulated.data( ), task_list.size( ) );
+}
+
+
+void find_hot( const TaskList &task_list, vector< unsigned char > &hot )
+{
+    hot.resize( task_list.size( ) );
+#if defined(PIXIE_HAVE_AVX2)
+    if( have_avx2( ) ) {
+        find_hot_avx2( task_list.daily.data( ), task_list.accumulated_debt.data( ), task_list.epoch( ), hot.data( ), task_list.size( ) );
+        return;
+    }
+#endif
+    find_hot_scalar( task_list.daily.data( ), task_list.accumulated_debt.data( ), task_list.epoch( ), hot.data( ), task_list.size( ) );
+}
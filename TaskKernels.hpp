@@ -0,0 +1,26 @@
+/*! \file    TaskKernels.hpp
+ *  \brief   Operations that apply to every task in a task list.
+ *  \author  Peter C. Chapin <pchapin@vtc.edu>
+ */
+
+#ifndef TASKKERNELS_HPP
+#define TASKKERNELS_HPP
+
+#include <cstddef>
+#include <vector>
+
+#include "TaskList.hpp"
+
+//! Stops every task and zeros all accumulated times. Tasks with a daily allocation owe one day.
+void zero_times( TaskList &task_list ) noexcept;
+
+//! Returns the sum of the priorities of every task.
+long long total_priority( const TaskList &task_list ) noexcept;
+
+//! Returns the sum of the accumulated times of every task.
+long long total_accumulated( const TaskList &task_list ) noexcept;
+
+//! Sets hot[i] to one if task i is hot (it has a daily allocation that is not yet met), else zero.
+void find_hot( const TaskList &task_list, std::vector< unsigned char > &hot );
+
+#endif
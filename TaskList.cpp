@@ -0,0 +1,466 @@
+/*! \file    TaskList.cpp
+ *  \brief   Column oriented storage for the task list.
+ *  \author  Peter C. Chapin <pchapin@vtc.edu>
+ */
+
+#include <algorithm>
+#include <memory>
+#include <utility>
+
+#include "TaskList.hpp"
+
+using namespace std;
+
+namespace {
+
+    const size_t kept_scratch = 4096; //!< Larger scratch columns are released after use.
+    const size_t min_index    = 16;   //!< Smallest size of the ID hash table.
+
+    //! Returns the preferred place of an ID in a hash table with the given mask.
+    size_t index_home( TaskId task_id, size_t mask ) noexcept
+    {
+        return static_cast< size_t >( ( task_id * 0x9E3779B97F4A7C15ULL ) >> 32 ) & mask;
+    }
+
+    //! Applies a permutation to the [first, last) range of one column using the given scratch space.
+    template< typename T >
+    void permute_column( vector< T > &column,
+                         vector< T > &scratch,
+                         const vector< size_t > &order,
+                         size_t first,
+                         size_t last )
+    {
+        scratch.resize( last - first );
+        for( size_t i = first; i < last; ++i ) {
+            scratch[i - first] = std::move( column[order[i - first]] );
+        }
+        for( size_t i = first; i < last; ++i ) {
+            column[i] = std::move( scratch[i - first] );
+        }
+        if( scratch.capacity( ) > kept_scratch )
+            vector< T >( ).swap( scratch );
+        else
+            scratch.clear( );
+    }
+
+}
+
+
+TaskList::~TaskList( )
+{
+    for( TaskDescription &text : descriptions ) retire( text );
+}
+
+
+void TaskList::clear( ) noexcept
+{
+    start_time.clear( );
+    priority.clear( );
+    accumulated.clear( );
+    accumulated_today.clear( );
+    today_stamp.clear( );
+    daily.clear( );
+    accumulated_debt.clear( );
+    for( TaskDescription &text : descriptions ) retire( text );
+    descriptions.clear( );
+    shard.clear( );
+    workday_epoch = 0;
+    clamped_count = 0;
+    slot_of.clear( );
+    // Handles to the old tasks must not match the slots of new ones.
+    for( const Slot &slot : slots ) new_generation = max( new_generation, slot.generation + 1 );
+    slots.clear( );
+    free_slot = no_slot;
+    id_index.clear( );
+    daily_slots.clear( );
+    index_used   = 0;
+    next_task_id = 1;
+}
+
+
+void TaskList::reserve( size_t count )
+{
+    start_time.reserve( count );
+    priority.reserve( count );
+    accumulated.reserve( count );
+    accumulated_today.reserve( count );
+    today_stamp.reserve( count );
+    daily.reserve( count );
+    accumulated_debt.reserve( count );
+    descriptions.reserve( count );
+    shard.reserve( count );
+    slot_of.reserve( count );
+    slots.reserve( count );
+    if( 2 * count > id_index.size( ) ) rebuild_index( count );
+}
+
+
+size_t TaskList::find( TaskId task_id ) const noexcept
+{
+    if( id_index.empty( ) ) return npos;
+    const size_t entry = id_index[index_probe( task_id )];
+    return ( entry == 0 ) ? npos : slots[entry - 1].position;
+}
+
+
+size_t TaskList::index_probe( TaskId task_id ) const noexcept
+{
+    const size_t mask = id_index.size( ) - 1;
+    size_t i = index_home( task_id, mask );
+    while( id_index[i] != 0 && slots[id_index[i] - 1].id != task_id ) i = ( i + 1 ) & mask;
+    return i;
+}
+
+
+void TaskList::rebuild_index( size_t count )
+{
+    size_t size = min_index;
+    while( size < 2 * count ) size *= 2;
+    vector< uint32_t > larger( size, 0 );
+    id_index.swap( larger );
+    const size_t mask = id_index.size( ) - 1;
+    for( size_t i = 0; i < slots.size( ); ++i ) {
+        if( slots[i].id == 0 ) continue;
+        size_t j = index_home( slots[i].id, mask );
+        while( id_index[j] != 0 ) j = ( j + 1 ) & mask;
+        id_index[j] = static_cast< uint32_t >( i + 1 );
+    }
+}
+
+
+void TaskList::index_insert( TaskId task_id, uint32_t slot )
+{
+    // Keep the table at most half full.
+    if( 2 * ( index_used + 1 ) > id_index.size( ) ) {
+        slots[slot].id = 0;
+        rebuild_index( id_index.size( ) );
+        slots[slot].id = task_id;
+    }
+    id_index[index_probe( task_id )] = slot + 1;
+    ++index_used;
+}
+
+
+void TaskList::index_erase( TaskId task_id ) noexcept
+{
+    if( id_index.empty( ) ) return;
+    const size_t mask = id_index.size( ) - 1;
+    size_t hole = index_probe( task_id );
+    if( id_index[hole] == 0 ) return;
+
+    // Move later entries of the same cluster back into the hole when that doesn't put them
+    // before their preferred place. This keeps every ID reachable without tombstones.
+    size_t next = hole;
+    for( ;; ) {
+        next = ( next + 1 ) & mask;
+        if( id_index[next] == 0 ) break;
+        const size_t home = index_home( slots[id_index[next] - 1].id, mask );
+        const bool movable = ( hole < next ) ? ( home <= hole || home > next ) : ( home <= hole && home > next );
+        if( movable ) {
+            id_index[hole] = id_index[next];
+            hole = next;
+        }
+    }
+    id_index[hole] = 0;
+    --index_used;
+}
+
+
+uint32_t TaskList::allocate_slot( TaskId task_id, size_t position )
+{
+    uint32_t slot;
+    if( free_slot != no_slot ) {
+        slot = free_slot;
+        free_slot = slots[slot].position;
+    }
+    else {
+        slots.push_back( Slot( ) );
+        slot = static_cast< uint32_t >( slots.size( ) - 1 );
+        slots[slot].generation = new_generation;
+    }
+    slots[slot].id       = task_id;
+    slots[slot].position = static_cast< uint32_t >( position );
+    return slot;
+}
+
+
+void TaskList::release_slot( uint32_t slot ) noexcept
+{
+    index_erase( slots[slot].id );
+    slots[slot].id       = 0;
+    slots[slot].position = free_slot;
+    ++slots[slot].generation;
+    free_slot = slot;
+}
+
+
+void TaskList::retire( TaskDescription &old_description ) noexcept
+{
+    if( !retired || !old_description.is_owned( ) ) return;
+    try {
+        retired->text.emplace_back( old_description.data( ) );
+    }
+    catch( ... ) {
+        // The text is leaked rather than released early.
+    }
+    old_description.release( );
+}
+
+
+TaskDescription TaskList::take_description( size_t position ) noexcept
+{
+    TaskDescription result;
+    result.swap( descriptions[position] );
+    return result;
+}
+
+
+void TaskList::push_back( PixieTask &&task, uint16_t task_shard )
+{
+    TaskId task_id = task.id;
+    if( task_id == 0 || find( task_id ) != npos ) task_id = next_task_id;
+    const uint32_t slot = allocate_slot( task_id, size( ) );
+    index_insert( task_id, slot );
+    slot_of.push_back( slot );
+    if( task_id >= next_task_id ) next_task_id = task_id + 1;
+
+    descriptions.push_back( std::move( task.description ) );
+    start_time.push_back( task.start_time );
+    priority.push_back( narrow_priority( task.priority ) );
+    accumulated.push_back( task.accumulated );
+    accumulated_today.push_back( task.accumulated_today );
+    today_stamp.push_back( day_stamp );
+    daily.push_back( task.daily );
+    note_daily( size( ) - 1, 0, task.daily );
+    accumulated_debt.push_back( task.accumulated_debt - task.daily * workday_epoch );
+    shard.push_back( task_shard );
+}
+
+
+void TaskList::set( size_t position, PixieTask &&task )
+{
+    retire( descriptions[position] );
+    descriptions[position] = std::move( task.description );
+    start_time[position]        = task.start_time;
+    priority[position]          = narrow_priority( task.priority );
+    accumulated[position]       = task.accumulated;
+    accumulated_today[position] = task.accumulated_today;
+    today_stamp[position]       = day_stamp;
+    note_daily( position, daily[position], task.daily );
+    daily[position]             = task.daily;
+    accumulated_debt[position]  = task.accumulated_debt - task.daily * workday_epoch;
+}
+
+
+void TaskList::note_daily( size_t position, int old_daily, int new_daily )
+{
+    if( ( old_daily != 0 ) == ( new_daily != 0 ) ) return;
+    if( new_daily != 0 ) {
+        daily_slots.push_back( slot_of[position] );
+    }
+    else {
+        // Daily tasks are few, so finding the slot costs little.
+        const auto entry = std::find( daily_slots.begin( ), daily_slots.end( ), slot_of[position] );
+        *entry = daily_slots.back( );
+        daily_slots.pop_back( );
+    }
+}
+
+
+uint8_t TaskList::narrow_priority( int value ) noexcept
+{
+    if( value < 1 || value > max_priority ) {
+        ++clamped_count;
+        value = ( value < 1 ) ? 1 : max_priority;
+    }
+    return static_cast< uint8_t >( value );
+}
+
+
+void TaskList::add_work( size_t position, int minutes ) noexcept
+{
+    accumulated[position] += minutes;
+    if( today_stamp[position] != day_stamp ) {
+        accumulated_today[position] = 0;
+        today_stamp[position] = day_stamp;
+    }
+    accumulated_today[position] += minutes;
+    if( daily[position] != 0 ) accumulated_debt[position] -= minutes;
+}
+
+
+void TaskList::set_daily( size_t position, int new_daily )
+{
+    // The stored debt is adjusted for the epoch so that only the change in allocation counts.
+    if( new_daily == 0 ) {
+        accumulated_debt[position] = 0;
+    }
+    else {
+        accumulated_debt[position] += ( new_daily - daily[position] ) * ( 1 - workday_epoch );
+    }
+    note_daily( position, daily[position], new_daily );
+    daily[position] = new_daily;
+}
+
+
+void TaskList::charge_workdays( int count ) noexcept
+{
+    workday_epoch += count;
+    if( workday_epoch > max_epoch || workday_epoch < -max_epoch ) {
+        // Keep the products in debt( ) from overflowing. Rare enough that the loop doesn't matter.
+        for( const uint32_t slot : daily_slots ) {
+            const size_t position = slots[slot].position;
+            accumulated_debt[position] += daily[position] * workday_epoch;
+        }
+        workday_epoch = 0;
+    }
+}
+
+
+void TaskList::rename( size_t position, const char *first, const char *last )
+{
+    TaskDescription new_description;
+    new_description.assign( first, last );
+    retire( descriptions[position] );
+    descriptions[position] = std::move( new_description );
+}
+
+
+void TaskList::erase( size_t position )
+{
+    note_daily( position, daily[position], 0 );
+    release_slot( slot_of[position] );
+    retire( descriptions[position] );
+
+    const size_t last = size( ) - 1;
+    if( position != last ) {
+        start_time[position]        = start_time[last];
+        priority[position]          = priority[last];
+        accumulated[position]       = accumulated[last];
+        accumulated_today[position] = accumulated_today[last];
+        today_stamp[position]       = today_stamp[last];
+        daily[position]             = daily[last];
+        accumulated_debt[position]  = accumulated_debt[last];
+        descriptions[position]      = std::move( descriptions[last] );
+        shard[position]             = shard[last];
+        slot_of[position]           = slot_of[last];
+        slots[slot_of[position]].position = static_cast< uint32_t >( position );
+    }
+
+    start_time.pop_back( );
+    priority.pop_back( );
+    accumulated.pop_back( );
+    accumulated_today.pop_back( );
+    today_stamp.pop_back( );
+    daily.pop_back( );
+    accumulated_debt.pop_back( );
+    descriptions.pop_back( );
+    shard.pop_back( );
+    slot_of.pop_back( );
+}
+
+
+void TaskList::erase_in_order( size_t position )
+{
+    note_daily( position, daily[position], 0 );
+    release_slot( slot_of[position] );
+    slot_of.erase( slot_of.begin( ) + position );
+    for( size_t i = position; i < slot_of.size( ); ++i ) {
+        slots[slot_of[i]].position = static_cast< uint32_t >( i );
+    }
+
+    start_time.erase( start_time.begin( ) + position );
+    priority.erase( priority.begin( ) + position );
+    accumulated.erase( accumulated.begin( ) + position );
+    accumulated_today.erase( accumulated_today.begin( ) + position );
+    today_stamp.erase( today_stamp.begin( ) + position );
+    daily.erase( daily.begin( ) + position );
+    accumulated_debt.erase( accumulated_debt.begin( ) + position );
+    retire( descriptions[position] );
+    descriptions.erase( descriptions.begin( ) + position );
+    shard.erase( shard.begin( ) + position );
+}
+
+
+void TaskList::permute( const vector< size_t > &order, size_t first, size_t last )
+{
+    if( first >= last ) return;
+    permute_column( start_time, time_scratch, order, first, last );
+    permute_column( priority, byte_scratch, order, first, last );
+    permute_column( accumulated, int_scratch, order, first, last );
+    permute_column( accumulated_today, int_scratch, order, first, last );
+    permute_column( today_stamp, stamp_scratch, order, first, last );
+    permute_column( daily, int_scratch, order, first, last );
+    permute_column( accumulated_debt, int_scratch, order, first, last );
+    permute_column( descriptions, description_scratch, order, first, last );
+    permute_column( shard, short_scratch, order, first, last );
+    permute_column( slot_of, stamp_scratch, order, first, last );
+    for( size_t i = first; i < last; ++i ) {
+        slots[slot_of[i]].position = static_cast< uint32_t >( i );
+    }
+}
+
+
+shared_ptr< const TaskList > TaskList::snapshot( )
+{
+    shared_ptr< TaskList > copy = make_shared< TaskList >( );
+    copy->start_time        = start_time;
+    copy->priority          = priority;
+    copy->accumulated       = accumulated;
+    copy->accumulated_today = accumulated_today;
+    copy->today_stamp       = today_stamp;
+    copy->daily             = daily;
+    copy->accumulated_debt  = accumulated_debt;
+    copy->shard             = shard;
+    copy->workday_epoch     = workday_epoch;
+    copy->day_stamp         = day_stamp;
+    copy->slot_of           = slot_of;
+    copy->slots             = slots;
+    copy->free_slot         = free_slot;
+    copy->id_index          = id_index;
+    copy->index_used        = index_used;
+    copy->next_task_id      = next_task_id;
+    copy->descriptions.resize( size( ) );
+    for( size_t i = 0; i < size( ); ++i ) {
+        copy->descriptions[i] = description( i );
+    }
+
+    // Text retired from now on might be used by this snapshot or by any earlier one.
+    const shared_ptr< RetiredText > generation = make_shared< RetiredText >( );
+    if( retired ) retired->next = generation;
+    retired    = generation;
+    copy->held = generation;
+    return copy;
+}
+
+
+void TaskList::retire_storage( shared_ptr< const void > storage )
+{
+    if( retired ) retired->storage.push_back( std::move( storage ) );
+}
+
+
+size_t TaskList::memory_used( ) const noexcept
+{
+    size_t total =
+        start_time.capacity( )        * sizeof( start_time[0] ) +
+        priority.capacity( )          * sizeof( priority[0] ) +
+        accumulated.capacity( )       * sizeof( accumulated[0] ) +
+        accumulated_today.capacity( ) * sizeof( accumulated_today[0] ) +
+        today_stamp.capacity( )       * sizeof( today_stamp[0] ) +
+        daily.capacity( )             * sizeof( daily[0] ) +
+        accumulated_debt.capacity( )  * sizeof( accumulated_debt[0] ) +
+        descriptions.capacity( )      * sizeof( descriptions[0] ) +
+        shard.capacity( )             * sizeof( shard[0] ) +
+        slot_of.capacity( )           * sizeof( slot_of[0] ) +
+        slots.capacity( )             * sizeof( slots[0] ) +
+        id_index.capacity( )          * sizeof( id_index[0] ) +
+        daily_slots.capacity( )       * sizeof( daily_slots[0] );
+
+    // Each owned description is a separate allocation, which also costs the allocator a header
+    // and rounding up (typically to 16 bytes).
+    for( const TaskDescription &text : descriptions ) {
+        if( text.is_owned( ) ) total += ( text.size( ) + sizeof( void * ) + 15 ) / 16 * 16;
+    }
+    return total;
+}
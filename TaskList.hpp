@@ -0,0 +1,290 @@
+/*! \file    TaskList.hpp
+ *  \brief   Column oriented storage for the task list.
+ *  \author  Peter C. Chapin <pchapin@vtc.edu>
+ */
+
+#ifndef TASKLIST_HPP
+#define TASKLIST_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <ctime>
+#include <memory>
+#include <vector>
+
+#include "PixieTask.hpp"
+
+//! The task list, stored with one contiguous column per field.
+/*!
+ * Operations that apply to every task (see TaskKernels.hpp) only touch the columns they need
+ * instead of striding over complete task records. The columns are public; they must always
+ * have the same length. Individual tasks move into the list as PixieTask records. Fields with a
+ * small range are stored in narrow columns; see the limits below.
+ *
+ * Day changes are lazy so that they take the same time however long the list is. The debt column
+ * is relative to a workday epoch: the effective debt of a task is its stored debt plus its daily
+ * allocation for every workday charged since the epoch began (see debt( )). Likewise today's
+ * time only counts if the task's stamp matches the list's current day stamp (see today( )).
+ * Code that changes a task's debt, daily allocation, or time today must use the functions below.
+ *
+ * Each task has an ID that stays the same while the list is reordered. IDs lead to positions
+ * through a slot map: a hash table maps each ID to a slot, and the slot holds the task's current
+ * position. Reordering the list only updates the slots of the tasks that moved. Slots of deleted
+ * tasks go on a free list for reuse. Each slot has a generation that changes when its task is
+ * deleted, so a Handle (a slot and its generation) can't be mistaken for a later task in the
+ * same slot. Handles are cheaper to look up than IDs but only last while the list is loaded.
+ *
+ * The list can be stored in several files (shards); the shard column records which one holds
+ * each task. The numbers mean nothing to the list itself.
+ *
+ * Descriptions are read with description( ); the list keeps a TaskDescription for each task.
+ *
+ * Other threads read the list through snapshots (see snapshot( )). A snapshot refers to the
+ * description text of the list instead of copying it, so text that the list replaces or removes
+ * is retired instead of released: it is kept until every snapshot that might refer to it has
+ * been destroyed.
+ */
+class TaskList {
+public:
+    static const int max_priority = 99;         //!< Priorities range from 1 to max_priority. See clamped( ).
+    static const std::size_t npos = static_cast< std::size_t >( -1 );
+
+    //! Refers to a task wherever it moves in the list. See handle( ).
+    struct Handle {
+        std::uint32_t slot;
+        std::uint32_t generation;
+    };
+
+    std::vector< std::time_t >     start_time;
+    std::vector< std::uint8_t >    priority;
+    std::vector< int >             accumulated;
+    std::vector< int >             accumulated_today;  //!< Only current where today_stamp matches; see today( ).
+    std::vector< std::uint32_t >   today_stamp;        //!< Day stamp of each task's accumulated_today.
+    std::vector< int >             daily;
+    std::vector< int >             accumulated_debt;   //!< Relative to the workday epoch; see debt( ).
+    std::vector< std::uint16_t >   shard;              //!< The file each task is stored in.
+
+    TaskList( ) = default;
+    TaskList( const TaskList & ) = delete;
+    TaskList &operator=( const TaskList & ) = delete;
+   ~TaskList( );
+
+    std::size_t size( ) const noexcept { return priority.size( ); }
+    bool empty( ) const noexcept { return priority.empty( ); }
+
+    void clear( ) noexcept;
+    void reserve( std::size_t count );
+
+    //! Returns the description of the task at the given position.
+    /*!
+     * The result refers to text kept by the list. It can be used until the task is renamed or
+     * removed or the list is cleared.
+     */
+    TaskDescription description( std::size_t position ) const noexcept
+    {
+        TaskDescription result;
+        result.assign_mapped( descriptions[position].data( ), descriptions[position].size( ) );
+        return result;
+    }
+
+    //! Moves the description of the task at the given position out of the list.
+    /*!
+     * The task is left with an empty description.
+     */
+    TaskDescription take_description( std::size_t position ) noexcept;
+
+    //! Returns the ID of the task at the given position.
+    TaskId id( std::size_t position ) const noexcept { return slots[slot_of[position]].id; }
+
+    //! Returns the position of the task with the given ID, or npos if there is no such task.
+    std::size_t find( TaskId task_id ) const noexcept;
+
+    //! Returns a handle to the task at the given position.
+    Handle handle( std::size_t position ) const noexcept
+    {
+        const std::uint32_t slot = slot_of[position];
+        return Handle{ slot, slots[slot].generation };
+    }
+
+    //! Returns the position of the task with the given handle, or npos if that task has been removed.
+    std::size_t find( Handle task ) const noexcept
+    {
+        if( task.slot >= slots.size( ) ) return npos;
+        const Slot &slot = slots[task.slot];
+        return ( slot.generation == task.generation && slot.id != 0 ) ? slot.position : npos;
+    }
+
+    //! Returns the ID that the next new task will get.
+    TaskId next_id( ) const noexcept { return next_task_id; }
+
+    //! Makes sure that IDs given to new tasks are at least the given value.
+    /*!
+     * Used when loading a list so that the IDs of tasks deleted earlier are not reused.
+     */
+    void reserve_ids( TaskId first_free ) noexcept { if( first_free > next_task_id ) next_task_id = first_free; }
+
+    //! Returns the minutes spent today on the task at the given position.
+    int today( std::size_t position ) const noexcept
+    {
+        return ( today_stamp[position] == day_stamp ) ? accumulated_today[position] : 0;
+    }
+
+    //! Returns the minutes of attention the task at the given position requires (negative for a credit).
+    int debt( std::size_t position ) const noexcept
+    {
+        return accumulated_debt[position] + daily[position] * workday_epoch;
+    }
+
+    //! Returns the number of workdays charged to every task since the stored debts were last rebased.
+    int epoch( ) const noexcept { return workday_epoch; }
+
+    //! Adds minutes of work to the task at the given position. Only tasks with a daily allocation pay off debt.
+    void add_work( std::size_t position, int minutes ) noexcept;
+
+    //! Changes the daily allocation of the task at the given position, adjusting its debt to match.
+    /*!
+     * A task without a daily allocation has no debt.
+     */
+    void set_daily( std::size_t position, int new_daily );
+
+    //! Returns the number of tasks with a daily allocation.
+    std::size_t daily_count( ) const noexcept { return daily_slots.size( ); }
+
+    //! Returns the position of the i-th task with a daily allocation (they are in no particular order).
+    std::size_t daily_position( std::size_t i ) const noexcept { return slots[daily_slots[i]].position; }
+
+    //! Charges the given number of workdays (negative to refund them) to every task with a daily allocation.
+    void charge_workdays( int count ) noexcept;
+
+    //! Returns how many tasks given to push_back( ) or set( ) since clear( ) had a priority out of range.
+    /*!
+     * Such a priority is clamped to the nearest one in range. Old task files written by hand might
+     * hold one, and they must still load.
+     */
+    std::size_t clamped( ) const noexcept { return clamped_count; }
+
+    //! Clears the time spent today on every task.
+    void clear_today( ) noexcept { ++day_stamp; }
+
+    //! Appends a task, stored in the given shard, to the end of the list.
+    /*!
+     * The task keeps its ID unless it has none or the ID is already in use; then it gets a new one.
+     */
+    void push_back( PixieTask &&task, std::uint16_t task_shard = 0 );
+
+    //! Replaces the task at the given position. The task at that position keeps its ID and shard.
+    void set( std::size_t position, PixieTask &&task );
+
+    //! Replaces the description of the task at the given position with a copy of [first, last).
+    void rename( std::size_t position, const char *first, const char *last );
+
+    //! Removes the task at the given position. The last task moves into its place.
+    void erase( std::size_t position );
+
+    //! Removes the task at the given position. Later tasks move down one position.
+    /*!
+     * This takes time proportional to the number of later tasks; erase( ) takes constant time.
+     */
+    void erase_in_order( std::size_t position );
+
+    //! Rearranges the tasks in [first, last) so the task at position order[i - first] moves to position i.
+    /*!
+     * The order vector has an entry for each position in [first, last). Those entries must be a
+     * rearrangement of first .. last - 1.
+     */
+    void permute( const std::vector< std::size_t > &order, std::size_t first, std::size_t last );
+
+    //! Returns an immutable copy of the list that other threads can read while this list changes.
+    /*!
+     * Only the columns are copied. The snapshot may be destroyed by any thread.
+     */
+    std::shared_ptr< const TaskList > snapshot( );
+
+    //! Keeps storage that descriptions in snapshots might refer to until those snapshots are gone.
+    /*!
+     * Used for text kept outside of the list, such as a mapped task file that is replaced. The
+     * storage is released at once if no snapshot has been taken.
+     */
+    void retire_storage( std::shared_ptr< const void > storage );
+
+    //! Returns the number of bytes allocated for the columns and for the description text.
+    /*!
+     * Descriptions that are allocated separately include an estimate of the allocator's overhead.
+     */
+    std::size_t memory_used( ) const noexcept;
+
+private:
+    static const int max_epoch = 1 << 16;  //!< Larger epochs are folded into the debt column.
+    static const std::uint32_t no_slot = 0xFFFFFFFFU;
+
+    //! Where the task with a particular ID is. A free slot holds the next free slot instead.
+    struct Slot {
+        TaskId        id;          //!< Zero if the slot is free.
+        std::uint32_t position;    //!< Position of the task (or the next free slot).
+        std::uint32_t generation;  //!< Changes whenever the slot is freed.
+    };
+
+    std::vector< std::uint32_t > slot_of;   //!< The slot of the task at each position.
+    std::vector< Slot >          slots;
+    std::uint32_t                free_slot    = no_slot;  //!< First slot on the free list.
+    std::uint32_t                new_generation = 0;     //!< Generation of slots added from now on.
+    std::vector< std::uint32_t > id_index;  //!< Open addressing hash table of slot + 1; zero is empty.
+    std::size_t                  index_used   = 0;
+    TaskId                       next_task_id = 1;
+    std::vector< std::uint32_t > daily_slots;  //!< Slots of the tasks with a daily allocation. Not in snapshots.
+
+    int           workday_epoch = 0;
+    std::uint32_t day_stamp     = 0;
+    std::size_t   clamped_count = 0;
+
+    //! Keeps daily_slots up to date when the daily allocation of the task at the given position changes.
+    void note_daily( std::size_t position, int old_daily, int new_daily );
+
+    //! Narrows a priority for the priority column, clamping it (and counting it) if it's out of range.
+    std::uint8_t narrow_priority( int value ) noexcept;
+
+    std::vector< TaskDescription > descriptions;
+
+    //! Description text removed from the list while one snapshot was the most recent.
+    /*!
+     * A snapshot holds the generation that was started when it was taken; each generation holds
+     * the next one. Thus retired text lives until every snapshot taken before it was retired is gone.
+     */
+    struct RetiredText {
+        std::vector< std::unique_ptr< const char[] > > text;
+        std::vector< std::shared_ptr< const void > >   storage;  //!< See retire_storage( ).
+        std::shared_ptr< RetiredText > next;
+    };
+    std::shared_ptr< RetiredText > retired;  //!< Current generation. Null until the first snapshot.
+    std::shared_ptr< RetiredText > held;     //!< In a snapshot, keeps the text it refers to alive.
+
+    std::vector< std::time_t >     time_scratch;
+    std::vector< std::uint8_t >    byte_scratch;
+    std::vector< std::uint16_t >   short_scratch;
+    std::vector< std::uint32_t >   stamp_scratch;  // Also used for slot_of.
+    std::vector< int >             int_scratch;
+    std::vector< TaskDescription > description_scratch;
+
+    //! Gives a slot to the task with the given ID at the given position. Returns the slot.
+    std::uint32_t allocate_slot( TaskId task_id, std::size_t position );
+
+    //! Removes the task in the given slot from the hash table and puts the slot on the free list.
+    void release_slot( std::uint32_t slot ) noexcept;
+
+    //! Returns the slot in the hash table where the given ID is or would go.
+    std::size_t index_probe( TaskId task_id ) const noexcept;
+
+    //! Replaces the hash table with one that holds count IDs while at most half full.
+    void rebuild_index( std::size_t count );
+
+    //! Adds an entry to the hash table.
+    void index_insert( TaskId task_id, std::uint32_t slot );
+
+    //! Removes the entry for the given ID from the hash table.
+    void index_erase( TaskId task_id ) noexcept;
+
+    //! Keeps the text of a description that is about to be replaced if a snapshot might use it.
+    void retire( TaskDescription &old_description ) noexcept;
+};
+
+#endif
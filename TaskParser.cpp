@@ -0,0 +1,54 @@
+/*! \file    TaskParser.cpp
+ *  \brief   Parsing of task file and journal lines.
+ *  \author  Peter C. Chapin <pchapin@vtc.edu>
+ */
+
+#include <cstring>
+
+#include "TaskParser.hpp"
+
+using namespace std;
+
+bool parse_line( const char *first, const char *last, PixieTask &new_task, bool with_id )
+{
+    if( first != last && last[-1] == '\r' ) --last;
+
+    new_task.id = 0;
+    if( with_id ) {
+        long long task_id;
+        if( ( first = parse_integer( first, last, task_id ) ) == nullptr || task_id <= 0 ) return false;
+        new_task.id = static_cast< TaskId >( task_id );
+    }
+
+    if( ( first = parse_integer( first, last, new_task.start_time        ) ) == nullptr ) return false;
+    if( ( first = parse_integer( first, last, new_task.accumulated       ) ) == nullptr ) return false;
+    if( ( first = parse_integer( first, last, new_task.accumulated_today ) ) == nullptr ) return false;
+    if( ( first = parse_integer( first, last, new_task.daily             ) ) == nullptr ) return false;
+    if( ( first = parse_integer( first, last, new_task.priority          ) ) == nullptr ) return false;
+    if( ( first = parse_integer( first, last, new_task.accumulated_debt  ) ) == nullptr ) return false;
+
+    // The description is everything else on the line.
+    first = skip_blanks( first, last );
+    if( first == last ) return false;
+    new_task.description.assign( first, last );
+    return true;
+}
+
+
+const char *end_of_line( const char *first, const char *last ) noexcept
+{
+    const void *newline = memchr( first, '\n', static_cast< size_t >( last - first ) );
+    return ( newline == nullptr ) ? last : static_cast< const char * >( newline );
+}
+
+
+size_t count_lines( const char *first, const char *last ) noexcept
+{
+    size_t count = 0;
+    while( first != last ) {
+        first = end_of_line( first, last );
+        if( first != last ) ++first;
+        ++count;
+    }
+    return count;
+}
@@ -0,0 +1,75 @@
+/*! \file    TaskParser.hpp
+ *  \brief   Parsing of task file and journal lines.
+ *  \author  Peter C. Chapin <pchapin@vtc.edu>
+ *
+ * Lines are examined in place, usually inside a mapped file. None of these functions needs a null
+ * terminated string.
+ */
+
+#ifndef TASKPARSER_HPP
+#define TASKPARSER_HPP
+
+#include <cstddef>
+#include <limits>
+
+#include "PixieTask.hpp"
+
+//! Returns a pointer to the first character in [first, last) that is not a space or tab.
+inline const char *skip_blanks( const char *first, const char *last ) noexcept
+{
+    while( first != last && ( *first == ' ' || *first == '\t' ) ) ++first;
+    return first;
+}
+
+
+//! Parses a decimal integer that is terminated by a space, a tab, or the end of the text.
+/*!
+ * Leading white space is skipped. This function returns a pointer just past the integer or
+ * nullptr if there is no integer, if it is followed by something other than white space, or
+ * if it is out of range for the Integer type (which must be signed).
+ */
+template< typename Integer >
+const char *parse_integer( const char *first, const char *last, Integer &value ) noexcept
+{
+    const long long limit = std::numeric_limits< Integer >::max( );
+    long long result   = 0;
+    bool      negative = false;
+
+    first = skip_blanks( first, last );
+    if( first != last && ( *first == '-' || *first == '+' ) ) {
+        negative = ( *first == '-' );
+        ++first;
+    }
+    const char *digits = first;
+    while( first != last && *first >= '0' && *first <= '9' ) {
+        const int digit = *first - '0';
+        if( result > ( limit - digit ) / 10 ) return nullptr;
+        result = 10 * result + digit;
+        ++first;
+    }
+    if( first == digits ) return nullptr;
+    if( first != last && *first != ' ' && *first != '\t' ) return nullptr;
+
+    value = static_cast< Integer >( negative ? -result : result );
+    return first;
+}
+
+
+//! Parse a line from the task file.
+/*!
+ * This function locates the start time, accumulated time, priority, and task description in
+ * the line [first, last) and uses that information to load up the given task object. If with_id
+ * is true the line starts with the task's ID (task files written before IDs existed have none).
+ * The line is examined in place; the only memory allocated is for the description. This
+ * function returns true if it is successful, and false otherwise. (XML task files are read
+ * by read_task_xml( ) instead.)
+ */
+bool parse_line( const char *first, const char *last, PixieTask &new_task, bool with_id = false );
+
+//! Returns the end of the line starting at first (the position of its '\n' or last).
+const char *end_of_line( const char *first, const char *last ) noexcept;
+
+//! Counts the lines in [first, last). A final line without a '\n' counts.
+std::size_t count_lines( const char *first, const char *last ) noexcept;
+
+#endif
@@ -0,0 +1,268 @@
+/*! \file    TaskRenderer.cpp
+ *  \brief   Formatting of the task list for display.
+ *  \author  Peter C. Chapin <pchapin@vtc.edu>
+ */
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <streambuf>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/ioctl.h>
+#include <unistd.h>
+#define PIXIE_HAVE_TERMINAL
+#endif
+
+#include "TaskKernels.hpp"
+#include "TaskRenderer.hpp"
+
+using namespace std;
+
+//! Passes output on to another stream buffer, counting the lines.
+class LineCounter : public streambuf {
+public:
+    explicit LineCounter( streambuf *target ) noexcept : target( target ) { }
+
+    streambuf *original( ) const noexcept { return target; }
+    unsigned long lines( ) const noexcept { return line_count; }
+
+protected:
+    int_type overflow( int_type ch ) override
+    {
+        if( traits_type::eq_int_type( ch, traits_type::eof( ) ) ) return traits_type::not_eof( ch );
+        if( traits_type::to_char_type( ch ) == '\n' ) ++line_count;
+        return target->sputc( traits_type::to_char_type( ch ) );
+    }
+
+    streamsize xsputn( const char *text, streamsize count ) override
+    {
+        line_count += static_cast< unsigned long >( std::count( text, text + count, '\n' ) );
+        return target->sputn( text, count );
+    }
+
+    int sync( ) override
+    {
+        return target->pubsync( );
+    }
+
+private:
+    streambuf    *target;
+    unsigned long line_count = 0;
+};
+
+namespace {
+
+    //! Appends a number, right aligned in a field of the given width.
+    void append_number( string &buffer, long long value, int width )
+    {
+        char  digits[24];
+        char *const end = digits + sizeof( digits );
+        char *start = end;
+        unsigned long long magnitude =
+            ( value < 0 ) ? 0ULL - static_cast< unsigned long long >( value ) : static_cast< unsigned long long >( value );
+        do {
+            *--start = static_cast< char >( '0' + magnitude % 10 );
+            magnitude /= 10;
+        } while( magnitude != 0 );
+        if( value < 0 ) *--start = '-';
+
+        if( end - start < width ) buffer.append( static_cast< size_t >( width - ( end - start ) ), ' ' );
+        buffer.append( start, end );
+    }
+
+    //! Returns the offset at which the text of a row reaches the given number of columns.
+    /*!
+     * Bytes that continue a UTF-8 character don't occupy a column.
+     */
+    size_t column_limit( const char *row, size_t size, size_t columns ) noexcept
+    {
+        size_t used = 0;
+        for( size_t i = 0; i < size; ++i ) {
+            if( ( static_cast< unsigned char >( row[i] ) & 0xC0 ) == 0x80 ) continue;
+            if( used == columns ) return i;
+            ++used;
+        }
+        return size;
+    }
+
+    //! Gets the size of the terminal. Returns false if it isn't known.
+    bool terminal_size( size_t &width, size_t &height ) noexcept
+    {
+#if defined(PIXIE_HAVE_TERMINAL)
+        winsize size;
+        if( ioctl( STDOUT_FILENO, TIOCGWINSZ, &size ) == 0 && size.ws_col != 0 && size.ws_row != 0 ) {
+            width  = size.ws_col;
+            height = size.ws_row;
+            return true;
+        }
+#endif
+        (void)width;
+        (void)height;
+        return false;
+    }
+
+    //! Appends an escape sequence that moves the cursor to the start of the given line (one based).
+    void append_move( string &buffer, size_t line )
+    {
+        buffer += "\x1b[";
+        append_number( buffer, static_cast< long long >( line ), 0 );
+        buffer += ";1H";
+    }
+
+}
+
+
+TaskRenderer::TaskRenderer( ) = default;
+
+
+TaskRenderer::~TaskRenderer( )
+{
+    set_redraw( false );
+}
+
+
+bool TaskRenderer::set_redraw( bool enabled )
+{
+    if( enabled == redraw ) return true;
+    if( enabled ) {
+#if defined(PIXIE_HAVE_TERMINAL)
+        if( !isatty( STDOUT_FILENO ) ) return false;
+        counter.reset( new LineCounter( cout.rdbuf( ) ) );
+        cout.rdbuf( counter.get( ) );
+        redraw       = true;
+        screen_valid = false;
+        return true;
+#else
+        return false;
+#endif
+    }
+
+    cout.rdbuf( counter->original( ) );
+    counter.reset( );
+    redraw = false;
+    return true;
+}
+
+
+void TaskRenderer::format_rows( const TaskList &task_list, size_t first, size_t count, size_t width )
+{
+    const long long total_priority_value = total_priority( task_list );
+    const size_t    last = min( task_list.size( ), first + count );
+
+    frame.clear( );
+    row_ends.clear( );
+    for( size_t i = first; i < last; ++i ) {
+        const size_t row_start = frame.size( );
+
+        append_number( frame, static_cast< long long >( i + 1 ), 2 );
+        frame += ( task_list.start_time[i] != 0 ) ? ") * " : ")   ";
+        frame += "time=";
+        append_number( frame, task_list.accumulated[i], 4 );
+        frame += '/';
+        append_number( frame, task_list.debt( i ), 4 );    // Could be negative.
+        frame += ", today=";
+        append_number( frame, task_list.today( i ), 3 );
+        frame += '/';
+        append_number( frame, task_list.daily[i], 3 );
+        frame += ", prio=";
+        append_number( frame, task_list.priority[i], 2 );
+
+        char percent[32];
+        const int percent_size = snprintf( percent, sizeof( percent ), " (%5.1f%%), ",
+            100 * static_cast< double >( task_list.priority[i] ) / total_priority_value );
+        frame.append( percent, static_cast< size_t >( percent_size ) );
+        frame.append( task_list.description( i ).data( ), task_list.description( i ).size( ) );
+
+        // Rows on the screen must not wrap or the cursor positions would be wrong.
+        if( width != 0 ) {
+            frame.resize( row_start + column_limit( frame.data( ) + row_start, frame.size( ) - row_start, width - 1 ) );
+        }
+        frame += '\n';
+        row_ends.push_back( frame.size( ) );
+    }
+
+    if( first != 0 || last != task_list.size( ) ) {
+        frame += "(tasks ";
+        append_number( frame, static_cast< long long >( min( first + 1, last ) ), 0 );
+        frame += '-';
+        append_number( frame, static_cast< long long >( last ), 0 );
+        frame += " of ";
+        append_number( frame, static_cast< long long >( task_list.size( ) ), 0 );
+        frame += ")\n";
+        row_ends.push_back( frame.size( ) );
+    }
+}
+
+
+void TaskRenderer::write_changes( size_t height )
+{
+    const size_t rows = row_ends.size( );
+
+    // Text written since the last frame (the output of a command, for example) is left visible:
+    // the rows are written after it and the screen is redrawn completely the next time.
+    const unsigned long lines_since = counter->lines( ) - lines_at_frame;
+    if( lines_since != 0 ) {
+        cout.write( frame.data( ), static_cast< streamsize >( frame.size( ) ) );
+        cout.flush( );
+        lines_at_frame = counter->lines( );
+        screen_valid = false;
+        return;
+    }
+
+    output.clear( );
+    if( !screen_valid ) {
+        output += "\x1b[H\x1b[2J";
+        output += frame;
+    }
+    else {
+        size_t row_start = 0;
+        for( size_t i = 0; i < rows; ++i ) {
+            const size_t row_size = row_ends[i] - row_start;
+            bool unchanged = false;
+            if( i < shown_ends.size( ) ) {
+                const size_t shown_start = ( i == 0 ) ? 0 : shown_ends[i - 1];
+                unchanged = ( shown_ends[i] - shown_start == row_size &&
+                    memcmp( shown.data( ) + shown_start, frame.data( ) + row_start, row_size ) == 0 );
+            }
+            if( !unchanged ) {
+                append_move( output, i + 1 );
+                output.append( frame, row_start, row_size - 1 );
+                output += "\x1b[K";
+            }
+            row_start = row_ends[i];
+        }
+        append_move( output, rows + 1 );
+    }
+    output += "\x1b[J";
+
+    cout.write( output.data( ), static_cast< streamsize >( output.size( ) ) );
+    cout.flush( );
+    lines_at_frame = counter->lines( );
+
+    // The rows, the prompt line, and the line on which the next command is typed must fit on the
+    // screen for the rows to stay where they were drawn.
+    screen_valid = ( rows + 2 <= height );
+    shown.swap( frame );
+    shown_ends.swap( row_ends );
+}
+
+
+void TaskRenderer::render( const TaskList &task_list, size_t first, size_t count )
+{
+    size_t width  = 0;
+    size_t height = 0;
+    if( redraw && !terminal_size( width, height ) ) {
+        width  = 80;
+        height = 24;
+    }
+
+    format_rows( task_list, first, count, width );
+    if( redraw ) {
+        write_changes( height );
+        return;
+    }
+    cout.write( frame.data( ), static_cast< streamsize >( frame.size( ) ) );
+    cout.flush( );
+}
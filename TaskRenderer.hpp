@@ -0,0 +1,56 @@
+/*! \file    TaskRenderer.hpp
+ *  \brief   Formatting of the task list for display.
+ *  \author  Peter C. Chapin <pchapin@vtc.edu>
+ */
+
+#ifndef TASKRENDERER_HPP
+#define TASKRENDERER_HPP
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "TaskList.hpp"
+
+class LineCounter;
+
+//! Writes rows of the task list to cout.
+/*!
+ * Every row is formatted into one buffer that is reused from one display to the next, and the
+ * buffer is written with a single call. In redraw mode the renderer assumes that it owns the top
+ * of an ANSI terminal: it remembers the rows on the screen and rewrites only those that changed.
+ * Lines written to cout by anything else are counted so that the screen is redrawn completely
+ * if they might have scrolled it.
+ */
+class TaskRenderer {
+public:
+    TaskRenderer( );
+    ~TaskRenderer( );
+
+    TaskRenderer( const TaskRenderer & ) = delete;
+    TaskRenderer &operator=( const TaskRenderer & ) = delete;
+
+    //! Turns redraw mode on or off. Returns false if the standard output isn't a terminal.
+    bool set_redraw( bool enabled );
+
+    //! Displays count tasks starting at position first. The other tasks are only counted.
+    void render( const TaskList &task_list, std::size_t first, std::size_t count );
+
+private:
+    std::string                frame;       //!< Rows being displayed, each ending with a newline.
+    std::vector< std::size_t > row_ends;    //!< Offset just past each row in frame.
+    std::string                shown;       //!< Rows on the screen (redraw mode).
+    std::vector< std::size_t > shown_ends;
+    std::string                output;      //!< What is written in redraw mode.
+
+    bool          redraw       = false;
+    bool          screen_valid = false;     //!< True if the screen still holds the shown rows.
+    std::unique_ptr< LineCounter > counter; //!< Installed in cout in redraw mode.
+    unsigned long lines_at_frame = 0;       //!< Line count just after the last frame was written.
+
+    void format_rows( const TaskList &task_list, std::size_t first, std::size_t count, std::size_t width );
+    void write_changes( std::size_t height );
+};
+
+#endif
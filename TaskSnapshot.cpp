@@ -0,0 +1,200 @@
+/*! \file    TaskSnapshot.cpp
+ *  \brief   Binary task file format.
+ *  \author  Peter C. Chapin <pchapin@vtc.edu>
+ *
+ * A snapshot consists of a header, an array of fixed size records holding the numeric fields of
+ * each task, and a string table holding the descriptions. All values are stored in the byte
+ * order of the machine that wrote the file; a marker in the header lets a reader on a machine
+ * with a different byte order reject the file rather than misread it.
+ *
+ * Version 2 added task IDs at the end of the header and of each record. Version 1 snapshots are
+ * still read; their tasks are given new IDs.
+ */
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <sstream>
+#include <string>
+#include <utility>
+
+#include "TaskSnapshot.hpp"
+
+using namespace std;
+
+namespace {
+
+    const char          snapshot_magic[8] = { 'P', 'I', 'X', 'I', 'E', 'S', 'N', 'P' };
+    const std::uint32_t snapshot_version  = 2;
+    const std::size_t   version_1_header  = 72;  //!< Size of the header in version 1.
+    const std::size_t   version_1_record  = 40;  //!< Size of a record in version 1.
+    const std::uint32_t byte_order_marker = 0x01020304;
+
+    struct SnapshotHeader {
+        char          magic[8];
+        std::uint32_t version;
+        std::uint32_t byte_order;
+        char          date[32];     //!< Text form of the file date, NUL padded.
+        std::uint64_t sequence;     //!< Last journal record included in the snapshot.
+        std::uint64_t task_count;
+        std::uint64_t strings_size; //!< Size of the string table in bytes.
+        std::uint64_t next_id;      //!< ID of the next new task.
+    };
+
+    struct SnapshotRecord {
+        std::int64_t  start_time;
+        std::int32_t  priority;
+        std::int32_t  accumulated;
+        std::int32_t  accumulated_today;
+        std::int32_t  daily;
+        std::int32_t  accumulated_debt;
+        std::uint32_t description_offset; //!< Offset of the description in the string table.
+        std::uint32_t description_size;
+        std::uint32_t reserved;
+        std::uint64_t id;
+    };
+
+    static_assert( sizeof( SnapshotHeader ) == 80, "Unexpected padding in SnapshotHeader" );
+    static_assert( sizeof( SnapshotRecord ) == 48, "Unexpected padding in SnapshotRecord" );
+
+}
+
+
+bool is_task_snapshot( const MappedFile &file ) noexcept
+{
+    return file.size( ) >= sizeof( snapshot_magic ) &&
+           memcmp( file.begin( ), snapshot_magic, sizeof( snapshot_magic ) ) == 0;
+}
+
+
+bool read_task_snapshot( const MappedFile &file,
+                         spica::Date &file_date,
+                         unsigned long long &sequence,
+                         TaskList &task_list,
+                         const char *&error )
+{
+    SnapshotHeader header;
+
+    if( !is_task_snapshot( file ) || file.size( ) < version_1_header ) {
+        error = "not a task snapshot";
+        return false;
+    }
+    memset( &header, 0, sizeof( header ) );
+    memcpy( &header, file.begin( ), version_1_header );
+    if( header.byte_order != byte_order_marker ) {
+        error = "written on a machine with a different byte order";
+        return false;
+    }
+    if( header.version != 1 && header.version != snapshot_version ) {
+        error = "unsupported snapshot version";
+        return false;
+    }
+    const std::size_t header_size = ( header.version == 1 ) ? version_1_header : sizeof( SnapshotHeader );
+    const std::size_t record_size = ( header.version == 1 ) ? version_1_record : sizeof( SnapshotRecord );
+    if( file.size( ) < header_size ) {
+        error = "truncated or damaged snapshot";
+        return false;
+    }
+    memcpy( &header, file.begin( ), header_size );
+
+    // Check the sizes before touching any records. The counts come from the file and can't be trusted.
+    const std::uint64_t available = file.size( ) - header_size;
+    if( header.task_count > available / record_size ||
+        header.strings_size != available - header.task_count * record_size ) {
+        error = "truncated or damaged snapshot";
+        return false;
+    }
+
+    header.date[sizeof( header.date ) - 1] = '\0';
+    istringstream date_text( header.date );
+    if( !( date_text >> file_date ) ) {
+        error = "bad date";
+        return false;
+    }
+    sequence = header.sequence;
+
+    const char *records = file.begin( ) + header_size;
+    const char *strings = records + header.task_count * record_size;
+
+    task_list.reserve( task_list.size( ) + static_cast< size_t >( header.task_count ) );
+    task_list.reserve_ids( header.next_id );
+    for( std::uint64_t i = 0; i < header.task_count; ++i ) {
+        SnapshotRecord record;
+        memset( &record, 0, sizeof( record ) );
+        memcpy( &record, records + i * record_size, record_size );
+        if( static_cast< std::uint64_t >( record.description_offset ) + record.description_size > header.strings_size ) {
+            error = "description outside of the string table";
+            return false;
+        }
+
+        PixieTask new_task;
+        new_task.id                = record.id;
+        new_task.start_time        = static_cast< time_t >( record.start_time );
+        new_task.priority          = record.priority;
+        new_task.accumulated       = record.accumulated;
+        new_task.accumulated_today = record.accumulated_today;
+        new_task.daily             = record.daily;
+        new_task.accumulated_debt  = record.accumulated_debt;
+        new_task.description.assign_mapped( strings + record.description_offset, record.description_size );
+        task_list.push_back( std::move( new_task ) );
+    }
+    return true;
+}
+
+
+bool write_task_snapshot( ostream &output,
+                          const spica::Date &file_date,
+                          unsigned long long sequence,
+                          const TaskList &task_list,
+                          std::uint16_t shard )
+{
+    SnapshotHeader header;
+    memset( &header, 0, sizeof( header ) );
+    memcpy( header.magic, snapshot_magic, sizeof( snapshot_magic ) );
+    header.version    = snapshot_version;
+    header.byte_order = byte_order_marker;
+    header.sequence   = sequence;
+    header.task_count = static_cast< std::uint64_t >( count( task_list.shard.begin( ), task_list.shard.end( ), shard ) );
+    header.next_id    = task_list.next_id( );
+
+    ostringstream date_text;
+    date_text << file_date;
+    const string date_string = date_text.str( );
+    if( date_string.size( ) >= sizeof( header.date ) ) return false;
+    memcpy( header.date, date_string.data( ), date_string.size( ) );
+
+    std::uint64_t strings_size = 0;
+    for( size_t i = 0; i < task_list.size( ); ++i ) {
+        if( task_list.shard[i] != shard ) continue;
+        strings_size += task_list.description( i ).size( );
+    }
+    if( strings_size > numeric_limits< std::uint32_t >::max( ) ) return false;
+    header.strings_size = strings_size;
+
+    output.write( reinterpret_cast< const char * >( &header ), sizeof( header ) );
+
+    std::uint32_t offset = 0;
+    for( size_t i = 0; i < task_list.size( ); ++i ) {
+        if( task_list.shard[i] != shard ) continue;
+        SnapshotRecord record;
+        record.start_time         = task_list.start_time[i];
+        record.priority           = task_list.priority[i];
+        record.accumulated        = task_list.accumulated[i];
+        record.accumulated_today  = task_list.today( i );
+        record.daily              = task_list.daily[i];
+        record.accumulated_debt   = task_list.debt( i );
+        record.description_offset = offset;
+        record.description_size   = static_cast< std::uint32_t >( task_list.description( i ).size( ) );
+        record.reserved           = 0;
+        record.id                 = task_list.id( i );
+        output.write( reinterpret_cast< const char * >( &record ), sizeof( record ) );
+        offset += record.description_size;
+    }
+
+    for( size_t i = 0; i < task_list.size( ); ++i ) {
+        if( task_list.shard[i] != shard ) continue;
+        output.write( task_list.description( i ).data( ), task_list.description( i ).size( ) );
+    }
+    return static_cast< bool >( output );
+}
@@ -0,0 +1,38 @@
+/*! \file    TaskSnapshot.hpp
+ *  \brief   Binary task file format.
+ *  \author  Peter C. Chapin <pchapin@vtc.edu>
+ */
+
+#ifndef TASKSNAPSHOT_HPP
+#define TASKSNAPSHOT_HPP
+
+#include <cstdint>
+#include <ostream>
+
+#include "Date.hpp"
+#include "MappedFile.hpp"
+#include "TaskList.hpp"
+
+//! Returns true if the mapped file contains a binary task snapshot.
+bool is_task_snapshot( const MappedFile &file ) noexcept;
+
+//! Loads the tasks in a mapped binary snapshot.
+/*!
+ * The descriptions are not copied; each task refers to its description in the mapped file, so
+ * the file must stay mapped for as long as the tasks are in use. Returns false (and explains in
+ * error) if the snapshot is damaged or was written by an incompatible version of Pixie.
+ */
+bool read_task_snapshot( const MappedFile &file,
+                         spica::Date &file_date,
+                         unsigned long long &sequence,
+                         TaskList &task_list,
+                         const char *&error );
+
+//! Writes the tasks in one shard of a list (see TaskList::shard) as a binary snapshot.
+bool write_task_snapshot( std::ostream &output,
+                          const spica::Date &file_date,
+                          unsigned long long sequence,
+                          const TaskList &task_list,
+                          std::uint16_t shard = 0 );
+
+#endif
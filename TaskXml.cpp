@@ -0,0 +1,684 @@
+/*! \file    TaskXml.cpp
+ *  \brief   XML task file format.
+ *  \author  Peter C. Chapin <pchapin@vtc.edu>
+ *
+ * An XML task file has a root element named pixie holding one task element for each task. The
+ * attributes of a task element are the numbers found on a line of the text format, so the two
+ * formats convert into each other without loss:
+ *
+ *     <?xml version="1.0" encoding="UTF-8"?>
+ *     <pixie version="1" date="..." sequence="12" next-id="4">
+ *       <task id="3" start="0" accumulated="95" today="20" daily="30" priority="50" debt="-5"><description>Write the report</description></task>
+ *     </pixie>
+ *
+ * The parser is a small event driven (SAX style) reader that works on the mapped file in place.
+ * It supports the parts of XML a task file needs: elements, attributes, character references,
+ * CDATA sections, comments, and processing instructions. A document type declaration is
+ * skipped, so entities defined there are not available.
+ */
+
+#include <algorithm>
+#include <cstring>
+#include <sstream>
+#include <vector>
+
+#include "TaskParser.hpp"
+#include "TaskXml.hpp"
+
+using namespace std;
+
+namespace {
+
+    const char *const xml_declaration = "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n";
+    const std::size_t max_attributes  = 16;   //!< Most attributes an element may have.
+    const std::size_t max_depth       = 256;  //!< Deepest nesting of elements allowed.
+
+    //! An attribute in a start tag. The value still contains any character references.
+    struct XmlAttribute {
+        const char *name;
+        std::size_t name_size;
+        const char *value;
+        std::size_t value_size;
+    };
+
+
+    bool is_space( char ch ) noexcept
+    {
+        return ch == ' ' || ch == '\t' || ch == '\n' || ch == '\r';
+    }
+
+
+    const char *skip_spaces( const char *first, const char *last ) noexcept
+    {
+        while( first != last && is_space( *first ) ) ++first;
+        return first;
+    }
+
+
+    //! Returns the end of the name starting at first.
+    const char *scan_name( const char *first, const char *last ) noexcept
+    {
+        while( first != last && !is_space( *first ) &&
+               *first != '>' && *first != '/' && *first != '=' && *first != '<' ) ++first;
+        return first;
+    }
+
+
+    bool equal( const char *text, std::size_t size, const char *name ) noexcept
+    {
+        return strlen( name ) == size && memcmp( text, name, size ) == 0;
+    }
+
+
+    bool starts_with( const char *first, const char *last, const char *prefix ) noexcept
+    {
+        const std::size_t size = strlen( prefix );
+        return static_cast< std::size_t >( last - first ) >= size && memcmp( first, prefix, size ) == 0;
+    }
+
+
+    //! Returns the first occurrence of pattern in [first, last), or last if there is none.
+    const char *find_text( const char *first, const char *last, const char *pattern ) noexcept
+    {
+        const std::size_t size = strlen( pattern );
+        while( static_cast< std::size_t >( last - first ) >= size ) {
+            const void *start = memchr( first, pattern[0], static_cast< std::size_t >( last - first ) - size + 1 );
+            if( start == nullptr ) break;
+            first = static_cast< const char * >( start );
+            if( memcmp( first, pattern, size ) == 0 ) return first;
+            ++first;
+        }
+        return last;
+    }
+
+
+    void append_utf8( unsigned long code, string &text )
+    {
+        if( code < 0x80 ) {
+            text += static_cast< char >( code );
+        }
+        else if( code < 0x800 ) {
+            text += static_cast< char >( 0xC0 | ( code >> 6 ) );
+            text += static_cast< char >( 0x80 | ( code & 0x3F ) );
+        }
+        else if( code < 0x10000 ) {
+            text += static_cast< char >( 0xE0 | ( code >> 12 ) );
+            text += static_cast< char >( 0x80 | ( ( code >> 6 ) & 0x3F ) );
+            text += static_cast< char >( 0x80 | ( code & 0x3F ) );
+        }
+        else {
+            text += static_cast< char >( 0xF0 | ( code >> 18 ) );
+            text += static_cast< char >( 0x80 | ( ( code >> 12 ) & 0x3F ) );
+            text += static_cast< char >( 0x80 | ( ( code >> 6 ) & 0x3F ) );
+            text += static_cast< char >( 0x80 | ( code & 0x3F ) );
+        }
+    }
+
+
+    //! Appends the character data [first, last) to text, replacing references. Returns false for a bad reference.
+    bool append_text( const char *first, const char *last, string &text )
+    {
+        while( first != last ) {
+            const char *reference = static_cast< const char * >( memchr( first, '&', static_cast< std::size_t >( last - first ) ) );
+            if( reference == nullptr ) {
+                text.append( first, last );
+                return true;
+            }
+            text.append( first, reference );
+
+            const char *name = reference + 1;
+            const char *end  = static_cast< const char * >( memchr( name, ';', static_cast< std::size_t >( last - name ) ) );
+            if( end == nullptr ) return false;
+            const std::size_t size = static_cast< std::size_t >( end - name );
+            if     ( equal( name, size, "amp"  ) ) text += '&';
+            else if( equal( name, size, "lt"   ) ) text += '<';
+            else if( equal( name, size, "gt"   ) ) text += '>';
+            else if( equal( name, size, "quot" ) ) text += '"';
+            else if( equal( name, size, "apos" ) ) text += '\'';
+            else if( size >= 2 && name[0] == '#' ) {
+                const bool hexadecimal = ( name[1] == 'x' );
+                const char *digit = name + ( hexadecimal ? 2 : 1 );
+                if( digit == end ) return false;
+                unsigned long code = 0;
+                for( ; digit != end; ++digit ) {
+                    int value;
+                    if( *digit >= '0' && *digit <= '9' ) value = *digit - '0';
+                    else if( hexadecimal && *digit >= 'a' && *digit <= 'f' ) value = *digit - 'a' + 10;
+                    else if( hexadecimal && *digit >= 'A' && *digit <= 'F' ) value = *digit - 'A' + 10;
+                    else return false;
+                    code = code * ( hexadecimal ? 16 : 10 ) + static_cast< unsigned long >( value );
+                    if( code > 0x10FFFF ) return false;
+                }
+                if( code == 0 ) return false;
+                append_utf8( code, text );
+            }
+            else {
+                return false;
+            }
+            first = end + 1;
+        }
+        return true;
+    }
+
+
+    //! Reads an XML document as a stream of events, calling the handler for each.
+    /*!
+     * The handler has the members below. Each returns null to continue or an error message to
+     * stop the parse.
+     *
+     *     start_element( const char *tag, const char *name, std::size_t name_size,
+     *                    const XmlAttribute *attributes, std::size_t attribute_count )
+     *     end_element( const char *name, std::size_t name_size, const char *tag_end )
+     *     text( const char *first, const char *last, bool literal )
+     *
+     * The tag is the position of the '<' that starts an element and tag_end is just past the
+     * '>' that ends it, so the element is [tag, tag_end) in the document. An empty element tag
+     * produces both a start and an end event. Literal text comes from a CDATA section and has no
+     * references to replace. Only the names of the open elements are remembered, so memory use
+     * doesn't depend on the size of the document. On an error the function returns false with
+     * where set to the position of the problem.
+     */
+    template< typename Handler >
+    bool parse_xml( const char *first, const char *last, Handler &handler, const char *&where, const char *&message )
+    {
+        struct OpenElement {
+            const char *name;
+            std::size_t name_size;
+        };
+        vector< OpenElement > open;
+        XmlAttribute attributes[max_attributes];
+        bool root_seen = false;
+
+        // Skip a UTF-8 byte order mark.
+        const char *current = first;
+        if( starts_with( current, last, "\xEF\xBB\xBF" ) ) current += 3;
+
+        message = nullptr;
+        while( current != last ) {
+            where = current;
+
+            // Character data.
+            if( *current != '<' ) {
+                const void *next_tag = memchr( current, '<', static_cast< std::size_t >( last - current ) );
+                const char *text_end = ( next_tag == nullptr ) ? last : static_cast< const char * >( next_tag );
+                if( open.empty( ) ) {
+                    where = skip_spaces( current, text_end );
+                    if( where != text_end ) message = "text outside of the root element";
+                }
+                else {
+                    message = handler.text( current, text_end, false );
+                }
+                if( message != nullptr ) return false;
+                current = text_end;
+                continue;
+            }
+
+            // Markup other than elements.
+            if( starts_with( current, last, "<?" ) ) {
+                const char *end = find_text( current, last, "?>" );
+                if( end == last ) { message = "unterminated processing instruction"; return false; }
+                current = end + 2;
+                continue;
+            }
+            if( starts_with( current, last, "<!--" ) ) {
+                const char *end = find_text( current, last, "-->" );
+                if( end == last ) { message = "unterminated comment"; return false; }
+                current = end + 3;
+                continue;
+            }
+            if( starts_with( current, last, "<![CDATA[" ) ) {
+                const char *end = find_text( current, last, "]]>" );
+                if( end == last ) { message = "unterminated CDATA section"; return false; }
+                if( open.empty( ) ) { message = "text outside of the root element"; return false; }
+                if( ( message = handler.text( current + 9, end, true ) ) != nullptr ) return false;
+                current = end + 3;
+                continue;
+            }
+            if( starts_with( current, last, "<!" ) ) {
+                // A document type declaration, which might have an internal subset in brackets.
+                int brackets = 0;
+                for( ++current; current != last && ( *current != '>' || brackets > 0 ); ++current ) {
+                    if( *current == '[' ) ++brackets;
+                    if( *current == ']' ) --brackets;
+                }
+                if( current == last ) { message = "unterminated declaration"; return false; }
+                ++current;
+                continue;
+            }
+
+            // End tags.
+            if( starts_with( current, last, "</" ) ) {
+                const char *name     = current + 2;
+                const char *name_end = scan_name( name, last );
+                const char *close    = skip_spaces( name_end, last );
+                const std::size_t name_size = static_cast< std::size_t >( name_end - name );
+                if( close == last || *close != '>' ) { message = "malformed end tag"; return false; }
+                if( open.empty( ) || open.back( ).name_size != name_size ||
+                    memcmp( open.back( ).name, name, name_size ) != 0 ) {
+                    message = "end tag doesn't match the start tag";
+                    return false;
+                }
+                open.pop_back( );
+                current = close + 1;
+                if( ( message = handler.end_element( name, name_size, current ) ) != nullptr ) return false;
+                continue;
+            }
+
+            // Start tags.
+            const char *tag      = current;
+            const char *name     = current + 1;
+            const char *name_end = scan_name( name, last );
+            const std::size_t name_size = static_cast< std::size_t >( name_end - name );
+            if( name_size == 0 ) { message = "malformed tag"; return false; }
+            if( open.empty( ) && root_seen ) { message = "more than one root element"; return false; }
+
+            std::size_t attribute_count = 0;
+            bool empty = false;
+            current = name_end;
+            for( ;; ) {
+                const char *next = skip_spaces( current, last );
+                where = next;
+                if( next == last ) { message = "unterminated tag"; return false; }
+                if( *next == '>' ) {
+                    current = next + 1;
+                    break;
+                }
+                if( *next == '/' ) {
+                    if( next + 1 == last || next[1] != '>' ) { message = "malformed tag"; return false; }
+                    empty = true;
+                    current = next + 2;
+                    break;
+                }
+                if( next == current ) { message = "malformed tag"; return false; }
+
+                const char *attribute_end = scan_name( next, last );
+                const char *equals = skip_spaces( attribute_end, last );
+                if( attribute_end == next || equals == last || *equals != '=' ) { message = "malformed attribute"; return false; }
+                const char *quote = skip_spaces( equals + 1, last );
+                if( quote == last || ( *quote != '"' && *quote != '\'' ) ) { message = "malformed attribute"; return false; }
+                const char *value = quote + 1;
+                const void *value_end = memchr( value, *quote, static_cast< std::size_t >( last - value ) );
+                if( value_end == nullptr ) { message = "unterminated attribute"; return false; }
+                if( attribute_count == max_attributes ) { message = "too many attributes"; return false; }
+                attributes[attribute_count++] = XmlAttribute{
+                    next, static_cast< std::size_t >( attribute_end - next ),
+                    value, static_cast< std::size_t >( static_cast< const char * >( value_end ) - value ) };
+                current = static_cast< const char * >( value_end ) + 1;
+            }
+
+            where = tag;
+            if( open.size( ) == max_depth ) { message = "elements nested too deeply"; return false; }
+            root_seen = true;
+            message = handler.start_element( tag, name, name_size, attributes, attribute_count );
+            if( message == nullptr && empty ) message = handler.end_element( name, name_size, current );
+            if( message != nullptr ) return false;
+            if( !empty ) open.push_back( OpenElement{ name, name_size } );
+        }
+
+        where = last;
+        if( !open.empty( ) ) { message = "unterminated element"; return false; }
+        if( !root_seen ) { message = "no root element"; return false; }
+        return true;
+    }
+
+
+    //! Converts an attribute to an integer. Returns false if it isn't one.
+    template< typename Integer >
+    bool attribute_value( const XmlAttribute &attribute, Integer &value ) noexcept
+    {
+        const char *const last = attribute.value + attribute.value_size;
+        return parse_integer( attribute.value, last, value ) == last;
+    }
+
+
+    //! Builds a task list from the events of parse_xml( ).
+    class TaskReader {
+    public:
+        TaskReader( TaskList &task_list,
+                    spica::Date &file_date,
+                    unsigned long long &sequence,
+                    string &file_extras,
+                    XmlTaskExtras &task_extras ) :
+            task_list( task_list ),
+            file_date( file_date ),
+            sequence( sequence ),
+            file_extras( file_extras ),
+            task_extras( task_extras )
+        { }
+
+        const char *start_element( const char *tag,
+                                   const char *name,
+                                   std::size_t name_size,
+                                   const XmlAttribute *attributes,
+                                   std::size_t attribute_count );
+        const char *end_element( const char *name, std::size_t name_size, const char *tag_end );
+        const char *text( const char *first, const char *last, bool literal );
+
+    private:
+        TaskList           &task_list;
+        spica::Date        &file_date;
+        unsigned long long &sequence;
+        string             &file_extras;
+        XmlTaskExtras      &task_extras;
+
+        std::size_t depth = 0;              //!< Number of open elements.
+        bool        in_description = false;
+        bool        date_seen = false;
+        PixieTask   task;                   //!< The task being read.
+        string      description;            //!< The description of the task being read.
+        string      extras;                 //!< Unknown elements in the task being read.
+        const char *unknown_tag = nullptr;  //!< Start of the unknown element being skipped (if any).
+        std::size_t unknown_depth = 0;      //!< Depth of that element.
+
+        const char *start_root( const XmlAttribute *attributes, std::size_t attribute_count );
+        const char *start_task( const XmlAttribute *attributes, std::size_t attribute_count );
+        const char *finish_task( );
+    };
+
+
+    const char *TaskReader::start_element( const char *tag,
+                                           const char *name,
+                                           std::size_t name_size,
+                                           const XmlAttribute *attributes,
+                                           std::size_t attribute_count )
+    {
+        const char *message = nullptr;
+        if( unknown_tag == nullptr ) {
+            if( depth == 0 ) {
+                if( !equal( name, name_size, "pixie" ) ) return "not a Pixie task file";
+                message = start_root( attributes, attribute_count );
+            }
+            else if( depth == 1 && equal( name, name_size, "task" ) ) {
+                message = start_task( attributes, attribute_count );
+            }
+            else if( depth == 2 && equal( name, name_size, "description" ) ) {
+                in_description = true;
+            }
+            else if( depth == 3 ) {
+                return "element inside a description";
+            }
+            else {
+                unknown_tag   = tag;
+                unknown_depth = depth;
+            }
+        }
+        ++depth;
+        return message;
+    }
+
+
+    const char *TaskReader::end_element( const char *, std::size_t, const char *tag_end )
+    {
+        --depth;
+        if( unknown_tag != nullptr ) {
+            if( depth == unknown_depth ) {
+                if( depth == 1 ) {
+                    file_extras += "  ";
+                    file_extras.append( unknown_tag, tag_end );
+                    file_extras += '\n';
+                }
+                else {
+                    extras.append( unknown_tag, tag_end );
+                }
+                unknown_tag = nullptr;
+            }
+            return nullptr;
+        }
+        if( depth == 2 ) in_description = false;
+        if( depth == 1 ) return finish_task( );
+        if( depth == 0 && !date_seen ) return "no date";
+        return nullptr;
+    }
+
+
+    // Text outside of descriptions is only layout.
+    const char *TaskReader::text( const char *first, const char *last, bool literal )
+    {
+        if( !in_description || unknown_tag != nullptr ) return nullptr;
+        if( literal ) {
+            description.append( first, last );
+        }
+        else if( !append_text( first, last, description ) ) {
+            return "bad character reference";
+        }
+        return nullptr;
+    }
+
+
+    const char *TaskReader::start_root( const XmlAttribute *attributes, std::size_t attribute_count )
+    {
+        for( std::size_t i = 0; i < attribute_count; ++i ) {
+            const XmlAttribute &attribute = attributes[i];
+            if( equal( attribute.name, attribute.name_size, "date" ) ) {
+                string date_text;
+                if( !append_text( attribute.value, attribute.value + attribute.value_size, date_text ) ) return "bad date";
+                istringstream date_stream( date_text );
+                if( !( date_stream >> file_date ) ) return "bad date";
+                date_seen = true;
+            }
+            else if( equal( attribute.name, attribute.name_size, "sequence" ) ) {
+                long long value;
+                if( !attribute_value( attribute, value ) || value < 0 ) return "bad sequence number";
+                sequence = static_cast< unsigned long long >( value );
+            }
+            else if( equal( attribute.name, attribute.name_size, "next-id" ) ) {
+                long long value;
+                if( !attribute_value( attribute, value ) || value < 0 ) return "bad next-id";
+                task_list.reserve_ids( static_cast< TaskId >( value ) );
+            }
+        }
+        return nullptr;
+    }
+
+
+    const char *TaskReader::start_task( const XmlAttribute *attributes, std::size_t attribute_count )
+    {
+        task.id                = 0;
+        task.priority          = 0;
+        task.start_time        = 0;
+        task.accumulated       = 0;
+        task.accumulated_today = 0;
+        task.daily             = 0;
+        task.accumulated_debt  = 0;
+        description.clear( );
+        extras.clear( );
+
+        // Attributes that Pixie doesn't know are ignored.
+        for( std::size_t i = 0; i < attribute_count; ++i ) {
+            const XmlAttribute &attribute = attributes[i];
+            bool valid = true;
+            if( equal( attribute.name, attribute.name_size, "id" ) ) {
+                long long value;
+                valid = attribute_value( attribute, value ) && value > 0;
+                task.id = static_cast< TaskId >( value );
+            }
+            else if( equal( attribute.name, attribute.name_size, "start"       ) ) valid = attribute_value( attribute, task.start_time );
+            else if( equal( attribute.name, attribute.name_size, "accumulated" ) ) valid = attribute_value( attribute, task.accumulated );
+            else if( equal( attribute.name, attribute.name_size, "today"       ) ) valid = attribute_value( attribute, task.accumulated_today );
+            else if( equal( attribute.name, attribute.name_size, "daily"       ) ) valid = attribute_value( attribute, task.daily );
+            else if( equal( attribute.name, attribute.name_size, "priority"    ) ) valid = attribute_value( attribute, task.priority );
+            else if( equal( attribute.name, attribute.name_size, "debt"        ) ) valid = attribute_value( attribute, task.accumulated_debt );
+            if( !valid ) return "bad task attribute";
+        }
+        return nullptr;
+    }
+
+
+    const char *TaskReader::finish_task( )
+    {
+        // The text format keeps each task on one line, so line breaks become spaces.
+        for( char &ch : description ) {
+            if( ch == '\n' || ch == '\r' ) ch = ' ';
+        }
+        if( skip_blanks( description.data( ), description.data( ) + description.size( ) ) ==
+            description.data( ) + description.size( ) ) {
+            return "task without a description";
+        }
+
+        task.description.assign( description.data( ), description.data( ) + description.size( ) );
+        task_list.push_back( std::move( task ) );
+        if( !extras.empty( ) ) task_extras[task_list.id( task_list.size( ) - 1 )] = extras;
+        return nullptr;
+    }
+
+
+    //! Collects output in one buffer, passing it to a stream whenever the buffer fills.
+    class OutputBuffer {
+    public:
+        explicit OutputBuffer( ostream &output ) noexcept : output( output ) { }
+
+        void put( const char *text, std::size_t size )
+        {
+            if( size > capacity - used ) flush( );
+            if( size >= capacity ) {
+                output.write( text, static_cast< streamsize >( size ) );
+                return;
+            }
+            memcpy( buffer + used, text, size );
+            used += size;
+        }
+
+        void put( const char *text ) { put( text, strlen( text ) ); }
+        void put( const string &text ) { put( text.data( ), text.size( ) ); }
+
+        void put_number( unsigned long long value, bool negative = false )
+        {
+            char digits[24];
+            char *first = digits + sizeof( digits );
+            do {
+                *--first = static_cast< char >( '0' + value % 10 );
+                value /= 10;
+            } while( value != 0 );
+            if( negative ) *--first = '-';
+            put( first, static_cast< std::size_t >( digits + sizeof( digits ) - first ) );
+        }
+
+        void put_number( long long value )
+        {
+            if( value < 0 )
+                put_number( 0ULL - static_cast< unsigned long long >( value ), true );
+            else
+                put_number( static_cast< unsigned long long >( value ) );
+        }
+
+        //! Writes text with the characters that are special in XML replaced by references.
+        void put_escaped( const char *text, std::size_t size )
+        {
+            const char *const last = text + size;
+            const char *run = text;
+            for( const char *current = text; current != last; ++current ) {
+                const char *reference;
+                switch( *current ) {
+                case '&': reference = "&amp;";  break;
+                case '<': reference = "&lt;";   break;
+                case '>': reference = "&gt;";   break;
+                case '"': reference = "&quot;"; break;
+                default: continue;
+                }
+                put( run, static_cast< std::size_t >( current - run ) );
+                put( reference );
+                run = current + 1;
+            }
+            put( run, static_cast< std::size_t >( last - run ) );
+        }
+
+        bool flush( )
+        {
+            output.write( buffer, static_cast< streamsize >( used ) );
+            used = 0;
+            return static_cast< bool >( output );
+        }
+
+    private:
+        static const std::size_t capacity = 64 * 1024;
+
+        ostream    &output;
+        std::size_t used = 0;
+        char        buffer[capacity];
+    };
+
+}
+
+
+bool is_task_xml( const MappedFile &file ) noexcept
+{
+    const char *first = file.begin( );
+    if( starts_with( first, file.end( ), "\xEF\xBB\xBF" ) ) first += 3;
+    first = skip_spaces( first, file.end( ) );
+    return starts_with( first, file.end( ), "<?xml" ) || starts_with( first, file.end( ), "<pixie" );
+}
+
+
+bool read_task_xml( const MappedFile &file,
+                    spica::Date &file_date,
+                    unsigned long long &sequence,
+                    TaskList &task_list,
+                    std::string &file_extras,
+                    XmlTaskExtras &task_extras,
+                    std::string &error )
+{
+    TaskReader reader( task_list, file_date, sequence, file_extras, task_extras );
+    const char *where   = file.begin( );
+    const char *message = nullptr;
+
+    if( !parse_xml( file.begin( ), file.end( ), reader, where, message ) ) {
+        // Lines are only counted when they are needed for an error message.
+        error = "line " + to_string( count( file.begin( ), where, '\n' ) + 1 ) + ": " + message;
+        return false;
+    }
+    return true;
+}
+
+
+bool write_task_xml( ostream &output,
+                     const spica::Date &file_date,
+                     unsigned long long sequence,
+                     const TaskList &task_list,
+                     std::uint16_t shard,
+                     const std::string &file_extras,
+                     const XmlTaskExtras &task_extras )
+{
+    OutputBuffer buffer( output );
+    ostringstream date_text;
+    date_text << file_date;
+    const string date_string = date_text.str( );
+
+    buffer.put( xml_declaration );
+    buffer.put( "<pixie version=\"1\" date=\"" );
+    buffer.put_escaped( date_string.data( ), date_string.size( ) );
+    buffer.put( "\" sequence=\"" );
+    buffer.put_number( sequence );
+    buffer.put( "\" next-id=\"" );
+    buffer.put_number( static_cast< unsigned long long >( task_list.next_id( ) ) );
+    buffer.put( "\">\n" );
+
+    for( std::size_t i = 0; i < task_list.size( ); ++i ) {
+        if( task_list.shard[i] != shard ) continue;
+        const TaskId task_id = task_list.id( i );
+        buffer.put( "  <task id=\"" );
+        buffer.put_number( static_cast< unsigned long long >( task_id ) );
+        buffer.put( "\" start=\"" );
+        buffer.put_number( static_cast< long long >( task_list.start_time[i] ) );
+        buffer.put( "\" accumulated=\"" );
+        buffer.put_number( static_cast< long long >( task_list.accumulated[i] ) );
+        buffer.put( "\" today=\"" );
+        buffer.put_number( static_cast< long long >( task_list.today( i ) ) );
+        buffer.put( "\" daily=\"" );
+        buffer.put_number( static_cast< long long >( task_list.daily[i] ) );
+        buffer.put( "\" priority=\"" );
+        buffer.put_number( static_cast< long long >( task_list.priority[i] ) );
+        buffer.put( "\" debt=\"" );
+        buffer.put_number( static_cast< long long >( task_list.debt( i ) ) );
+        buffer.put( "\"><description>" );
+        buffer.put_escaped( task_list.description( i ).data( ), task_list.description( i ).size( ) );
+        buffer.put( "</description>" );
+        if( !task_extras.empty( ) ) {
+            const auto extras = task_extras.find( task_id );
+            if( extras != task_extras.end( ) ) buffer.put( extras->second );
+        }
+        buffer.put( "</task>\n" );
+    }
+    buffer.put( file_extras );
+    buffer.put( "</pixie>\n" );
+    return buffer.flush( );
+}
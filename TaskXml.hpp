@@ -0,0 +1,57 @@
+/*! \file    TaskXml.hpp
+ *  \brief   XML task file format.
+ *  \author  Peter C. Chapin <pchapin@vtc.edu>
+ */
+
+#ifndef TASKXML_HPP
+#define TASKXML_HPP
+
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+
+#include "Date.hpp"
+#include "MappedFile.hpp"
+#include "TaskList.hpp"
+
+//! Elements inside task elements that this version of Pixie doesn't know, by task ID.
+/*!
+ * Each string holds the elements exactly as they appeared in the file so that they can be
+ * written back unchanged.
+ */
+typedef std::unordered_map< TaskId, std::string > XmlTaskExtras;
+
+//! Returns true if the mapped file looks like an XML document.
+bool is_task_xml( const MappedFile &file ) noexcept;
+
+//! Loads the tasks in a mapped XML task file.
+/*!
+ * The file is parsed in a single pass as a stream of start tags, end tags, and text; no tree
+ * is built. Elements that Pixie doesn't know are kept (see write_task_xml( )): those directly
+ * inside the root element are appended to file_extras and those inside a task element are
+ * stored in task_extras under the ID the task was given in the list. Returns false (and
+ * explains in error) if the file isn't a well formed task file.
+ */
+bool read_task_xml( const MappedFile &file,
+                    spica::Date &file_date,
+                    unsigned long long &sequence,
+                    TaskList &task_list,
+                    std::string &file_extras,
+                    XmlTaskExtras &task_extras,
+                    std::string &error );
+
+//! Writes the tasks in one shard of a list (see TaskList::shard) as an XML document.
+/*!
+ * The extra elements found by read_task_xml( ) are written back: file_extras at the end of the
+ * root element and the entry of task_extras for a task at the end of that task's element.
+ */
+bool write_task_xml( std::ostream &output,
+                     const spica::Date &file_date,
+                     unsigned long long sequence,
+                     const TaskList &task_list,
+                     std::uint16_t shard,
+                     const std::string &file_extras,
+                     const XmlTaskExtras &task_extras );
+
+#endif
@@ -4,219 +4,1787 @@
  */
 
 #include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
 #include <cstdlib>
+#include <cstring>
 #include <ctime>
 #include <iomanip>
 #include <iostream>
 #include <fstream>
+#include <memory>
+#include <mutex>
 #include <sstream>
 #include <string>
+#include <thread>
+#include <utility>
 #include <vector>
 
+#if defined(_WIN32)
+#include <direct.h>
+#include <windows.h>
+#else
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+#endif
+
+#include "Calendar.hpp"
 #include "Date.hpp"
+#include "Export.hpp"
+#include "FileWatch.hpp"
+#include "Journal.hpp"
+#include "LockFile.hpp"
+#include "MappedFile.hpp"
+#include "PixieTask.hpp"
+#include "Scheduler.hpp"
+#include "SessionHistory.hpp"
+#include "Statistics.hpp"
+#include "TaskKernels.hpp"
+#include "TaskList.hpp"
+#include "TaskParser.hpp"
+#include "TaskRenderer.hpp"
+#include "TaskSnapshot.hpp"
+#include "TaskXml.hpp"
 #include "Tasks.hpp"
+#include "ThreadPool.hpp"
+#include "TrigramIndex.hpp"
 
 using namespace std;
 
 namespace {
 
-    //! Structure that holds information about a single task.
-    struct PixieTask {
-        std::string description;       //!< Description of the task as presented to the user.
-        int         priority;          //!< Range 1 .. 99
-        std::time_t start_time;        //!< Zero implies that the task is not active.
-        int         accumulated;       //!< Total number of minutes applied to this task.
-        int         accumulated_today; //!< Total number of minutes applied to this task today.
-        int         daily;             //!< Number of minutes of attention this task requires each day.
-        int         accumulated_debt;  //!< Total number of minutes of attention this task requires. A credit is negative.
+    spica::Date today;              //!< Today's date.
+    std::string task_file_name;     //!< Name of the task file.
+    TaskList    tasks;              //!< The tasks themselves, kept in priority order.
+
+    //! One of the files that hold the task list.
+    /*!
+     * The main task file is shard zero. Every file in the shard folder is another shard, holding
+     * the tasks that were moved there. All shards are loaded into the one task list; the shard
+     * column of the list records where each task is stored.
+     */
+    struct Shard {
+        std::string    name;                 //!< Name in the shard folder ("-" for the main task file).
+        std::string    file_name;            //!< Full name of the file.
+        TaskFileFormat format = TaskFileFormat::text;  //!< Format used to write the file.
+        MappedFile     mapping;              //!< Binary snapshot holding the descriptions of loaded tasks.
+        bool           changed    = false;   //!< True if the file must be rewritten.
+        bool           unreadable = false;   //!< True if the file couldn't be loaded (completely). It is never written.
+        std::string    error;                //!< Why the file couldn't be loaded.
+        std::string    xml_extras;           //!< Elements of an XML file that Pixie doesn't know.
+        XmlTaskExtras  xml_task_extras;      //!< Likewise for each task, until the shards are merged.
     };
 
-    spica::Date today;              //!< Today's date.
-    std::string task_file_name;     //!< Name of the task file.
-    std::vector< PixieTask > tasks; //!< The tasks themselves.
+    const std::size_t max_shards = 4096;
+    std::string shard_folder;                       //!< Holds the shards other than the main task file.
+    std::vector< std::unique_ptr< Shard > > shards; //!< Shard zero is the main task file.
+
+    //! Elements in the tasks of XML files that Pixie doesn't know, kept to be written back.
+    /*!
+     * This is only replaced when the task files are read, so the save worker can share it.
+     */
+    std::shared_ptr< const XmlTaskExtras > xml_task_extras = std::make_shared< const XmlTaskExtras >( );
+
+    // Changes are recorded in a journal as they are made and written to disk by the save worker
+    // (see request_save( )). The task file itself is only rewritten when the journal grows too
+    // large or when the day changes.
+    //
+    const long         journal_limit = 1024 * 1024; //!< Journal size (bytes) that triggers compaction.
+    std::string        journal_file_name;           //!< Name of the journal.
+    std::string        old_journal_file_name;       //!< Journal renamed by an unfinished compaction.
+    Journal            journal;                     //!< Records changes to the task list.
+    std::atomic< bool > compaction_failed( false ); //!< True if every shard must be written.
+    bool               task_file_found = false;     //!< True if read_tasks( ) found a task file.
+    spica::Date        task_file_date;              //!< Date stored in the task file.
+    long               list_day = 0;                //!< Day (see day_number( )) the task list is for.
+    unsigned long long task_file_sequence = 0;      //!< Last journal record in the task file.
+    unsigned long long replayed_sequence  = 0;      //!< Last journal record applied at startup.
+
+    // Several processes can share the task list. Each holds the lock file while it reads or
+    // writes the task files or the journal; the save worker has a lock of its own so that it
+    // excludes the main thread too. Records that other processes add to the journal are applied
+    // by sync_tasks( ), and new tasks get IDs claimed through the lock file so that two
+    // processes never give the same ID to different tasks.
+    //
+    std::string  lock_file_name;                    //!< Name of the lock file.
+    LockFile     main_lock;                         //!< Lock used by the main thread.
+    LockFile     saver_lock;                        //!< Lock used by the save worker.
+    std::string  task_folder;                       //!< Folder holding the task file.
+    FileWatch    task_watch;                        //!< Notices changes to the task file and journal.
+    bool         task_watch_started = false;        //!< True if opening task_watch was attempted.
+    bool         synced_once        = false;        //!< True if sync_tasks( ) has been called.
+    bool         sync_pending = false;              //!< True if a change seen by task_watch isn't applied yet.
+    long         journal_read = 0;                  //!< Bytes at the start of the journal already applied.
+    unsigned     journal_read_generation = 0;       //!< The journal_generation journal_read refers to.
+    std::string  journal_tail;                      //!< Scratch space used by sync_tasks( ).
+    const TaskId id_block_size   = 64;              //!< Number of IDs claimed at once.
+    TaskId       next_claimed_id = 0;               //!< First claimed ID not yet used.
+    TaskId       claimed_end     = 0;               //!< End of the claimed IDs.
+
+    SessionHistory history;                         //!< Every start/stop interval ever recorded.
+    TaskRenderer   renderer;                        //!< Used by display_tasks( ).
+    std::size_t    view_first = 0;                  //!< Position of the first task displayed.
+    std::size_t    view_count = 0;                  //!< Number of tasks displayed (zero for all).
+    std::size_t    page_size  = 20;                 //!< Number of tasks on a page.
+
+    // The search index is built by the first search and then kept up to date by the functions
+    // that add, rename, or remove tasks.
+    //
+    const std::size_t max_matches = 20;             //!< Number of matches display_matches( ) shows.
+    TrigramIndex   search_index;
+    bool           search_index_ready = false;      //!< True if search_index describes the task list.
+
+    // The scheduler's run queue is brought up to date by display_next( ). Every change to a sort
+    // key is noted along with the dirty tasks (see mark_dirty( )).
+    //
+    Scheduler      scheduler;
+
+    // The task list is kept sorted between prompts. Mutators that change a sort key record a
+    // handle to the task they touched so that display_tasks( ) only needs to reposition those
+    // tasks instead of sorting the entire list again.
+    //
+    const std::size_t max_dirty_tasks = 256;       //!< Beyond this many dirty tasks just re-sort.
+    std::vector< TaskList::Handle > changed_tasks; //!< Tasks with changed sort keys.
+    std::vector< TaskList::Handle > moved_tasks;   //!< Tasks taken to be at the end; see erase_task( ).
+    std::vector< std::size_t > dirty_tasks;       //!< Scratch space used while reordering.
+    std::vector< std::size_t > dirty_gaps;        //!< Scratch space used while reordering.
+    std::vector< std::size_t > dirty_order;       //!< Scratch space used while reordering.
+    std::vector< std::size_t > moved_rank;        //!< Scratch space used while reordering.
+    const std::size_t not_moved = static_cast< std::size_t >( -1 );  //!< The moved_rank of other tasks.
+    std::vector< std::size_t > insertion_points;  //!< Scratch space used while reordering.
+    std::vector< std::size_t > new_order;         //!< Scratch space used while reordering.
+    std::vector< unsigned char > hot_scratch;     //!< Scratch space used while reordering.
+    bool order_invalid = true;                    //!< True if the whole list must be sorted.
+
+    // Other threads see the task list through immutable snapshots. Copying the list takes time
+    // in proportion to its size, so a new snapshot is only published (replacing the pointer
+    // atomically) when one is wanted: for a compaction, when the command thread asks for one, or
+    // at the next commit point after another thread asked. Readers holding an older snapshot
+    // keep it alive until they are done with it.
+    //
+    std::shared_ptr< const TaskList > published_tasks; //!< Only use atomic_load( ) and atomic_store( ).
+    unsigned long long task_version      = 1;          //!< Counts changes to the task list.
+    unsigned long long published_version = 0;          //!< Version of published_tasks.
+    std::thread::id    command_thread;                 //!< The thread that runs commands.
+    std::atomic< bool > snapshot_wanted( false );      //!< True if another thread wants a new snapshot.
+
+    //! Returns the position of the given task, or TaskList::npos if there is no such task.
+    std::size_t locate( TaskRef task ) noexcept
+    {
+        if( task.is_id( ) ) return tasks.find( task.id( ) );
+        if( task.number( ) < 1 || static_cast< std::size_t >( task.number( ) ) > tasks.size( ) ) return TaskList::npos;
+        return static_cast< std::size_t >( task.number( ) - 1 );
+    }
+
+    //! Notes that the shard holding the task at the given position must be rewritten.
+    void touch_shard( std::size_t position ) noexcept
+    {
+        shards[tasks.shard[position]]->changed = true;
+    }
+
+    //! Notes that every shard must be rewritten.
+    void touch_all_shards( ) noexcept
+    {
+        for( auto &shard : shards ) shard->changed = true;
+    }
+
+    //! Journals the entire task at the given position. Only used for new tasks.
+    void log_task( std::size_t position ) noexcept
+    {
+        ++task_version;
+        touch_shard( position );
+        journal.put( position, tasks );
+    }
+
+    //! Journals a change to anything but the times of the task at the given position.
+    void log_edit( std::size_t position ) noexcept
+    {
+        ++task_version;
+        touch_shard( position );
+        journal.edit( position, tasks );
+    }
+
+    //! Journals that minutes of work were added to the task at the given position.
+    void log_work( std::size_t position, int minutes ) noexcept
+    {
+        ++task_version;
+        touch_shard( position );
+        journal.add_work( tasks.id( position ), minutes );
+    }
+
+    //! Journals the removal of the task at the given position. Call before removing it.
+    void log_erase( std::size_t position ) noexcept
+    {
+        ++task_version;
+        touch_shard( position );
+        scheduler.note_change( tasks.id( position ) );
+        journal.erase( tasks.id( position ) );
+    }
+
+    //! Journals that the task at the given position moved to a different shard.
+    void log_move( std::size_t position ) noexcept
+    {
+        ++task_version;
+        touch_shard( position );
+        journal.move( tasks.id( position ), shards[tasks.shard[position]]->name );
+    }
+
+    //! Journals an operation that affects the entire list.
+    void log_operation( char operation ) noexcept
+    {
+        ++task_version;
+        journal.record( operation );
+    }
+
+    //! Adds the session of the (running) task at the given position, ending now, to the history.
+    void end_session( std::size_t position, time_t now ) noexcept
+    {
+        history.add( tasks.id( position ), tasks.start_time[position], now );
+    }
+
+    //! Returns true if the task at the given position has a daily allocation that isn't met yet.
+    bool is_hot( const TaskList &list, std::size_t position ) noexcept
+    {
+        return list.daily[position] != 0 && list.debt( position ) > 0;
+    }
+
+
+    //! Compares two tasks, possibly in different lists, whose "hot" status is already known.
+    bool compare_keys( const TaskList &left_list,  bool left_hot,  std::size_t left,
+                       const TaskList &right_list, bool right_hot, std::size_t right ) noexcept
+    {
+        return PixiePolicy::before( PixiePolicy::key( left_list, left, left_hot ),
+                                    PixiePolicy::key( right_list, right, right_hot ) );
+    }
+
+
+    //! Sorts pixie tasks in the task window.
+    /*!
+     * This function implements Pixie's task priority logic (see PixiePolicy). It returns true if
+     * the task at the left position belongs before the task at the right position. The displayed
+     * list always uses this order; other scheduling policies are consulted by display_next( ).
+     */
+    bool compare_tasks( std::size_t left, std::size_t right ) noexcept
+    {
+        return compare_keys( tasks, is_hot( tasks, left ), left, tasks, is_hot( tasks, right ), right );
+    }
+
+
+    //! Puts an entire list into priority order (as a stable sort using compare_tasks( ) would).
+    /*!
+     * The "hot" status of every task is worked out in one pass first. Lists are saved in order so
+     * a list that was just loaded is often in order already; then nothing is moved. Returns true
+     * if the list had to be reordered (and "hot" no longer matches it).
+     */
+    bool sort_list( TaskList &list, vector< std::size_t > &order, vector< unsigned char > &hot )
+    {
+        const std::size_t total_count = list.size( );
+        const auto compare = [&list, &hot]( std::size_t left, std::size_t right ) {
+            return compare_keys( list, hot[left] != 0, left, list, hot[right] != 0, right );
+        };
+
+        find_hot( list, hot );
+        order.resize( total_count );
+        for( std::size_t i = 0; i < total_count; ++i ) order[i] = i;
+        if( !is_sorted( order.begin( ), order.end( ), compare ) ) {
+            stable_sort( order.begin( ), order.end( ), compare );
+            list.permute( order, 0, total_count );
+            return true;
+        }
+        return false;
+    }
+
+
+    //! Notes that the sort key of the task at the given position has changed.
+    /*!
+     * This function never allocates memory (the dirty list is reserved ahead of time) so it can
+     * be used by the noexcept mutators. If too many tasks are dirty the whole list is sorted
+     * instead.
+     */
+    void mark_dirty( std::size_t position ) noexcept
+    {
+        scheduler.note_change( tasks.id( position ) );
+        if( order_invalid ) return;
+        if( changed_tasks.size( ) == changed_tasks.capacity( ) ) {
+            order_invalid = true;
+            return;
+        }
+        changed_tasks.push_back( tasks.handle( position ) );
+    }
+
+
+    //! Notes that the sort keys of any number of tasks might have changed.
+    void invalidate_order( ) noexcept
+    {
+        order_invalid = true;
+        changed_tasks.clear( );
+        moved_tasks.clear( );
+        scheduler.invalidate( );
+    }
+
+
+    //! Removes the task at the given position. The last task in the list takes its place.
+    /*!
+     * The list stays sorted apart from the dirty tasks and the moved one, so the moved task is
+     * marked dirty. A stable sort would still put it after the tasks it ties with, as it was at
+     * the end of the list, so it goes into moved_tasks for order_tasks( ). That vector holds the
+     * tasks that are taken to be at the end of the list, in their order there. A task that moves
+     * for a second time is already among them; any other task that moves was before all of them,
+     * and a task appended later (see append_task( )) goes after them.
+     */
+    void erase_task( std::size_t position ) noexcept
+    {
+        tasks.erase( position );
+        if( position == tasks.size( ) || order_invalid ) return;
+
+        const TaskList::Handle moved = tasks.handle( position );
+        for( const TaskList::Handle &task : moved_tasks ) {
+            if( task.slot == moved.slot && task.generation == moved.generation ) return;
+        }
+        if( moved_tasks.size( ) == moved_tasks.capacity( ) ) {
+            order_invalid = true;
+            return;
+        }
+        moved_tasks.insert( moved_tasks.begin( ), moved );
+        mark_dirty( position );
+    }
+
+
+    //! Appends a task to the list. The caller marks it dirty.
+    void append_task( PixieTask &&task )
+    {
+        tasks.push_back( std::move( task ) );
+        if( moved_tasks.empty( ) || order_invalid ) return;
+        if( moved_tasks.size( ) == moved_tasks.capacity( ) ) {
+            order_invalid = true;
+            return;
+        }
+        moved_tasks.push_back( tasks.handle( tasks.size( ) - 1 ) );
+    }
+
+
+    //! Returns the position of the clean task that is the given number of clean tasks into the list.
+    /*!
+     * Uses dirty_gaps, where dirty_gaps[m] is the number of clean tasks before the m-th dirty task.
+     */
+    std::size_t clean_position( std::size_t clean_index ) noexcept
+    {
+        return clean_index +
+            ( upper_bound( dirty_gaps.begin( ), dirty_gaps.end( ), clean_index ) - dirty_gaps.begin( ) );
+    }
+
+
+    //! Restores priority order in the task list.
+    /*!
+     * The result is exactly what a stable sort using compare_tasks( ) would produce on the
+     * current list, with the tasks in moved_tasks taken to be at the end (see erase_task( )).
+     * When the whole list must be sorted sort_list( ) does the work. Otherwise only the dirty
+     * tasks are out of place: each of them is located among the remaining (still sorted) tasks
+     * with a binary search, and only the part of the list between the old and new positions of
+     * the dirty tasks is rearranged. When nothing has changed since the last call this does no
+     * work.
+     */
+    void order_tasks( )
+    {
+        const std::size_t total_count = tasks.size( );
+
+        if( order_invalid ) {
+            sort_list( tasks, new_order, hot_scratch );
+            vector< std::size_t >( ).swap( new_order );
+            vector< unsigned char >( ).swap( hot_scratch );
+            changed_tasks.clear( );
+            moved_tasks.clear( );
+            order_invalid = false;
+            ++task_version;
+            return;
+        }
+
+        // Tasks that were changed and then removed are skipped.
+        dirty_tasks.clear( );
+        for( const TaskList::Handle &task : changed_tasks ) {
+            const std::size_t position = tasks.find( task );
+            if( position != TaskList::npos ) dirty_tasks.push_back( position );
+        }
+        changed_tasks.clear( );
+        if( dirty_tasks.empty( ) ) {
+            moved_tasks.clear( );
+            return;
+        }
+        ++task_version;
+
+        sort( dirty_tasks.begin( ), dirty_tasks.end( ) );
+        dirty_tasks.erase( unique( dirty_tasks.begin( ), dirty_tasks.end( ) ), dirty_tasks.end( ) );
+
+        const std::size_t dirty_count = dirty_tasks.size( );
+        const std::size_t clean_count = total_count - dirty_count;
+
+        dirty_gaps.resize( dirty_count );
+        for( std::size_t m = 0; m < dirty_count; ++m ) dirty_gaps[m] = dirty_tasks[m] - m;
+
+        // The stable sort is of the list with the moved tasks at the end: after every clean task
+        // and every other dirty task.
+        moved_rank.assign( dirty_count, not_moved );
+        for( std::size_t k = 0; k < moved_tasks.size( ); ++k ) {
+            const std::size_t position = tasks.find( moved_tasks[k] );
+            if( position == TaskList::npos ) continue;
+            const std::size_t m = lower_bound( dirty_tasks.begin( ), dirty_tasks.end( ), position ) - dirty_tasks.begin( );
+            if( m < dirty_count && dirty_tasks[m] == position ) moved_rank[m] = k;
+        }
+        moved_tasks.clear( );
+
+        // Find where each dirty task goes among the clean tasks. Among equivalent clean tasks the
+        // dirty task keeps the place it had before, which is what a stable sort would do.
+        insertion_points.resize( dirty_count );
+        for( std::size_t m = 0; m < dirty_count; ++m ) {
+            const std::size_t dirty = dirty_tasks[m];
+            std::size_t low = 0;
+            std::size_t high = clean_count;
+            while( low < high ) {
+                const std::size_t middle = low + ( high - low ) / 2;
+                if( compare_tasks( clean_position( middle ), dirty ) ) low = middle + 1; else high = middle;
+            }
+            std::size_t end = low;
+            high = clean_count;
+            while( end < high ) {
+                const std::size_t middle = end + ( high - end ) / 2;
+                if( compare_tasks( dirty, clean_position( middle ) ) ) high = middle; else end = middle + 1;
+            }
+            const std::size_t anchor = ( moved_rank[m] == not_moved ) ? dirty_gaps[m] : clean_count;
+            insertion_points[m] = std::min( std::max( anchor, low ), end );
+        }
+
+        // Sort the dirty tasks among themselves. Ties keep their original relative order.
+        dirty_order.clear( );
+        for( std::size_t m = 0; m < dirty_count; ++m ) {
+            if( moved_rank[m] == not_moved ) dirty_order.push_back( m );
+        }
+        const std::size_t unmoved_count = dirty_order.size( );
+        for( std::size_t m = 0; m < dirty_count; ++m ) {
+            if( moved_rank[m] != not_moved ) dirty_order.push_back( m );
+        }
+        sort( dirty_order.begin( ) + unmoved_count, dirty_order.end( ),
+            []( std::size_t left, std::size_t right ) { return moved_rank[left] < moved_rank[right]; } );
+        stable_sort( dirty_order.begin( ), dirty_order.end( ),
+            []( std::size_t left, std::size_t right ) {
+                return compare_tasks( dirty_tasks[left], dirty_tasks[right] );
+            } );
+
+        // The r-th dirty task in priority order ends up after its insertion point's clean tasks and
+        // the r dirty tasks before it. Nothing outside [first, last) moves.
+        std::size_t first = total_count;
+        std::size_t last  = 0;
+        for( std::size_t r = 0; r < dirty_count; ++r ) {
+            const std::size_t m = dirty_order[r];
+            const std::size_t final_position = insertion_points[m] + r;
+            first = std::min( first, std::min( final_position, dirty_tasks[m] ) );
+            last  = std::max( last,  std::max( final_position, dirty_tasks[m] ) + 1 );
+        }
+
+        new_order.assign( last - first, total_count );
+        for( std::size_t r = 0; r < dirty_count; ++r ) {
+            const std::size_t m = dirty_order[r];
+            new_order[insertion_points[m] + r - first] = dirty_tasks[m];
+        }
+
+        // The clean tasks in the range fill the remaining slots in their existing order.
+        std::size_t slot = 0;
+        std::size_t next_dirty = lower_bound( dirty_tasks.begin( ), dirty_tasks.end( ), first ) - dirty_tasks.begin( );
+        for( std::size_t position = first; position < last; ++position ) {
+            if( next_dirty < dirty_count && dirty_tasks[next_dirty] == position ) {
+                ++next_dirty;
+                continue;
+            }
+            while( new_order[slot] != total_count ) ++slot;
+            new_order[slot++] = position;
+        }
+
+        tasks.permute( new_order, first, last );
+    }
+
+
+    //! Returns true if name can be the name of a shard.
+    bool valid_shard_name( const std::string &name ) noexcept
+    {
+        const std::size_t max_length = 64;
+        const std::string temporary_suffix = ".new";
+
+        if( name.empty( ) || name.size( ) > max_length || !isalnum( static_cast< unsigned char >( name[0] ) ) ) return false;
+        if( name.size( ) > temporary_suffix.size( ) &&
+            name.compare( name.size( ) - temporary_suffix.size( ), temporary_suffix.size( ), temporary_suffix ) == 0 ) return false;
+        for( char ch : name ) {
+            if( !isalnum( static_cast< unsigned char >( ch ) ) && ch != '-' && ch != '_' && ch != '.' ) return false;
+        }
+        return true;
+    }
+
+
+    //! Returns the names of the shards in the shard folder, sorted. A shard might only exist as a temporary file.
+    vector< string > list_shard_files( )
+    {
+        vector< string > names;
+        const auto consider = [&names]( string name ) {
+            const std::size_t suffix = name.rfind( ".new" );
+            if( suffix != string::npos && suffix + 4 == name.size( ) ) name.erase( suffix );
+            if( valid_shard_name( name ) ) names.push_back( name );
+        };
+
+#if defined(_WIN32)
+        WIN32_FIND_DATAA entry;
+        const HANDLE search = FindFirstFileA( ( shard_folder + "\\*" ).c_str( ), &entry );
+        if( search == INVALID_HANDLE_VALUE ) return names;
+        do {
+            if( ( entry.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY ) == 0 ) consider( entry.cFileName );
+        } while( FindNextFileA( search, &entry ) );
+        FindClose( search );
+#else
+        DIR *folder = opendir( shard_folder.c_str( ) );
+        if( folder == nullptr ) return names;
+        while( const dirent *entry = readdir( folder ) ) {
+            struct stat status;
+            const string path = shard_folder + '/' + entry->d_name;
+            if( stat( path.c_str( ), &status ) == 0 && S_ISREG( status.st_mode ) ) consider( entry->d_name );
+        }
+        closedir( folder );
+#endif
+        sort( names.begin( ), names.end( ) );
+        names.erase( unique( names.begin( ), names.end( ) ), names.end( ) );
+        return names;
+    }
+
+
+    //! Adds a shard with the given (valid) name to the list of shards. Returns its index.
+    std::size_t add_shard( const std::string &name )
+    {
+        unique_ptr< Shard > shard( new Shard );
+        shard->name      = name;
+        shard->file_name = shard_folder + '/' + name;
+        shard->format    = shards[0]->format;
+        shards.push_back( std::move( shard ) );
+        return shards.size( ) - 1;
+    }
+
+
+    //! Returns the index of the named shard, or shards.size( ) if there is no such shard.
+    /*!
+     * If create is true a shard that doesn't exist yet is added (along with the shard folder)
+     * provided that the name is valid.
+     */
+    std::size_t find_shard( const std::string &name, bool create )
+    {
+        for( std::size_t i = 0; i < shards.size( ); ++i ) {
+            if( shards[i]->name == name ) return i;
+        }
+        if( !create || !valid_shard_name( name ) || shards.size( ) >= max_shards ) return shards.size( );
+#if defined(_WIN32)
+        _mkdir( shard_folder.c_str( ) );
+#else
+        mkdir( shard_folder.c_str( ), 0777 );
+#endif
+        return add_shard( name );
+    }
+
+
+    //! Returns the number of a date as given by day_number( ).
+    long date_number( const spica::Date &date )
+    {
+        return days_from_civil( date.year( ), date.month( ), date.day( ) );
+    }
+
+
+    //! Returns the date of a day numbered as by day_number( ).
+    spica::Date day_date( long day_number )
+    {
+        long year;
+        int  month;
+        int  day;
+        civil_from_days( day_number, year, month, day );
+        return spica::Date( static_cast< int >( year ), month, day );
+    }
+
+
+    // Workdays are counted by spica. The counts for the days around the day Pixie started are
+    // looked up in a table instead, which is filled once by initialize_tasks( ) before any
+    // thread reads it.
+    //
+    const long    workday_table_reach = 4 * 366; //!< Days covered on each side of the start day.
+    long          workday_table_first = 0;       //!< Day number of the first day in the table.
+    vector< int > workday_table;                 //!< Entry i counts the workdays in (first, first + i].
+
+    //! Fills workday_table for the days around the given one.
+    /*!
+     * The table is built a day at a time with spica's workday_difference( ), so a lookup gives
+     * the same count that spica would.
+     */
+    void build_workday_table( long center )
+    {
+        workday_table_first = center - workday_table_reach;
+        workday_table.resize( static_cast< std::size_t >( 2 * workday_table_reach + 1 ) );
+        workday_table[0] = 0;
+        spica::Date previous = day_date( workday_table_first );
+        for( std::size_t i = 1; i < workday_table.size( ); ++i ) {
+            const spica::Date current = day_date( workday_table_first + static_cast< long >( i ) );
+            workday_table[i] = workday_table[i - 1] + static_cast< int >( workday_difference( current, previous ) );
+            previous = current;
+        }
+    }
+
+
+    //! Returns the number of workdays from the earlier day to the later one (both numbered as by day_number( )).
+    /*!
+     * This is a table lookup unless one of the days is outside of workday_table.
+     */
+    long workdays_between( long earlier, long later )
+    {
+        const long table_last = workday_table_first + static_cast< long >( workday_table.size( ) );
+        if( earlier >= workday_table_first && earlier < table_last &&
+            later   >= workday_table_first && later   < table_last ) {
+            return workday_table[static_cast< std::size_t >( later - workday_table_first )] -
+                   workday_table[static_cast< std::size_t >( earlier - workday_table_first )];
+        }
+        return workday_difference( day_date( later ), day_date( earlier ) );
+    }
+
+
+    //! Reads the named task file, as it was written, into an empty list.
+    /*!
+     * This function only touches its parameters so that several shards can be read at once. A
+     * binary snapshot stays mapped by shard.mapping since the tasks refer to the descriptions
+     * inside it. Returns false, explaining in error, if the file is damaged.
+     */
+    bool read_task_file( const std::string &file_name,
+                         TaskList &task_list,
+                         Shard &shard,
+                         spica::Date &file_date,
+                         unsigned long long &sequence,
+                         bool &found,
+                         LatencyProbe &probe,
+                         std::string &error )
+    {
+        MappedFile task_file;
+
+        // Open the file. If it doesn't exist, that's not an error. That way a user without a project
+        // file can use the program to create his/her project list.
+        //
+        found = task_file.open( file_name );
+        if( !found ) {
+            return true;
+        }
+        record_bytes( probe, task_file.size( ) );
+
+        if( is_task_snapshot( task_file ) ) {
+            const char *snapshot_error = nullptr;
+            shard.format = TaskFileFormat::binary;
+            shard.mapping.swap( task_file );
+            if( !read_task_snapshot( shard.mapping, file_date, sequence, task_list, snapshot_error ) ) {
+                error = "File: " + file_name + " (" + snapshot_error + ")";
+                task_list.clear( );
+                return false;
+            }
+            return true;
+        }
+        if( is_task_xml( task_file ) ) {
+            std::string xml_error;
+            shard.format = TaskFileFormat::xml;
+            if( !read_task_xml( task_file, file_date, sequence, task_list, shard.xml_extras, shard.xml_task_extras, xml_error ) ) {
+                error = "File: " + file_name + " (" + xml_error + ")";
+                task_list.clear( );
+                return false;
+            }
+            return true;
+        }
+        shard.format = TaskFileFormat::text;
+
+        const char *const last = task_file.end( );
+        const char *line_start = task_file.begin( );
+        const char *line_end   = end_of_line( line_start, last );
+        std::size_t line_number = 1;
+        if( line_start == last ) return true;
+
+        // Read the date at the start of the file. Only this line goes through a stream. The date
+        // might be followed by the sequence number of the last journal record in the file and
+        // then by the next task ID. Only files with the next task ID have IDs on each line.
+        bool with_ids = false;
+        {
+            istringstream date_line( string( line_start, line_end ) );
+            if( !( date_line >> file_date ) ) {
+                error = "Line: 1, File: " + file_name + " (bad date)";
+                return false;
+            }
+            TaskId next_id;
+            if( !( date_line >> sequence ) ) sequence = 0;
+            else if( date_line >> next_id ) {
+                with_ids = true;
+                task_list.reserve_ids( next_id );
+            }
+        }
+        task_list.reserve( count_lines( line_start, last ) - 1 );
+
+        // Process the rest of the file one line at a time.
+        PixieTask new_task;
+        while( line_end != last ) {
+            line_start = line_end + 1;
+            line_end   = end_of_line( line_start, last );
+            ++line_number;
+            if( line_start == last ) break;
+
+            if( parse_line( line_start, line_end, new_task, with_ids ) ) {
+                task_list.push_back( std::move( new_task ) );
+            }
+            else {
+                error = "Line: " + to_string( line_number ) + ", File: " + file_name;
+                return false;
+            }
+        }
+        return true;
+    }
+
+
+    //! Replaces one file with another.
+    bool replace_file( const std::string &new_name, const std::string &file_name )
+    {
+#if defined(_WIN32)
+        std::remove( file_name.c_str( ) );
+#endif
+        return std::rename( new_name.c_str( ), file_name.c_str( ) ) == 0;
+    }
+
+
+    //! Loads a shard other than the main task file into its own list.
+    /*!
+     * Compaction writes every shard it saves under a temporary name, then replaces the main task
+     * file, and only then renames the other temporary files. A temporary shard file with the
+     * same sequence number as the main task file was thus part of a completed compaction and
+     * replaces the shard; any other temporary file is left over from a compaction that failed.
+     *
+     * A shard that was not saved when the day changed is brought forward to the date of the main
+     * task file. This function only touches its parameters (and the shard's files).
+     */
+    void load_shard( Shard &shard,
+                     TaskList &task_list,
+                     bool main_found,
+                     unsigned long long main_sequence,
+                     long main_day,
+                     LatencyProbe &probe )
+    {
+        spica::Date file_date;
+        unsigned long long sequence = 0;
+        bool found = false;
+        bool loaded = false;
+
+        const std::string temporary_name = shard.file_name + ".new";
+        if( ifstream( temporary_name.c_str( ) ).good( ) ) {
+            loaded = read_task_file( temporary_name, task_list, shard, file_date, sequence, found, probe, shard.error ) &&
+                     main_found && sequence == main_sequence &&
+                     replace_file( temporary_name, shard.file_name );
+            if( !loaded ) {
+                std::remove( temporary_name.c_str( ) );
+                task_list.clear( );
+                shard.mapping.close( );
+                shard.error.clear( );
+                shard.xml_extras.clear( );
+                shard.xml_task_extras.clear( );
+            }
+        }
+        if( !loaded ) {
+            sequence = 0;
+            if( !read_task_file( shard.file_name, task_list, shard, file_date, sequence, found, probe, shard.error ) ) {
+                shard.unreadable = true;
+                task_list.clear( );
+                return;
+            }
+            if( !found ) return;
+        }
+
+        const long day = date_number( file_date );
+        if( day < main_day ) {
+            task_list.clear_today( );
+            task_list.charge_workdays( static_cast< int >( workdays_between( day, main_day ) ) );
+        }
+    }
+
+
+    //! The tasks of one shard while the shards are being loaded.
+    struct LoadedShard {
+        TaskList                     tasks;
+        std::vector< TaskId >        ids;   //!< The ID of each task.
+        std::vector< unsigned char > hot;   //!< See find_hot( ).
+    };
+
+
+    //! Puts a loaded shard into priority order and works out what merge_shards( ) needs to know.
+    /*!
+     * The IDs are gathered here, by the loading threads, because the slot map of a sorted list
+     * scatters them; reading them during the merge would miss the cache for nearly every task.
+     */
+    void prepare_shard( LoadedShard &shard )
+    {
+        vector< std::size_t > order;
+        if( sort_list( shard.tasks, order, shard.hot ) ) find_hot( shard.tasks, shard.hot );
+        shard.ids.resize( shard.tasks.size( ) );
+        for( std::size_t i = 0; i < shard.tasks.size( ); ++i ) shard.ids[i] = shard.tasks.id( i );
+    }
+
+
+    //! Moves the task at the given position out of a list, leaving an empty description behind.
+    PixieTask take_task( TaskList &list, std::size_t position, TaskId task_id )
+    {
+        PixieTask task;
+        task.id                = task_id;
+        task.priority          = list.priority[position];
+        task.start_time        = list.start_time[position];
+        task.accumulated       = list.accumulated[position];
+        task.accumulated_today = list.today( position );
+        task.daily             = list.daily[position];
+        task.accumulated_debt  = list.debt( position );
+        task.description       = list.take_description( position );
+        return task;
+    }
+
+
+    //! Merges shards that are each in priority order into the (empty) task list.
+    /*!
+     * This is a k-way merge: a heap holds the first remaining task of each shard and the task
+     * with the highest priority is taken next. Ties go to the shard with the lower index, so the
+     * result is what a stable sort of all the shards, one after the other, would give.
+     */
+    void merge_shards( vector< unique_ptr< LoadedShard > > &loaded )
+    {
+        struct Cursor {
+            std::uint16_t shard;
+            std::size_t   position;
+        };
+
+        // Returns true if the task under left goes after the task under right.
+        const auto later = [&loaded]( const Cursor &left, const Cursor &right ) {
+            const LoadedShard &left_shard  = *loaded[left.shard];
+            const LoadedShard &right_shard = *loaded[right.shard];
+            const bool left_hot  = left_shard.hot[left.position] != 0;
+            const bool right_hot = right_shard.hot[right.position] != 0;
+            if( left.shard < right.shard )
+                return compare_keys( right_shard.tasks, right_hot, right.position, left_shard.tasks, left_hot, left.position );
+            else
+                return !compare_keys( left_shard.tasks, left_hot, left.position, right_shard.tasks, right_hot, right.position );
+        };
+
+        std::size_t total_count = 0;
+        vector< Cursor > heap;
+        for( std::size_t i = 0; i < loaded.size( ); ++i ) {
+            total_count += loaded[i]->tasks.size( );
+            tasks.reserve_ids( loaded[i]->tasks.next_id( ) );
+            if( !loaded[i]->tasks.empty( ) ) heap.push_back( Cursor{ static_cast< std::uint16_t >( i ), 0 } );
+        }
+        make_heap( heap.begin( ), heap.end( ), later );
+        tasks.reserve( total_count );
+
+        while( !heap.empty( ) ) {
+            pop_heap( heap.begin( ), heap.end( ), later );
+            Cursor &next = heap.back( );
+            LoadedShard &shard = *loaded[next.shard];
+            const TaskId task_id = shard.ids[next.position];
+            tasks.push_back( take_task( shard.tasks, next.position, task_id ), next.shard );
+
+            // A shard copied from elsewhere might use IDs that are already taken.
+            const TaskId new_id = tasks.id( tasks.size( ) - 1 );
+            if( new_id != task_id ) {
+                XmlTaskExtras &extras = shards[next.shard]->xml_task_extras;
+                const auto entry = extras.find( task_id );
+                if( entry != extras.end( ) ) {
+                    string moved = std::move( entry->second );
+                    extras.erase( entry );
+                    extras[new_id] = std::move( moved );
+                }
+                shards[next.shard]->changed = true;
+            }
+
+            if( ++next.position == shard.tasks.size( ) )
+                heap.pop_back( );
+            else
+                push_heap( heap.begin( ), heap.end( ), later );
+        }
+    }
+
+
+    //! Warns that some tasks read from the given shard had their priority clamped (see TaskList::clamped( )).
+    void report_clamped( const Shard &shard, std::size_t count )
+    {
+        if( count == 0 ) return;
+        cerr << "Warning! " << count << " task(s) in " << shard.file_name << " had a priority outside 1 to "
+             << TaskList::max_priority << "; the nearest priority in range was used" << endl;
+    }
+
+
+    //! Reads the main task file and every other shard, merging them into the task list.
+    /*!
+     * The shards are read by a pool of threads, each into a list of its own that is then put into
+     * priority order. Since every list is in order the task list comes out of the merge in order.
+     */
+    bool read_shards( LatencyProbe &probe )
+    {
+        vector< unique_ptr< LoadedShard > > loaded;
+        for( std::size_t i = 0; i < shards.size( ); ++i ) loaded.emplace_back( new LoadedShard );
+
+        // The main task file decides which temporary shard files are kept, so it is read first.
+        bool complete = read_task_file(
+            task_file_name, loaded[0]->tasks, *shards[0], task_file_date, task_file_sequence, task_file_found, probe, shards[0]->error );
+        if( !complete ) {
+            shards[0]->unreadable = true;
+            cerr << "Error in task file! " << shards[0]->error << " (the task file won't be saved)" << endl;
+        }
+
+        const long main_day = date_number( task_file_date );
+        const unsigned core_count = max( 1U, thread::hardware_concurrency( ) );
+        ThreadPool pool( static_cast< unsigned >( min< std::size_t >( shards.size( ), core_count ) ) );
+        pool.run( shards.size( ), [&]( std::size_t i ) {
+            if( i != 0 ) load_shard( *shards[i], loaded[i]->tasks, task_file_found, task_file_sequence, main_day, probe );
+            prepare_shard( *loaded[i] );
+        } );
+
+        for( std::size_t i = 0; i < shards.size( ); ++i ) report_clamped( *shards[i], loaded[i]->tasks.clamped( ) );
+        for( std::size_t i = 1; i < shards.size( ); ++i ) {
+            if( shards[i]->unreadable ) {
+                cerr << "Error in shard file! " << shards[i]->error << " (the shard won't be saved)" << endl;
+                complete = false;
+            }
+        }
+        merge_shards( loaded );
+        order_invalid = false;
+        return complete;
+    }
+
+
+    //! Gathers the unknown XML elements of the tasks in every shard into xml_task_extras.
+    void collect_xml_extras( )
+    {
+        shared_ptr< XmlTaskExtras > extras = make_shared< XmlTaskExtras >( );
+        for( auto &shard : shards ) {
+            for( auto &entry : shard->xml_task_extras ) ( *extras )[entry.first] = std::move( entry.second );
+            shard->xml_task_extras.clear( );
+        }
+        xml_task_extras = extras;
+    }
+
+
+    //! Reads the task file (and the other shards, if any) as it was written.
+    /*!
+     * Adjustments for days that have passed since the file was written are made separately by
+     * roll_over( ) so that the journal can be replayed first.
+     */
+    bool read_tasks( )
+    {
+        static LatencyProbe &probe = find_probe( "read_tasks( )" );
+        LatencyTimer timer( probe );
+
+        tasks.clear( );
+        invalidate_order( );
+        task_file_date = today;
+        task_file_sequence = 0;
+
+        bool complete;
+        if( shards.size( ) > 1 ) {
+            complete = read_shards( probe );
+        }
+        else {
+            complete = read_task_file(
+                task_file_name, tasks, *shards[0], task_file_date, task_file_sequence, task_file_found, probe, shards[0]->error );
+            if( !complete ) {
+                shards[0]->unreadable = true;
+                cerr << "Error in task file! " << shards[0]->error << " (the task file won't be saved)" << endl;
+            }
+            report_clamped( *shards[0], tasks.clamped( ) );
+        }
+        collect_xml_extras( );
+        return complete;
+    }
+
+
+    //! Adjusts the tasks for the days that have passed since list_day, making new_day current.
+    /*!
+     * This only changes counters in the task list. Only the debts of tasks with a daily
+     * allocation change, and only when workdays have passed, so only those tasks (found through
+     * the list's index of them) are moved when the list is next put in order.
+     */
+    void roll_over( long new_day )
+    {
+        const int workdays = static_cast< int >( workdays_between( list_day, new_day ) );
+        tasks.clear_today( );
+        tasks.charge_workdays( workdays );
+        list_day = new_day;
+        if( workdays != 0 ) {
+            for( std::size_t i = 0; i < tasks.daily_count( ); ++i ) mark_dirty( tasks.daily_position( i ) );
+        }
+        ++task_version;
+        journal.record( 'R', new_day );
+    }
+
+
+    //! Applies one journal record to the task list. Returns false if the record is malformed.
+    bool apply_record( const char *first, const char *last )
+    {
+        long long sequence;
+        long long position;
+
+        if( first != last && last[-1] == '\r' ) --last;
+        if( ( first = parse_integer( first, last, sequence ) ) == nullptr ) return false;
+        first = skip_blanks( first, last );
+        if( first == last ) return false;
+        const char operation = *first++;
+
+        // Records that are already reflected in the task file are skipped.
+        if( static_cast< unsigned long long >( sequence ) <= task_file_sequence ) return true;
+        replayed_sequence = static_cast< unsigned long long >( sequence );
+
+        switch( operation ) {
+        case 'P': {
+            PixieTask new_task;
+            if( ( first = parse_integer( first, last, position ) ) == nullptr ) return false;
+            if( position < 0 || static_cast< unsigned long long >( position ) > tasks.size( ) ) return false;
+            if( !parse_line( first, last, new_task ) ) return false;
+            if( static_cast< std::size_t >( position ) == tasks.size( ) )
+                append_task( std::move( new_task ) );
+            else
+                tasks.set( position, std::move( new_task ) );
+            mark_dirty( position );
+            touch_shard( position );
+            search_index_ready = false;
+            break;
+        }
+        case 'D':
+            if( ( first = parse_integer( first, last, position ) ) == nullptr ) return false;
+            if( position < 0 || static_cast< unsigned long long >( position ) >= tasks.size( ) ) return false;
+            touch_shard( position );
+            // Later records of these journals expect the tasks after this one to move down.
+            tasks.erase_in_order( position );
+            search_index_ready = false;
+            break;
+        case 'T': {
+            PixieTask new_task;
+            if( !parse_line( first, last, new_task, true ) ) return false;
+            std::size_t existing = tasks.find( new_task.id );
+            if( existing == TaskList::npos ) {
+                append_task( std::move( new_task ) );
+                existing = tasks.size( ) - 1;
+            }
+            else {
+                tasks.set( existing, std::move( new_task ) );
+            }
+            mark_dirty( existing );
+            touch_shard( existing );
+            search_index_ready = false;
+            break;
+        }
+        case 'E': {
+            // The times are left alone so that work recorded by other processes isn't lost.
+            PixieTask new_task;
+            if( !parse_line( first, last, new_task, true ) ) return false;
+            const std::size_t existing = tasks.find( new_task.id );
+            if( existing == TaskList::npos ) break;
+            tasks.start_time[existing] = new_task.start_time;
+            tasks.priority[existing]   = static_cast< std::uint8_t >( new_task.priority );
+            if( tasks.daily[existing] != new_task.daily ) tasks.set_daily( existing, new_task.daily );
+            const TaskDescription old_description = tasks.description( existing );
+            const TaskDescription &new_description = new_task.description;
+            if( old_description.size( ) != new_description.size( ) ||
+                memcmp( old_description.data( ), new_description.data( ), new_description.size( ) ) != 0 ) {
+                tasks.rename( existing, new_description.data( ), new_description.data( ) + new_description.size( ) );
+                search_index_ready = false;
+            }
+            mark_dirty( existing );
+            touch_shard( existing );
+            break;
+        }
+        case 'A': {
+            long long task_id;
+            int minutes;
+            if( ( first = parse_integer( first, last, task_id ) ) == nullptr ) return false;
+            if( ( first = parse_integer( first, last, minutes ) ) == nullptr ) return false;
+            const std::size_t existing = tasks.find( static_cast< TaskId >( task_id ) );
+            if( existing == TaskList::npos ) break;
+            tasks.add_work( existing, minutes );
+            mark_dirty( existing );
+            touch_shard( existing );
+            break;
+        }
+        case 'X': {
+            // Two processes might both delete a task.
+            long long task_id;
+            if( ( first = parse_integer( first, last, task_id ) ) == nullptr ) return false;
+            const std::size_t existing = tasks.find( static_cast< TaskId >( task_id ) );
+            if( existing == TaskList::npos ) break;
+            touch_shard( existing );
+            erase_task( existing );
+            search_index_ready = false;
+            break;
+        }
+        case 'S': {
+            long long task_id;
+            if( ( first = parse_integer( first, last, task_id ) ) == nullptr ) return false;
+            const std::size_t existing = tasks.find( static_cast< TaskId >( task_id ) );
+            const std::size_t shard = find_shard( string( skip_blanks( first, last ), last ), true );
+            if( shard == shards.size( ) ) return false;
+            if( existing == TaskList::npos ) break;
+            touch_shard( existing );
+            tasks.shard[existing] = static_cast< std::uint16_t >( shard );
+            touch_shard( existing );
+            break;
+        }
+        case 'O':
+            // Only written by older versions, whose P and D records depend on the order.
+            order_tasks( );
+            break;
+        case 'U':
+            undo_daily( );
+            break;
+        case 'Z':
+            zero_tasks( );
+            break;
+        case 'R': {
+            long long day;
+            if( ( first = parse_integer( first, last, day ) ) == nullptr ) return false;
+            if( day > list_day ) roll_over( static_cast< long >( day ) );
+            break;
+        }
+        default:
+            return false;
+        }
+        return true;
+    }
+
+
+    //! Applies the records in the named journal (if it exists) to the task list.
+    /*!
+     * Recording must be turned off while this happens. Replay stops at the first record that
+     * can't be applied; normally that is a record left incomplete by a crash. This function
+     * returns false in that case. The size of the journal is stored in size.
+     */
+    bool replay_journal( const std::string &file_name, long &size )
+    {
+        static LatencyProbe &probe = find_probe( "replay_journal( )" );
+        LatencyTimer timer( probe );
+
+        MappedFile journal_file;
+
+        size = 0;
+        if( !journal_file.open( file_name ) ) {
+            return true;
+        }
+        size = static_cast< long >( journal_file.size( ) );
+        record_bytes( probe, journal_file.size( ) );
+
+        const char *const last = journal_file.end( );
+        const char *line_start = journal_file.begin( );
+        std::size_t line_number = 0;
+        while( line_start != last ) {
+            const char *line_end = end_of_line( line_start, last );
+            ++line_number;
+            if( line_end == last || !apply_record( line_start, line_end ) ) {
+                cerr << "Error in journal! Line: " << line_number
+                     << ", File: " << file_name << endl;
+                return false;
+            }
+            line_start = line_end + 1;
+        }
+        return true;
+    }
+
+
+    //! Makes the current task list, in priority order, available to task_snapshot( ).
+    /*!
+     * This copies the list when it has changed, so it is only done when a snapshot is needed.
+     */
+    void publish_tasks( )
+    {
+        order_tasks( );
+        if( published_version == task_version ) return;
+        atomic_store( &published_tasks, tasks.snapshot( ) );
+        published_version = task_version;
+    }
+
+
+    //! Returns the current date.
+    spica::Date current_date( )
+    {
+        const time_t now = time( NULL );
+        const struct tm * const cooked_time = localtime( &now );
+        return spica::Date( cooked_time->tm_year + 1900, cooked_time->tm_mon + 1, cooked_time->tm_mday );
+    }
+
+
+    //! A shard to be written by write_tasks( ).
+    struct ShardFile {
+        std::uint16_t  shard;
+        std::string    file_name;
+        TaskFileFormat format;
+        std::string    xml_extras;  //!< See Shard.
+    };
+
+
+    //! Waits for the named file to reach disk.
+    bool sync_file( const std::string &file_name ) noexcept
+    {
+#if defined(_WIN32)
+        (void)file_name;
+        return true;
+#else
+        const int descriptor = ::open( file_name.c_str( ), O_RDONLY );
+        if( descriptor < 0 ) return false;
+        const bool synced = fsync( descriptor ) == 0;
+        ::close( descriptor );
+        return synced;
+#endif
+    }
+
+
+    //! Writes the tasks in one shard of a list to the named file.
+    bool write_task_file( const ShardFile &file,
+                          const std::string &file_name,
+                          const spica::Date &file_date,
+                          unsigned long long sequence,
+                          const TaskList &task_list,
+                          const XmlTaskExtras &task_extras,
+                          LatencyProbe &probe )
+    {
+        const std::uint16_t shard = file.shard;
+
+        // Open the output file.
+        ofstream task_file( file_name.c_str( ), ios::binary );
+        if( !task_file ) {
+            return false;
+        }
+
+        if( file.format == TaskFileFormat::binary ) {
+            if( !write_task_snapshot( task_file, file_date, sequence, task_list, shard ) ) return false;
+        }
+        else if( file.format == TaskFileFormat::xml ) {
+            if( !write_task_xml( task_file, file_date, sequence, task_list, shard, file.xml_extras, task_extras ) ) return false;
+        }
+        else {
+            task_file << file_date << " " << sequence << " " << task_list.next_id( ) << "\n";
+
+            // Step down the vector and output one line for each project.
+            for( std::size_t i = 0; i < task_list.size( ); i++ ) {
+                if( task_list.shard[i] != shard ) continue;
+                task_file << task_list.id( i ) << " "
+                    << task_list.start_time[i] << " "
+                    << task_list.accumulated[i] << " "
+                    << task_list.today( i ) << " "
+                    << task_list.daily[i] << " "
+                    << static_cast< int >( task_list.priority[i] ) << " "
+                    << task_list.debt( i ) << " ";
+                task_file.write( task_list.description( i ).data( ), task_list.description( i ).size( ) );
+                task_file << "\n";
+            }
+        }
+        task_file.flush( );
+        if( !task_file ) {
+            return false;
+        }
+        record_bytes( probe, static_cast< unsigned long long >( task_file.tellp( ) ) );
+        task_file.close( );
+        return sync_file( file_name );
+    }
+
 
-    //! Sorts pixie tasks in the task window.
+    //! Writes shards of a list of tasks to their files. The first shard must be the main task file.
     /*!
-     * This function implements Pixie's task priority logic.
-     *
-     * \todo The way in which Pixie sorts tasks should be configurable.
+     * Each shard is written to a temporary file which then replaces the shard's file so that a
+     * crash while writing can't destroy the existing file. Replacing the main task file commits
+     * the entire set: it happens after every temporary file is complete, and the others are
+     * renamed afterwards (see load_shard( )). Each temporary file is on disk before it is renamed.
+     * Since this function is used by the save worker it only touches its parameters.
      */
-    bool compare_tasks( const PixieTask &left, const PixieTask &right ) noexcept
+    bool write_tasks( const vector< ShardFile > &files,
+                      const spica::Date &file_date,
+                      unsigned long long sequence,
+                      const TaskList &task_list,
+                      const XmlTaskExtras &task_extras )
     {
-        const bool left_hot = ( left.daily != 0 && left.accumulated_debt > 0 );
-        const bool right_hot = ( right.daily != 0 && right.accumulated_debt > 0 );
+        static LatencyProbe &probe = find_probe( "write_tasks( )" );
+        LatencyTimer timer( probe );
 
-        if( left_hot && right_hot ) {
-            if( left.priority == right.priority )
-                return left.accumulated_debt > right.accumulated_debt;
-            else
-                return left.priority > right.priority;
+        for( const ShardFile &file : files ) {
+            if( !write_task_file( file, file.file_name + ".new", file_date, sequence, task_list, task_extras, probe ) )
+                return false;
+        }
+        for( const ShardFile &file : files ) {
+            if( !replace_file( file.file_name + ".new", file.file_name ) ) return false;
         }
+        return true;
+    }
 
-        if( left_hot && !right_hot ) return true;
-        if( right_hot && !left_hot ) return false;
 
-        return ( right.priority * left.accumulated ) < ( left.priority * right.accumulated );
+    //! Returns the shards that a compaction must write: the main task file and every changed shard.
+    vector< ShardFile > changed_shards( )
+    {
+        vector< ShardFile > files;
+        for( std::size_t i = 0; i < shards.size( ); ++i ) {
+            const Shard &shard = *shards[i];
+            if( i != 0 && ( !shard.changed || shard.unreadable ) ) continue;
+            files.push_back( ShardFile{ static_cast< std::uint16_t >( i ), shard.file_name, shard.format, shard.xml_extras } );
+        }
+        return files;
     }
 
 
-    //! Parse a line from the task file.
-    /*!
-     * This function locates the start time, accumulated time, priority, and task description in
-     * that line and uses that information to load up the given task object. This function returns
-     * true if it is successful, and false otherwise.
-     *
-     * \todo This function is a horrible hack. However, don't waste time fixing it. Eventually the
-     * input file will be XML and read using an XML parser.
-     */
-    bool parse_line( const string &line, PixieTask &new_task )
+    //! Notes that the shards in the given set no longer need to be written.
+    void mark_saved( const vector< ShardFile > &files ) noexcept
     {
-        // Skip leading white space to locate the start of the first word.
-        const std::size_t word1_start = line.find_first_not_of( " \t", 0 );
-        if( word1_start == string::npos ) return false;
+        for( const ShardFile &file : files ) shards[file.shard]->changed = false;
+    }
 
-        // Find the end of this word.
-        const std::size_t word1_end = line.find_first_of( " \t", word1_start );
-        if( word1_end == string::npos ) return false;
 
-        string word1 = line.substr( word1_start, word1_end - word1_start );
+    // The save worker writes journal records, and rewrites the task files, on its own thread so
+    // that commands never wait for the disk. A burst of commands is written at once: the worker
+    // waits until no changes have arrived for save_delay, but not longer than save_limit after
+    // the first change it hasn't written.
+    //
+    const std::chrono::milliseconds save_delay( 1000 );
+    const std::chrono::milliseconds save_limit( 5000 );
+
+    //! Work for the save worker.
+    struct SaveRequest {
+        std::string        records;           //!< Journal records to write.
+        unsigned long long sequence = 0;      //!< Number of journal records made before the request.
+        bool               urgent   = false;  //!< True if the worker shouldn't wait for a pause.
+        bool               compact  = false;  //!< True if the task files must be rewritten.
+
+        // What to write when compacting. The snapshot includes every record made before the
+        // request and the first journal_seen bytes of the journal (as of journal_generation).
+        std::shared_ptr< const TaskList >      task_list;
+        std::vector< ShardFile >               files;
+        spica::Date                            file_date;
+        std::shared_ptr< const XmlTaskExtras > task_extras;
+        long                                   journal_seen       = 0;
+        unsigned                               journal_generation = 0;
+
+        std::chrono::steady_clock::time_point first_change;  //!< When the oldest record was passed on.
+        std::chrono::steady_clock::time_point last_change;   //!< When the newest record was passed on.
+
+        bool empty( ) const noexcept { return records.empty( ) && !compact; }
+    };
 
-        // Similarly for the second word...
-        const std::size_t word2_start = line.find_first_not_of( " \t", word1_end );
-        if( word2_start == string::npos ) return false;
+    std::thread             saver;                        //!< Runs save_worker( ).
+    std::mutex              save_mutex;                   //!< Protects the four variables below.
+    std::condition_variable save_requested;               //!< Signalled when pending_save changes.
+    std::condition_variable save_finished;                //!< Signalled when the worker finishes a request.
+    SaveRequest             pending_save;                 //!< Work the worker hasn't started.
+    bool                    saver_busy     = false;       //!< True while the worker writes.
+    bool                    saver_stopping = false;       //!< True if the worker should finish and exit.
+    std::atomic< bool >     compaction_pending( false );  //!< True from a compaction request until it is done.
+    std::atomic< bool >     save_failed( false );         //!< True if a write failed since the last report.
+    std::atomic< unsigned long long > saved_sequence( 0 ); //!< Number of journal records known to be on disk.
 
-        const std::size_t word2_end = line.find_first_of( " \t", word2_start );
-        if( word2_end == string::npos ) return false;
+    // What the save worker and the main thread know about the journal and task file that other
+    // processes share. Protected by save_mutex.
+    //
+    unsigned journal_generation = 0;                  //!< Counts the times this process emptied the journal.
+    std::vector< std::pair< long, long > > own_ranges; //!< Parts of the journal written by this process, in order.
+    FileStamp task_file_stamp;                         //!< The main task file as this process last read or wrote it.
 
-        string word2 = line.substr( word2_start, word2_end - word2_start );
+    unsigned long long written_sequence = 0;           //!< Sequence number of the last record written (save worker).
 
-        // Similarly for the third word...
-        const std::size_t word3_start = line.find_first_not_of( " \t", word2_end );
-        if( word3_start == string::npos ) return false;
 
-        const std::size_t word3_end = line.find_first_of( " \t", word3_start );
-        if( word3_end == string::npos ) return false;
+    //! Returns true if the journal only holds records that are reflected in the request's snapshot.
+    /*!
+     * Called by the save worker while it holds the lock file, with save_mutex locked. The
+     * snapshot includes everything up to journal_seen and every record this process wrote. If
+     * another process replaced the task file the snapshot doesn't include that either.
+     */
+    bool snapshot_complete( const SaveRequest &request )
+    {
+        if( !( stamp_file( task_file_name ) == task_file_stamp ) ) return false;
+        if( !journal.is_open( ) ) return true;
+
+        long position = ( request.journal_generation == journal_generation ) ? request.journal_seen : 0;
+        for( const auto &range : own_ranges ) {
+            if( range.second <= position ) continue;
+            if( range.first > position ) return false;
+            position = range.second;
+        }
+        return position >= journal.end( );
+    }
 
-        string word3 = line.substr( word3_start, word3_end - word3_start );
 
-        // Similarly for the fourth word...
-        const std::size_t word4_start = line.find_first_not_of( " \t", word3_end );
-        if( word4_start == string::npos ) return false;
+    //! Carries out one request of the save worker.
+    /*!
+     * The records are written before any compaction so that they are safe while the (possibly
+     * large) task files are written. A completed compaction contains every record in the journal,
+     * so the journal is emptied; records made in the meantime are still waiting in pending_save.
+     * If other processes wrote records that the snapshot doesn't include the compaction is put
+     * off (and every shard is written by the next one). The lock file is held throughout.
+     */
+    void perform_save( const SaveRequest &request )
+    {
+        LockHolder holder( saver_lock, true );
+        SharedCounters counters = saver_lock.read( );
+        written_sequence = max( written_sequence, counters.sequence );
+
+        bool saved = true;
+        if( !request.compact || journal.is_open( ) ) {
+            long offset = 0;
+            saved = journal.write( request.records, written_sequence, offset );
+            if( saved && !request.records.empty( ) ) {
+                lock_guard< mutex > lock( save_mutex );
+                own_ranges.push_back( make_pair( offset, journal.end( ) ) );
+            }
+        }
+        if( request.compact ) {
+            bool complete;
+            {
+                lock_guard< mutex > lock( save_mutex );
+                complete = snapshot_complete( request );
+            }
+            if( !complete ) {
+                compaction_failed = true;
+            }
+            else if( write_tasks( request.files, request.file_date, written_sequence, *request.task_list, *request.task_extras ) ) {
+                std::remove( old_journal_file_name.c_str( ) );
+                journal.truncate( );
+                compaction_failed = false;
+
+                lock_guard< mutex > lock( save_mutex );
+                ++journal_generation;
+                own_ranges.clear( );
+                task_file_stamp = stamp_file( task_file_name );
+            }
+            else {
+                compaction_failed = true;
+                saved = false;
+            }
+            compaction_pending = false;
+        }
+        counters.sequence = written_sequence;
+        saver_lock.write( counters );
 
-        const std::size_t word4_end = line.find_first_of( " \t", word4_start );
-        if( word4_end == string::npos ) return false;
+        if( saved ) saved_sequence = request.sequence;
+        else save_failed = true;
+    }
 
-        string word4 = line.substr( word4_start, word4_end - word4_start );
 
-        // Similarly for the fifth word...
-        const std::size_t word5_start = line.find_first_not_of( " \t", word4_end );
-        if( word5_start == string::npos ) return false;
+    //! Writes the requests in pending_save until saver_stopping is set and nothing is pending.
+    void save_worker( )
+    {
+        unique_lock< mutex > lock( save_mutex );
+        while( true ) {
+            if( pending_save.empty( ) ) {
+                if( saver_stopping ) return;
+                save_requested.wait( lock );
+                continue;
+            }
+            if( !saver_stopping && !pending_save.urgent ) {
+                const auto deadline =
+                    min( pending_save.last_change + save_delay, pending_save.first_change + save_limit );
+                if( chrono::steady_clock::now( ) < deadline ) {
+                    save_requested.wait_until( lock, deadline );
+                    continue;
+                }
+            }
 
-        const std::size_t word5_end = line.find_first_of( " \t", word5_start );
-        if( word5_end == string::npos ) return false;
+            SaveRequest request( std::move( pending_save ) );
+            pending_save = SaveRequest( );
+            saver_busy = true;
+            lock.unlock( );
+            perform_save( request );
+            lock.lock( );
+            saver_busy = false;
+            save_finished.notify_all( );
+        }
+    }
 
-        string word5 = line.substr( word5_start, word5_end - word5_start );
 
-        // Similarly for the sixth word...
-        const std::size_t word6_start = line.find_first_not_of( " \t", word5_end );
-        if( word6_start == string::npos ) return false;
+    //! Starts the save worker. The journal must be open (if it can be).
+    void start_saver( )
+    {
+        pending_save   = SaveRequest( );
+        saver_stopping = false;
+        saved_sequence = journal.record_count( );
+        saver = thread( save_worker );
+    }
 
-        const std::size_t word6_end = line.find_first_of( " \t", word6_start );
-        if( word6_end == string::npos ) return false;
 
-        string word6 = line.substr( word6_start, word6_end - word6_start );
+    //! Waits for the save worker to write everything passed to it and then stops it.
+    void stop_saver( )
+    {
+        if( !saver.joinable( ) ) return;
+        {
+            lock_guard< mutex > lock( save_mutex );
+            saver_stopping = true;
+        }
+        save_requested.notify_one( );
+        saver.join( );
+    }
 
-        // Locate the start of the description.
-        const std::size_t word7_start = line.find_first_not_of( " \t", word6_end );
-        if( word7_start == string::npos ) return false;
 
-        // Load up the result.
-        new_task.start_time = atoi( word1.c_str( ) );
-        new_task.accumulated = atoi( word2.c_str( ) );
-        new_task.accumulated_today = atoi( word3.c_str( ) );
-        new_task.daily = atoi( word4.c_str( ) );
-        new_task.priority = atoi( word5.c_str( ) );
-        new_task.accumulated_debt = atoi( word6.c_str( ) );
-        new_task.description = line.substr( word7_start );
-        return true;
+    //! Waits for the save worker to write everything passed to it.
+    void wait_for_saver( )
+    {
+        unique_lock< mutex > lock( save_mutex );
+        save_finished.wait( lock, []( ) { return !saver_busy && pending_save.empty( ); } );
     }
 
 
-    bool read_tasks( )
+    //! Tells the user if the save worker failed to write something.
+    void report_save_failure( )
     {
-        spica::Date file_date;
-        string      line;
+        if( save_failed.exchange( false ) ) {
+            cerr << "Can't save the task list: " << task_file_name << endl;
+        }
+    }
 
-        // Open the file. If it doesn't exist, that's not an error. That way a user without a project
-        // file can use the program to create his/her project list.
-        //
-        ifstream task_file( task_file_name.c_str( ) );
-        if( !task_file ) {
-            return true;
+
+    //! Passes the journal records made since the last request to the save worker.
+    /*!
+     * If compact, the worker also rewrites the task file (and changed shards) from a snapshot of
+     * the task list and then empties the journal. This is also done for every change when there
+     * is no journal. A compaction that is still pending when more changes arrive is updated to the
+     * newer snapshot. If urgent, the worker doesn't wait for the commands to pause. The caller
+     * only waits for the worker to take (or finish) a request, never for the disk.
+     */
+    void request_save( bool compact, bool urgent )
+    {
+        const bool changed = journal.has_records( );
+        if( changed && !journal.is_open( ) ) compact = true;
+
+        // A main task file that couldn't be read completely is never rewritten, since the tasks
+        // after the error would be lost. The journal keeps every change instead.
+        if( shards[0]->unreadable ) compact = false;
+
+        // A compaction writes the published list. Otherwise only the journal records are passed on.
+        bool compacting = compact;
+        {
+            lock_guard< mutex > lock( save_mutex );
+            compacting = compacting || pending_save.compact;
+        }
+        if( snapshot_wanted.exchange( false ) || compacting ) publish_tasks( );
+
+        lock_guard< mutex > lock( save_mutex );
+        SaveRequest &request = pending_save;
+        if( changed || compact ) {
+            const auto now = chrono::steady_clock::now( );
+            if( request.empty( ) ) request.first_change = now;
+            request.last_change = now;
+        }
+        journal.take( request.records );
+        request.sequence = journal.record_count( );
+        request.urgent   = request.urgent || urgent;
+
+        if( compact || request.compact ) {
+            if( compact ) {
+                compaction_pending = true;
+                if( compaction_failed ) touch_all_shards( );
+            }
+            for( const ShardFile &file : changed_shards( ) ) {
+                const auto same_shard = [&file]( const ShardFile &other ) { return other.shard == file.shard; };
+                const auto existing = find_if( request.files.begin( ), request.files.end( ), same_shard );
+                if( existing == request.files.end( ) ) request.files.push_back( file );
+                else *existing = file;
+            }
+            mark_saved( request.files );
+            request.compact     = true;
+            request.task_list   = atomic_load( &published_tasks );
+            request.file_date   = today;
+            request.task_extras = xml_task_extras;
+            request.journal_seen       = journal_read;
+            request.journal_generation = journal_read_generation;
         }
+        if( !request.empty( ) ) save_requested.notify_one( );
+    }
 
-        tasks.clear( );
 
-        // Read the date at the start of the file.
-        task_file >> file_date;
-        getline( task_file, line );  // Eat the rest of the first line.
+    //! Reads the task file and the other shards and then replays the journal.
+    /*!
+     * The caller holds main_lock exclusively (loading can finish an interrupted compaction).
+     * Returns false if the task file or the journal is damaged. Adjustments for a new day are
+     * left to the caller.
+     */
+    bool load_tasks( )
+    {
+        // The main task file is the first shard. Any others are in the shard folder.
+        shards.clear( );
+        shards.emplace_back( new Shard );
+        shards[0]->name      = "-";
+        shards[0]->file_name = task_file_name;
+        for( const string &name : list_shard_files( ) ) {
+            if( shards.size( ) == max_shards ) {
+                cerr << "Too many shards; only " << max_shards - 1 << " are loaded" << endl;
+                break;
+            }
+            add_shard( name );
+        }
+        read_tasks( );
+        list_day = date_number( task_file_date );
+
+        // An old journal means an earlier compaction didn't finish. The journal might have started
+        // a new day already (see refresh_date( )).
+        long old_journal_size;
+        journal.set_recording( false );
+        compaction_failed = ifstream( old_journal_file_name.c_str( ) ).good( );
+        const bool journal_complete =
+            replay_journal( old_journal_file_name, old_journal_size ) && replay_journal( journal_file_name, journal_read );
+        journal.set_recording( true );
+
+        lock_guard< mutex > lock( save_mutex );
+        journal_read_generation = journal_generation;
+        own_ranges.clear( );
+        task_file_stamp = stamp_file( task_file_name );
+        return journal_complete;
+    }
 
-        // Read the project file one line at a time.
-        while( getline( task_file, line ) ) {
-            PixieTask new_task;
-            if( !parse_line( line, new_task ) ) {
-#ifdef NEVER
-                cerr << "Error in project file! Line: "
-                    << line_counter << ", File: " << file_name << endl;
-#endif
-                return false;
+
+    //! Starts watching the task file and journal, if that wasn't tried already.
+    /*!
+     * The watch is only worth its cost (creating and closing an inotify instance takes longer
+     * than loading a short task list) in a process that syncs more than once. Changes made before
+     * the watch started aren't reported by it, so the next sync looks at the journal anyway.
+     */
+    void start_task_watch( )
+    {
+        if( task_watch_started ) return;
+        task_watch_started = true;
+        task_watch.open( task_folder, { ".pixie-tasks", ".pixie-tasks.journal" } );
+        sync_pending = true;
+    }
+
+
+    //! Applies the records that other processes added to the journal since it was last read.
+    /*!
+     * The caller holds main_lock. Records this process wrote are skipped since they are applied
+     * already. Returns false, applying nothing, if another process replaced the task file since
+     * this process read it; then the journal no longer follows the loaded task file.
+     */
+    bool read_journal_tail( )
+    {
+        const FileStamp current_stamp = stamp_file( task_file_name );
+        vector< pair< long, long > > skipped;
+        {
+            lock_guard< mutex > lock( save_mutex );
+            if( !( current_stamp == task_file_stamp ) ) return false;
+            if( journal_read_generation != journal_generation ) {
+                // This process emptied the journal after applying everything in it.
+                journal_read_generation = journal_generation;
+                journal_read = 0;
             }
-            if( file_date != today ) {
-                new_task.accumulated_today = 0;
-                if( new_task.daily != 0 )
-                    new_task.accumulated_debt += ( workday_difference( today, file_date ) ) * new_task.daily;
+            own_ranges.erase(
+                remove_if( own_ranges.begin( ), own_ranges.end( ),
+                    []( const pair< long, long > &range ) { return range.second <= journal_read; } ),
+                own_ranges.end( ) );
+            skipped = own_ranges;
+        }
+
+        FILE *journal_file = fopen( journal_file_name.c_str( ), "rb" );
+        if( journal_file == nullptr ) return true;
+        long size = -1;
+        if( fseek( journal_file, 0, SEEK_END ) == 0 ) size = ftell( journal_file );
+        if( size > journal_read && fseek( journal_file, journal_read, SEEK_SET ) == 0 ) {
+            journal_tail.resize( static_cast< std::size_t >( size - journal_read ) );
+            journal_tail.resize( fread( &journal_tail[0], 1, journal_tail.size( ), journal_file ) );
+        }
+        else {
+            journal_tail.clear( );
+        }
+        fclose( journal_file );
+
+        // Only complete lines are applied; the rest is read again next time.
+        const char *const tail = journal_tail.data( );
+        std::size_t line_start = 0;
+        std::size_t line_end;
+        std::size_t next_skipped = 0;
+        bool applied = false;
+        journal.set_recording( false );
+        while( ( line_end = journal_tail.find( '\n', line_start ) ) != string::npos ) {
+            const long offset = journal_read + static_cast< long >( line_start );
+            while( next_skipped < skipped.size( ) && skipped[next_skipped].second <= offset ) ++next_skipped;
+            if( next_skipped == skipped.size( ) || skipped[next_skipped].first > offset ) {
+                if( apply_record( tail + line_start, tail + line_end ) ) {
+                    applied = true;
+                }
+                else {
+                    cerr << "Error in journal! Offset: " << offset << ", File: " << journal_file_name << endl;
+                }
             }
-            tasks.push_back( new_task );
+            line_start = line_end + 1;
         }
+        journal.set_recording( true );
+        journal_read += static_cast< long >( line_start );
+        if( applied ) ++task_version;
         return true;
     }
 
 
-    bool write_tasks( )
+    //! Loads the task list again after another process replaced the task file.
+    /*!
+     * Everything this process changed is written to the journal first, so the new task file and
+     * the journal together include it.
+     */
+    void reload_tasks( )
     {
-        // Open the output file.
-        ofstream task_file( task_file_name.c_str( ) );
-        if( !task_file ) {
-#ifdef NEVER
-            cerr << "Can't open project file: " << file_name << endl;
-#endif
-            return false;
+        static LatencyProbe &probe = find_probe( "reload_tasks( )" );
+        LatencyTimer timer( probe );
+
+        request_save( false, true );
+        wait_for_saver( );
+        report_save_failure( );
+
+        // Published snapshots might refer to descriptions in the old mappings, so they are kept
+        // until those snapshots are gone.
+        vector< shared_ptr< const void > > old_mappings;
+        for( auto &shard : shards ) {
+            if( shard->mapping.size( ) == 0 ) continue;
+            shared_ptr< MappedFile > old_mapping = make_shared< MappedFile >( );
+            old_mapping->swap( shard->mapping );
+            old_mappings.push_back( std::move( old_mapping ) );
+        }
+        {
+            LockHolder holder( main_lock, true );
+            load_tasks( );
+        }
+        for( auto &old_mapping : old_mappings ) tasks.retire_storage( std::move( old_mapping ) );
+        search_index.clear( );
+        search_index_ready = false;
+        ++task_version;
+        if( list_day != date_number( today ) ) {
+            roll_over( date_number( today ) );
         }
 
-        task_file << today << "\n";
+        // Replacing the published snapshot, which is out of date anyway, lets the old mappings go
+        // once no reader holds an older snapshot. Loading took longer than copying the list.
+        publish_tasks( );
+    }
+
 
-        // Step down the vector and output one line for each project.
-        for( vector< PixieTask >::size_type i = 0; i < tasks.size( ); i++ ) {
-            task_file << tasks[i].start_time << " "
-                << tasks[i].accumulated << " "
-                << tasks[i].accumulated_today << " "
-                << tasks[i].daily << " "
-                << tasks[i].priority << " "
-                << tasks[i].accumulated_debt << " "
-                << tasks[i].description << endl;
+    //! Returns an ID for a new task that no other process gives to one of its tasks.
+    /*!
+     * IDs are claimed through the lock file a block at a time. Returns zero (so that the task
+     * list chooses) if there is no lock file.
+     */
+    TaskId claim_id( )
+    {
+        if( !main_lock.is_open( ) ) return 0;
+        if( next_claimed_id == claimed_end ) {
+            LockHolder holder( main_lock, true );
+            SharedCounters counters = main_lock.read( );
+            next_claimed_id  = max( counters.next_id, tasks.next_id( ) );
+            claimed_end      = next_claimed_id + id_block_size;
+            counters.next_id = claimed_end;
+            main_lock.write( counters );
         }
-        return true;
+        return next_claimed_id++;
     }
-
 }
 
 
 void initialize_tasks( )
 {
     // Figure out today's date and store it.
-    const time_t now = time( NULL );
-    const struct tm * const cooked_time = localtime( &now );
-    today.set(cooked_time->tm_year + 1900, cooked_time->tm_mon + 1, cooked_time->tm_mday );
+    today = current_date( );
+    command_thread = this_thread::get_id( );
+    build_workday_table( date_number( today ) );
 
     // Read the task file.
     char *pixie_folder = getenv( "PIXIE_HOME" );
@@ -226,119 +1794,355 @@ void initialize_tasks( )
     task_file_name =  pixie_folder;
     task_file_name += '/';
     task_file_name += ".pixie-tasks";
-    read_tasks( );
+    journal_file_name = task_file_name + ".journal";
+    old_journal_file_name = journal_file_name + ".old";
+    lock_file_name = task_file_name + ".lock";
+    if( !history.open( string( pixie_folder ) + "/.pixie-history" ) ) {
+        cerr << "Can't open the session history; sessions won't be recorded" << endl;
+    }
+    changed_tasks.reserve( max_dirty_tasks );
+    moved_tasks.reserve( max_dirty_tasks );
+    search_index.clear( );
+    search_index_ready = false;
+    shard_folder = string( pixie_folder ) + "/.pixie-shards";
+
+    // Other processes using the task list are noticed from here on.
+    if( !main_lock.open( lock_file_name ) || !saver_lock.open( lock_file_name ) ) {
+        cerr << "Can't open the lock file; other Pixie processes might overwrite changes" << endl;
+    }
+    task_folder        = pixie_folder;
+    task_watch_started = false;
+    synced_once        = false;
+    sync_pending       = false;
+    next_claimed_id = 0;
+    claimed_end     = 0;
+
+    bool journal_complete;
+    {
+        LockHolder holder( main_lock, true );
+        journal_complete = load_tasks( );
+        written_sequence = max( max( task_file_sequence, replayed_sequence ), main_lock.read( ).sequence );
+    }
+    journal.open( journal_file_name );
+    start_saver( );
+    if( list_day != date_number( today ) ) {
+        roll_over( date_number( today ) );
+    }
+
+    // Start a new task file (and journal) on a new day so that the journal doesn't grow across
+    // many days. Also start with a clean journal if the old one is damaged or too large.
+    if( !task_file_found || task_file_date != today || !journal_complete ||
+         compaction_failed || journal.size( ) > journal_limit ) {
+        request_save( true, true );
+        wait_for_saver( );
+        report_save_failure( );
+    }
+    publish_tasks( );
+}
+
+
+void refresh_date( )
+{
+    const spica::Date current = current_date( );
+    if( current == today ) return;
+
+    // Only a record of the new day goes to the journal. The task file is rewritten by the next
+    // compaction; the journal can span dates since it records the day changes.
+    today = current;
+    roll_over( date_number( today ) );
 }
 
 
 void cleanup_tasks( )
 {
-    save_tasks( );
+    request_save( journal.size( ) > journal_limit && !compaction_pending, true );
+    stop_saver( );
+    report_save_failure( );
+    journal.close( );
+    task_watch.close( );
+    main_lock.close( );
+    saver_lock.close( );
+    history.close( );
 }
 
 
-void add_minutes( int task_number, int additional_minutes) noexcept
+void sync_tasks( )
 {
-    task_number--;
-    if( task_number < 0 || static_cast< unsigned >( task_number ) >= tasks.size( ) ) return;
+    if( synced_once ) start_task_watch( );
+    synced_once = true;
+    if( !task_watch.changed( ) && !sync_pending ) return;
+
+    static LatencyProbe &probe = find_probe( "sync_tasks( )" );
+    LatencyTimer timer( probe );
+
+    // A process holding the lock exclusively is writing; its changes are picked up next time.
+    sync_pending = true;
+    if( !main_lock.try_lock( false ) ) return;
+    const bool current = read_journal_tail( );
+    main_lock.unlock( );
+    if( !current ) reload_tasks( );
+    sync_pending = false;
+}
 
-    tasks[task_number].accumulated += additional_minutes;
-    tasks[task_number].accumulated_today += additional_minutes;
-    if( tasks[task_number].daily != 0 ) {
-        tasks[task_number].accumulated_debt -= additional_minutes;
-    }
+
+int task_watch_descriptor( )
+{
+    start_task_watch( );
+    return task_watch.descriptor( );
 }
 
 
-void change_daily( int task_number, int new_daily ) noexcept
+void convert_tasks( TaskFileFormat format )
 {
-    task_number--;
-    if( task_number < 0 || static_cast< unsigned >( task_number ) >= tasks.size( ) ) return;
-    if( new_daily < 0 ) return;
+    for( auto &shard : shards ) shard->format = format;
+    touch_all_shards( );
+    request_save( true, true );
+    wait_for_saver( );
+    report_save_failure( );
+}
+
+
+void commit_tasks( )
+{
+    static LatencyProbe &probe = find_probe( "commit_tasks( )" );
+    LatencyTimer timer( probe );
 
-    if( new_daily == 0 ) {
-        tasks[task_number].daily = 0;
-        tasks[task_number].accumulated_debt = 0;
+    request_save( journal.size( ) > journal_limit && !compaction_pending, false );
+    report_save_failure( );
+}
+
+
+std::shared_ptr< const TaskList > task_snapshot( )
+{
+    if( this_thread::get_id( ) == command_thread ) {
+        publish_tasks( );
     }
     else {
-        const int debt_adjustment = new_daily - tasks[task_number].daily;
-        tasks[task_number].daily = new_daily;
-        tasks[task_number].accumulated_debt += debt_adjustment;
+        snapshot_wanted.store( true );
     }
+    return atomic_load( &published_tasks );
 }
 
 
-void change_priority( int task_number, int new_priority ) noexcept
+bool task_exists( TaskRef task ) noexcept
 {
-    task_number--;
-    if( task_number < 0 || static_cast< unsigned >( task_number ) >= tasks.size( ) ) return;
-    if( new_priority < 1 || new_priority >= 100 ) return;
+    return locate( task ) != TaskList::npos;
+}
+
+
+TaskId task_id( TaskRef task ) noexcept
+{
+    const std::size_t position = locate( task );
+    return ( position == TaskList::npos ) ? 0 : tasks.id( position );
+}
+
+
+int task_count( ) noexcept
+{
+    return static_cast< int >( tasks.size( ) );
+}
+
+
+std::uint64_t claim_entity_id( std::uint64_t at_least )
+{
+    // IDs below at_least left in the claimed block are given up.
+    tasks.reserve_ids( at_least );
+    if( next_claimed_id < at_least ) next_claimed_id = claimed_end;
+    TaskId id = claim_id( );
+    if( id == 0 ) id = tasks.next_id( );
+    tasks.reserve_ids( id + 1 );
+    return id;
+}
+
+
+void add_minutes( TaskRef task, int additional_minutes ) noexcept
+{
+    static LatencyProbe &probe = find_probe( "add_minutes( )" );
+    LatencyTimer timer( probe );
 
-    tasks[task_number].priority = new_priority;
+    const std::size_t position = locate( task );
+    if( position == TaskList::npos ) return;
+
+    tasks.add_work( position, additional_minutes );
+    mark_dirty( position );
+    log_work( position, additional_minutes );
+}
+
+
+void change_daily( TaskRef task, int new_daily )
+{
+    static LatencyProbe &probe = find_probe( "change_daily( )" );
+    LatencyTimer timer( probe );
+
+    const std::size_t position = locate( task );
+    if( position == TaskList::npos ) return;
+    if( new_daily < 0 ) return;
+
+    tasks.set_daily( position, new_daily );
+    mark_dirty( position );
+    log_edit( position );
+}
+
+
+void change_priority( TaskRef task, int new_priority ) noexcept
+{
+    static LatencyProbe &probe = find_probe( "change_priority( )" );
+    LatencyTimer timer( probe );
+
+    const std::size_t position = locate( task );
+    if( position == TaskList::npos ) return;
+    if( new_priority < 1 || new_priority > TaskList::max_priority ) return;
+
+    tasks.priority[position] = new_priority;
+    mark_dirty( position );
+    log_edit( position );
 }
 
 
 // Why doesn't PixieTask have a constructor?
-void create_task( const string &new_description, int initial_priority )
+void create_task( const char *first, const char *last, int initial_priority )
 {
+    static LatencyProbe &probe = find_probe( "create_task( )" );
+    LatencyTimer timer( probe );
+
     PixieTask new_task;
 
-    new_task.description       = new_description;
+    new_task.id                = claim_id( );
     new_task.priority          = initial_priority;
     new_task.start_time        = 0;
     new_task.accumulated       = 0;
     new_task.accumulated_today = 0;
     new_task.daily             = 0;
     new_task.accumulated_debt  = 0;
-    tasks.push_back( new_task );
+    append_task( std::move( new_task ) );
+    tasks.rename( tasks.size( ) - 1, first, last );
+    if( search_index_ready ) search_index.insert( tasks.id( tasks.size( ) - 1 ), first, last );
+    mark_dirty( tasks.size( ) - 1 );
+    log_task( tasks.size( ) - 1 );
+}
+
+
+void delete_task( TaskRef task ) noexcept
+{
+    static LatencyProbe &probe = find_probe( "delete_task( )" );
+    LatencyTimer timer( probe );
+
+    const std::size_t position = locate( task );
+    if( position == TaskList::npos ) return;
+
+    if( tasks.start_time[position] != 0 ) end_session( position, time( 0 ) );
+    const TaskDescription description = tasks.description( position );
+    history.name_deleted( tasks.id( position ), description.data( ), description.data( ) + description.size( ) );
+    if( search_index_ready ) {
+        search_index.erase( tasks.id( position ), description.data( ), description.data( ) + description.size( ) );
+    }
+    log_erase( position );
+    erase_task( position );
+}
+
+
+void rename( TaskRef task, const char *first, const char *last )
+{
+    static LatencyProbe &probe = find_probe( "rename( )" );
+    LatencyTimer timer( probe );
+
+    const std::size_t position = locate( task );
+    if( position == TaskList::npos ) return;
+
+    if( search_index_ready ) {
+        const TaskDescription description = tasks.description( position );
+        search_index.erase( tasks.id( position ), description.data( ), description.data( ) + description.size( ) );
+        search_index.insert( tasks.id( position ), first, last );
+    }
+    tasks.rename( position, first, last );
+    log_edit( position );
 }
 
 
-void delete_task( int task_number ) noexcept
+bool is_shard_name( const char *first, const char *last )
 {
-    task_number--;
-    if( task_number < 0 || static_cast< unsigned >( task_number ) >= tasks.size( ) ) return;
+    const string name( first, last );
+    return name == "-" || valid_shard_name( name );
+}
 
-    vector< PixieTask >::iterator delete_me = tasks.begin( ) + task_number;
-    tasks.erase( delete_me );
+
+bool is_policy_name( const char *first, const char *last ) noexcept
+{
+    SchedulingPolicy policy;
+    return find_policy( first, last, policy );
 }
 
 
-void rename( int task_number, const std::string &new_description )
+bool set_policy( const char *first, const char *last ) noexcept
 {
-    task_number--;
-    if( task_number < 0 || static_cast< unsigned >( task_number ) >= tasks.size( ) ) return;
+    SchedulingPolicy policy;
+    if( !find_policy( first, last, policy ) ) return false;
+    scheduler.select( policy );
+    return true;
+}
+
 
-    tasks[task_number].description = new_description;
+bool move_task( TaskRef task, const char *first, const char *last )
+{
+    static LatencyProbe &probe = find_probe( "move_task( )" );
+    LatencyTimer timer( probe );
+
+    const std::size_t position = locate( task );
+    const std::size_t shard = find_shard( string( first, last ), true );
+    if( position == TaskList::npos || shard == shards.size( ) || shards[shard]->unreadable ) return false;
+    if( tasks.shard[position] == shard ) return true;
+
+    touch_shard( position );
+    tasks.shard[position] = static_cast< std::uint16_t >( shard );
+    log_move( position );
+    return true;
 }
 
 
 void save_tasks( )
 {
-    write_tasks( );
+    static LatencyProbe &probe = find_probe( "save_tasks( )" );
+    LatencyTimer timer( probe );
+
+    request_save( false, true );
+}
+
+
+bool tasks_unsaved( ) noexcept
+{
+    return saved_sequence != journal.record_count( );
 }
 
 
-void start_task( int task_number ) noexcept
+void start_task( TaskRef task ) noexcept
 {
-     task_number--;
-    if( task_number < 0 || static_cast< unsigned >( task_number ) >= tasks.size( ) ) return;
+    static LatencyProbe &probe = find_probe( "start_task( )" );
+    LatencyTimer timer( probe );
+
+    const std::size_t position = locate( task );
+    if( position == TaskList::npos ) return;
 
     const time_t raw_time = time( 0 );
-    tasks[task_number].start_time = raw_time;
+    tasks.start_time[position] = raw_time;
+    log_edit( position );
 }
 
 
 void stop_tasks( ) noexcept
 {
-    for( vector< PixieTask >::size_type i = 0; i < tasks.size( ); i++ ) {
-        if( tasks[i].start_time != 0 ) {
-            const int minutes = static_cast< int >( time( 0 ) - tasks[i].start_time ) / 60;
-            tasks[i].accumulated       += minutes;
-            tasks[i].accumulated_today += minutes;
-            if( tasks[i].daily != 0 ) {
-                tasks[i].accumulated_debt -= minutes;
-            }
-            tasks[i].start_time = 0;
+    static LatencyProbe &probe = find_probe( "stop_tasks( )" );
+    LatencyTimer timer( probe );
+
+    const time_t now = time( 0 );
+    for( std::size_t i = 0; i < tasks.size( ); i++ ) {
+        if( tasks.start_time[i] != 0 ) {
+            end_session( i, now );
+            const int minutes = static_cast< int >( now - tasks.start_time[i] ) / 60;
+            tasks.add_work( i, minutes );
+            tasks.start_time[i] = 0;
+            mark_dirty( i );
+            log_edit( i );
+            log_work( i, minutes );
         }
     }
 }
@@ -346,53 +2150,256 @@ void stop_tasks( ) noexcept
 
 void undo_daily( ) noexcept
 {
-     for( vector< PixieTask >::size_type i = 0; i < tasks.size( ); i++ ) {
-        tasks[i].accumulated_debt -= tasks[i].daily;
-    }
+    static LatencyProbe &probe = find_probe( "undo_daily( )" );
+    LatencyTimer timer( probe );
+
+    tasks.charge_workdays( -1 );
+    for( std::size_t i = 0; i < tasks.daily_count( ); ++i ) mark_dirty( tasks.daily_position( i ) );
+    touch_all_shards( );
+    log_operation( 'U' );
 }
 
 
 void zero_tasks( ) noexcept
 {
-    for( vector< PixieTask >::size_type i = 0; i < tasks.size( ); i++ ) {
-        tasks[i].start_time        = 0;
-        tasks[i].accumulated       = 0;
-        tasks[i].accumulated_today = 0;
-        if( tasks[i].daily != 0 ) {
-            tasks[i].accumulated_debt = tasks[i].daily;
-        }
+    static LatencyProbe &probe = find_probe( "zero_tasks( )" );
+    LatencyTimer timer( probe );
+
+    const time_t now = time( 0 );
+    for( std::size_t i = 0; i < tasks.size( ); i++ ) {
+        if( tasks.start_time[i] != 0 ) end_session( i, now );
     }
+    zero_times( tasks );
+    invalidate_order( );
+    touch_all_shards( );
+    log_operation( 'Z' );
 }
 
 
-void display_tasks( )
+void sort_tasks( bool from_scratch )
 {
-    int total_priority_value = 0;
+    static LatencyProbe &probe = find_probe( "sort_tasks( )" );
+    LatencyTimer timer( probe );
+
+    if( from_scratch ) order_invalid = true;
+    order_tasks( );
+}
 
-    stable_sort( tasks.begin( ), tasks.end( ), compare_tasks );
 
-    for( vector< PixieTask >::size_type i = 0; i < tasks.size( ); ++i ) {
-        total_priority_value += tasks[i].priority;
+void display_tasks( )
+{
+    static LatencyProbe &probe = find_probe( "display_tasks( )" );
+    LatencyTimer timer( probe );
+
+    // The command thread can render the list itself; a snapshot would copy all of it.
+    order_tasks( );
+    const TaskList &view = tasks;
+
+    // The list is kept in display order, so the tasks with the highest priority are a prefix of it.
+    const std::size_t count = ( view_count == 0 ) ? view.size( ) : view_count;
+    std::size_t first = view_first;
+    if( first >= view.size( ) && first != 0 ) {
+        first = ( view.size( ) == 0 ) ? 0 : ( view.size( ) - 1 ) / count * count;
     }
+    renderer.render( view, first, count );
+}
+
+
+void show_tasks( int count ) noexcept
+{
+    view_first = 0;
+    view_count = static_cast< std::size_t >( count );
+    if( count != 0 ) page_size = view_count;
+}
+
+
+void show_page( int page ) noexcept
+{
+    view_first = static_cast< std::size_t >( page - 1 ) * page_size;
+    view_count = page_size;
+}
+
+
+bool set_redraw( bool enabled )
+{
+    return renderer.set_redraw( enabled );
+}
 
-    for( vector< PixieTask >::size_type i = 0; i < tasks.size( ); ++i ) {
-        const bool is_hot = ( tasks[i].daily && tasks[i].accumulated_debt > 0 );
-        ostringstream formatter;
 
-        formatter << setw(2) << i + 1 << ") ";
-        if( tasks[i].start_time != 0 ) {
-            formatter << "* ";
+void display_report( int weeks )
+{
+    static LatencyProbe &probe = find_probe( "display_report( )" );
+    LatencyTimer timer( probe );
+
+    if( !history.load( ) ) {
+        cout << "The session history isn't available" << endl;
+        return;
+    }
+
+    // Weeks start on Monday. Day zero (1970-01-01) was a Thursday.
+    const long today_number = day_number( time( 0 ) );
+    const long this_week = today_number - ( today_number + 3 ) % 7;
+
+    vector< pair< long long, std::size_t > > week_totals;
+    for( int week = 0; week < weeks; ++week ) {
+        const long first_day = this_week - 7L * week;
+        long long week_seconds = 0;
+
+        week_totals.clear( );
+        for( std::size_t task = 0; task < history.task_count( ); ++task ) {
+            const long long seconds = history.seconds( task, first_day, first_day + 7 );
+            if( seconds < 60 ) continue;
+            week_totals.push_back( make_pair( seconds, task ) );
+            week_seconds += seconds;
         }
-        else {
-            formatter << "  ";
+        sort( week_totals.begin( ), week_totals.end( ),
+            []( const pair< long long, std::size_t > &left, const pair< long long, std::size_t > &right ) {
+                return left.first > right.first;
+            } );
+
+        char week_text[16];
+        const time_t week_start = day_start( first_day );
+        strftime( week_text, sizeof( week_text ), "%Y-%m-%d", localtime( &week_start ) );
+        cout << "Week of " << week_text << ": " << week_seconds / 60 << " minutes\n";
+        for( const auto &entry : week_totals ) {
+            const TaskId task_id = history.task_id( entry.second );
+            cout << setw( 8 ) << entry.first / 60 << "  ";
+            const std::size_t position = tasks.find( task_id );
+            const string *deleted_name = history.deleted_name( task_id );
+            if( position != TaskList::npos ) {
+                const TaskDescription description = tasks.description( position );
+                cout.write( description.data( ), static_cast< streamsize >( description.size( ) ) );
+            }
+            else if( deleted_name != nullptr ) {
+                cout << *deleted_name << " (deleted)";
+            }
+            else {
+                cout << "#" << task_id << " (deleted)";
+            }
+            cout << "\n";
+        }
+    }
+    cout << history.session_count( ) << " sessions recorded" << endl;
+}
+
+
+bool export_records( const char *first, const char *last, const char *&error_message )
+{
+    static LatencyProbe &probe = find_probe( "export_records( )" );
+    LatencyTimer timer( probe );
+
+    ExportRequest request;
+    if( !parse_export( first, last, request, error_message ) ) return false;
+
+    ofstream file;
+    if( request.file_name != "-" ) {
+        file.open( request.file_name.c_str( ), ios::binary );
+        if( !file ) {
+            error_message = "can't create the export file";
+            return false;
         }
-        formatter << "time="  << setw(4) << tasks[i].accumulated << "/"
-                              << setw(4) << tasks[i].accumulated_debt << ", ";    // Could be negative.
-        formatter << "today=" << setw(3) << tasks[i].accumulated_today << "/"
-                              << setw(3) << tasks[i].daily << ", ";
-        formatter << "prio="  << setw(2) << tasks[i].priority << " ("
-                              << setw(5) << fixed << setprecision(1) << 100 * static_cast<double>( tasks[i].priority ) / total_priority_value << "%), ";
-        formatter << tasks[i].description;
-        cout << formatter.str( ).c_str( ) << endl;
     }
+    ostream &output = ( request.file_name == "-" ) ? cout : file;
+
+    if( request.source == ExportRequest::Source::sessions ) {
+        return export_sessions( history, tasks, request, output, error_message );
+    }
+    // The list doesn't change while it is written, so it can be exported without a snapshot.
+    order_tasks( );
+    vector< string > shard_names;
+    for( const auto &shard : shards ) shard_names.push_back( shard->name );
+    if( !export_tasks( tasks, shard_names, request, output ) ) {
+        error_message = "the export couldn't be written";
+        return false;
+    }
+    return true;
+}
+
+
+void display_memory( )
+{
+    const std::size_t used = tasks.memory_used( );
+
+    cout << tasks.size( ) << " tasks use " << used << " bytes";
+    if( !tasks.empty( ) ) {
+        cout << " (" << used / tasks.size( ) << " per task)";
+    }
+    std::size_t mapped = 0;
+    for( const auto &shard : shards ) mapped += shard->mapping.size( );
+    if( mapped != 0 ) {
+        cout << " plus " << mapped << " bytes of mapped snapshot";
+    }
+    if( search_index_ready ) {
+        cout << " plus " << search_index.memory_used( ) << " bytes of search index";
+    }
+    if( scheduler.memory_used( ) != 0 ) {
+        cout << " plus " << scheduler.memory_used( ) << " bytes of run queue";
+    }
+    cout << endl;
+}
+
+
+void display_matches( const char *first, const char *last )
+{
+    static LatencyProbe &probe = find_probe( "display_matches( )" );
+    LatencyTimer timer( probe );
+
+    if( !search_index_ready ) {
+        search_index.build( tasks );
+        search_index_ready = true;
+    }
+    std::size_t total;
+    const vector< TrigramIndex::Match > matches = search_index.search( tasks, first, last, max_matches, total );
+
+    // Near matches are marked with a tilde.
+    for( const TrigramIndex::Match &match : matches ) {
+        const TaskDescription description = tasks.description( match.position );
+        cout << setw( 5 ) << match.position + 1 << ") "
+             << ( match.score < TrigramIndex::substring_score ? '~' : ' ' )
+             << " #" << match.id << "  ";
+        cout.write( description.data( ), static_cast< streamsize >( description.size( ) ) );
+        cout << "\n";
+    }
+    if( total == 0 ) {
+        cout << "No matches\n";
+    }
+    else if( total > matches.size( ) ) {
+        cout << "(" << total - matches.size( ) << " more)\n";
+    }
+    cout << flush;
+}
+
+
+void display_next( )
+{
+    static LatencyProbe &probe = find_probe( "display_next( )" );
+    LatencyTimer timer( probe );
+
+    // The list is put in order so that the task number matches the displayed list.
+    order_tasks( );
+    const TaskId task_id = scheduler.next( tasks );
+    if( task_id == 0 ) {
+        cout << "No tasks" << endl;
+        return;
+    }
+    const std::size_t position = tasks.find( task_id );
+    const TaskDescription description = tasks.description( position );
+    cout << setw( 5 ) << position + 1 << ")  #" << task_id << "  ";
+    cout.write( description.data( ), static_cast< streamsize >( description.size( ) ) );
+    cout << "  (" << policy_name( scheduler.policy( ) ) << ")" << endl;
+}
+
+
+void display_shards( )
+{
+    vector< std::size_t > counts( shards.size( ), 0 );
+    for( std::size_t i = 0; i < tasks.size( ); ++i ) ++counts[tasks.shard[i]];
+
+    for( std::size_t i = 0; i < shards.size( ); ++i ) {
+        cout << setw( 8 ) << counts[i] << "  " << shards[i]->name;
+        if( i == 0 ) cout << " (main task file)";
+        if( shards[i]->unreadable ) cout << " (unreadable, not saved)";
+        cout << "\n";
+    }
+    cout << flush;
 }
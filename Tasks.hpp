@@ -6,46 +6,214 @@
 #ifndef TASKS_HPP
 #define TASKS_HPP
 
+#include <cstdint>
+#include <memory>
+
+class TaskList;
+
+//! Refers to a task either by its number in the displayed list (starting at 1) or by its ID.
+/*!
+ * Task numbers change whenever the list is reordered, so a client that can't be sure what the
+ * list looks like (a script talking to the daemon, say) should use IDs, which never change. An
+ * int converts to a task number.
+ */
+class TaskRef {
+public:
+    TaskRef( int task_number ) noexcept : value( static_cast< std::uint64_t >( task_number ) ), by_id( false ) { }
+
+    static TaskRef from_id( std::uint64_t task_id ) noexcept
+        { TaskRef task( 0 ); task.value = task_id; task.by_id = true; return task; }
+
+    bool is_id( ) const noexcept { return by_id; }
+    std::uint64_t id( ) const noexcept { return value; }
+    int number( ) const noexcept { return static_cast< int >( value ); }
+
+private:
+    std::uint64_t value;
+    bool          by_id;
+};
+
+//! Formats in which the task file can be stored.
+enum class TaskFileFormat {
+    text,   //!< One line of text per task.
+    binary, //!< Snapshot with fixed size records and a separate string table.
+    xml     //!< XML document with one element per task.
+};
+
 //! Initializes the task list.
 void initialize_tasks( );
 
+//! Rolls the task list over to a new day if the date has changed since it was last checked.
+/*!
+ * The date is checked by initialize_tasks( ). Processes that run for a long time (such as the
+ * daemon) must call this function before each group of commands.
+ */
+void refresh_date( );
+
+//! Applies the changes that other Pixie processes made to the task list.
+/*!
+ * Only the records that the other processes added to the journal are read, so this costs little
+ * however long the task list is; if another process rewrote the task file, though, the entire
+ * list is loaded again. Changes to the times of a task made by different processes add up. Call
+ * this function before each group of commands (before the task list is displayed, since applying
+ * changes can renumber the tasks). It returns at once if nothing changed.
+ */
+void sync_tasks( );
+
+//! Returns a descriptor that becomes readable when another process might have changed the task list, or -1.
+int task_watch_descriptor( );
+
 //! Releases any resources in use by the task list.
 void cleanup_tasks( );
 
+//! Rewrites the task file in the given format. Later writes use the same format.
+void convert_tasks( TaskFileFormat format );
+
+//! Passes the changes made by the last command to the background save, compacting the journal if necessary.
+void commit_tasks( );
+
+//! Returns an immutable copy of the task list, in priority order.
+/*!
+ * Any thread may call this function; it never waits for a command in progress. Called from the
+ * thread that runs commands (between commands) it returns the current list. Other threads get
+ * the list as last published and cause the next commit_tasks( ) to publish the list again if it
+ * has changed, so a reader polling for snapshots sees each commit soon after it happens. A
+ * snapshot stays valid, and unchanged, for as long as the caller holds it. Include TaskList.hpp
+ * to examine it.
+ */
+std::shared_ptr< const TaskList > task_snapshot( );
+
+//! Returns true if the indicated task exists.
+bool task_exists( TaskRef task ) noexcept;
+
+//! Returns the ID of the indicated task, or zero if there is no such task.
+std::uint64_t task_id( TaskRef task ) noexcept;
+
+//! Returns the number of tasks in the task list.
+int task_count( ) noexcept;
+
+//! Returns an ID, at least at_least, that no task or event in any Pixie process has or will get.
+/*!
+ * Events get their IDs from here so that IDs are unique among all the entities that Pixie keeps.
+ */
+std::uint64_t claim_entity_id( std::uint64_t at_least );
+
 //! Add the specified number of minutes to the indicated task.
-void add_minutes( int task_number, int additional_minutes ) noexcept;
+void add_minutes( TaskRef task, int additional_minutes ) noexcept;
 
 //! Change the daily allocation of the indicated task to the new amount of minutes.
-void change_daily( int task_number, int new_daily ) noexcept;
+void change_daily( TaskRef task, int new_daily );
 
 //! Change priority of the indicated task to the new priority level.
-void change_priority( int task_number, int new_priority ) noexcept;
+void change_priority( TaskRef task, int new_priority ) noexcept;
+
+//! Create a task with the description in [first, last) and the given priority. Other attributes are default.
+void create_task( const char *first, const char *last, int initial_priority );
+
+//! Delete the indicated task.
+void delete_task( TaskRef task ) noexcept;
 
-//! Create a task with the given description and priority. Other attributes are default.
-void create_task( const std::string &new_description, int initial_priority );
+//! Rename the indicated task using the new description text in [first, last).
+void rename( TaskRef task, const char *first, const char *last );
 
-//! Delete a task given it's index in the task list.
-void delete_task( int task_number ) noexcept;
+//! Returns true if [first, last) is "-" or a valid name for a new shard.
+bool is_shard_name( const char *first, const char *last );
 
-//! Rename the indicated task using the new description text.
-void rename( int task_number, const std::string &new_description );
+//! Moves the indicated task to the named shard, which is created if necessary.
+/*!
+ * Shards are files in the .pixie-shards folder next to the task file; "-" names the task file
+ * itself. Returns false if there is no such task or the shard can't be used.
+ */
+bool move_task( TaskRef task, const char *first, const char *last );
 
-//! Save the tasks to the task list used during construction.
+//! Asks for all changes to the task list to be written to disk without waiting for a pause.
+/*!
+ * Changes are saved in the background after each group of commands anyway (see commit_tasks( )).
+ * This function doesn't wait for the disk; tasks_unsaved( ) tells when the changes are there.
+ */
 void save_tasks( );
 
+//! Returns true if some changes to the task list might not be on disk yet.
+bool tasks_unsaved( ) noexcept;
+
 //! Start working on the indicated task.
-void start_task( int task_number ) noexcept;
+void start_task( TaskRef task ) noexcept;
 
-//! Stop working on all active tasks.
+//! Stop working on all active tasks. Each session is recorded in the session history.
 void stop_tasks( ) noexcept;
 
 //! Remove one day's worth of daily allocations.
 void undo_daily( ) noexcept;
 
-//! Zero accumulated times for all tasks. This also stops any active tasks.
+//! Zero accumulated times for all tasks. This also stops any active tasks. The session history is kept.
 void zero_tasks( ) noexcept;
 
-//! Displays all the tasks.
+//! Puts the task list into the order used by display_tasks( ).
+/*!
+ * Normally only tasks that changed since the last call are moved. If from_scratch is true the
+ * entire list is sorted again.
+ */
+void sort_tasks( bool from_scratch = false );
+
+//! Displays the tasks selected by show_tasks( ) or show_page( ); initially all of them.
 void display_tasks( );
 
+//! Makes display_tasks( ) display only the first count tasks, or all tasks if count is zero.
+/*!
+ * A nonzero count also becomes the size of the pages used by show_page( ).
+ */
+void show_tasks( int count ) noexcept;
+
+//! Makes display_tasks( ) display the given page (1 based) of the task list.
+/*!
+ * Pages have the size last given to show_tasks( ), or 20 tasks by default. A page past the end
+ * of the list displays the last page.
+ */
+void show_page( int page ) noexcept;
+
+//! Turns on or off the terminal redraw mode of display_tasks( ).
+/*!
+ * In redraw mode the task list is drawn at the top of the terminal and only the rows that
+ * changed are rewritten. Returns false if the standard output isn't a terminal.
+ */
+bool set_redraw( bool enabled );
+
+//! Displays the minutes spent on each task during each of the given number of weeks (the current week first).
+void display_report( int weeks );
+
+//! Exports the tasks or the session history as described by [first, last) (see parse_export( )).
+/*!
+ * Returns false, explaining in error_message, if the request is bad or the export fails.
+ */
+bool export_records( const char *first, const char *last, const char *&error_message );
+
+//! Displays the tasks whose descriptions contain [first, last), or nearly do, best matches first.
+/*!
+ * Case is ignored. Near matches allow for small typing mistakes. The search index is built the
+ * first time this function is called.
+ */
+void display_matches( const char *first, const char *last );
+
+//! Returns true if [first, last) names a scheduling policy: pixie, stride, deadline, or fair_share.
+bool is_policy_name( const char *first, const char *last ) noexcept;
+
+//! Makes the named scheduling policy the one used by display_next( ). Returns false if there is no such policy.
+/*!
+ * The pixie policy, which is used at first, orders the tasks as the displayed list does (but
+ * takes equivalent tasks in order of ID). The choice isn't saved.
+ */
+bool set_policy( const char *first, const char *last ) noexcept;
+
+//! Displays the task that the current scheduling policy suggests working on next.
+/*!
+ * Only the changes since the last call are examined, so this usually takes logarithmic time.
+ */
+void display_next( );
+
+//! Displays the shards and the number of tasks stored in each.
+void display_shards( );
+
+//! Displays the amount of memory used by the task list.
+void display_memory( );
+
 #endif
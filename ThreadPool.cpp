@@ -0,0 +1,86 @@
+/*! \file    ThreadPool.cpp
+ *  \brief   Fixed set of worker threads for running independent jobs in parallel.
+ *  \author  Peter C. Chapin <pchapin@vtc.edu>
+ */
+
+#include "ThreadPool.hpp"
+
+using namespace std;
+
+ThreadPool::ThreadPool( unsigned thread_count )
+{
+    if( thread_count == 0 ) thread_count = thread::hardware_concurrency( );
+    if( thread_count == 0 ) thread_count = 1;
+    workers.reserve( thread_count - 1 );
+    for( unsigned i = 1; i < thread_count; ++i ) {
+        workers.emplace_back( &ThreadPool::work, this );
+    }
+}
+
+
+ThreadPool::~ThreadPool( )
+{
+    {
+        lock_guard< mutex > guard( lock );
+        stopping = true;
+    }
+    work_ready.notify_all( );
+    for( thread &worker : workers ) worker.join( );
+}
+
+
+void ThreadPool::run( size_t count, const function< void ( size_t ) > &job )
+{
+    if( count == 0 ) return;
+
+    unique_lock< mutex > guard( lock );
+    current       = &job;
+    job_count     = count;
+    next_job      = 0;
+    jobs_finished = 0;
+    failure       = nullptr;
+    ++batch;
+    work_ready.notify_all( );
+
+    take_jobs( guard );
+    work_done.wait( guard, [this]( ) { return jobs_finished == job_count; } );
+    current = nullptr;
+    if( failure ) {
+        exception_ptr error = failure;
+        failure = nullptr;
+        rethrow_exception( error );
+    }
+}
+
+
+void ThreadPool::work( )
+{
+    unsigned long long seen = 0;
+    unique_lock< mutex > guard( lock );
+    for( ;; ) {
+        work_ready.wait( guard, [this, &seen]( ) { return stopping || batch != seen; } );
+        if( stopping ) return;
+        seen = batch;
+        take_jobs( guard );
+    }
+}
+
+
+//! Runs jobs from the current batch until none are left. The lock is released while a job runs.
+void ThreadPool::take_jobs( unique_lock< mutex > &guard )
+{
+    while( next_job < job_count ) {
+        const size_t job = next_job++;
+        guard.unlock( );
+        try {
+            ( *current )( job );
+        }
+        catch( ... ) {
+            guard.lock( );
+            if( !failure ) failure = current_exception( );
+            guard.unlock( );
+        }
+        guard.lock( );
+        if( ++jobs_finished == job_count ) work_done.notify_all( );
+    }
+}
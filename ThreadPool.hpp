@@ -0,0 +1,59 @@
+/*! \file    ThreadPool.hpp
+ *  \brief   Fixed set of worker threads for running independent jobs in parallel.
+ *  \author  Peter C. Chapin <pchapin@vtc.edu>
+ */
+
+#ifndef THREADPOOL_HPP
+#define THREADPOOL_HPP
+
+#include <condition_variable>
+#include <cstddef>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+//! Runs numbered jobs on a fixed set of threads.
+/*!
+ * The threads are started once and wait between batches of jobs. Jobs are handed out one at a
+ * time, so a batch of jobs with very different sizes still keeps every thread busy. The thread
+ * that calls run( ) works on the batch too. Only one thread at a time may call run( ).
+ */
+class ThreadPool {
+public:
+    //! Starts a pool with the given number of threads (counting the caller). Zero means one per core.
+    explicit ThreadPool( unsigned thread_count = 0 );
+   ~ThreadPool( );
+
+    ThreadPool( const ThreadPool & ) = delete;
+    ThreadPool &operator=( const ThreadPool & ) = delete;
+
+    //! Returns the number of threads, counting the one that calls run( ).
+    unsigned size( ) const noexcept { return static_cast< unsigned >( workers.size( ) ) + 1; }
+
+    //! Calls job( i ) for every i in [0, count) and waits until all of the calls have returned.
+    /*!
+     * If any call throws, the remaining jobs still run and the first exception is rethrown.
+     */
+    void run( std::size_t count, const std::function< void ( std::size_t ) > &job );
+
+private:
+    std::vector< std::thread > workers;
+    std::mutex                 lock;          //!< Protects everything below.
+    std::condition_variable    work_ready;
+    std::condition_variable    work_done;
+
+    const std::function< void ( std::size_t ) > *current = nullptr;
+    std::size_t        job_count     = 0;
+    std::size_t        next_job      = 0;
+    std::size_t        jobs_finished = 0;
+    unsigned long long batch         = 0;     //!< Counts calls to run( ) so workers notice new work.
+    std::exception_ptr failure;
+    bool               stopping      = false;
+
+    void work( );
+    void take_jobs( std::unique_lock< std::mutex > &guard );
+};
+
+#endif
@@ -0,0 +1,301 @@
+/*! \file    TrigramIndex.cpp
+ *  \brief   Inverted index of the three letter sequences in task descriptions.
+ *  \author  Peter C. Chapin <pchapin@vtc.edu>
+ */
+
+#include <algorithm>
+#include <cctype>
+#include <string>
+
+#include "TaskList.hpp"
+#include "TrigramIndex.hpp"
+
+using namespace std;
+
+namespace {
+
+    //! Maps each character to its lower case form.
+    struct FoldTable {
+        unsigned char folded[256];
+
+        FoldTable( ) noexcept
+        {
+            for( int ch = 0; ch < 256; ++ch ) folded[ch] = static_cast< unsigned char >( tolower( ch ) );
+        }
+    };
+
+    const FoldTable fold_table;
+
+
+    unsigned char fold( char ch ) noexcept
+    {
+        return fold_table.folded[static_cast< unsigned char >( ch )];
+    }
+
+
+    //! Stores [first, last), in lower case, in text.
+    void fold_text( const char *first, const char *last, string &text )
+    {
+        text.resize( static_cast< std::size_t >( last - first ) );
+        for( std::size_t i = 0; first != last; ++first, ++i ) text[i] = static_cast< char >( fold( *first ) );
+    }
+
+
+    //! Calls action( trigram ) for each trigram of [first, last), including any repeats.
+    template< typename Action >
+    void for_each_trigram( const char *first, const char *last, Action action )
+    {
+        if( last - first < 3 ) return;
+        std::uint32_t trigram = ( static_cast< std::uint32_t >( fold( first[0] ) ) << 8 ) | fold( first[1] );
+        for( const char *current = first + 2; current != last; ++current ) {
+            trigram = ( ( trigram << 8 ) | fold( *current ) ) & 0xFFFFFFU;
+            action( trigram );
+        }
+    }
+
+
+    //! Stores the distinct trigrams of [first, last), sorted, in trigrams.
+    void find_trigrams( const char *first, const char *last, vector< std::uint32_t > &trigrams )
+    {
+        trigrams.clear( );
+        for_each_trigram( first, last, [&trigrams]( std::uint32_t trigram ) { trigrams.push_back( trigram ); } );
+        sort( trigrams.begin( ), trigrams.end( ) );
+        trigrams.erase( unique( trigrams.begin( ), trigrams.end( ) ), trigrams.end( ) );
+    }
+
+
+    //! Adds an ID to a list of IDs in increasing order.
+    void add_id( vector< TaskId > &ids, TaskId task_id )
+    {
+        // New tasks have the largest IDs, so they usually go at the end.
+        if( ids.empty( ) || ids.back( ) < task_id ) {
+            ids.push_back( task_id );
+        }
+        else {
+            const auto position = lower_bound( ids.begin( ), ids.end( ), task_id );
+            if( *position != task_id ) ids.insert( position, task_id );
+        }
+    }
+
+
+    //! Removes an ID from a list of IDs in increasing order. Returns false if it wasn't there.
+    bool remove_id( vector< TaskId > &ids, TaskId task_id ) noexcept
+    {
+        const auto position = lower_bound( ids.begin( ), ids.end( ), task_id );
+        if( position == ids.end( ) || *position != task_id ) return false;
+        ids.erase( position );
+        return true;
+    }
+
+
+    //! Returns the score of a description that contains the (folded) query, or zero if it doesn't.
+    int match_score( const TaskDescription &description, const string &query ) noexcept
+    {
+        const char *const text = description.data( );
+        if( query.size( ) > description.size( ) ) return 0;
+
+        // Case is ignored, so the search compares folded characters one at a time.
+        int score = 0;
+        const std::size_t last_offset = description.size( ) - query.size( );
+        for( std::size_t offset = 0; offset <= last_offset; ++offset ) {
+            if( fold( text[offset] ) != static_cast< unsigned char >( query[0] ) ) continue;
+            std::size_t i = 1;
+            while( i < query.size( ) && fold( text[offset + i] ) == static_cast< unsigned char >( query[i] ) ) ++i;
+            if( i < query.size( ) ) continue;
+
+            if( offset == 0 ) return TrigramIndex::substring_score + 2;
+            if( !isalnum( static_cast< unsigned char >( text[offset - 1] ) ) ) return TrigramIndex::substring_score + 1;
+            score = TrigramIndex::substring_score;
+        }
+        return score;
+    }
+
+}
+
+
+void TrigramIndex::clear( ) noexcept
+{
+    postings.clear( );
+    short_ids.clear( );
+}
+
+
+void TrigramIndex::build( const TaskList &task_list )
+{
+    for( std::size_t i = 0; i < task_list.size( ); ++i ) {
+        const TaskId task_id = task_list.id( i );
+        const TaskDescription description = task_list.description( i );
+        if( description.size( ) < 3 ) short_ids.push_back( task_id );
+        find_trigrams( description.data( ), description.data( ) + description.size( ), trigram_scratch );
+        for( std::uint32_t trigram : trigram_scratch ) postings[trigram].push_back( task_id );
+    }
+    sort( short_ids.begin( ), short_ids.end( ) );
+
+    // Lists loaded from several shards needn't be in ID order.
+    for( auto &entry : postings ) {
+        vector< TaskId > &ids = entry.second;
+        if( !is_sorted( ids.begin( ), ids.end( ) ) ) sort( ids.begin( ), ids.end( ) );
+    }
+}
+
+
+void TrigramIndex::insert( TaskId task_id, const char *first, const char *last )
+{
+    if( last - first < 3 ) add_id( short_ids, task_id );
+    find_trigrams( first, last, trigram_scratch );
+    for( std::uint32_t trigram : trigram_scratch ) add_id( postings[trigram], task_id );
+}
+
+
+// Repeated trigrams are looked up again; by then the ID is already gone.
+void TrigramIndex::erase( TaskId task_id, const char *first, const char *last ) noexcept
+{
+    if( last - first < 3 ) remove_id( short_ids, task_id );
+    for_each_trigram( first, last, [this, task_id]( std::uint32_t trigram ) {
+        const auto entry = postings.find( trigram );
+        if( entry == postings.end( ) ) return;
+        if( remove_id( entry->second, task_id ) && entry->second.empty( ) ) postings.erase( entry );
+    } );
+}
+
+
+vector< TrigramIndex::Match > TrigramIndex::search( const TaskList &task_list,
+                                                    const char *first,
+                                                    const char *last,
+                                                    std::size_t limit,
+                                                    std::size_t &total ) const
+{
+    vector< Match > matches;
+    string query;
+    vector< std::uint32_t > trigrams;
+
+    fold_text( first, last, query );
+    find_trigrams( first, last, trigrams );
+    total = 0;
+    if( query.empty( ) ) return matches;
+
+    if( query.size( ) == 1 ) {
+        // Every description must be examined.
+        for( std::size_t i = 0; i < task_list.size( ); ++i ) {
+            const int score = match_score( task_list.description( i ), query );
+            if( score != 0 ) matches.push_back( Match{ task_list.id( i ), i, score } );
+        }
+    }
+    else if( query.size( ) == 2 ) {
+        // A description of three or more characters that contains the query has a trigram that
+        // starts or ends with it. Shorter descriptions are checked directly.
+        const std::uint32_t pair = ( static_cast< std::uint32_t >( fold( query[0] ) ) << 8 ) | fold( query[1] );
+        vector< TaskId > candidates( short_ids );
+        for( std::uint32_t ch = 0; ch < 256; ++ch ) {
+            for( std::uint32_t trigram : { ( pair << 8 ) | ch, ( ch << 16 ) | pair } ) {
+                const auto entry = postings.find( trigram );
+                if( entry != postings.end( ) ) candidates.insert( candidates.end( ), entry->second.begin( ), entry->second.end( ) );
+            }
+        }
+        sort( candidates.begin( ), candidates.end( ) );
+        candidates.erase( unique( candidates.begin( ), candidates.end( ) ), candidates.end( ) );
+        for( TaskId candidate : candidates ) {
+            const std::size_t position = task_list.find( candidate );
+            if( position == TaskList::npos ) continue;
+            const int score = match_score( task_list.description( position ), query );
+            if( score != 0 ) matches.push_back( Match{ candidate, position, score } );
+        }
+    }
+    else {
+        // The lists of IDs for the query's trigrams, shortest first.
+        static const vector< TaskId > no_ids;
+        vector< const vector< TaskId > * > lists;
+        for( std::uint32_t trigram : trigrams ) {
+            const auto entry = postings.find( trigram );
+            lists.push_back( entry == postings.end( ) ? &no_ids : &entry->second );
+        }
+        sort( lists.begin( ), lists.end( ), []( const vector< TaskId > *left, const vector< TaskId > *right ) {
+            return left->size( ) < right->size( );
+        } );
+        const std::size_t count = lists.size( );
+
+        // A task that contains the query has all of its trigrams, so it is in the shortest list.
+        // The IDs are in increasing order, so the search in each list resumes where it stopped.
+        vector< std::size_t > cursors( count, 0 );
+        vector< TaskId > found;
+        for( TaskId candidate : *lists[0] ) {
+            std::size_t i = 1;
+            for( ; i < count; ++i ) {
+                const vector< TaskId > &ids = *lists[i];
+                const auto position = lower_bound( ids.begin( ) + cursors[i], ids.end( ), candidate );
+                cursors[i] = static_cast< std::size_t >( position - ids.begin( ) );
+                if( position == ids.end( ) || *position != candidate ) break;
+            }
+            if( i < count ) continue;
+
+            const std::size_t position = task_list.find( candidate );
+            if( position == TaskList::npos ) continue;
+            const int score = match_score( task_list.description( position ), query );
+            if( score == 0 ) continue;
+            matches.push_back( Match{ candidate, position, score } );
+            found.push_back( candidate );
+        }
+
+        // Near matches rank below every task that contains the query, so they are only needed if
+        // there are too few of those. A trigram that appears in more than an eighth of the tasks
+        // (in a long list) says little about which task is meant, so only the others (the "rare"
+        // trigrams) count.
+        // A near match needs a third of the rare trigrams, and there must be at least three of
+        // them to judge. Any task with that many is in at least one of the (rare - needed + 1)
+        // shortest lists; those tasks are the candidates.
+        const std::size_t common = max< std::size_t >( task_list.size( ) / 8, 64 );
+        std::size_t rare = 0;
+        while( rare < count && lists[rare]->size( ) <= common ) ++rare;
+        if( matches.size( ) < limit && rare >= 3 ) {
+            const std::size_t needed = ( rare + 2 ) / 3;
+            vector< TaskId > candidates;
+            for( std::size_t i = 0; i < rare - needed + 1; ++i ) {
+                candidates.insert( candidates.end( ), lists[i]->begin( ), lists[i]->end( ) );
+            }
+            sort( candidates.begin( ), candidates.end( ) );
+            candidates.erase( unique( candidates.begin( ), candidates.end( ) ), candidates.end( ) );
+
+            fill( cursors.begin( ), cursors.end( ), 0 );
+            for( TaskId candidate : candidates ) {
+                std::size_t shared = 0;
+                for( std::size_t i = 0; i < rare && shared + ( rare - i ) >= needed; ++i ) {
+                    const vector< TaskId > &ids = *lists[i];
+                    const auto position = lower_bound( ids.begin( ) + cursors[i], ids.end( ), candidate );
+                    cursors[i] = static_cast< std::size_t >( position - ids.begin( ) );
+                    if( position != ids.end( ) && *position == candidate ) ++shared;
+                }
+                if( shared < needed || binary_search( found.begin( ), found.end( ), candidate ) ) continue;
+
+                const std::size_t position = task_list.find( candidate );
+                if( position == TaskList::npos ) continue;
+                const int score = min( substring_score - 1, static_cast< int >( 100 * shared / rare ) );
+                matches.push_back( Match{ candidate, position, score } );
+            }
+        }
+    }
+
+
+    total = matches.size( );
+    const auto better = []( const Match &left, const Match &right ) {
+        return left.score > right.score || ( left.score == right.score && left.position < right.position );
+    };
+    if( matches.size( ) > limit ) {
+        partial_sort( matches.begin( ), matches.begin( ) + limit, matches.end( ), better );
+        matches.resize( limit );
+    }
+    else {
+        sort( matches.begin( ), matches.end( ), better );
+    }
+    return matches;
+}
+
+
+std::size_t TrigramIndex::memory_used( ) const noexcept
+{
+    // Each entry of the hash table is assumed to cost a node plus a bucket pointer.
+    std::size_t used = postings.bucket_count( ) * sizeof( void * ) + short_ids.capacity( ) * sizeof( TaskId );
+    for( const auto &entry : postings ) {
+        used += sizeof( entry ) + 2 * sizeof( void * ) + entry.second.capacity( ) * sizeof( TaskId );
+    }
+    return used;
+}
@@ -0,0 +1,79 @@
+/*! \file    TrigramIndex.hpp
+ *  \brief   Inverted index of the three letter sequences in task descriptions.
+ *  \author  Peter C. Chapin <pchapin@vtc.edu>
+ */
+
+#ifndef TRIGRAMINDEX_HPP
+#define TRIGRAMINDEX_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+#include "PixieTask.hpp"
+
+class TaskList;
+
+//! Finds tasks by their descriptions without examining every description.
+/*!
+ * For each trigram (sequence of three characters, ignoring case) the index holds the IDs of
+ * the tasks with that trigram in their description, in increasing order. A task can only
+ * contain a query if it has every trigram of the query, so the shortest lists of IDs narrow the
+ * search to a few candidates that are then checked directly. A task that has many of the
+ * query's trigrams, but not all of them, is reported as a near match; this catches small typing
+ * mistakes. Trigrams that are common to many tasks are ignored when looking for near matches.
+ * Queries of two characters use the trigrams that begin or end with them; a query of a single
+ * character is compared with every description.
+ *
+ * The index is keyed by ID so that reordering the task list doesn't affect it. The owner of the
+ * list must tell the index about each description that is added or removed.
+ */
+class TrigramIndex {
+public:
+    //! A task found by search( ).
+    struct Match {
+        TaskId      id;
+        std::size_t position;  //!< Position of the task in the list that was searched.
+        int         score;     //!< See search( ).
+    };
+
+    static const int substring_score = 100;  //!< Lowest score of a task that contains the query.
+
+    //! Removes every task from the index.
+    void clear( ) noexcept;
+
+    //! Indexes every task in a list. The index must be empty.
+    void build( const TaskList &task_list );
+
+    //! Adds a task with the description [first, last).
+    void insert( TaskId task_id, const char *first, const char *last );
+
+    //! Removes a task that was added with the description [first, last).
+    void erase( TaskId task_id, const char *first, const char *last ) noexcept;
+
+    //! Returns the tasks in the list whose descriptions match [first, last), best matches first.
+    /*!
+     * A task whose description contains the query (ignoring case) scores at least
+     * substring_score: more if the match starts a word and most if it starts the description.
+     * A near match scores the percentage of the query's trigrams that the description has. Tasks
+     * with the same score are in list order. Near matches are only looked for if fewer than limit
+     * tasks contain the query. At most limit matches are returned; total is set to the number
+     * found. The index must describe the list.
+     */
+    std::vector< Match > search( const TaskList &task_list,
+                                 const char *first,
+                                 const char *last,
+                                 std::size_t limit,
+                                 std::size_t &total ) const;
+
+    //! Returns the number of bytes allocated by the index.
+    std::size_t memory_used( ) const noexcept;
+
+private:
+    std::unordered_map< std::uint32_t, std::vector< TaskId > > postings;  //!< IDs for each trigram.
+    std::vector< TaskId >        short_ids;  //!< Tasks with descriptions too short to have trigrams.
+    std::vector< std::uint32_t > trigram_scratch;
+};
+
+#endif
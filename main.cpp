@@ -18,167 +18,215 @@
  * 
  */
 
+#include <chrono>
 #include <cstdlib>
 #include <cstring>
+#include <fstream>
+#include <iomanip>
 #include <iostream>
+#include <sstream>
 #include <stdexcept>
 #include <string>
-#include <vector>
 
+#include "CommandTrace.hpp"
+#include "Commands.hpp"
+#include "Daemon.hpp"
+#include "Events.hpp"
+#include "Statistics.hpp"
 #include "Tasks.hpp"
 
 using namespace std;
 
 namespace {
 
-    //! Splits the command line into separate words.
+    string statistics_file;  //!< Where statistics are written when Pixie exits (if not empty).
+
+    //! Writes the statistics to statistics_file. Registered with atexit( ).
+    void dump_statistics( )
+    {
+        if( !write_statistics( statistics_file ) ) {
+            cerr << "Unable to write statistics to " << statistics_file << endl;
+        }
+    }
+
+    //! Executes commands read from the given stream, one per line.
     /*!
-     * This function does basic command line splitting based on the given delimiters.
+     * Nothing is displayed between commands. The task list is put in order when the batch starts
+     * and otherwise only by the commands that need it in order (save, next, and export) or when
+     * the date changes, so until then task numbers refer to the order in which the tasks were
+     * displayed when the batch started. Deleting a task gives its number to the last task in the
+     * list. One status line is printed for each command followed by a summary. Returns the
+     * program's exit code.
      */
-    static vector<string> split_string(
-        const string  &buffer,         // String to be split.
-        const char    *delimiters      // String of delimiter characters.
-    )
+    int run_batch( istream &commands )
     {
-        enum State { START, IN_WORD };
-
-        State             current_state = START;
-        string::size_type buffer_offset;
-        vector<string>    strings;
+        using namespace std::chrono;
+
+        string        command_line;
+        unsigned long command_count = 0;
+        unsigned long error_count   = 0;
+        const steady_clock::time_point start = steady_clock::now( );
+
+        sync_tasks( );
+        sort_tasks( );
+        while( getline( commands, command_line ) ) {
+            const char *error_message = "";
+            const CommandStatus status = process_command( command_line, error_message );
+
+            ++command_count;
+            if( status == CommandStatus::error ) {
+                ++error_count;
+                cout << command_count << ": error: " << error_message << ": " << command_line << "\n";
+            }
+            else {
+                cout << command_count << ": ok\n";
+            }
+            if( status == CommandStatus::quit || status == CommandStatus::shutdown ) break;
+        }
 
-        buffer_offset = 0;
-        while( buffer_offset != buffer.size( ) ) {
-            char ch = buffer[buffer_offset];
+        const long long elapsed =
+            duration_cast< microseconds >( steady_clock::now( ) - start ).count( );
+        cout << command_count << " commands, " << error_count << " errors, "
+             << elapsed / 1000 << "." << setfill( '0' ) << setw( 3 ) << elapsed % 1000 << " ms" << endl;
+        return ( error_count == 0 ) ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+}
 
-            switch( current_state ) {
-            case START:
-                if( strchr( delimiters, ch ) != 0 ) {
-                    current_state = START;
-                }
-                else {
-                    current_state = IN_WORD;
-                    strings.push_back( string( 1, ch ) );
-                }
-                break;
 
-            case IN_WORD:
-                if( strchr( delimiters, ch ) != 0 ) {
-                    current_state = START;
-                }
-                else {
-                    strings.back( ).append( 1, ch );
+//! Pixie entry point.
+int main( int argc, char **argv )
+{
+    string command_line;
+    int    rc = EXIT_SUCCESS;
+ 
+    try {
+        // These options may precede the others. pixie --stats collects statistics for the stats
+        // command and --stats-file also writes them to the named file when Pixie exits. pixie
+        // --redraw updates the task list in place on the terminal instead of printing it again
+        // after each command. pixie --trace file records the commands in the named file for
+        // pixie-replay.
+        bool redraw = false;
+        while( argc >= 2 ) {
+            if( strcmp( argv[1], "--redraw" ) == 0 ) {
+                redraw = true;
+            }
+            else if( strcmp( argv[1], "--stats" ) == 0 ) {
+                enable_statistics( true );
+            }
+            else if( argc >= 3 && strcmp( argv[1], "--stats-file" ) == 0 ) {
+                enable_statistics( true );
+                statistics_file = argv[2];
+                atexit( dump_statistics );
+                --argc;
+                ++argv;
+            }
+            else if( argc >= 3 && strcmp( argv[1], "--trace" ) == 0 ) {
+                if( !start_trace( argv[2] ) ) {
+                    cerr << "Pixie: Can't create trace file: " << argv[2] << "\n";
+                    return EXIT_FAILURE;
                 }
+                atexit( stop_trace );
+                --argc;
+                ++argv;
+            }
+            else {
                 break;
             }
-
-            buffer_offset++;
+            --argc;
+            ++argv;
         }
-        
-        return strings;
-     }
-
 
-    bool process_command( const string &command_line )
-    {
-        vector<string> command_parts;
-        vector<string>::size_type argument_count;
-
-        command_parts = split_string( command_line, " " );
-        argument_count = command_parts.size( );
-
-        if( argument_count == 0 ) return true;
-
-        if( command_parts[0] == "help" ) {
-            cout << "quit                    : Terminate Pixie, saving automatically\n"
-                 << "add task_no minutes     : Adds 'minutes' to task 'task_no'\n"
-                 << "create task_name        : Creates a task 'task_name'. The name can contain spaces\n"
-                 << "daily task_no minutes   : Sets task 'task_no' to have 'minutes' daily minutes\n"
-                 << "delete task_no          : Deletes task 'task_no'\n"
-                 << "priority task_no, pri   : Sets task 'task_no' to priority 'pri'\n"
-                 << "rename task_no new_name : Changes task 'task_no' to the name 'new_name'\n"
-                 << "save                    : Saves current state\n"
-                 << "start task_no           : Starts task 'task_no'\n"
-                 << "stop                    : Stops the currently running task\n"
-                 << "undo_daily              : Removes one day's worth of daily accumulation from all tasks \n"
-                 << "zero                    : Sets all times to zero \n";
-            return true;
+        // pixie --client command... sends the commands to a daemon started with pixie --daemon.
+        // The task file isn't read here; the daemon holds the task list.
+        if( argc >= 2 && strcmp( argv[1], "--client" ) == 0 ) {
+            return run_client( argc - 2, argv + 2 );
         }
-
-        if( command_parts[0] == "quit" ) {
-            return false;
-        }
-        else if( command_parts[0] == "add" ) {
-            if( argument_count == 3 ) {
-                add_minutes( atoi( command_parts[1].c_str( ) ), atoi( command_parts[2].c_str( ) ) );
-            }
+        if( argc == 2 && strcmp( argv[1], "--daemon" ) == 0 ) {
+            return run_daemon( );
         }
-        else if( command_parts[0] == "create" ) {
-            // This is kind of hacked.
-            const string::size_type index = command_line.find_first_of( ' ' );
-            if( index != string::npos ) {
-                create_task( command_line.substr( index + 1 ), 50 );
-            }
+        initialize_tasks( );
+
+        // pixie --binary, pixie --text, or pixie --xml converts the task file and exits.
+        if( argc == 2 && ( strcmp( argv[1], "--binary" ) == 0 || strcmp( argv[1], "--text" ) == 0 ||
+                           strcmp( argv[1], "--xml" ) == 0 ) ) {
+            TaskFileFormat format = TaskFileFormat::text;
+            if( strcmp( argv[1], "--binary" ) == 0 ) format = TaskFileFormat::binary;
+            if( strcmp( argv[1], "--xml"    ) == 0 ) format = TaskFileFormat::xml;
+            convert_tasks( format );
+            cleanup_tasks( );
+            return rc;
         }
-        else if( command_parts[0] == "daily" ) {
-            if( argument_count == 3 ) {
-                change_daily( atoi( command_parts[1].c_str( ) ), atoi( command_parts[2].c_str( ) ) );
+
+        // pixie --export what format file... exports the tasks or sessions (see the export
+        // command) and exits.
+        if( argc >= 2 && strcmp( argv[1], "--export" ) == 0 ) {
+            string request;
+            for( int i = 2; i < argc; ++i ) {
+                if( i > 2 ) request += ' ';
+                request += argv[i];
             }
-        }
-        else if( command_parts[0] == "delete" ) {
-            if( argument_count == 2 ) {
-                delete_task( atoi( command_parts[1].c_str( ) ) );
+            const char *error_message = "";
+            sync_tasks( );
+            if( !export_records( request.data( ), request.data( ) + request.size( ), error_message ) ) {
+                cerr << "Pixie: " << error_message << "\n";
+                rc = EXIT_FAILURE;
             }
+            cleanup_tasks( );
+            return rc;
         }
-        else if( command_parts[0] == "priority" ) {
-            if( argument_count == 3 ) {
-                change_priority( atoi( command_parts[1].c_str( ) ), atoi( command_parts[2].c_str( ) ) );
-            }
+
+        // Batch mode. pixie -b reads commands from the standard input, pixie -f file reads them
+        // from a file, and pixie -c command... takes each remaining argument as a command.
+        if( argc >= 2 && strcmp( argv[1], "-b" ) == 0 ) {
+            rc = run_batch( cin );
+            cleanup_events( );
+            cleanup_tasks( );
+            return rc;
         }
-        else if( command_parts[0] == "rename" ) {
-            // This is kind of hacked.
-            string::size_type index = command_line.find_first_of( ' ' );
-            index = command_line.find_first_of( ' ', index + 1 );
-            if( index != string::npos ) {
-                rename( atoi( command_parts[1].c_str( ) ), command_line.substr( index + 1 ) );
+        if( argc == 3 && strcmp( argv[1], "-f" ) == 0 ) {
+            ifstream command_file( argv[2] );
+            if( !command_file ) {
+                cerr << "Pixie: Can't open command file: " << argv[2] << "\n";
+                cleanup_events( );
+                cleanup_tasks( );
+                return EXIT_FAILURE;
             }
+            rc = run_batch( command_file );
+            cleanup_events( );
+            cleanup_tasks( );
+            return rc;
         }
-        else if( command_parts[0] == "save" ) {
-            save_tasks( );
-        }
-        else if( command_parts[0] == "start" ) {
-            if( argument_count == 2 ) {
-                start_task( atoi( command_parts[1].c_str( ) ) );
+        if( argc >= 2 && strcmp( argv[1], "-c" ) == 0 ) {
+            stringstream commands;
+            for( int i = 2; i < argc; ++i ) {
+                commands << argv[i] << '\n';
             }
-        }
-        else if( command_parts[0] == "stop" ) {
-            stop_tasks( );
-        }
-        else if( command_parts[0] == "undo_daily" ) {
-            undo_daily( );
-        }
-        else if( command_parts[0] == "zero" ) {
-            zero_tasks( );
+            rc = run_batch( commands );
+            cleanup_events( );
+            cleanup_tasks( );
+            return rc;
         }
 
-        return true;
-    }
-}
-
-
-//! Pixie entry point.
-int main( int argc, char **argv )
-{
-    string command_line;
-    int    rc = EXIT_SUCCESS;
- 
-    try {
-        initialize_tasks( );
+        if( redraw ) set_redraw( true );
         while( 1 ) {
+            const char *error_message = "";
+
+            // Changes made by other processes are applied before the list is displayed so that
+            // task numbers refer to what the user sees.
+            sync_tasks( );
             display_tasks( );
-            cout << "> " << flush;
-            getline( cin, command_line );
-            if( !process_command( command_line ) ) break;
+            // The prompt starts with * while changes are waiting to be saved.
+            cout << ( tasks_unsaved( ) ? "*> " : "> " ) << flush;
+            if( !getline( cin, command_line ) ) break;
+
+            const CommandStatus status = process_command( command_line, error_message );
+            if( status == CommandStatus::quit || status == CommandStatus::shutdown ) break;
+            if( status == CommandStatus::error ) {
+                cout << "Pixie: " << error_message << "\n";
+            }
+            commit_tasks( );
         }
+        cleanup_events( );
         cleanup_tasks( );
     }
     catch( exception &e ) {